@@ -0,0 +1,17 @@
+#include "AST.h"
+
+/*
+    This file implements the helper functions for the AST nodes.
+*/
+
+namespace ntsc {
+// This is the implementation of the function that returns the name of a
+// NodeKind.
+auto getNodeKindName(NodeKind kind) -> const char * {
+    static const char *const names[] = {
+#define NODE(name) #name,
+#include "NodeKinds.def"
+    };
+    return names[static_cast<uint8_t>(kind)];
+}
+} // namespace ntsc
@@ -0,0 +1,400 @@
+#ifndef NTSC_AST_H
+#define NTSC_AST_H
+#include "IdentifierTable.h"
+#include "Token.h"
+#include <cstdint>
+#include <type_traits>
+
+/*
+    This file defines the nodes of the AST. Nodes are allocated from the arena
+    of an ASTContext and are never destroyed one at a time, so they must be
+    trivially destructible. To keep them small, a node refers to its children
+    through 32 bit NodeRefs into the arena instead of pointers, locations are
+    byte offsets into the source file, and the kind is a single byte. The
+    classof methods let the LLVM casting functions check the kind of a node.
+*/
+
+namespace ntsc {
+// This enum holds the kind of every node in NodeKinds.def.
+enum class NodeKind : uint8_t {
+#define NODE(name) name,
+#include "NodeKinds.def"
+};
+
+// This function will return the name of the given NodeKind for debugging
+// purposes.
+auto getNodeKindName(NodeKind kind) -> const char *;
+
+// This class is a reference to a node in the arena of an ASTContext. A
+// reference of 0 is null, which marks a missing optional child.
+class NodeRef {
+    uint32_t index = 0;
+
+  public:
+    NodeRef() = default;
+    explicit NodeRef(uint32_t index) : index{index} {}
+
+    [[nodiscard]] inline auto isValid() const -> bool { return index != 0; }
+    [[nodiscard]] inline auto getIndex() const -> uint32_t { return index; }
+
+    inline auto operator==(NodeRef other) const -> bool {
+        return index == other.index;
+    }
+    inline auto operator!=(NodeRef other) const -> bool {
+        return index != other.index;
+    }
+};
+
+// This struct is a list of children, such as the statements of a block. The
+// references are stored contiguously in the arena.
+struct NodeList {
+    uint32_t first = 0;
+    uint32_t count = 0;
+};
+
+// These are the flags that may be set on a node.
+namespace nodeflags {
+// The parameter, property or declaration is marked with '?'.
+constexpr uint8_t optional = 1 << 0;
+// The parameter is a rest parameter.
+constexpr uint8_t rest = 1 << 1;
+// The access or call is part of an optional chain, as in 'a?.b'.
+constexpr uint8_t optionalChain = 1 << 2;
+// The class member is static.
+constexpr uint8_t isStatic = 1 << 3;
+// The node was recovered from a syntax error.
+constexpr uint8_t recovered = 1 << 7;
+} // namespace nodeflags
+
+// This enum holds the keyword that introduces a VariableStatement.
+enum class DeclarationKeyword : uint16_t { Var, Let, Const };
+
+// This is the header of every node. It is 12 bytes, and the data field holds
+// a small payload for the nodes that need one, such as the operator of a
+// BinaryExpression.
+struct Node {
+    NodeKind kind;
+    uint8_t flags;
+    uint16_t data;
+    uint32_t offset;
+    uint32_t length;
+
+    [[nodiscard]] inline auto hasFlag(uint8_t flag) const -> bool {
+        return (flags & flag) != 0;
+    }
+};
+static_assert(sizeof(Node) == 12, "the node header should be 12 bytes");
+
+// These are the base classes of each category. They only add a classof
+// method, which checks the range of the category.
+#define NODE_RANGE(category, first, last)                                      \
+    struct category : Node {                                                   \
+        static inline auto classof(const Node *node) -> bool {                 \
+            return node->kind >= NodeKind::first &&                            \
+                   node->kind <= NodeKind::last;                               \
+        }                                                                      \
+    };
+#include "NodeKinds.def"
+
+// This macro will define the kind of a concrete node, which the ASTContext
+// sets when the node is created, and its classof method.
+#define NTSC_NODE(name)                                                        \
+    static constexpr auto nodeKind = NodeKind::name;                           \
+    static inline auto classof(const Node *node) -> bool {                     \
+        return node->kind == nodeKind;                                         \
+    }
+
+// Nodes that are not part of a category
+// This node is named apart from its kind, since SourceFile is the class that
+// holds the text of the file.
+struct SourceFileNode : Node {
+    NodeList statements;
+    NTSC_NODE(SourceFile)
+};
+
+struct Parameter : Node {
+    NodeRef name;
+    NodeRef type;
+    NodeRef initializer;
+    NTSC_NODE(Parameter)
+};
+
+struct VariableDeclaration : Node {
+    NodeRef name;
+    NodeRef type;
+    NodeRef initializer;
+    NTSC_NODE(VariableDeclaration)
+};
+
+struct PropertyAssignment : Node {
+    NodeRef name;
+    NodeRef initializer;
+    NTSC_NODE(PropertyAssignment)
+};
+
+// Statements
+struct Block : Statement {
+    NodeList statements;
+    NTSC_NODE(Block)
+};
+
+struct EmptyStatement : Statement {
+    NTSC_NODE(EmptyStatement)
+};
+
+struct ExpressionStatement : Statement {
+    NodeRef expression;
+    NTSC_NODE(ExpressionStatement)
+};
+
+struct VariableStatement : Statement {
+    NodeList declarations;
+    [[nodiscard]] inline auto getKeyword() const -> DeclarationKeyword {
+        return static_cast<DeclarationKeyword>(data);
+    }
+    NTSC_NODE(VariableStatement)
+};
+
+struct IfStatement : Statement {
+    NodeRef condition;
+    NodeRef thenStatement;
+    NodeRef elseStatement;
+    NTSC_NODE(IfStatement)
+};
+
+struct WhileStatement : Statement {
+    NodeRef condition;
+    NodeRef body;
+    NTSC_NODE(WhileStatement)
+};
+
+struct DoStatement : Statement {
+    NodeRef body;
+    NodeRef condition;
+    NTSC_NODE(DoStatement)
+};
+
+struct ForStatement : Statement {
+    NodeRef initializer;
+    NodeRef condition;
+    NodeRef update;
+    NodeRef body;
+    NTSC_NODE(ForStatement)
+};
+
+struct ReturnStatement : Statement {
+    NodeRef expression;
+    NTSC_NODE(ReturnStatement)
+};
+
+struct BreakStatement : Statement {
+    NodeRef label;
+    NTSC_NODE(BreakStatement)
+};
+
+struct ContinueStatement : Statement {
+    NodeRef label;
+    NTSC_NODE(ContinueStatement)
+};
+
+struct FunctionDeclaration : Statement {
+    NodeRef name;
+    NodeList parameters;
+    NodeRef returnType;
+    NodeRef body;
+    NTSC_NODE(FunctionDeclaration)
+};
+
+struct ClassDeclaration : Statement {
+    NodeRef name;
+    NodeRef baseClass;
+    NodeList members;
+    NTSC_NODE(ClassDeclaration)
+};
+
+struct PropertyDeclaration : Statement {
+    NodeRef name;
+    NodeRef type;
+    NodeRef initializer;
+    NTSC_NODE(PropertyDeclaration)
+};
+
+struct MethodDeclaration : Statement {
+    NodeRef name;
+    NodeList parameters;
+    NodeRef returnType;
+    NodeRef body;
+    NTSC_NODE(MethodDeclaration)
+};
+
+struct TypeAliasDeclaration : Statement {
+    NodeRef name;
+    NodeRef type;
+    NTSC_NODE(TypeAliasDeclaration)
+};
+
+// Expressions
+struct Identifier : Expression {
+    Symbol name;
+    NTSC_NODE(Identifier)
+};
+
+// The value is stored in the node, so the TokenBuffer does not need to
+// outlive the AST.
+struct NumberLiteral : Expression {
+    double value;
+    NTSC_NODE(NumberLiteral)
+};
+
+// The limbs are stored in the arena, least significant first.
+struct BigIntLiteral : Expression {
+    uint32_t limbs;
+    uint32_t limbCount;
+    NTSC_NODE(BigIntLiteral)
+};
+
+struct StringLiteral : Expression {
+    Symbol value;
+    NTSC_NODE(StringLiteral)
+};
+
+struct TrueLiteral : Expression {
+    NTSC_NODE(TrueLiteral)
+};
+
+struct FalseLiteral : Expression {
+    NTSC_NODE(FalseLiteral)
+};
+
+struct NullLiteral : Expression {
+    NTSC_NODE(NullLiteral)
+};
+
+struct ThisExpression : Expression {
+    NTSC_NODE(ThisExpression)
+};
+
+struct ArrayLiteral : Expression {
+    NodeList elements;
+    NTSC_NODE(ArrayLiteral)
+};
+
+struct ObjectLiteral : Expression {
+    NodeList properties;
+    NTSC_NODE(ObjectLiteral)
+};
+
+struct ParenthesizedExpression : Expression {
+    NodeRef expression;
+    NTSC_NODE(ParenthesizedExpression)
+};
+
+// The operator of the unary and binary expressions is the TokenKind of its
+// punctuator or keyword, which is held in the data field.
+struct PrefixUnaryExpression : Expression {
+    NodeRef operand;
+    [[nodiscard]] inline auto getOperator() const -> TokenKind {
+        return static_cast<TokenKind>(data);
+    }
+    NTSC_NODE(PrefixUnaryExpression)
+};
+
+struct PostfixUnaryExpression : Expression {
+    NodeRef operand;
+    [[nodiscard]] inline auto getOperator() const -> TokenKind {
+        return static_cast<TokenKind>(data);
+    }
+    NTSC_NODE(PostfixUnaryExpression)
+};
+
+// Assignments and the comma operator are binary expressions too.
+struct BinaryExpression : Expression {
+    NodeRef left;
+    NodeRef right;
+    [[nodiscard]] inline auto getOperator() const -> TokenKind {
+        return static_cast<TokenKind>(data);
+    }
+    NTSC_NODE(BinaryExpression)
+};
+
+struct ConditionalExpression : Expression {
+    NodeRef condition;
+    NodeRef whenTrue;
+    NodeRef whenFalse;
+    NTSC_NODE(ConditionalExpression)
+};
+
+struct CallExpression : Expression {
+    NodeRef callee;
+    NodeList arguments;
+    NTSC_NODE(CallExpression)
+};
+
+struct NewExpression : Expression {
+    NodeRef callee;
+    NodeList arguments;
+    NTSC_NODE(NewExpression)
+};
+
+struct PropertyAccessExpression : Expression {
+    NodeRef object;
+    NodeRef name;
+    NTSC_NODE(PropertyAccessExpression)
+};
+
+struct ElementAccessExpression : Expression {
+    NodeRef object;
+    NodeRef index;
+    NTSC_NODE(ElementAccessExpression)
+};
+
+struct ArrowFunction : Expression {
+    NodeList parameters;
+    NodeRef returnType;
+    NodeRef body;
+    NTSC_NODE(ArrowFunction)
+};
+
+// Type annotations
+// The keyword, such as number or string, is the TokenKind held in the data
+// field.
+struct KeywordType : Type {
+    [[nodiscard]] inline auto getKeyword() const -> TokenKind {
+        return static_cast<TokenKind>(data);
+    }
+    NTSC_NODE(KeywordType)
+};
+
+struct TypeReference : Type {
+    NodeRef name;
+    NodeList typeArguments;
+    NTSC_NODE(TypeReference)
+};
+
+struct ArrayType : Type {
+    NodeRef elementType;
+    NTSC_NODE(ArrayType)
+};
+
+struct UnionType : Type {
+    NodeList types;
+    NTSC_NODE(UnionType)
+};
+
+struct FunctionType : Type {
+    NodeList parameters;
+    NodeRef returnType;
+    NTSC_NODE(FunctionType)
+};
+
+#undef NTSC_NODE
+
+// The most common nodes should stay within a cache line of each other.
+static_assert(sizeof(Identifier) == 16, "Identifier should be 16 bytes");
+static_assert(sizeof(BinaryExpression) == 20,
+              "BinaryExpression should be 20 bytes");
+static_assert(sizeof(CallExpression) == 24,
+              "CallExpression should be 24 bytes");
+} // namespace ntsc
+
+#endif
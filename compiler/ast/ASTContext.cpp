@@ -0,0 +1,294 @@
+#include "ASTContext.h"
+#include "llvm/Support/ErrorHandling.h"
+#include <algorithm>
+
+/*
+    This file implements the ASTContext interface.
+*/
+
+namespace ntsc {
+// This is the implementation of the primary constructor. No slab is allocated
+// until the first node is created.
+ASTContext::ASTContext(const SourceFile &file) : file{file} {}
+
+// This is the implementation of the method to start a slab. The slab after
+// the current one is used, unless the object is too large for it, in which
+// case the slabs in between are skipped. The first unit of the arena is never
+// used, since a NodeRef of 0 is null.
+auto ASTContext::startSlab(size_t units) -> void {
+    auto slab = endUnit == 0 ? 0 : getSlab(endUnit - 1) + 1;
+    for (; slab < maxSlabs; ++slab) {
+        auto start = getSlabStart(slab) + (slab == 0 ? 2 : 0);
+        if (getSlabStart(slab + 1) - start >= units)
+            break;
+    }
+    if (slab >= maxSlabs)
+        llvm::report_fatal_error("the AST of a file is larger than 16 GiB");
+
+    auto slabSize = (size_t{1} << (slab + firstSlabBits)) * unitSize;
+    slabs[slab] =
+        static_cast<char *>(allocator.Allocate(slabSize, alignof(uint64_t)));
+    nextUnit = getSlabStart(slab) + (slab == 0 ? 2 : 0);
+    endUnit = getSlabStart(slab + 1);
+}
+
+// This is the implementation of the method to create a list. Empty lists do
+// not use the arena.
+auto ASTContext::createList(llvm::ArrayRef<NodeRef> refs) -> NodeList {
+    if (refs.empty())
+        return {};
+    auto unit = allocateUnits(refs.size() * sizeof(NodeRef), alignof(NodeRef));
+    std::copy(refs.begin(), refs.end(),
+              static_cast<NodeRef *>(getAddress(unit)));
+    return {unit, static_cast<uint32_t>(refs.size())};
+}
+
+// This is the implementation of the method to store the limbs of a BigInt.
+auto ASTContext::createBigIntLimbs(BigIntLiteral &literal,
+                                   llvm::ArrayRef<uint64_t> limbs) -> void {
+    literal.limbs = 0;
+    literal.limbCount = static_cast<uint32_t>(limbs.size());
+    if (limbs.empty())
+        return;
+    literal.limbs =
+        allocateUnits(limbs.size() * sizeof(uint64_t), alignof(uint64_t));
+    std::copy(limbs.begin(), limbs.end(),
+              static_cast<uint64_t *>(getAddress(literal.limbs)));
+}
+
+// This is the implementation of the method to return the limbs of a BigInt.
+auto ASTContext::getBigIntLimbs(const BigIntLiteral &literal) const
+    -> llvm::ArrayRef<uint64_t> {
+    if (literal.limbCount == 0)
+        return {};
+    return {static_cast<const uint64_t *>(getAddress(literal.limbs)),
+            literal.limbCount};
+}
+
+// This is the implementation of the method to visit the children of a node.
+// Each kind lists its children in the order they appear in the source.
+auto ASTContext::forEachChild(NodeRef ref,
+                              llvm::function_ref<void(NodeRef)> callback) const
+    -> void {
+    auto visit = [&](NodeRef child) {
+        if (child.isValid())
+            callback(child);
+    };
+    auto visitList = [&](NodeList list) {
+        for (auto child : getList(list))
+            visit(child);
+    };
+
+    auto *node = get(ref);
+    switch (node->kind) {
+    case NodeKind::SourceFile:
+        visitList(llvm::cast<SourceFileNode>(node)->statements);
+        return;
+    case NodeKind::Parameter: {
+        auto *parameter = llvm::cast<Parameter>(node);
+        visit(parameter->name);
+        visit(parameter->type);
+        visit(parameter->initializer);
+        return;
+    }
+    case NodeKind::VariableDeclaration: {
+        auto *declaration = llvm::cast<VariableDeclaration>(node);
+        visit(declaration->name);
+        visit(declaration->type);
+        visit(declaration->initializer);
+        return;
+    }
+    case NodeKind::PropertyAssignment: {
+        auto *property = llvm::cast<PropertyAssignment>(node);
+        visit(property->name);
+        visit(property->initializer);
+        return;
+    }
+
+    case NodeKind::Block:
+        visitList(llvm::cast<Block>(node)->statements);
+        return;
+    case NodeKind::ExpressionStatement:
+        visit(llvm::cast<ExpressionStatement>(node)->expression);
+        return;
+    case NodeKind::VariableStatement:
+        visitList(llvm::cast<VariableStatement>(node)->declarations);
+        return;
+    case NodeKind::IfStatement: {
+        auto *statement = llvm::cast<IfStatement>(node);
+        visit(statement->condition);
+        visit(statement->thenStatement);
+        visit(statement->elseStatement);
+        return;
+    }
+    case NodeKind::WhileStatement: {
+        auto *statement = llvm::cast<WhileStatement>(node);
+        visit(statement->condition);
+        visit(statement->body);
+        return;
+    }
+    case NodeKind::DoStatement: {
+        auto *statement = llvm::cast<DoStatement>(node);
+        visit(statement->body);
+        visit(statement->condition);
+        return;
+    }
+    case NodeKind::ForStatement: {
+        auto *statement = llvm::cast<ForStatement>(node);
+        visit(statement->initializer);
+        visit(statement->condition);
+        visit(statement->update);
+        visit(statement->body);
+        return;
+    }
+    case NodeKind::ReturnStatement:
+        visit(llvm::cast<ReturnStatement>(node)->expression);
+        return;
+    case NodeKind::BreakStatement:
+        visit(llvm::cast<BreakStatement>(node)->label);
+        return;
+    case NodeKind::ContinueStatement:
+        visit(llvm::cast<ContinueStatement>(node)->label);
+        return;
+    case NodeKind::FunctionDeclaration: {
+        auto *function = llvm::cast<FunctionDeclaration>(node);
+        visit(function->name);
+        visitList(function->parameters);
+        visit(function->returnType);
+        visit(function->body);
+        return;
+    }
+    case NodeKind::ClassDeclaration: {
+        auto *declaration = llvm::cast<ClassDeclaration>(node);
+        visit(declaration->name);
+        visit(declaration->baseClass);
+        visitList(declaration->members);
+        return;
+    }
+    case NodeKind::PropertyDeclaration: {
+        auto *property = llvm::cast<PropertyDeclaration>(node);
+        visit(property->name);
+        visit(property->type);
+        visit(property->initializer);
+        return;
+    }
+    case NodeKind::MethodDeclaration: {
+        auto *method = llvm::cast<MethodDeclaration>(node);
+        visit(method->name);
+        visitList(method->parameters);
+        visit(method->returnType);
+        visit(method->body);
+        return;
+    }
+    case NodeKind::TypeAliasDeclaration: {
+        auto *alias = llvm::cast<TypeAliasDeclaration>(node);
+        visit(alias->name);
+        visit(alias->type);
+        return;
+    }
+
+    case NodeKind::ArrayLiteral:
+        visitList(llvm::cast<ArrayLiteral>(node)->elements);
+        return;
+    case NodeKind::ObjectLiteral:
+        visitList(llvm::cast<ObjectLiteral>(node)->properties);
+        return;
+    case NodeKind::ParenthesizedExpression:
+        visit(llvm::cast<ParenthesizedExpression>(node)->expression);
+        return;
+    case NodeKind::PrefixUnaryExpression:
+        visit(llvm::cast<PrefixUnaryExpression>(node)->operand);
+        return;
+    case NodeKind::PostfixUnaryExpression:
+        visit(llvm::cast<PostfixUnaryExpression>(node)->operand);
+        return;
+    case NodeKind::BinaryExpression: {
+        auto *expression = llvm::cast<BinaryExpression>(node);
+        visit(expression->left);
+        visit(expression->right);
+        return;
+    }
+    case NodeKind::ConditionalExpression: {
+        auto *expression = llvm::cast<ConditionalExpression>(node);
+        visit(expression->condition);
+        visit(expression->whenTrue);
+        visit(expression->whenFalse);
+        return;
+    }
+    case NodeKind::CallExpression: {
+        auto *call = llvm::cast<CallExpression>(node);
+        visit(call->callee);
+        visitList(call->arguments);
+        return;
+    }
+    case NodeKind::NewExpression: {
+        auto *expression = llvm::cast<NewExpression>(node);
+        visit(expression->callee);
+        visitList(expression->arguments);
+        return;
+    }
+    case NodeKind::PropertyAccessExpression: {
+        auto *access = llvm::cast<PropertyAccessExpression>(node);
+        visit(access->object);
+        visit(access->name);
+        return;
+    }
+    case NodeKind::ElementAccessExpression: {
+        auto *access = llvm::cast<ElementAccessExpression>(node);
+        visit(access->object);
+        visit(access->index);
+        return;
+    }
+    case NodeKind::ArrowFunction: {
+        auto *function = llvm::cast<ArrowFunction>(node);
+        visitList(function->parameters);
+        visit(function->returnType);
+        visit(function->body);
+        return;
+    }
+
+    case NodeKind::TypeReference: {
+        auto *reference = llvm::cast<TypeReference>(node);
+        visit(reference->name);
+        visitList(reference->typeArguments);
+        return;
+    }
+    case NodeKind::ArrayType:
+        visit(llvm::cast<ArrayType>(node)->elementType);
+        return;
+    case NodeKind::UnionType:
+        visitList(llvm::cast<UnionType>(node)->types);
+        return;
+    case NodeKind::FunctionType: {
+        auto *function = llvm::cast<FunctionType>(node);
+        visitList(function->parameters);
+        visit(function->returnType);
+        return;
+    }
+
+    // The remaining kinds have no children.
+    case NodeKind::EmptyStatement:
+    case NodeKind::Identifier:
+    case NodeKind::NumberLiteral:
+    case NodeKind::BigIntLiteral:
+    case NodeKind::StringLiteral:
+    case NodeKind::TrueLiteral:
+    case NodeKind::FalseLiteral:
+    case NodeKind::NullLiteral:
+    case NodeKind::ThisExpression:
+    case NodeKind::KeywordType:
+        return;
+    }
+}
+
+// This is the implementation of the method to release the AST. The slabs are
+// all larger than the allocator's own slabs, so each one is a separate
+// allocation that the reset frees.
+auto ASTContext::reset() -> void {
+    allocator.Reset();
+    slabs.fill(nullptr);
+    nextUnit = 0;
+    endUnit = 0;
+    root = NodeRef{};
+}
+} // namespace ntsc
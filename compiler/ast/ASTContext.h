@@ -0,0 +1,171 @@
+#ifndef NTSC_ASTCONTEXT_H
+#define NTSC_ASTCONTEXT_H
+#include "AST.h"
+#include "SourceFile.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/STLFunctionalExtras.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/Casting.h"
+#include "llvm/Support/MathExtras.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/*
+    This file defines the ASTContext interface, which owns the AST of a single
+    source file. Every node and list is allocated from the context's
+    BumpPtrAllocator, so disposing of an AST is a single reset of the arena,
+    and no node is ever freed on its own.
+*/
+
+namespace ntsc {
+class ASTContext {
+    // The arena is addressed in 4 byte units. It is made of slabs that double
+    // in size, so a small file only needs a small slab, and the slab holding
+    // a unit is found from the position of its highest bit. Slabs are never
+    // moved once allocated, so pointers to nodes stay valid.
+    static constexpr unsigned unitSize = 4;
+    static constexpr unsigned firstSlabBits = 10;
+    static constexpr unsigned maxSlabs = 22;
+
+    // This is the file the AST was parsed from.
+    const SourceFile &file;
+
+    // This owns the memory of every slab, along with anything else that lives
+    // as long as the AST.
+    llvm::BumpPtrAllocator allocator;
+
+    std::array<char *, maxSlabs> slabs{};
+    uint32_t nextUnit = 0;
+    uint32_t endUnit = 0;
+
+    // This is the node for the whole file.
+    NodeRef root;
+
+    // These methods will return the first unit of a slab, and the slab that
+    // holds a unit.
+    [[nodiscard]] static inline auto getSlabStart(unsigned slab) -> uint32_t {
+        return ((1u << slab) - 1) << firstSlabBits;
+    }
+    [[nodiscard]] static inline auto getSlab(uint32_t unit) -> unsigned {
+        return llvm::Log2_32((unit >> firstSlabBits) + 1);
+    }
+
+    // This method will allocate a new slab that can hold the given number of
+    // units, and move to its start.
+    auto startSlab(size_t units) -> void;
+
+    // This method will reserve space for an object, and return the unit at
+    // which it begins.
+    inline auto allocateUnits(size_t size, size_t alignment) -> uint32_t {
+        auto units = (size + unitSize - 1) / unitSize;
+        auto unitAlignment = alignment > unitSize ? alignment / unitSize : 1;
+        auto unit = llvm::alignTo(nextUnit, unitAlignment);
+        if (unit + units > endUnit) {
+            startSlab(units + unitAlignment);
+            unit = llvm::alignTo(nextUnit, unitAlignment);
+        }
+        nextUnit = static_cast<uint32_t>(unit + units);
+        return static_cast<uint32_t>(unit);
+    }
+
+  public:
+    explicit ASTContext(const SourceFile &file);
+    ASTContext(const ASTContext &) = delete;
+    auto operator=(const ASTContext &) -> ASTContext & = delete;
+
+    // This method will return the file the AST was parsed from.
+    [[nodiscard]] inline auto getFile() const -> const SourceFile & {
+        return file;
+    }
+
+    // This method will return the address of a unit of the arena.
+    [[nodiscard]] inline auto getAddress(uint32_t unit) const -> void * {
+        auto slab = getSlab(unit);
+        return slabs[slab] + (unit - getSlabStart(slab)) * unitSize;
+    }
+
+    // This method will create a node of the given type, with every field set
+    // to zero. It will return the node along with its reference, so that the
+    // caller can fill in the children.
+    template <typename T>
+    auto create(uint32_t offset, uint32_t length, uint8_t flags = 0)
+        -> std::pair<NodeRef, T *> {
+        static_assert(std::is_trivially_destructible<T>::value,
+                      "nodes are never destroyed");
+        static_assert(alignof(T) <= 8, "slabs are only 8 byte aligned");
+        auto unit = allocateUnits(sizeof(T), alignof(T));
+        auto *node = new (getAddress(unit)) T{};
+        node->kind = T::nodeKind;
+        node->flags = flags;
+        node->offset = offset;
+        node->length = length;
+        return {NodeRef{unit}, node};
+    }
+
+    // This method will return the node for a valid reference.
+    [[nodiscard]] inline auto get(NodeRef ref) const -> Node * {
+        return static_cast<Node *>(getAddress(ref.getIndex()));
+    }
+
+    // These methods will return the node for a reference as the given type.
+    // The cast is checked in assertion builds.
+    template <typename T>
+    [[nodiscard]] inline auto get(NodeRef ref) const -> T * {
+        return llvm::cast<T>(get(ref));
+    }
+    template <typename T>
+    [[nodiscard]] inline auto getIfPresent(NodeRef ref) const -> T * {
+        return ref.isValid() ? llvm::cast<T>(get(ref)) : nullptr;
+    }
+
+    // This method will copy a list of children into the arena.
+    auto createList(llvm::ArrayRef<NodeRef> refs) -> NodeList;
+
+    // This method will return the children of a list.
+    [[nodiscard]] inline auto getList(NodeList list) const
+        -> llvm::ArrayRef<NodeRef> {
+        if (list.count == 0)
+            return {};
+        return {static_cast<const NodeRef *>(getAddress(list.first)),
+                list.count};
+    }
+
+    // This method will call the callback on every child of a node, in source
+    // order. Missing optional children are skipped.
+    auto forEachChild(NodeRef ref,
+                      llvm::function_ref<void(NodeRef)> callback) const
+        -> void;
+
+    // These methods will copy the limbs of a BigInt literal into the arena,
+    // and return them.
+    auto createBigIntLimbs(BigIntLiteral &literal,
+                           llvm::ArrayRef<uint64_t> limbs) -> void;
+    [[nodiscard]] auto getBigIntLimbs(const BigIntLiteral &literal) const
+        -> llvm::ArrayRef<uint64_t>;
+
+    // These methods will set and return the node for the whole file.
+    inline auto setRoot(NodeRef ref) -> void { root = ref; }
+    [[nodiscard]] inline auto getRoot() const -> NodeRef { return root; }
+
+    // This method will return the allocator of the arena, for data that lives
+    // as long as the AST but is not a node.
+    [[nodiscard]] inline auto getAllocator() -> llvm::BumpPtrAllocator & {
+        return allocator;
+    }
+
+    // This method will release every node at once. Every reference into the
+    // arena is invalid afterwards.
+    auto reset() -> void;
+
+    // This method will return the number of bytes held by the arena.
+    [[nodiscard]] inline auto getMemoryUsage() const -> size_t {
+        return allocator.getTotalMemory();
+    }
+};
+} // namespace ntsc
+
+#endif
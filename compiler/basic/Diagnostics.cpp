@@ -0,0 +1,396 @@
+#include "Diagnostics.h"
+#include "SourceManager.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Support/JSON.h"
+#include <algorithm>
+#include <string>
+#include <utility>
+
+/*
+    This file implements the DiagnosticsEngine interface for recording and
+    rendering diagnostics.
+*/
+
+#define DEBUG_TYPE "diagnostics"
+
+ALWAYS_ENABLED_STATISTIC(diagnosticsReported,
+                         "Number of distinct diagnostics reported");
+ALWAYS_ENABLED_STATISTIC(diagnosticsEmitted,
+                         "Number of diagnostics emitted after the error limit");
+
+namespace ntsc {
+// This is the source of the unique number of each engine.
+static std::atomic<uint64_t> nextGeneration{1};
+
+// This is the buffer cached by each thread for the engine it reported to
+// most recently.
+static thread_local struct {
+    uint64_t generation = 0;
+    std::vector<Diagnostic> *buffer = nullptr;
+} threadBufferCache;
+
+// These are the tables generated from DiagnosticKinds.def.
+static const DiagnosticLevel diagnosticLevels[] = {
+#define DIAG(name, level, format) DiagnosticLevel::level,
+#include "DiagnosticKinds.def"
+};
+
+static const char *const diagnosticFormats[] = {
+#define DIAG(name, level, format) format,
+#include "DiagnosticKinds.def"
+};
+
+static const char *const diagnosticNames[] = {
+#define DIAG(name, level, format) #name,
+#include "DiagnosticKinds.def"
+};
+
+// This is the implementation of the primary constructor.
+DiagnosticsEngine::DiagnosticsEngine(const SourceManager &sourceManager)
+    : sourceManager{sourceManager},
+      generation{nextGeneration.fetch_add(1, std::memory_order_relaxed)} {}
+
+// This is the implementation of the method to find the buffer of the calling
+// thread. The lock is only taken the first time a thread reports to this
+// engine.
+auto DiagnosticsEngine::getThreadBuffer() -> std::vector<Diagnostic> & {
+    if (threadBufferCache.generation == generation)
+        return *threadBufferCache.buffer;
+
+    std::lock_guard<std::mutex> lock{threadBuffersMutex};
+    threadBuffers.push_back(std::make_unique<std::vector<Diagnostic>>());
+    threadBufferCache.generation = generation;
+    threadBufferCache.buffer = threadBuffers.back().get();
+    return *threadBufferCache.buffer;
+}
+
+// This is the implementation of the method to record a diagnostic.
+auto DiagnosticsEngine::report(DiagID id, FileID file, uint32_t offset,
+                               std::initializer_list<llvm::StringRef> args)
+    -> void {
+    Diagnostic diagnostic{id, 0, file, offset, {}};
+    for (auto arg : args)
+        diagnostic.args[diagnostic.argCount++] = arg;
+    report(diagnostic);
+}
+
+// This is the implementation of the method to record a built diagnostic.
+auto DiagnosticsEngine::report(const Diagnostic &diagnostic) -> void {
+    getThreadBuffer().push_back(diagnostic);
+
+    if (getLevel(diagnostic.id) == DiagnosticLevel::Error)
+        errorCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+// This is the implementation of the method to take the recorded diagnostics.
+auto DiagnosticsEngine::takeDiagnostics() -> std::vector<Diagnostic> {
+    return collectDiagnostics();
+}
+
+// This is the implementation of the method to merge the thread buffers. The
+// sort is stable on (file, offset), so diagnostics at the same location keep
+// the order in which they were reported.
+auto DiagnosticsEngine::collectDiagnostics() -> std::vector<Diagnostic> {
+    std::vector<Diagnostic> diagnostics;
+    {
+        std::lock_guard<std::mutex> lock{threadBuffersMutex};
+        size_t total = 0;
+        for (auto &buffer : threadBuffers)
+            total += buffer->size();
+        diagnostics.reserve(total);
+        for (auto &buffer : threadBuffers) {
+            diagnostics.insert(diagnostics.end(), buffer->begin(),
+                               buffer->end());
+            buffer->clear();
+        }
+    }
+
+    auto sameLocation = [](const Diagnostic &a, const Diagnostic &b) {
+        return a.file == b.file && a.offset == b.offset;
+    };
+    std::stable_sort(diagnostics.begin(), diagnostics.end(),
+                     [](const Diagnostic &a, const Diagnostic &b) {
+                         return std::make_pair(a.file.getValue(), a.offset) <
+                                std::make_pair(b.file.getValue(), b.offset);
+                     });
+
+    // A diagnostic is dropped if an identical one was already kept at the same
+    // location. There are rarely more than a couple at one location, so a
+    // linear search is enough.
+    auto isDuplicate = [](const Diagnostic &a, const Diagnostic &b) {
+        return a.id == b.id && a.argCount == b.argCount &&
+               std::equal(a.args.begin(), a.args.begin() + a.argCount,
+                          b.args.begin());
+    };
+    size_t kept = 0, locationStart = 0;
+    for (size_t i = 0; i < diagnostics.size(); ++i) {
+        if (kept == 0 || !sameLocation(diagnostics[kept - 1], diagnostics[i]))
+            locationStart = kept;
+        auto duplicate = false;
+        for (auto j = locationStart; j < kept && !duplicate; ++j)
+            duplicate = isDuplicate(diagnostics[j], diagnostics[i]);
+        if (!duplicate)
+            diagnostics[kept++] = diagnostics[i];
+    }
+    diagnostics.resize(kept);
+    return diagnostics;
+}
+
+// This is the implementation of the method to render diagnostics as text. The
+// format matches the one used by the compiler before diagnostics were
+// buffered.
+auto DiagnosticsEngine::renderText(
+    llvm::raw_ostream &os, const std::vector<Diagnostic> &diagnostics) const
+    -> void {
+    for (auto &diagnostic : diagnostics) {
+        auto &file = sourceManager.getFile(diagnostic.file);
+        auto loc = file.getLineAndColumn(diagnostic.offset);
+        os << llvm::raw_ostream::Colors::RED
+           << (getLevel(diagnostic.id) == DiagnosticLevel::Error ? "error: "
+                                                                   : "warning: ")
+           << llvm::raw_ostream::Colors::WHITE << file.getPath() << ": "
+           << loc.line << ":" << loc.col << ": ";
+        formatMessage(diagnostic, os);
+        os << '\n';
+    }
+}
+
+// This is the implementation of the method to render diagnostics as a JSON
+// array with one object per diagnostic.
+auto DiagnosticsEngine::renderJSON(
+    llvm::raw_ostream &os, const std::vector<Diagnostic> &diagnostics) const
+    -> void {
+    llvm::json::OStream json{os, 2};
+    json.array([&] {
+        for (auto &diagnostic : diagnostics) {
+            auto &file = sourceManager.getFile(diagnostic.file);
+            auto loc = file.getLineAndColumn(diagnostic.offset);
+            std::string message;
+            llvm::raw_string_ostream messageStream{message};
+            formatMessage(diagnostic, messageStream);
+
+            json.object([&] {
+                json.attribute("id", getName(diagnostic.id));
+                json.attribute(
+                    "level", getLevel(diagnostic.id) == DiagnosticLevel::Error
+                                 ? "error"
+                                 : "warning");
+                json.attribute("file", file.getPath());
+                json.attribute("line", loc.line);
+                json.attribute("column", loc.col);
+                json.attribute("offset", diagnostic.offset);
+                json.attribute("message", messageStream.str());
+            });
+        }
+    });
+    os << '\n';
+}
+
+// This function will convert the format of a diagnostic to a SARIF message
+// string, whose placeholders are written {0} rather than %0, and whose
+// literal braces are doubled.
+static auto getSARIFMessage(DiagID id) -> std::string {
+    auto format = DiagnosticsEngine::getFormat(id);
+    std::string message;
+    message.reserve(format.size());
+    for (size_t i = 0; i < format.size(); ++i) {
+        auto c = format[i];
+        if (c == '%' && i + 1 < format.size() && format[i + 1] >= '0' &&
+            format[i + 1] <= '9') {
+            message += '{';
+            message += format[++i];
+            message += '}';
+        } else if (c == '{' || c == '}') {
+            message += c;
+            message += c;
+        } else {
+            message += c;
+        }
+    }
+    return message;
+}
+
+// This is the implementation of the method to render diagnostics as a SARIF
+// 2.1.0 log with a single run. Each rule holds the format of its message as a
+// message string, since SARIF consumers show a description verbatim.
+auto DiagnosticsEngine::renderSARIF(
+    llvm::raw_ostream &os, const std::vector<Diagnostic> &diagnostics) const
+    -> void {
+    // Only the rules that were triggered are listed in the tool description.
+    std::vector<DiagID> rules;
+    for (auto &diagnostic : diagnostics)
+        if (std::find(rules.begin(), rules.end(), diagnostic.id) ==
+            rules.end())
+            rules.push_back(diagnostic.id);
+
+    llvm::json::OStream json{os, 2};
+    json.object([&] {
+        json.attribute("$schema",
+                       "https://json.schemastore.org/sarif-2.1.0.json");
+        json.attribute("version", "2.1.0");
+        json.attributeArray("runs", [&] {
+            json.object([&] {
+                json.attributeObject("tool", [&] {
+                    json.attributeObject("driver", [&] {
+                        json.attribute("name", "ntsc");
+                        json.attributeArray("rules", [&] {
+                            for (auto id : rules)
+                                json.object([&] {
+                                    json.attribute("id", getName(id));
+                                    json.attributeObject(
+                                        "messageStrings", [&] {
+                                            json.attributeObject(
+                                                "default", [&] {
+                                                    json.attribute(
+                                                        "text",
+                                                        getSARIFMessage(id));
+                                                });
+                                        });
+                                });
+                        });
+                    });
+                });
+                json.attributeArray("results", [&] {
+                    for (auto &diagnostic : diagnostics)
+                        renderSARIFResult(json, diagnostic);
+                });
+            });
+        });
+    });
+    os << '\n';
+}
+
+// This is the implementation of the method to render a single SARIF result.
+// The message is given both as text and as the arguments of the message
+// string of its rule, so consumers that do not look up the rule still show
+// it.
+auto DiagnosticsEngine::renderSARIFResult(llvm::json::OStream &json,
+                                          const Diagnostic &diagnostic) const
+    -> void {
+    auto &file = sourceManager.getFile(diagnostic.file);
+    auto loc = file.getLineAndColumn(diagnostic.offset);
+    std::string message;
+    llvm::raw_string_ostream messageStream{message};
+    formatMessage(diagnostic, messageStream);
+
+    json.object([&] {
+        json.attribute("ruleId", getName(diagnostic.id));
+        json.attribute("level",
+                       getLevel(diagnostic.id) == DiagnosticLevel::Error
+                           ? "error"
+                           : "warning");
+        json.attributeObject("message", [&] {
+            json.attribute("text", messageStream.str());
+            json.attribute("id", "default");
+            json.attributeArray("arguments", [&] {
+                for (unsigned i = 0; i < diagnostic.argCount; ++i)
+                    json.value(diagnostic.args[i]);
+            });
+        });
+        json.attributeArray("locations", [&] {
+            json.object([&] {
+                json.attributeObject("physicalLocation", [&] {
+                    json.attributeObject("artifactLocation", [&] {
+                        json.attribute("uri", file.getPath());
+                    });
+                    json.attributeObject("region", [&] {
+                        json.attribute("startLine", loc.line);
+                        json.attribute("startColumn", loc.col);
+                        json.attribute("byteOffset", diagnostic.offset);
+                    });
+                });
+            });
+        });
+    });
+}
+
+// This is the implementation of the method to emit the diagnostics. The output
+// is built in memory, so the stream is written once no matter how many
+// diagnostics there are.
+auto DiagnosticsEngine::emit(llvm::raw_ostream &os, DiagnosticsFormat format)
+    -> void {
+    auto diagnostics = collectDiagnostics();
+    diagnosticsReported += diagnostics.size();
+
+    // Once the error limit is reached, the remaining errors are dropped.
+    // Warnings are kept until the cut off point.
+    auto truncated = false;
+    if (errorLimit != 0) {
+        unsigned errors = 0;
+        for (auto it = diagnostics.begin(); it != diagnostics.end(); ++it) {
+            if (getLevel(it->id) != DiagnosticLevel::Error)
+                continue;
+            if (errors++ == errorLimit) {
+                diagnostics.erase(it, diagnostics.end());
+                truncated = true;
+                break;
+            }
+        }
+    }
+
+    diagnosticsEmitted += diagnostics.size();
+    if (diagnostics.empty())
+        return;
+
+    llvm::SmallString<1024> output;
+    llvm::raw_svector_ostream outputStream{output};
+    outputStream.enable_colors(os.colors_enabled());
+    switch (format) {
+    case DiagnosticsFormat::Text:
+        renderText(outputStream, diagnostics);
+        if (truncated)
+            outputStream << llvm::raw_ostream::Colors::RED
+                         << "fatal error: " << llvm::raw_ostream::Colors::WHITE
+                         << "too many errors emitted, stopping now "
+                            "[-ferror-limit=]\n";
+        break;
+    case DiagnosticsFormat::JSON:
+        renderJSON(outputStream, diagnostics);
+        break;
+    case DiagnosticsFormat::SARIF:
+        renderSARIF(outputStream, diagnostics);
+    }
+
+    os << output;
+    os.flush();
+}
+
+// This is the implementation of the method to find the level of a diagnostic.
+auto DiagnosticsEngine::getLevel(DiagID id) -> DiagnosticLevel {
+    return diagnosticLevels[static_cast<uint16_t>(id)];
+}
+
+// This is the implementation of the method to find the format of a diagnostic.
+auto DiagnosticsEngine::getFormat(DiagID id) -> llvm::StringRef {
+    return diagnosticFormats[static_cast<uint16_t>(id)];
+}
+
+// This is the implementation of the method to find the name of a diagnostic.
+auto DiagnosticsEngine::getName(DiagID id) -> llvm::StringRef {
+    return diagnosticNames[static_cast<uint16_t>(id)];
+}
+
+// This is the implementation of the method to format a message. A '%' followed
+// by a digit is replaced by that argument, and any other '%' is kept as is.
+auto DiagnosticsEngine::formatMessage(const Diagnostic &diagnostic,
+                                      llvm::raw_ostream &os) -> void {
+    auto format = getFormat(diagnostic.id);
+    while (!format.empty()) {
+        auto percent = format.find('%');
+        os << format.substr(0, percent);
+        if (percent == llvm::StringRef::npos)
+            return;
+
+        auto index = percent + 1 < format.size() ? format[percent + 1] - '0'
+                                                 : -1;
+        if (index >= 0 && index < diagnostic.argCount) {
+            os << diagnostic.args[index];
+            format = format.substr(percent + 2);
+        } else {
+            os << '%';
+            format = format.substr(percent + 1);
+        }
+    }
+}
+} // namespace ntsc
@@ -0,0 +1,142 @@
+#ifndef NTSC_DIAGNOSTICS_H
+#define NTSC_DIAGNOSTICS_H
+#include "SourceFile.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/*
+    This file defines the DiagnosticsEngine interface. Diagnostics are recorded
+    as compact records while the compiler runs, and they are sorted, merged and
+    rendered once at the end of the compilation.
+*/
+
+namespace ntsc {
+class SourceManager;
+
+// This enum holds the identifier of every diagnostic in DiagnosticKinds.def.
+enum class DiagID : uint16_t {
+#define DIAG(name, level, format) name,
+#include "DiagnosticKinds.def"
+};
+
+// This enum holds the severity of a diagnostic.
+enum class DiagnosticLevel : uint8_t { Warning, Error };
+
+// This enum holds the output formats for rendering diagnostics.
+enum class DiagnosticsFormat : uint8_t { Text, JSON, SARIF };
+
+// This struct is a single recorded diagnostic. It does not own its arguments,
+// so they must point into a source buffer, the retained text of a streamed
+// file or static storage, all of which outlive the engine.
+struct Diagnostic {
+    DiagID id;
+    uint8_t argCount;
+    FileID file;
+    uint32_t offset;
+    std::array<llvm::StringRef, 3> args;
+};
+
+class DiagnosticsEngine {
+    // This is the SourceManager used to find paths, lines and columns when the
+    // diagnostics are rendered.
+    const SourceManager &sourceManager;
+
+    // These are the buffers of every thread that has reported a diagnostic.
+    // A thread only ever appends to its own buffer, so reporting does not take
+    // a lock after the first diagnostic.
+    std::vector<std::unique_ptr<std::vector<Diagnostic>>> threadBuffers;
+    std::mutex threadBuffersMutex;
+
+    // This is a unique number for the engine. It is used to tell whether the
+    // buffer cached by a thread belongs to this engine.
+    uint64_t generation;
+
+    // This is the number of errors that have been reported so far, including
+    // duplicates.
+    std::atomic<size_t> errorCount{0};
+
+    // This is the maximum number of errors to render. 0 means no limit.
+    unsigned errorLimit = 0;
+
+    // This method will return the buffer of the calling thread, creating it
+    // if needed.
+    auto getThreadBuffer() -> std::vector<Diagnostic> &;
+
+    // This method will merge every thread buffer into one list sorted by
+    // file and offset, with exact duplicates removed.
+    auto collectDiagnostics() -> std::vector<Diagnostic>;
+
+    // These methods will render the diagnostics in each output format.
+    auto renderText(llvm::raw_ostream &os,
+                    const std::vector<Diagnostic> &diagnostics) const -> void;
+    auto renderJSON(llvm::raw_ostream &os,
+                    const std::vector<Diagnostic> &diagnostics) const -> void;
+    auto renderSARIF(llvm::raw_ostream &os,
+                     const std::vector<Diagnostic> &diagnostics) const -> void;
+    auto renderSARIFResult(llvm::json::OStream &json,
+                           const Diagnostic &diagnostic) const -> void;
+
+  public:
+    explicit DiagnosticsEngine(const SourceManager &sourceManager);
+    DiagnosticsEngine(const DiagnosticsEngine &) = delete;
+    auto operator=(const DiagnosticsEngine &) -> DiagnosticsEngine & = delete;
+
+    // This method will return the SourceManager that owns the files of the
+    // diagnostics.
+    [[nodiscard]] inline auto getSourceManager() const
+        -> const SourceManager & {
+        return sourceManager;
+    }
+
+    // This method will set the maximum number of errors to render.
+    inline auto setErrorLimit(unsigned limit) -> void { errorLimit = limit; }
+
+    // This method will record a diagnostic at the given offset into a file. It
+    // is safe to call from any thread.
+    auto report(DiagID id, FileID file, uint32_t offset,
+                std::initializer_list<llvm::StringRef> args = {}) -> void;
+
+    // This method will record a diagnostic that has already been built, such
+    // as one forwarded from another engine.
+    auto report(const Diagnostic &diagnostic) -> void;
+
+    // This method will return the number of errors reported so far.
+    [[nodiscard]] inline auto getErrorCount() const -> size_t {
+        return errorCount.load(std::memory_order_relaxed);
+    }
+
+    // This method will sort, merge and render every recorded diagnostic to the
+    // stream in a single write, and then clear them. No other thread may be
+    // reporting diagnostics at the same time.
+    auto emit(llvm::raw_ostream &os, DiagnosticsFormat format) -> void;
+
+    // This method will return every recorded diagnostic, sorted and merged as
+    // for emit, and then clear them. It lets a private engine hold back
+    // diagnostics until the caller knows whether to forward them.
+    auto takeDiagnostics() -> std::vector<Diagnostic>;
+
+    // These methods will return the severity and the message format of a
+    // diagnostic.
+    [[nodiscard]] static auto getLevel(DiagID id) -> DiagnosticLevel;
+    [[nodiscard]] static auto getFormat(DiagID id) -> llvm::StringRef;
+
+    // This method will return the name of a diagnostic, which is used as the
+    // rule ID in machine readable output.
+    [[nodiscard]] static auto getName(DiagID id) -> llvm::StringRef;
+
+    // This method will substitute the arguments of a diagnostic into its
+    // format.
+    static auto formatMessage(const Diagnostic &diagnostic,
+                              llvm::raw_ostream &os) -> void;
+};
+} // namespace ntsc
+
+#endif
@@ -0,0 +1,54 @@
+#include "IdentifierTable.h"
+#include "llvm/Support/DJB.h"
+#include "llvm/Support/ErrorHandling.h"
+
+/*
+    This file implements the IdentifierTable interface for interning strings.
+*/
+
+namespace ntsc {
+// This is the implementation of the method to intern a string. The value of a
+// Symbol holds the shard in its low bits and the index within the shard plus
+// one in the rest, so it is never 0. The shard is chosen from the high bits of
+// the hash, since the low bits pick the bucket inside the map.
+auto IdentifierTable::intern(llvm::StringRef name) -> Symbol {
+    auto shardIndex = llvm::djbHash(name) >> (32 - shardBits);
+    auto &shard = shards[shardIndex];
+
+    std::lock_guard<std::mutex> lock{shard.mutex};
+    auto inserted = shard.map.try_emplace(name, Symbol{});
+    if (!inserted.second)
+        return inserted.first->second;
+
+    auto index = shard.count++;
+    auto chunk = index >> chunkBits;
+    if (chunk >= maxChunks)
+        llvm::report_fatal_error("too many distinct identifiers");
+    if (!shard.chunks[chunk])
+        shard.chunks[chunk] = std::make_unique<llvm::StringRef[]>(chunkSize);
+    shard.chunks[chunk][index & (chunkSize - 1)] = inserted.first->first();
+
+    auto symbol = Symbol{(index + 1) << shardBits | shardIndex};
+    inserted.first->second = symbol;
+    return symbol;
+}
+
+// This is the implementation of the method to resolve a Symbol. The caller got
+// the Symbol from intern, which published the chunk under the shard's lock, so
+// no lock is needed here.
+auto IdentifierTable::getName(Symbol symbol) const -> llvm::StringRef {
+    auto &shard = shards[symbol.getValue() & (shardCount - 1)];
+    auto index = (symbol.getValue() >> shardBits) - 1;
+    return shard.chunks[index >> chunkBits][index & (chunkSize - 1)];
+}
+
+// This is the implementation of the method to count the strings.
+auto IdentifierTable::size() const -> size_t {
+    size_t total = 0;
+    for (auto &shard : shards) {
+        std::lock_guard<std::mutex> lock{shard.mutex};
+        total += shard.count;
+    }
+    return total;
+}
+} // namespace ntsc
@@ -0,0 +1,80 @@
+#ifndef NTSC_IDENTIFIERTABLE_H
+#define NTSC_IDENTIFIERTABLE_H
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Allocator.h"
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+/*
+    This file defines the IdentifierTable interface. It interns identifiers and
+    string literal values, so that every distinct string is stored once and can
+    be compared through a 32-bit Symbol.
+*/
+
+namespace ntsc {
+// This is a compact handle to an interned string. Two Symbols from the same
+// table are equal exactly when their strings are equal. The value 0 is
+// reserved for invalid handles.
+class Symbol {
+    uint32_t value = 0;
+
+  public:
+    Symbol() = default;
+    explicit Symbol(uint32_t value) : value{value} {}
+
+    [[nodiscard]] inline auto isValid() const -> bool { return value != 0; }
+    [[nodiscard]] inline auto getValue() const -> uint32_t { return value; }
+
+    inline auto operator==(Symbol other) const -> bool {
+        return value == other.value;
+    }
+    inline auto operator!=(Symbol other) const -> bool {
+        return value != other.value;
+    }
+};
+
+class IdentifierTable {
+    // The table is split into shards by the hash of the string, so threads
+    // lexing different files rarely wait on the same lock.
+    static constexpr unsigned shardBits = 4;
+    static constexpr unsigned shardCount = 1u << shardBits;
+
+    // The strings of each shard are indexed through a fixed array of chunks.
+    // Chunks are never moved once allocated, so a Symbol can be resolved
+    // without taking the lock.
+    static constexpr unsigned chunkBits = 12;
+    static constexpr unsigned chunkSize = 1u << chunkBits;
+    static constexpr unsigned maxChunks = 1024;
+
+    // This struct is a single shard. The strings are copied into the bump
+    // allocator owned by the map.
+    struct Shard {
+        mutable std::mutex mutex;
+        llvm::StringMap<Symbol, llvm::BumpPtrAllocator> map;
+        std::array<std::unique_ptr<llvm::StringRef[]>, maxChunks> chunks;
+        uint32_t count = 0;
+    };
+    std::array<Shard, shardCount> shards;
+
+  public:
+    IdentifierTable() = default;
+    IdentifierTable(const IdentifierTable &) = delete;
+    auto operator=(const IdentifierTable &) -> IdentifierTable & = delete;
+
+    // This method will return the Symbol for the given string, inserting it if
+    // it has not been seen before. It is safe to call from any thread.
+    auto intern(llvm::StringRef name) -> Symbol;
+
+    // This method will return the string for a valid Symbol. The string lives
+    // as long as the table.
+    [[nodiscard]] auto getName(Symbol symbol) const -> llvm::StringRef;
+
+    // This method will return the number of distinct strings in the table.
+    [[nodiscard]] auto size() const -> size_t;
+};
+} // namespace ntsc
+
+#endif
@@ -0,0 +1,294 @@
+#include "SourceFile.h"
+#include "FastScan.h"
+#include "llvm/Support/ConvertUTF.h"
+#include <algorithm>
+#include <cassert>
+
+/*
+    This file implements the SourceFile interface for mapping byte offsets to
+    lines and columns.
+*/
+
+namespace ntsc {
+// This is the implementation of the primary constructor.
+SourceFile::SourceFile(llvm::StringRef path, const char *bufPtr,
+                       const char *endPtr, FileID id)
+    : SourceFile{path, bufPtr, endPtr, id, nullptr} {}
+
+// This is the implementation of the constructor for buffers that have already
+// been validated.
+SourceFile::SourceFile(llvm::StringRef path, const char *bufPtr,
+                       const char *endPtr, FileID id, const char *validUTF8End)
+    : id{id}, path{path}, bufPtr{bufPtr}, endPtr{endPtr},
+      validUTF8End{validUTF8End} {}
+
+// This is the buffer of every streamed file. It is only the null character.
+static const char streamedBuffer[1] = {0};
+
+// This is the implementation of the constructor for streamed files.
+SourceFile::SourceFile(llvm::StringRef path, FileID id)
+    : id{id}, path{path}, bufPtr{streamedBuffer}, endPtr{streamedBuffer},
+      validUTF8End{streamedBuffer}, streamed{true} {}
+
+// This is the implementation of the method to validate the buffer.
+auto SourceFile::findValidUTF8End() const -> const char * {
+    auto *end = scanKernels.findInvalidUTF8(bufPtr, endPtr);
+    validUTF8End.store(end, std::memory_order_release);
+    return end;
+}
+
+// This is the implementation of the method that builds the line start table.
+// The scanning kernel will skip to the next byte that may begin a line
+// terminator, so only line terminators and the lead byte of U+2028 and U+2029
+// are checked here. This matches the line terminators recognized by the Lexer.
+auto SourceFile::buildLineStarts() const -> void {
+    // Most files average more than 16 bytes per line, so this will avoid most
+    // reallocations.
+    lineStarts.reserve(static_cast<size_t>(endPtr - bufPtr) / 16 + 1);
+    lineStarts.push_back(0);
+    findLineStarts(bufPtr, UINT64_MAX, lineStarts);
+}
+
+// This is the implementation of the method that finds the line starts after a
+// point in the buffer.
+auto SourceFile::findLineStarts(const char *ptr, uint64_t limit,
+                                std::vector<uint32_t> &starts) const -> void {
+    while (true) {
+        ptr = scanKernels.findLineBreak(ptr, endPtr);
+        switch (ptr[0]) {
+        case 0:
+            // We must check if this is really the end of the file.
+            if (ptr == endPtr)
+                return;
+            ++ptr;
+            continue;
+        case '\n':
+            ++ptr;
+            break;
+        case '\r':
+            // According to the TypeScript standard, \r\n should be treated as a
+            // single line terminator.
+            ptr += ptr[1] == '\n' ? 2 : 1;
+            break;
+        default:
+            // This is the lead byte 0xE2, so we must check for the encoding of
+            // U+2028 and U+2029.
+            if (ptr[1] != '\x80' || (ptr[2] != '\xa8' && ptr[2] != '\xa9')) {
+                ++ptr;
+                continue;
+            }
+            ptr += 3;
+        }
+        auto start = static_cast<uint32_t>(ptr - bufPtr);
+        starts.push_back(start);
+        if (start >= limit)
+            return;
+    }
+}
+
+// This is the implementation of the method to update the file after an edit.
+// A line start depends on the three bytes before it and the byte at it, so
+// the starts before the edit are kept, and those at least three bytes past it
+// are only moved. The text between them is scanned again from the last start
+// that is kept, up to the first start that is far enough past the inserted
+// text to match an old one. The first edit builds the table from the new
+// text if no location was asked for yet.
+auto SourceFile::applyEdit(const char *newBufPtr, const char *newEndPtr,
+                           uint32_t offset, uint32_t removedLength,
+                           uint32_t insertedLength) -> void {
+    assert(!streamed && "a streamed file cannot be edited");
+    // The old buffer may have been freed, so its pointers are only compared
+    // as numbers.
+    auto *oldValidEnd = validUTF8End.load(std::memory_order_relaxed);
+    auto validOffset = reinterpret_cast<uintptr_t>(oldValidEnd) -
+                       reinterpret_cast<uintptr_t>(bufPtr);
+    bufPtr = newBufPtr;
+    endPtr = newEndPtr;
+    auto delta = static_cast<int64_t>(insertedLength) -
+                 static_cast<int64_t>(removedLength);
+    auto insertedEnd = uint64_t{offset} + insertedLength;
+
+    // The text is validated from the character that the edit begins in, or
+    // the invalid sequence just before it, to the end of the character that
+    // the inserted text ends in. The text after it is as valid as it was, so
+    // the rest of the file is only validated again when the edit reached the
+    // first invalid sequence.
+    if (oldValidEnd && validOffset + 3 >= offset) {
+        auto *start = bufPtr + std::min<uint64_t>(validOffset, offset);
+        for (int i = 0; i < 3 && start > bufPtr &&
+                        (static_cast<uint8_t>(start[-1]) & 0xc0) == 0x80;
+             ++i)
+            --start;
+        if (start > bufPtr && static_cast<uint8_t>(start[-1]) >= 0xc0)
+            --start;
+        auto *end = bufPtr + insertedEnd;
+        for (int i = 0; i < 3 && end < endPtr &&
+                        (static_cast<uint8_t>(end[0]) & 0xc0) == 0x80;
+             ++i)
+            ++end;
+        auto *invalid = scanKernels.findInvalidUTF8(start, end);
+        if (invalid != end)
+            oldValidEnd = invalid;
+        else if (validOffset >= uint64_t{offset} + removedLength &&
+                 bufPtr + (validOffset + delta) >= end)
+            oldValidEnd = bufPtr + (validOffset + delta);
+        else
+            oldValidEnd = scanKernels.findInvalidUTF8(end, endPtr);
+    } else if (oldValidEnd) {
+        oldValidEnd = bufPtr + validOffset;
+    }
+    validUTF8End.store(oldValidEnd, std::memory_order_relaxed);
+
+    auto built = true;
+    std::call_once(lineStartsBuilt, [&] { built = false; });
+    if (!built) {
+        buildLineStarts();
+        return;
+    }
+
+    auto firstChanged = std::max(
+        lineStarts.begin() + 1,
+        std::lower_bound(lineStarts.begin(), lineStarts.end(), offset));
+    std::vector<uint32_t> middle;
+    findLineStarts(bufPtr + firstChanged[-1], insertedEnd + 3, middle);
+    auto tail = lineStarts.end();
+    if (!middle.empty() && middle.back() >= insertedEnd + 3) {
+        tail = std::lower_bound(firstChanged, lineStarts.end(),
+                                static_cast<uint32_t>(middle.back() - delta));
+        middle.pop_back();
+    }
+    for (auto it = tail; it != lineStarts.end(); ++it)
+        *it = static_cast<uint32_t>(*it + delta);
+    auto index = firstChanged - lineStarts.begin();
+    lineStarts.erase(firstChanged, tail);
+    lineStarts.insert(lineStarts.begin() + index, middle.begin(),
+                      middle.end());
+}
+
+// This is the implementation of the method that returns the number of lines.
+auto SourceFile::getLineCount() const -> uint32_t {
+    std::call_once(lineStartsBuilt, [this] { buildLineStarts(); });
+    return static_cast<uint32_t>(lineStarts.size());
+}
+
+// This is the implementation of the method that returns the start of a line.
+auto SourceFile::getLineStart(uint32_t line) const -> uint32_t {
+    std::call_once(lineStartsBuilt, [this] { buildLineStarts(); });
+    return lineStarts[line - 1];
+}
+
+// This is the implementation of the method to find the line and column of an
+// offset. Columns count code points, and invalid UTF-8 bytes do not count as a
+// character, which matches the Lexer's diagnostics. Only the lines after an
+// invalid sequence need to be decoded.
+auto SourceFile::getLineAndColumn(uint32_t offset) const -> LineAndColumn {
+    if (streamed) {
+        auto it = std::lower_bound(
+            recordedLocations.begin(), recordedLocations.end(), offset,
+            [](const auto &entry, uint32_t offset) {
+                return entry.first < offset;
+            });
+        return it != recordedLocations.end() && it->first == offset
+                   ? it->second
+                   : LineAndColumn{0, 0};
+    }
+
+    std::call_once(lineStartsBuilt, [this] { buildLineStarts(); });
+
+    // The line is the last line start that is not past the offset.
+    auto it = std::upper_bound(lineStarts.begin(), lineStarts.end(), offset);
+    auto line = static_cast<uint32_t>(it - lineStarts.begin());
+
+    auto *ptr = bufPtr + lineStarts[line - 1], *target = bufPtr + offset;
+    // The UTF-8 BOM is removed by the Lexer, so it is not a character.
+    if (line == 1 && target >= ptr + 3 &&
+        llvm::StringRef{ptr, static_cast<size_t>(endPtr - ptr)}.startswith(
+            "\xef\xbb\xbf"))
+        ptr += 3;
+
+    // In valid text, every byte that is not a continuation byte begins a
+    // character.
+    uint32_t col = 1;
+    if (target <= getValidUTF8End()) {
+        for (; ptr < target; ++ptr)
+            col += (static_cast<uint8_t>(ptr[0]) & 0xc0) != 0x80;
+        return {line, col};
+    }
+
+    while (ptr < target) {
+        if (static_cast<uint8_t>(ptr[0]) < 0x80) {
+            ++ptr;
+            ++col;
+            continue;
+        }
+
+        llvm::UTF32 cp;
+        if (llvm::convertUTF8Sequence((const llvm::UTF8 **)&ptr,
+                                      (const llvm::UTF8 *)endPtr, &cp,
+                                      llvm::strictConversion) !=
+            llvm::conversionOK) {
+            ++ptr;
+            continue;
+        }
+        ++col;
+    }
+    return {line, col};
+}
+
+// This is the implementation of the method to record a location in a streamed
+// file. The same offset may be recorded for several diagnostics.
+auto SourceFile::recordLocation(uint32_t offset, LineAndColumn loc) const
+    -> void {
+    if (recordedLocations.empty() || recordedLocations.back().first != offset)
+        recordedLocations.emplace_back(offset, loc);
+}
+
+// This is the implementation of the method to advance a LocationTracker. It
+// follows the same rules as the line start table and getLineAndColumn: \r\n is
+// a single line terminator, U+2028 and U+2029 end a line, the BOM is not a
+// character, and invalid UTF-8 bytes do not count towards the column.
+auto LocationTracker::advance(const char *ptr, const char *endPtr,
+                              uint32_t target) -> void {
+    if (offset == 0 && target >= 3 &&
+        llvm::StringRef{ptr, static_cast<size_t>(endPtr - ptr)}.startswith(
+            "\xef\xbb\xbf")) {
+        ptr += 3;
+        offset = 3;
+    }
+
+    while (offset < target) {
+        auto c = ptr[0];
+        if (c == '\n' || (c == '\r' && ptr[1] != '\n')) {
+            ++ptr;
+            ++offset;
+            loc = {loc.line + 1, 1};
+            continue;
+        }
+        if (static_cast<uint8_t>(c) < 0x80) {
+            ++ptr;
+            ++offset;
+            ++loc.col;
+            continue;
+        }
+        if (c == '\xe2' && ptr[1] == '\x80' &&
+            (ptr[2] == '\xa8' || ptr[2] == '\xa9')) {
+            ptr += 3;
+            offset += 3;
+            loc = {loc.line + 1, 1};
+            continue;
+        }
+
+        auto *start = ptr;
+        llvm::UTF32 cp;
+        if (llvm::convertUTF8Sequence((const llvm::UTF8 **)&ptr,
+                                      (const llvm::UTF8 *)endPtr, &cp,
+                                      llvm::strictConversion) !=
+            llvm::conversionOK) {
+            ++ptr;
+        } else {
+            ++loc.col;
+        }
+        offset += static_cast<uint32_t>(ptr - start);
+    }
+}
+} // namespace ntsc
@@ -0,0 +1,194 @@
+#ifndef NTSC_SOURCEFILE_H
+#define NTSC_SOURCEFILE_H
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/StringSaver.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+    This file defines the SourceFile interface. It describes the contents of a
+    single source file and maps byte offsets to lines and columns on demand.
+*/
+
+namespace ntsc {
+// This is a compact handle to a source file owned by the SourceManager. The
+// value 0 is reserved for invalid handles.
+class FileID {
+    uint32_t value = 0;
+
+  public:
+    FileID() = default;
+    explicit FileID(uint32_t value) : value{value} {}
+
+    [[nodiscard]] inline auto isValid() const -> bool { return value != 0; }
+    [[nodiscard]] inline auto getValue() const -> uint32_t { return value; }
+
+    inline auto operator==(FileID other) const -> bool {
+        return value == other.value;
+    }
+    inline auto operator!=(FileID other) const -> bool {
+        return value != other.value;
+    }
+};
+
+// This struct holds a 1-based line and column. Columns count Unicode code
+// points rather than bytes.
+struct LineAndColumn {
+    uint32_t line, col;
+};
+
+class SourceFile {
+    // This is the handle of the file in the SourceManager. It is invalid for
+    // files that are not owned by a SourceManager.
+    FileID id;
+
+    // This is the path of the file. It is either from the CLI or from another
+    // source file.
+    std::string path;
+
+    // These are the buffer start and end pointers. The end pointer must point
+    // to a null character.
+    const char *bufPtr, *endPtr;
+
+    // This points to the first invalid UTF-8 sequence of the buffer, or to the
+    // end of the buffer if it is all valid. The text before it is validated
+    // once, so that it can be decoded without checks. It is null until the
+    // buffer is first validated, which happens on the thread that lexes the
+    // file, so files are loaded without reading their text.
+    mutable std::atomic<const char *> validUTF8End;
+
+    // This method will validate the buffer and record where its valid text
+    // ends.
+    auto findValidUTF8End() const -> const char *;
+
+    // This table holds the offset of the first character of every line. It is
+    // only built when the first location is requested, since we only need
+    // positions when emitting diagnostics.
+    mutable std::vector<uint32_t> lineStarts;
+    mutable std::once_flag lineStartsBuilt;
+
+    // This method will scan the buffer for line terminators and fill the line
+    // start table.
+    auto buildLineStarts() const -> void;
+
+    // This method will scan the buffer from the start of a line, and append
+    // the start of every line after it, until it appends one at or past the
+    // limit or reaches the end of the buffer.
+    auto findLineStarts(const char *ptr, uint64_t limit,
+                        std::vector<uint32_t> &starts) const -> void;
+
+    // This tracks whether the file is streamed. The text of a streamed file is
+    // released as it is lexed, so its buffer is empty, and the locations of
+    // its diagnostics are recorded while the text is still in memory.
+    bool streamed = false;
+    mutable std::vector<std::pair<uint32_t, LineAndColumn>> recordedLocations;
+
+    // This holds the text of a streamed file that diagnostic arguments point
+    // into, since the rest of the text does not outlive the lexer.
+    mutable llvm::BumpPtrAllocator retainedTextAllocator;
+    mutable llvm::StringSaver retainedText{retainedTextAllocator};
+
+  public:
+    // This constructor will be used to instantiate SourceFile instances with a
+    // file path and a null terminated buffer. The SourceFile does not own the
+    // buffer. The buffer is validated as UTF-8 when it is first needed, unless
+    // the end of its valid text is given.
+    SourceFile(llvm::StringRef path, const char *bufPtr, const char *endPtr,
+               FileID id = FileID{});
+    SourceFile(llvm::StringRef path, const char *bufPtr, const char *endPtr,
+               FileID id, const char *validUTF8End);
+
+    // This constructor will be used to instantiate streamed SourceFile
+    // instances, which have no buffer.
+    SourceFile(llvm::StringRef path, FileID id);
+
+    SourceFile(const SourceFile &) = delete;
+    auto operator=(const SourceFile &) -> SourceFile & = delete;
+
+    // These methods will return the handle, path and buffer of the file.
+    [[nodiscard]] inline auto getID() const -> FileID { return id; }
+    [[nodiscard]] inline auto getPath() const -> llvm::StringRef {
+        return path;
+    }
+    [[nodiscard]] inline auto getBufferStart() const -> const char * {
+        return bufPtr;
+    }
+    [[nodiscard]] inline auto getBufferEnd() const -> const char * {
+        return endPtr;
+    }
+    [[nodiscard]] inline auto getBuffer() const -> llvm::StringRef {
+        return {bufPtr, static_cast<size_t>(endPtr - bufPtr)};
+    }
+
+    // This method will return the end of the valid UTF-8 text at the start of
+    // the buffer, which is the first invalid sequence. The buffer is validated
+    // by the first call. Threads that call it at once may both validate it,
+    // and find the same end.
+    [[nodiscard]] inline auto getValidUTF8End() const -> const char * {
+        auto *end = validUTF8End.load(std::memory_order_acquire);
+        return end ? end : findValidUTF8End();
+    }
+
+    // This method will update the file after its buffer was edited, which
+    // moved it to the given pointers and replaced the removed bytes at the
+    // offset with the inserted ones. Only the text around the edit is scanned
+    // again, for line terminators and for invalid UTF-8. No other thread may
+    // use the file during the edit.
+    auto applyEdit(const char *newBufPtr, const char *newEndPtr,
+                   uint32_t offset, uint32_t removedLength,
+                   uint32_t insertedLength) -> void;
+
+    // This method will return the number of lines in the file.
+    [[nodiscard]] auto getLineCount() const -> uint32_t;
+
+    // This method will return the offset of the first character of the given
+    // 1-based line.
+    [[nodiscard]] auto getLineStart(uint32_t line) const -> uint32_t;
+
+    // This method will find the line and column of the given byte offset. The
+    // line is found with a binary search over the line start table and the
+    // column is found by counting code points from the start of the line. For
+    // streamed files, the offset must have been recorded.
+    [[nodiscard]] auto getLineAndColumn(uint32_t offset) const
+        -> LineAndColumn;
+
+    // This method will return whether the file is streamed.
+    [[nodiscard]] inline auto isStreamed() const -> bool { return streamed; }
+
+    // This method will record the location of an offset in a streamed file.
+    // Offsets must be recorded in increasing order, from a single thread.
+    auto recordLocation(uint32_t offset, LineAndColumn loc) const -> void;
+
+    // This method will keep a copy of some text of a streamed file for as
+    // long as the file exists.
+    inline auto retainText(llvm::StringRef text) const -> llvm::StringRef {
+        return retainedText.save(text);
+    }
+};
+
+// This class finds lines and columns in a single forward pass over a file. It
+// is used for streamed files, whose text is only in memory once, and it gives
+// the same results as SourceFile::getLineAndColumn.
+class LocationTracker {
+    uint32_t offset = 0;
+    LineAndColumn loc{1, 1};
+
+  public:
+    // This method will advance to the target offset. The pointer must point
+    // to the text at the current offset, and the text must be available up to
+    // the end pointer, which must not be before the target. The buffer must be
+    // null terminated.
+    auto advance(const char *ptr, const char *endPtr, uint32_t target) -> void;
+
+    // These methods will return the current offset and its location.
+    [[nodiscard]] inline auto getOffset() const -> uint32_t { return offset; }
+    [[nodiscard]] inline auto getLocation() const -> LineAndColumn {
+        return loc;
+    }
+};
+} // namespace ntsc
+
+#endif
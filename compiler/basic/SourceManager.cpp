@@ -0,0 +1,231 @@
+#include "SourceManager.h"
+#include "llvm/Config/llvm-config.h"
+#include <cerrno>
+
+#if defined(LLVM_ON_UNIX)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+    This file implements the SourceManager interface for loading and owning
+    source files.
+*/
+
+namespace ntsc {
+// Files smaller than this are read into the heap. Setting up and tearing down
+// a mapping costs more than copying a few pages.
+static constexpr size_t minMappedFileSize = 16 * 1024;
+
+// This is the buffer shared by all empty files. It is only the null character.
+static const char emptyBuffer[1] = {0};
+
+// This is the implementation of the move constructor. The mapping must only be
+// released by one of the buffers.
+SourceManager::Buffer::Buffer(Buffer &&other) noexcept
+    : bufPtr{other.bufPtr}, endPtr{other.endPtr}, mapBase{other.mapBase},
+      mapSize{other.mapSize}, heapBuffer{std::move(other.heapBuffer)},
+      memoryBuffer{std::move(other.memoryBuffer)} {
+    other.mapBase = nullptr;
+}
+
+// This is the implementation of the destructor, which will release the mapping
+// of the file if there is one.
+SourceManager::Buffer::~Buffer() {
+#if defined(LLVM_ON_UNIX)
+    if (mapBase)
+        munmap(mapBase, mapSize);
+#endif
+}
+
+// This is the implementation of the method to create a new entry. The FileID is
+// the index of the entry plus one, since 0 is reserved for invalid handles.
+auto SourceManager::createEntry(llvm::StringRef path, Buffer buffer) -> FileID {
+    auto id = FileID{static_cast<uint32_t>(entries.size() + 1)};
+    entries.push_back(std::make_unique<Entry>(path, std::move(buffer), id));
+    return id;
+}
+
+#if defined(LLVM_ON_UNIX)
+// This is the implementation of the method to read a file on POSIX systems. We
+// memory map large files, and the Lexer needs a null character after the last
+// byte. If the size of the file is not a multiple of the page size, the kernel
+// fills the rest of the last page with zeroes. Otherwise, we reserve one extra
+// page of anonymous (zeroed) memory and map the file over the start of it.
+auto SourceManager::readFile(int fd, size_t size) -> llvm::ErrorOr<Buffer> {
+    Buffer buffer;
+    if (size == 0) {
+        buffer.bufPtr = buffer.endPtr = emptyBuffer;
+        return buffer;
+    }
+
+    // Small files are read into the heap with room for the null character.
+    if (size < minMappedFileSize) {
+        buffer.heapBuffer = std::make_unique<char[]>(size + 1);
+        size_t bytesRead = 0;
+        while (bytesRead < size) {
+            auto n = read(fd, buffer.heapBuffer.get() + bytesRead,
+                          size - bytesRead);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0)
+                return std::error_code{errno, std::generic_category()};
+            // The file has been truncated while we were reading it.
+            if (n == 0)
+                return std::make_error_code(std::errc::io_error);
+            bytesRead += static_cast<size_t>(n);
+        }
+        buffer.heapBuffer[size] = 0;
+        buffer.bufPtr = buffer.heapBuffer.get();
+        buffer.endPtr = buffer.bufPtr + size;
+        return buffer;
+    }
+
+    auto pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    void *mapBase;
+    auto mapSize = size;
+    if (size % pageSize != 0) {
+        mapBase = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    } else {
+        mapSize = size + pageSize;
+        mapBase = mmap(nullptr, mapSize, PROT_READ,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapBase != MAP_FAILED &&
+            mmap(mapBase, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) ==
+                MAP_FAILED) {
+            auto ec = std::error_code{errno, std::generic_category()};
+            munmap(mapBase, mapSize);
+            return ec;
+        }
+    }
+    if (mapBase == MAP_FAILED)
+        return std::error_code{errno, std::generic_category()};
+
+    // The Lexer reads the file from front to back exactly once, so we will ask
+    // the kernel to read ahead aggressively and start reading right away.
+    madvise(mapBase, size, MADV_SEQUENTIAL);
+    madvise(mapBase, size, MADV_WILLNEED);
+
+    buffer.mapBase = mapBase;
+    buffer.mapSize = mapSize;
+    buffer.bufPtr = static_cast<const char *>(mapBase);
+    buffer.endPtr = buffer.bufPtr + size;
+    return buffer;
+}
+
+// This is the implementation of the method to load a file on POSIX systems. The
+// unique ID comes from the device and inode of the open descriptor, so a file
+// reached through a symbolic link or a relative path is only loaded once.
+auto SourceManager::loadFile(llvm::StringRef path) -> llvm::ErrorOr<FileID> {
+    auto fd = open(path.str().c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return std::error_code{errno, std::generic_category()};
+
+    struct stat status;
+    if (fstat(fd, &status) != 0) {
+        auto ec = std::error_code{errno, std::generic_category()};
+        close(fd);
+        return ec;
+    }
+    if (!S_ISREG(status.st_mode)) {
+        close(fd);
+        return std::make_error_code(std::errc::invalid_argument);
+    }
+
+    auto uniqueID =
+        llvm::sys::fs::UniqueID{static_cast<uint64_t>(status.st_dev),
+                                static_cast<uint64_t>(status.st_ino)};
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        auto existing = filesByUniqueID.find(uniqueID);
+        if (existing != filesByUniqueID.end()) {
+            close(fd);
+            return existing->second;
+        }
+    }
+
+    // The file is read without holding the lock, so that worker threads can
+    // load files in parallel. The mapping stays valid after the descriptor is
+    // closed.
+    auto buffer = readFile(fd, static_cast<size_t>(status.st_size));
+    close(fd);
+    if (auto ec = buffer.getError())
+        return ec;
+
+    // Another thread may have loaded the same file in the meantime, in which
+    // case our copy is released.
+    std::lock_guard<std::mutex> lock{mutex};
+    auto inserted = filesByUniqueID.try_emplace(uniqueID, FileID{});
+    if (inserted.second)
+        inserted.first->second = createEntry(path, std::move(*buffer));
+    return inserted.first->second;
+}
+#else
+// This is the implementation of the method to load a file on other systems. We
+// will let LLVM decide whether to map the file.
+auto SourceManager::loadFile(llvm::StringRef path) -> llvm::ErrorOr<FileID> {
+    llvm::sys::fs::UniqueID uniqueID;
+    if (auto ec = llvm::sys::fs::getUniqueID(path, uniqueID))
+        return ec;
+
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        auto existing = filesByUniqueID.find(uniqueID);
+        if (existing != filesByUniqueID.end())
+            return existing->second;
+    }
+
+    auto fileResult = llvm::MemoryBuffer::getFile(path);
+    if (auto ec = fileResult.getError())
+        return ec;
+
+    Buffer buffer;
+    buffer.bufPtr = (*fileResult)->getBufferStart();
+    buffer.endPtr = (*fileResult)->getBufferEnd();
+    buffer.memoryBuffer = std::move(*fileResult);
+
+    std::lock_guard<std::mutex> lock{mutex};
+    auto inserted = filesByUniqueID.try_emplace(uniqueID, FileID{});
+    if (inserted.second)
+        inserted.first->second = createEntry(path, std::move(buffer));
+    return inserted.first->second;
+}
+#endif
+
+// This is the implementation of the method to take ownership of an in-memory
+// buffer. These buffers have no identity on disk, so they are never merged.
+auto SourceManager::addBuffer(std::unique_ptr<llvm::MemoryBuffer> memoryBuffer)
+    -> FileID {
+    Buffer buffer;
+    buffer.bufPtr = memoryBuffer->getBufferStart();
+    buffer.endPtr = memoryBuffer->getBufferEnd();
+    auto path = memoryBuffer->getBufferIdentifier().str();
+    buffer.memoryBuffer = std::move(memoryBuffer);
+
+    std::lock_guard<std::mutex> lock{mutex};
+    return createEntry(path, std::move(buffer));
+}
+
+// This is the implementation of the method to add a streamed file. Like
+// in-memory buffers, streamed files are never merged.
+auto SourceManager::addStreamedFile(llvm::StringRef path) -> FileID {
+    std::lock_guard<std::mutex> lock{mutex};
+    auto id = FileID{static_cast<uint32_t>(entries.size() + 1)};
+    entries.push_back(std::make_unique<Entry>(path, id));
+    return id;
+}
+
+// This is the implementation of the method to find a file by its handle.
+auto SourceManager::getFile(FileID id) const -> const SourceFile & {
+    std::lock_guard<std::mutex> lock{mutex};
+    return entries[id.getValue() - 1]->file;
+}
+
+// This is the implementation of the method to count the files.
+auto SourceManager::getFileCount() const -> uint32_t {
+    std::lock_guard<std::mutex> lock{mutex};
+    return static_cast<uint32_t>(entries.size());
+}
+} // namespace ntsc
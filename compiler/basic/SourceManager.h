@@ -0,0 +1,92 @@
+#ifndef NTSC_SOURCEMANAGER_H
+#define NTSC_SOURCEMANAGER_H
+#include "SourceFile.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Support/ErrorOr.h"
+#include "llvm/Support/FileSystem/UniqueID.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/*
+    This file defines the SourceManager interface. It owns the buffers of every
+    source file in a compilation and hands out compact FileIDs for them.
+*/
+
+namespace ntsc {
+class SourceManager {
+    // This struct owns the memory behind a single source file. Large files are
+    // memory mapped, while small files and in-memory buffers are kept on the
+    // heap.
+    struct Buffer {
+        const char *bufPtr = nullptr, *endPtr = nullptr;
+        void *mapBase = nullptr;
+        size_t mapSize = 0;
+        std::unique_ptr<char[]> heapBuffer;
+        std::unique_ptr<llvm::MemoryBuffer> memoryBuffer;
+
+        Buffer() = default;
+        Buffer(Buffer &&other) noexcept;
+        Buffer(const Buffer &) = delete;
+        ~Buffer();
+    };
+
+    // This struct holds a file together with the memory behind it.
+    struct Entry {
+        Buffer buffer;
+        SourceFile file;
+
+        Entry(llvm::StringRef path, Buffer buffer, FileID id)
+            : buffer{std::move(buffer)},
+              file{path, this->buffer.bufPtr, this->buffer.endPtr, id} {}
+        Entry(llvm::StringRef path, FileID id) : file{path, id} {}
+    };
+
+    // These are the files in the order they were added. The FileID of a file
+    // is its index plus one.
+    std::vector<std::unique_ptr<Entry>> entries;
+
+    // This map is used to load each file only once, even when it is reached
+    // through different paths or symbolic links.
+    llvm::DenseMap<llvm::sys::fs::UniqueID, FileID> filesByUniqueID;
+
+    // This mutex guards the tables above, so files can be loaded from worker
+    // threads.
+    mutable std::mutex mutex;
+
+    // This method will read or map the open file with the given descriptor and
+    // size into memory.
+    static auto readFile(int fd, size_t size) -> llvm::ErrorOr<Buffer>;
+
+    // This method will append a new entry and return its handle. The mutex
+    // must be held by the caller.
+    auto createEntry(llvm::StringRef path, Buffer buffer) -> FileID;
+
+  public:
+    SourceManager() = default;
+    SourceManager(const SourceManager &) = delete;
+    auto operator=(const SourceManager &) -> SourceManager & = delete;
+
+    // This method will load the file at the given path. The buffer is always
+    // terminated by a null character, which the Lexer relies on. If the file
+    // has already been loaded, the existing FileID is returned.
+    auto loadFile(llvm::StringRef path) -> llvm::ErrorOr<FileID>;
+
+    // This method will take ownership of an in-memory buffer, such as the
+    // contents of stdin. The buffer must be null terminated.
+    auto addBuffer(std::unique_ptr<llvm::MemoryBuffer> memoryBuffer) -> FileID;
+
+    // This method will add a streamed file, whose text is read and released
+    // by a StreamingLexer instead of being owned by the SourceManager.
+    auto addStreamedFile(llvm::StringRef path) -> FileID;
+
+    // This method will return the file for the given handle.
+    [[nodiscard]] auto getFile(FileID id) const -> const SourceFile &;
+
+    // This method will return the number of files that have been added.
+    [[nodiscard]] auto getFileCount() const -> uint32_t;
+};
+} // namespace ntsc
+
+#endif
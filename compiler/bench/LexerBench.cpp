@@ -0,0 +1,398 @@
+#include "Diagnostics.h"
+#include "IdentifierTable.h"
+#include "Lexer.h"
+#include "SourceManager.h"
+#include "Token.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*
+    This file implements the Lexer benchmark. It measures the throughput of
+    Lexer::lexToken over synthetic inputs that each stress one part of the DFA,
+    and over real corpora given on the command line. Every input is lexed
+    several times and the fastest run is reported, which is the most stable
+    number to compare across builds.
+*/
+
+static llvm::cl::OptionCategory benchCategory{"ntsc-bench options"};
+
+static llvm::cl::list<std::string> corpusPaths{
+    llvm::cl::Positional,
+    llvm::cl::desc("<corpus files or directories of .ts files>"),
+    llvm::cl::cat(benchCategory)};
+
+static llvm::cl::opt<unsigned> syntheticSize{
+    "synthetic-size",
+    llvm::cl::desc("The size of each synthetic input in MiB (0 disables them)"),
+    llvm::cl::value_desc("MiB"), llvm::cl::init(8),
+    llvm::cl::cat(benchCategory)};
+
+static llvm::cl::opt<unsigned> repetitions{
+    "repetitions", llvm::cl::desc("The number of times each input is lexed"),
+    llvm::cl::value_desc("N"), llvm::cl::init(10),
+    llvm::cl::cat(benchCategory)};
+
+static llvm::cl::opt<std::string> filter{
+    "filter",
+    llvm::cl::desc("Only run the inputs whose name contains the given text"),
+    llvm::cl::value_desc("text"), llvm::cl::cat(benchCategory)};
+
+static llvm::cl::opt<bool> jsonOutput{
+    "json", llvm::cl::desc("Print the results as a JSON array"),
+    llvm::cl::cat(benchCategory)};
+
+// This function will read the time stamp counter, or return 0 if the target
+// has none. Cycle counts are only reported when it is available.
+static inline auto readCycleCounter() -> uint64_t {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// This struct is a single input to the benchmark. The files of a corpus are
+// lexed one after another and reported as one input.
+struct BenchInput {
+    std::string name;
+    std::vector<ntsc::FileID> files;
+    uint64_t bytes = 0;
+};
+
+// This struct holds the best run of a single input.
+struct BenchResult {
+    uint64_t tokens = 0;
+    double seconds = 0;
+    uint64_t cycles = 0;
+};
+
+// This class generates the synthetic inputs. Each generator appends short
+// snippets until the requested size is reached, so every input has the same
+// size regardless of the snippets it contains. The seed is fixed, so the
+// inputs are the same in every run.
+class SyntheticGenerator {
+    std::mt19937 rng{0x6e747363};
+
+    auto pick(size_t count) -> size_t {
+        return std::uniform_int_distribution<size_t>{0, count - 1}(rng);
+    }
+
+    auto appendIdentifier(std::string &out) -> void {
+        static const char *const names[] = {
+            "value", "index", "result", "node", "parent", "options",
+            "context", "buffer", "length", "callback", "x", "_private",
+            "$element"};
+        out += names[pick(std::size(names))];
+        out += std::to_string(pick(100));
+    }
+
+  public:
+    // This method will generate code with a comment on nearly every line.
+    auto comments(size_t size) -> std::string {
+        std::string out;
+        while (out.size() < size) {
+            switch (pick(3)) {
+            case 0:
+                out += "// This line comment explains the statement below it.";
+                break;
+            case 1:
+                out += "/* A block comment\n * spanning several lines.\n */";
+                break;
+            default:
+                out += "/** @param value the input */";
+            }
+            out += "\nlet ";
+            appendIdentifier(out);
+            out += " = ";
+            appendIdentifier(out);
+            out += ";\n";
+        }
+        return out;
+    }
+
+    // This method will generate code that is dominated by string literals.
+    auto strings(size_t size) -> std::string {
+        std::string out;
+        while (out.size() < size) {
+            out += "messages.push(";
+            out += pick(2) ? '"' : '\'';
+            auto length = 8 + pick(120);
+            for (size_t i = 0; i < length; ++i)
+                out += static_cast<char>('a' + pick(26));
+            out += out[out.size() - length - 1];
+            out += ", \"key\", 'a much longer string literal value');\n";
+        }
+        return out;
+    }
+
+    // This method will generate code that is dominated by template literals
+    // and strings with escape sequences, whose values have to be cooked.
+    auto templates(size_t size) -> std::string {
+        std::string out;
+        while (out.size() < size) {
+            out += "log(`item ";
+            appendIdentifier(out);
+            out += ": ${";
+            appendIdentifier(out);
+            out += "} of ${count + 1}\\n`, \"tab\\tseparated \\\"quoted\\\" "
+                   "\\u00e9\");\n";
+        }
+        return out;
+    }
+
+    // This method will generate code that is dominated by numeric literals of
+    // every radix.
+    auto numbers(size_t size) -> std::string {
+        std::string out;
+        char digits[32];
+        while (out.size() < size) {
+            out += "table.set(";
+            out += std::to_string(rng());
+            out += ", ";
+            snprintf(digits, sizeof(digits), "0x%x",
+                     static_cast<unsigned>(rng()));
+            out += digits;
+            out += ", ";
+            snprintf(digits, sizeof(digits), "%.6g",
+                     std::uniform_real_distribution<double>{0, 1e6}(rng));
+            out += digits;
+            out += ", 1_000_000, 0b1010_1010, 0o755, 3.25e-8, ";
+            out += std::to_string(rng());
+            out += "n);\n";
+        }
+        return out;
+    }
+
+    // This method will generate code with non-ASCII identifiers, strings, and
+    // comments, which go through the UTF-8 slow paths of the Lexer.
+    auto unicode(size_t size) -> std::string {
+        static const char *const names[] = {"données", "переменная", "变量",
+                                            "πλάτος", "café", "ñandú"};
+        std::string out;
+        while (out.size() < size) {
+            out += "// Ünïcödé comment — ";
+            out += names[pick(std::size(names))];
+            out += "\nconst ";
+            out += names[pick(std::size(names))];
+            out += " = \"日本語のテキスト\" + '";
+            out += names[pick(std::size(names))];
+            out += "';\n";
+        }
+        return out;
+    }
+
+    // This method will generate minified code, where punctuators are dense and
+    // whitespace is rare.
+    auto minified(size_t size) -> std::string {
+        static const char *const operators[] = {
+            "=",   "+=",  "===", "!==", "&&", "||", "??", ">>>", ">>>=", "**=",
+            "?\?=", "&&=", "?.",  "=>",  "<=", "<<", "...", "++", "-",   "%"};
+        std::string out;
+        while (out.size() < size) {
+            out += static_cast<char>('a' + pick(26));
+            out += operators[pick(std::size(operators))];
+            out += static_cast<char>('a' + pick(26));
+            out += pick(4) ? "(" : "[";
+            out += std::to_string(pick(10));
+            out += pick(2) ? ")," : "]);";
+            if (pick(8) == 0)
+                out += "}function " + std::string(1, 'a' + pick(26)) + "(){";
+        }
+        return out;
+    }
+
+    // This method will generate ordinary code with CRLF line endings.
+    auto crlf(size_t size) -> std::string {
+        std::string out;
+        while (out.size() < size) {
+            out += "function ";
+            appendIdentifier(out);
+            out += "(a: number, b: string): boolean {\r\n    if (a >= ";
+            out += std::to_string(pick(1000));
+            out += " && b !== \"\") {\r\n        return true;\r\n    }\r\n"
+                   "    return a++ < 10 ?? false;\r\n}\r\n";
+        }
+        return out;
+    }
+};
+
+// This function will add every .ts file under the given path to the input. A
+// path that is not a directory is added as a single file.
+static auto addCorpus(ntsc::SourceManager &sourceManager, BenchInput &input,
+                      llvm::StringRef path) -> bool {
+    auto addFile = [&](llvm::StringRef filePath) -> bool {
+        auto fileResult = sourceManager.loadFile(filePath);
+        if (auto ec = fileResult.getError()) {
+            llvm::errs() << "error: " << filePath << ": " << ec.message()
+                         << '\n';
+            return false;
+        }
+        input.files.push_back(*fileResult);
+        input.bytes += sourceManager.getFile(*fileResult).getBuffer().size();
+        return true;
+    };
+
+    if (!llvm::sys::fs::is_directory(path))
+        return addFile(path);
+
+    // The files are sorted so that the order of a corpus is stable.
+    std::vector<std::string> filePaths;
+    std::error_code ec;
+    for (llvm::sys::fs::recursive_directory_iterator it{path, ec}, end;
+         it != end && !ec; it.increment(ec)) {
+        if (llvm::sys::path::extension(it->path()) == ".ts")
+            filePaths.push_back(it->path());
+    }
+    if (ec) {
+        llvm::errs() << "error: " << path << ": " << ec.message() << '\n';
+        return false;
+    }
+    std::sort(filePaths.begin(), filePaths.end());
+    for (auto &filePath : filePaths) {
+        if (!addFile(filePath))
+            return false;
+    }
+    return true;
+}
+
+// This function will lex every file of the input once, and return the number
+// of tokens. The tables are created for every run, so each run interns the
+// same names as a real compilation would.
+static auto lexInput(const ntsc::SourceManager &sourceManager,
+                     const BenchInput &input) -> uint64_t {
+    ntsc::DiagnosticsEngine diags{sourceManager};
+    ntsc::IdentifierTable identifiers;
+    uint64_t tokenCount = 0;
+    for (auto id : input.files) {
+        ntsc::Lexer lexer{sourceManager.getFile(id), diags, identifiers};
+        ntsc::Token tok;
+        do {
+            lexer.lexToken(tok);
+            ++tokenCount;
+        } while (tok.kind != ntsc::TokenKind::FileEnd);
+    }
+    return tokenCount;
+}
+
+// This function will run the input the requested number of times, and return
+// the fastest run.
+static auto runInput(const ntsc::SourceManager &sourceManager,
+                     const BenchInput &input) -> BenchResult {
+    // The first run is not measured. It faults in the pages of mapped files
+    // and warms up the caches.
+    BenchResult best;
+    best.tokens = lexInput(sourceManager, input);
+    best.seconds = HUGE_VAL;
+    for (unsigned i = 0; i < std::max(repetitions.getValue(), 1u); ++i) {
+        auto startTime = std::chrono::steady_clock::now();
+        auto startCycles = readCycleCounter();
+        lexInput(sourceManager, input);
+        auto cycles = readCycleCounter() - startCycles;
+        auto seconds = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - startTime)
+                           .count();
+        if (seconds < best.seconds) {
+            best.seconds = seconds;
+            best.cycles = cycles;
+        }
+    }
+    return best;
+}
+
+auto main(int argc, char **argv) -> int {
+    llvm::cl::HideUnrelatedOptions(benchCategory);
+    llvm::cl::ParseCommandLineOptions(argc, argv,
+                                      "Native-TS Lexer Benchmark\n");
+
+    ntsc::SourceManager sourceManager;
+    std::vector<BenchInput> inputs;
+
+    // The synthetic inputs are added as in-memory buffers, which are always
+    // null terminated.
+    if (syntheticSize != 0) {
+        auto size = static_cast<size_t>(syntheticSize) << 20;
+        SyntheticGenerator generator;
+        std::pair<const char *, std::string> sources[] = {
+            {"comments", generator.comments(size)},
+            {"strings", generator.strings(size)},
+            {"numbers", generator.numbers(size)},
+            {"unicode", generator.unicode(size)},
+            {"minified", generator.minified(size)},
+            {"crlf", generator.crlf(size)},
+            {"templates", generator.templates(size)}};
+        for (auto &source : sources) {
+            BenchInput input;
+            input.name = source.first;
+            input.bytes = source.second.size();
+            input.files.push_back(
+                sourceManager.addBuffer(llvm::MemoryBuffer::getMemBufferCopy(
+                    source.second, source.first)));
+            inputs.push_back(std::move(input));
+        }
+    }
+
+    for (auto &path : corpusPaths) {
+        BenchInput input;
+        input.name = path;
+        if (!addCorpus(sourceManager, input, path))
+            return 1;
+        inputs.push_back(std::move(input));
+    }
+
+    llvm::json::Array results;
+    if (!jsonOutput)
+        llvm::outs() << "input                           MiB     tokens      "
+                        "  MiB/s    Mtokens/s  cyc/token\n";
+    for (auto &input : inputs) {
+        if (!llvm::StringRef{input.name}.contains(filter))
+            continue;
+
+        auto result = runInput(sourceManager, input);
+        auto mebibytes = static_cast<double>(input.bytes) / (1 << 20);
+        auto bytesPerSecond = mebibytes / result.seconds;
+        auto tokensPerSecond =
+            static_cast<double>(result.tokens) / result.seconds / 1e6;
+        auto cyclesPerToken = static_cast<double>(result.cycles) /
+                              static_cast<double>(result.tokens);
+
+        if (jsonOutput) {
+            results.push_back(llvm::json::Object{
+                {"input", input.name},
+                {"files", static_cast<int64_t>(input.files.size())},
+                {"bytes", static_cast<int64_t>(input.bytes)},
+                {"tokens", static_cast<int64_t>(result.tokens)},
+                {"seconds", result.seconds},
+                {"mibPerSecond", bytesPerSecond},
+                {"mtokensPerSecond", tokensPerSecond},
+                {"cyclesPerToken", cyclesPerToken}});
+            continue;
+        }
+        llvm::outs() << llvm::format(
+            "%-24s %10.2f %10llu %12.1f %12.1f %10.1f\n", input.name.c_str(),
+            mebibytes, static_cast<unsigned long long>(result.tokens),
+            bytesPerSecond, tokensPerSecond, cyclesPerToken);
+    }
+
+    if (jsonOutput)
+        llvm::outs() << llvm::formatv("{0:2}",
+                                      llvm::json::Value(std::move(results)))
+                     << '\n';
+    return 0;
+}
@@ -0,0 +1,158 @@
+#include "AllocationPromotionPass.h"
+#include "EscapeAnalysis.h"
+#include "RuntimeFunctions.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/CFG.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/Casting.h"
+
+/*
+    This file contains the implementation of the AllocationPromotionPass. The
+    stack of a function is bounded, both for each object and in total, since
+    a deep recursion would otherwise overflow the stack of a program that ran
+    fine with every object on the heap.
+*/
+
+#define DEBUG_TYPE "codegen"
+
+ALWAYS_ENABLED_STATISTIC(objectsOnStack,
+                         "Number of allocations moved to the stack");
+ALWAYS_ENABLED_STATISTIC(objectsInArena,
+                         "Number of allocations moved to an arena");
+
+namespace ntsc {
+namespace {
+// These are the largest object that is moved to the stack, and the most
+// memory that the moved objects of a single function may take.
+constexpr uint64_t maxStackObjectSize = 512;
+constexpr uint64_t maxStackFrameSize = 2048;
+
+// This function will return whether a block can run again before its function
+// returns, which includes the cycles that are not natural loops.
+auto isInCycle(const llvm::BasicBlock *block, const llvm::DominatorTree &tree)
+    -> bool {
+    for (auto *successor : llvm::successors(block)) {
+        if (llvm::isPotentiallyReachable(successor, block, nullptr, &tree))
+            return true;
+    }
+    return false;
+}
+
+// This function will remove the write barriers of the stores into an
+// allocation, which the collector ignores once the object is off the heap.
+auto removeWriteBarriers(llvm::CallInst *call) -> void {
+    llvm::SmallVector<llvm::Value *, 8> pointers{call};
+    llvm::SmallVector<llvm::CallInst *, 8> barriers;
+    while (!pointers.empty()) {
+        auto *pointer = pointers.pop_back_val();
+        for (auto *user : pointer->users()) {
+            if (llvm::isa<llvm::BitCastInst>(user))
+                pointers.push_back(user);
+            else if (runtime::isCallTo(user, runtime::writeBarrier))
+                barriers.push_back(llvm::cast<llvm::CallInst>(user));
+        }
+    }
+    for (auto *barrier : barriers)
+        barrier->eraseFromParent();
+}
+
+// This function will replace an allocation with an object on the stack of the
+// given size.
+auto moveToStack(llvm::CallInst *call, uint64_t size) -> void {
+    removeWriteBarriers(call);
+    auto &function = *call->getFunction();
+    llvm::IRBuilder<> entry{&function.getEntryBlock(),
+                            function.getEntryBlock().begin()};
+    auto *object =
+        entry.CreateAlloca(llvm::ArrayType::get(entry.getInt8Ty(), size));
+    object->setAlignment(llvm::Align{runtime::allocationAlignment});
+    object->takeName(call);
+
+    llvm::IRBuilder<> builder{call};
+    auto *pointer = builder.CreatePointerCast(object, call->getType());
+    builder.CreateMemSet(pointer, builder.getInt8(0), size,
+                         llvm::Align{runtime::allocationAlignment});
+    call->replaceAllUsesWith(pointer);
+    call->eraseFromParent();
+}
+
+// This function will replace an allocation with one in the given arena.
+auto moveToArena(llvm::CallInst *call, llvm::Value *arena) -> void {
+    removeWriteBarriers(call);
+    llvm::IRBuilder<> builder{call};
+    auto *replacement = builder.CreateCall(
+        runtime::getArenaAllocateFunction(*call->getModule()),
+        {arena, call->getArgOperand(0)});
+    replacement->takeName(call);
+    call->replaceAllUsesWith(replacement);
+    call->eraseFromParent();
+}
+
+// This function will add to a counter when the statistics are enabled.
+auto count(llvm::TrackingStatistic &statistic) -> void {
+    if (llvm::AreStatisticsEnabled())
+        ++statistic;
+}
+} // namespace
+
+// This is the implementation of AllocationPromotionPass::run. Every decision
+// is made from the analysis of the original function before any change.
+auto AllocationPromotionPass::run(llvm::Function &function,
+                                  llvm::FunctionAnalysisManager &manager)
+    -> llvm::PreservedAnalyses {
+    auto &tree = manager.getResult<llvm::DominatorTreeAnalysis>(function);
+    EscapeAnalysis analysis{function, tree};
+
+    llvm::SmallVector<std::pair<llvm::CallInst *, uint64_t>, 8> stackObjects;
+    llvm::SmallVector<std::pair<llvm::CallInst *, llvm::Value *>, 8>
+        arenaObjects;
+    uint64_t frameSize = 0;
+    for (auto &instruction : llvm::instructions(function)) {
+        if (!runtime::isCallTo(&instruction, runtime::allocate))
+            continue;
+        auto *call = llvm::cast<llvm::CallInst>(&instruction);
+        switch (analysis.getEscape(call)) {
+        case Escape::None: {
+            // An object in a cycle reuses the same stack slot every time, so
+            // it may only be moved when no object of an earlier iteration
+            // can still be reached through a phi.
+            auto *size = llvm::dyn_cast<llvm::ConstantInt>(
+                call->getArgOperand(0));
+            if (!size || size->getZExtValue() > maxStackObjectSize ||
+                frameSize + size->getZExtValue() > maxStackFrameSize ||
+                (analysis.isMerged(call) && isInCycle(call->getParent(), tree)))
+                break;
+            frameSize += size->getZExtValue();
+            stackObjects.emplace_back(call, size->getZExtValue());
+            break;
+        }
+        case Escape::Arena:
+            arenaObjects.emplace_back(call, analysis.getArena(call));
+            break;
+        case Escape::Heap:
+            break;
+        }
+    }
+    if (stackObjects.empty() && arenaObjects.empty())
+        return llvm::PreservedAnalyses::all();
+
+    for (auto [call, size] : stackObjects) {
+        moveToStack(call, size);
+        count(objectsOnStack);
+    }
+    for (auto [call, arena] : arenaObjects) {
+        moveToArena(call, arena);
+        count(objectsInArena);
+    }
+
+    llvm::PreservedAnalyses preserved;
+    preserved.preserveSet<llvm::CFGAnalyses>();
+    return preserved;
+}
+} // namespace ntsc
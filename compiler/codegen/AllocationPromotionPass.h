@@ -0,0 +1,24 @@
+#ifndef NTSC_ALLOCATIONPROMOTIONPASS_H
+#define NTSC_ALLOCATIONPROMOTIONPASS_H
+#include "llvm/IR/Function.h"
+#include "llvm/IR/PassManager.h"
+
+/*
+    This file defines the AllocationPromotionPass, which moves the objects
+    that the EscapeAnalysis proves never leave their function off the heap
+    and onto the stack, and the objects that only escape into the arena of a
+    request into the same arena. An object on the stack is zeroed where it
+    would have been allocated, as the heap would have, so that SROA can then
+    replace it with the values of its fields.
+*/
+
+namespace ntsc {
+class AllocationPromotionPass
+    : public llvm::PassInfoMixin<AllocationPromotionPass> {
+  public:
+    auto run(llvm::Function &function, llvm::FunctionAnalysisManager &manager)
+        -> llvm::PreservedAnalyses;
+};
+} // namespace ntsc
+
+#endif
@@ -0,0 +1,135 @@
+#include "AsyncFunction.h"
+#include "Promise.h"
+#include "RuntimeFunctions.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Intrinsics.h"
+
+/*
+    This file contains the implementation of the AsyncFunction. Every await
+    has a node of its own, which CoroSplit keeps in the frame, since the node
+    is in use while the function is suspended.
+*/
+
+namespace ntsc {
+static_assert(sizeof(AwaitNode) == 2 * sizeof(void *),
+              "an AwaitNode is a coroutine followed by the next node");
+
+// These are the results of llvm.coro.suspend.
+enum : uint64_t {
+    resumed = 0,
+    destroyed = 1,
+};
+
+// This is the implementation of the AsyncFunction constructor. The frame is
+// only allocated when llvm.coro.alloc asks for it, which it does not once
+// the frame has been elided.
+AsyncFunction::AsyncFunction(llvm::Function &function,
+                             llvm::IRBuilderBase &builder)
+    : function{function}, module{*function.getParent()} {
+    auto &context = module.getContext();
+    auto *pointer = builder.getInt8PtrTy();
+    awaitNodeType = llvm::StructType::get(context, {pointer, pointer});
+    function.addFnAttr(llvm::Attribute::PresplitCoroutine);
+
+    auto intrinsic = [&](llvm::Intrinsic::ID id,
+                         llvm::ArrayRef<llvm::Type *> types = {}) {
+        return llvm::Intrinsic::getDeclaration(&module, id, types);
+    };
+    auto *entry = llvm::BasicBlock::Create(context, "entry", &function);
+    auto *allocate = llvm::BasicBlock::Create(context, "coro.alloc", &function);
+    auto *begin = llvm::BasicBlock::Create(context, "coro.begin", &function);
+    cleanup = llvm::BasicBlock::Create(context, "coro.cleanup", &function);
+    suspend = llvm::BasicBlock::Create(context, "coro.suspend", &function);
+
+    builder.SetInsertPoint(entry);
+    promise = builder.CreateCall(runtime::getPromiseNewFunction(module), {},
+                                 "promise");
+    auto *null = llvm::ConstantPointerNull::get(pointer);
+    id = builder.CreateCall(
+        intrinsic(llvm::Intrinsic::coro_id),
+        {builder.getInt32(runtime::allocationAlignment), null, null, null},
+        "id");
+    builder.CreateCondBr(
+        builder.CreateCall(intrinsic(llvm::Intrinsic::coro_alloc), {id}),
+        allocate, begin);
+
+    builder.SetInsertPoint(allocate);
+    auto *size = builder.CreateCall(
+        intrinsic(llvm::Intrinsic::coro_size, {builder.getInt64Ty()}));
+    auto *memory = builder.CreateCall(
+        runtime::getCoroutineAllocateFunction(module), {size}, "frame");
+    builder.CreateBr(begin);
+
+    builder.SetInsertPoint(begin);
+    auto *frame = builder.CreatePHI(pointer, 2);
+    frame->addIncoming(null, entry);
+    frame->addIncoming(memory, allocate);
+    handle = builder.CreateCall(intrinsic(llvm::Intrinsic::coro_begin),
+                                {id, frame}, "handle");
+    auto *body = builder.GetInsertBlock();
+
+    // The frame is null here when it was elided, which the pool ignores.
+    builder.SetInsertPoint(cleanup);
+    auto *freed =
+        builder.CreateCall(intrinsic(llvm::Intrinsic::coro_free), {id, handle});
+    builder.CreateCall(
+        runtime::getCoroutineFreeFunction(module),
+        {freed, builder.CreateCall(intrinsic(llvm::Intrinsic::coro_size,
+                                             {builder.getInt64Ty()}))});
+    builder.CreateBr(suspend);
+
+    builder.SetInsertPoint(suspend);
+    builder.CreateCall(intrinsic(llvm::Intrinsic::coro_end),
+                       {handle, builder.getFalse()});
+    builder.CreateRet(builder.CreatePointerCast(promise,
+                                                function.getReturnType()));
+
+    builder.SetInsertPoint(body);
+}
+
+// This is the implementation of AsyncFunction::emitAwait. The coroutine is
+// saved before it is handed to the promise, so that resuming it before it
+// suspends would still be correct.
+auto AsyncFunction::emitAwait(llvm::IRBuilderBase &builder,
+                              llvm::Value *awaited) -> llvm::Value * {
+    auto &context = module.getContext();
+    auto *pointer = builder.getInt8PtrTy();
+    llvm::IRBuilder<> entry{&function.getEntryBlock(),
+                            function.getEntryBlock().begin()};
+    auto *node = entry.CreateAlloca(awaitNodeType, nullptr, "await.node");
+
+    auto *save = builder.CreateCall(
+        llvm::Intrinsic::getDeclaration(&module, llvm::Intrinsic::coro_save),
+        {handle});
+    awaited = builder.CreatePointerCast(awaited, pointer);
+    builder.CreateCall(runtime::getPromiseAwaitFunction(module),
+                       {awaited, builder.CreatePointerCast(node, pointer),
+                        handle});
+    auto *result = builder.CreateCall(
+        llvm::Intrinsic::getDeclaration(&module,
+                                        llvm::Intrinsic::coro_suspend),
+        {save, builder.getFalse()});
+
+    auto *resume = llvm::BasicBlock::Create(context, "await.resume", &function);
+    auto *dispatch = builder.CreateSwitch(result, suspend, 2);
+    dispatch->addCase(builder.getInt8(resumed), resume);
+    dispatch->addCase(builder.getInt8(destroyed), cleanup);
+
+    builder.SetInsertPoint(resume);
+    return builder.CreateCall(runtime::getPromiseResultFunction(module),
+                              {awaited}, "awaited");
+}
+
+// This is the implementation of AsyncFunction::emitReturn. A function that
+// returns runs to the end of the coroutine, so its frame is freed without
+// a final suspension.
+auto AsyncFunction::emitReturn(llvm::IRBuilderBase &builder,
+                               llvm::Value *value) -> void {
+    builder.CreateCall(
+        runtime::getPromiseResolveFunction(module),
+        {builder.CreatePointerCast(promise, builder.getInt8PtrTy()), value});
+    builder.CreateBr(cleanup);
+    builder.ClearInsertionPoint();
+}
+} // namespace ntsc
@@ -0,0 +1,61 @@
+#ifndef NTSC_ASYNCFUNCTION_H
+#define NTSC_ASYNCFUNCTION_H
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Value.h"
+
+/*
+    This file defines the AsyncFunction interface, which emits an async
+    function as an LLVM coroutine with the switched resumption of
+    llvm.coro.*, in the layout of Promise.h. The function returns its promise
+    from its first await, and every await suspends it until the event loop
+    resumes it, so an await costs a suspension rather than a closure.
+
+    The frame is allocated from the pool of the runtime rather than the heap,
+    and the coroutine passes of the default pipelines split the function
+    into its ramp and its resumption once it has been optimized.
+*/
+
+namespace ntsc {
+class AsyncFunction {
+    llvm::Function &function;
+    llvm::Module &module;
+    llvm::Value *id;
+    llvm::Value *handle;
+    llvm::Value *promise;
+
+    // These are the blocks that free the frame once the function returns,
+    // and that return from the function when it suspends.
+    llvm::BasicBlock *cleanup;
+    llvm::BasicBlock *suspend;
+
+    // This is the type of an AwaitNode.
+    llvm::StructType *awaitNodeType;
+
+  public:
+    // This constructor will emit the start of an async function, which must
+    // return a pointer and have an empty body. The builder is left in the
+    // block where the body of the function begins.
+    AsyncFunction(llvm::Function &function, llvm::IRBuilderBase &builder);
+
+    // This method will return the promise of the function.
+    [[nodiscard]] inline auto getPromise() const -> llvm::Value * {
+        return promise;
+    }
+
+    // This method will emit an await of a promise, and return its boxed
+    // value. It emits branches, so the builder must be at the end of a block,
+    // where the function continues when it returns.
+    auto emitAwait(llvm::IRBuilderBase &builder, llvm::Value *awaited)
+        -> llvm::Value *;
+
+    // This method will emit a return of a boxed value, which fulfills the
+    // promise and frees the frame. The builder is left without a block.
+    auto emitReturn(llvm::IRBuilderBase &builder, llvm::Value *value) -> void;
+};
+} // namespace ntsc
+
+#endif
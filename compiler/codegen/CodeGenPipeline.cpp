@@ -0,0 +1,101 @@
+#include "CodeGenPipeline.h"
+#include "OptimizationPipeline.h"
+#include "llvm/ADT/Statistic.h"
+#include <algorithm>
+
+/*
+    This file implements the CodeGenPipeline interface. A TargetMachine may
+    not be used by two threads at once, so every module is compiled with a
+    TargetMachine of its own. Creating one costs far less than optimizing a
+    module.
+*/
+
+#define DEBUG_TYPE "codegen"
+
+ALWAYS_ENABLED_STATISTIC(modulesCompiled, "Number of modules compiled");
+ALWAYS_ENABLED_STATISTIC(peakModulesInFlight,
+                         "Largest number of modules in memory at once");
+
+namespace ntsc {
+// This is the implementation of the CodeGenPipeline constructor.
+CodeGenPipeline::CodeGenPipeline(ThreadPool &pool, OptimizationLevel level,
+                                 size_t maxModulesInFlight,
+                                 ThinLTOLinker *linker)
+    : pool{pool}, level{level}, linker{linker},
+      maxModulesInFlight{maxModulesInFlight != 0
+                             ? maxModulesInFlight
+                             : 2 * size_t{pool.getThreadCount()}} {}
+
+// This is the implementation of the CodeGenPipeline destructor. The jobs refer
+// to the pipeline, so it may not be destroyed before they finish.
+CodeGenPipeline::~CodeGenPipeline() {
+    std::unique_lock<std::mutex> lock{mutex};
+    moduleDone.wait(lock, [this] { return modulesInFlight == 0; });
+    llvm::consumeError(std::move(error));
+}
+
+// This is the implementation of CodeGenPipeline::compile. The module is owned
+// by this method, so its IR is freed before the job gives up its place in the
+// pipeline.
+auto CodeGenPipeline::compile(size_t index, GeneratedModule module,
+                              const std::string &objectPath) -> llvm::Error {
+    auto machine = createHostTargetMachine(level);
+    if (!machine)
+        return machine.takeError();
+
+    if (linker) {
+        linker->addModule(index,
+                          optimizeForThinLTO(*module.module, **machine, level));
+        return llvm::Error::success();
+    }
+    optimizeModule(*module.module, **machine, level);
+    return emitObjectFile(*module.module, **machine, objectPath);
+}
+
+// This is the implementation of CodeGenPipeline::submit.
+auto CodeGenPipeline::submit(size_t index, GeneratedModule module,
+                             llvm::StringRef objectPath) -> void {
+    {
+        std::unique_lock<std::mutex> lock{mutex};
+        moduleDone.wait(lock, [this] {
+            return modulesInFlight < maxModulesInFlight;
+        });
+        ++modulesInFlight;
+        if (llvm::AreStatisticsEnabled())
+            peakModulesInFlight.updateMax(modulesInFlight);
+    }
+
+    // The jobs of the pool must be copyable, so the module is moved into a
+    // shared owner that the job then takes it from.
+    auto owner = std::make_shared<GeneratedModule>(std::move(module));
+    pool.async([this, index, owner, path = objectPath.str()] {
+        auto result = compile(index, std::move(*owner), path);
+
+        std::lock_guard<std::mutex> lock{mutex};
+        if (result)
+            error = llvm::joinErrors(std::move(error), std::move(result));
+        else if (!linker)
+            objectPaths.emplace_back(index, path);
+        if (llvm::AreStatisticsEnabled())
+            ++modulesCompiled;
+        --modulesInFlight;
+        moduleDone.notify_all();
+    });
+}
+
+// This is the implementation of CodeGenPipeline::finish.
+auto CodeGenPipeline::finish() -> llvm::Expected<std::vector<std::string>> {
+    std::unique_lock<std::mutex> lock{mutex};
+    moduleDone.wait(lock, [this] { return modulesInFlight == 0; });
+    if (error)
+        return std::exchange(error, llvm::Error::success());
+
+    std::sort(objectPaths.begin(), objectPaths.end());
+    std::vector<std::string> paths;
+    paths.reserve(objectPaths.size());
+    for (auto &[index, path] : objectPaths)
+        paths.push_back(std::move(path));
+    objectPaths.clear();
+    return paths;
+}
+} // namespace ntsc
@@ -0,0 +1,87 @@
+#ifndef NTSC_CODEGENPIPELINE_H
+#define NTSC_CODEGENPIPELINE_H
+#include "ThinLTOLinker.h"
+#include "ThreadPool.h"
+#include "UserOpts.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Error.h"
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+    This file defines the CodeGenPipeline interface, which optimizes the LLVM
+    modules of a program and compiles them into object files on a ThreadPool,
+    while the front end is still producing the modules that follow. Each
+    module has its own LLVMContext, so modules never share state and any
+    number of them may be compiled at once.
+
+    The IR of a module is the largest thing the compiler holds, so only a
+    bounded number of modules may be waiting or being compiled at a time. The
+    front end is made to wait once the bound is reached, so the memory of a
+    compilation depends on the number of threads rather than on the size of
+    the program.
+*/
+
+namespace ntsc {
+// This struct is a module that the front end has generated, along with the
+// context that owns its types and constants.
+struct GeneratedModule {
+    std::unique_ptr<llvm::LLVMContext> context;
+    std::unique_ptr<llvm::Module> module;
+};
+
+class CodeGenPipeline {
+    ThreadPool &pool;
+    OptimizationLevel level;
+    ThinLTOLinker *linker;
+    size_t maxModulesInFlight;
+
+    // These track the modules that have been submitted but not yet compiled,
+    // the object files that have been written, and the errors of the modules
+    // that failed. They are guarded by the mutex.
+    std::mutex mutex;
+    std::condition_variable moduleDone;
+    size_t modulesInFlight = 0;
+    std::vector<std::pair<size_t, std::string>> objectPaths;
+    llvm::Error error = llvm::Error::success();
+
+    // This method will optimize and compile a single module on a worker.
+    auto compile(size_t index, GeneratedModule module,
+                 const std::string &objectPath) -> llvm::Error;
+
+  public:
+    // This constructor will prepare a pipeline that compiles modules on the
+    // given pool, with at most the given number of modules in memory at once,
+    // where zero allows two per thread. If a linker is given, the modules are
+    // prepared for ThinLTO and added to it instead of being compiled into
+    // object files, which the link then writes.
+    CodeGenPipeline(ThreadPool &pool, OptimizationLevel level,
+                    size_t maxModulesInFlight, ThinLTOLinker *linker = nullptr);
+    CodeGenPipeline(const CodeGenPipeline &) = delete;
+    auto operator=(const CodeGenPipeline &) -> CodeGenPipeline & = delete;
+
+    // This destructor will wait for the modules that are still in flight.
+    ~CodeGenPipeline();
+
+    // This method will submit a module to be compiled into an object file at
+    // the given path, which is unused with ThinLTO. It blocks while the bound
+    // of modules in flight is reached, so it must not be called from a job of
+    // the same pool, which could otherwise wait for itself.
+    auto submit(size_t index, GeneratedModule module,
+                llvm::StringRef objectPath) -> void;
+
+    // This method will wait for every submitted module, and return the paths
+    // of the object files in the order of the indices of their modules. With
+    // ThinLTO there are none until the linker is run.
+    auto finish() -> llvm::Expected<std::vector<std::string>>;
+};
+} // namespace ntsc
+
+#endif
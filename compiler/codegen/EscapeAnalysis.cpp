@@ -0,0 +1,185 @@
+#include "EscapeAnalysis.h"
+#include "RuntimeFunctions.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Support/Casting.h"
+
+/*
+    This file contains the implementation of the EscapeAnalysis. The uses of
+    every allocation are followed through the pointers derived from it. Loads
+    from an object are not followed, so an object that is stored into another
+    object escapes with it, which is only allowed when the other object ends
+    up in an arena, since the contract of the arena then covers everything
+    that can be loaded from it.
+*/
+
+namespace ntsc {
+// This is the implementation of EscapeAnalysis::analyze.
+auto EscapeAnalysis::analyze(const llvm::CallInst *call,
+                             const llvm::DominatorTree &tree) -> Allocation {
+    Allocation allocation;
+
+    // This function will record a store of the pointer into the memory at the
+    // destination, and return whether the object may still avoid the heap.
+    auto storeInto = [&](const llvm::Value *destination) {
+        auto *base = llvm::getUnderlyingObject(destination);
+        if (runtime::isCallTo(base, runtime::arenaAllocate)) {
+            auto *arena = llvm::cast<llvm::CallInst>(base)->getArgOperand(0);
+            if (allocation.arena && allocation.arena != arena)
+                return false;
+            allocation.arena = arena;
+            return true;
+        }
+        if (base != call && runtime::isCallTo(base, runtime::allocate)) {
+            allocation.containers.push_back(llvm::cast<llvm::CallInst>(base));
+            return true;
+        }
+        return false;
+    };
+
+    // This function will return whether a call can use the pointer without
+    // keeping it once the call returns.
+    auto isCapturedBy = [](const llvm::CallBase &user, const llvm::Use &use) {
+        if (auto *intrinsic = llvm::dyn_cast<llvm::IntrinsicInst>(&user)) {
+            switch (intrinsic->getIntrinsicID()) {
+            case llvm::Intrinsic::lifetime_start:
+            case llvm::Intrinsic::lifetime_end:
+            case llvm::Intrinsic::memset:
+            case llvm::Intrinsic::memcpy:
+            case llvm::Intrinsic::memmove:
+                return false;
+            default:
+                return true;
+            }
+        }
+        return !user.isArgOperand(&use) ||
+               !user.doesNotCapture(user.getArgOperandNo(&use));
+    };
+
+    llvm::SmallVector<const llvm::Value *, 8> pointers{call};
+    llvm::SmallPtrSet<const llvm::Value *, 8> visited{call};
+    while (!pointers.empty()) {
+        auto *pointer = pointers.pop_back_val();
+        for (auto &use : pointer->uses()) {
+            auto *user = llvm::cast<llvm::Instruction>(use.getUser());
+            auto escapes = false;
+            switch (user->getOpcode()) {
+            case llvm::Instruction::Load:
+            case llvm::Instruction::ICmp:
+                break;
+            case llvm::Instruction::Store: {
+                auto *store = llvm::cast<llvm::StoreInst>(user);
+                escapes = store->getValueOperand() == pointer &&
+                          !storeInto(store->getPointerOperand());
+                break;
+            }
+            case llvm::Instruction::Call:
+            case llvm::Instruction::Invoke:
+                escapes = isCapturedBy(*llvm::cast<llvm::CallBase>(user), use);
+                break;
+            case llvm::Instruction::PHI:
+            case llvm::Instruction::Select:
+                allocation.merged = true;
+                [[fallthrough]];
+            case llvm::Instruction::GetElementPtr:
+            case llvm::Instruction::BitCast:
+            case llvm::Instruction::AddrSpaceCast:
+                if (visited.insert(user).second)
+                    pointers.push_back(user);
+                break;
+            default:
+                escapes = true;
+                break;
+            }
+            if (escapes) {
+                allocation.escape = Escape::Heap;
+                return allocation;
+            }
+        }
+    }
+
+    // The arena must be available where the object is allocated.
+    if (auto *arena = llvm::dyn_cast_or_null<llvm::Instruction>(
+            allocation.arena);
+        arena && !tree.dominates(arena, call))
+        allocation.escape = Escape::Heap;
+    else if (allocation.arena || !allocation.containers.empty())
+        allocation.escape = Escape::Arena;
+    return allocation;
+}
+
+// This is the implementation of EscapeAnalysis::resolveContainers. Every
+// allocation that is stored into others starts out escaping into an arena,
+// and learns the arena from its containers. It escapes to the heap once one of
+// them does not end up in the same arena, and the allocations that only reach
+// each other through a cycle never learn an arena at all.
+auto EscapeAnalysis::resolveContainers(const llvm::DominatorTree &tree)
+    -> void {
+    for (auto changed = true; changed;) {
+        changed = false;
+        for (auto &[call, allocation] : allocations) {
+            if (allocation.escape != Escape::Arena)
+                continue;
+            for (auto *container : allocation.containers) {
+                auto &outer = allocations.find(container)->second;
+                auto *arena = llvm::dyn_cast_or_null<llvm::Instruction>(
+                    outer.arena);
+                if (outer.escape != Escape::Arena ||
+                    (outer.arena && allocation.arena &&
+                     outer.arena != allocation.arena) ||
+                    (arena && !tree.dominates(arena, call))) {
+                    allocation.escape = Escape::Heap;
+                    changed = true;
+                    break;
+                }
+                if (!allocation.arena && outer.arena) {
+                    allocation.arena = outer.arena;
+                    changed = true;
+                }
+            }
+        }
+
+        if (changed)
+            continue;
+        for (auto &[call, allocation] : allocations) {
+            if (allocation.escape == Escape::Arena && !allocation.arena) {
+                allocation.escape = Escape::Heap;
+                changed = true;
+            }
+        }
+    }
+}
+
+// This is the implementation of the EscapeAnalysis constructor.
+EscapeAnalysis::EscapeAnalysis(const llvm::Function &function,
+                               const llvm::DominatorTree &tree) {
+    for (auto &instruction : llvm::instructions(function)) {
+        if (runtime::isCallTo(&instruction, runtime::allocate)) {
+            auto *call = llvm::cast<llvm::CallInst>(&instruction);
+            allocations.try_emplace(call, analyze(call, tree));
+        }
+    }
+    resolveContainers(tree);
+}
+
+// This is the implementation of EscapeAnalysis::getEscape.
+auto EscapeAnalysis::getEscape(const llvm::CallInst *call) const -> Escape {
+    auto found = allocations.find(call);
+    return found != allocations.end() ? found->second.escape : Escape::Heap;
+}
+
+// This is the implementation of EscapeAnalysis::getArena.
+auto EscapeAnalysis::getArena(const llvm::CallInst *call) const
+    -> llvm::Value * {
+    auto found = allocations.find(call);
+    return found != allocations.end() ? found->second.arena : nullptr;
+}
+
+// This is the implementation of EscapeAnalysis::isMerged.
+auto EscapeAnalysis::isMerged(const llvm::CallInst *call) const -> bool {
+    auto found = allocations.find(call);
+    return found != allocations.end() && found->second.merged;
+}
+} // namespace ntsc
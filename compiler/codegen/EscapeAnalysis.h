@@ -0,0 +1,82 @@
+#ifndef NTSC_ESCAPEANALYSIS_H
+#define NTSC_ESCAPEANALYSIS_H
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Value.h"
+#include <cstdint>
+
+/*
+    This file defines the EscapeAnalysis interface, which finds the objects
+    allocated on the heap by a function that cannot outlive it. TypeScript
+    allocates object literals, arrays and closure environments all the time,
+    and most of them are only used by the function that creates them. Such an
+    object can live on the stack, where SROA breaks it into registers, and
+    the collector never sees it. An object that escapes only by being stored
+    into the arena of a request can be allocated in the same arena, since it
+    is dropped along with the data that refers to it.
+*/
+
+namespace ntsc {
+// This enum holds how far an allocation may outlive its function.
+enum class Escape : uint8_t {
+    // The object is never visible outside of the function.
+    None,
+    // The object is only visible through objects in the arena of a request.
+    Arena,
+    // The object may be visible anywhere.
+    Heap,
+};
+
+class EscapeAnalysis {
+    // This struct is what is known of an allocation.
+    struct Allocation {
+        Escape escape = Escape::None;
+        // This is the arena the object escapes into, when it escapes into
+        // one.
+        llvm::Value *arena = nullptr;
+        // This is set when the pointer is merged with others by a phi or a
+        // select, so that two objects from the same allocation may be live
+        // at once if it runs in a cycle.
+        bool merged = false;
+        // These are the allocations whose objects it is stored into. It only
+        // escapes into an arena if all of them do.
+        llvm::SmallVector<const llvm::CallInst *, 2> containers;
+    };
+
+    llvm::DenseMap<const llvm::CallInst *, Allocation> allocations;
+
+    // This method will find the escape of an allocation from its uses, with
+    // the allocations it is stored into recorded for later.
+    auto analyze(const llvm::CallInst *call, const llvm::DominatorTree &tree)
+        -> Allocation;
+
+    // This method will find the escape of the allocations that are stored
+    // into other allocations from the escapes of those.
+    auto resolveContainers(const llvm::DominatorTree &tree) -> void;
+
+  public:
+    // This constructor will analyze every call to the heap allocation
+    // function of the runtime in a function. The results do not follow
+    // changes to the function made afterwards.
+    EscapeAnalysis(const llvm::Function &function,
+                   const llvm::DominatorTree &tree);
+
+    // This method will return the escape of a call to the heap allocation
+    // function. Any other value escapes to the heap.
+    [[nodiscard]] auto getEscape(const llvm::CallInst *call) const -> Escape;
+
+    // This method will return the arena that an allocation escapes into.
+    [[nodiscard]] auto getArena(const llvm::CallInst *call) const
+        -> llvm::Value *;
+
+    // This method will return whether the pointer of an allocation is merged
+    // with other pointers by a phi or a select.
+    [[nodiscard]] auto isMerged(const llvm::CallInst *call) const -> bool;
+
+};
+} // namespace ntsc
+
+#endif
@@ -0,0 +1,117 @@
+#include "InlineCacheSpecializationPass.h"
+#include "ObjectModel.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/IR/ValueHandle.h"
+#include "llvm/Transforms/Utils/Local.h"
+#include <algorithm>
+
+/*
+    This file contains the implementation of the InlineCacheSpecializationPass.
+    Inlining copies the probes of an access into every caller, and the copies
+    still share the cache, so a cache keeps the entries that any copy hit. A
+    cache is only specialized when every one of its probes has a profile,
+    since a probe without one ran in code that the profile never saw.
+*/
+
+#define DEBUG_TYPE "codegen"
+
+ALWAYS_ENABLED_STATISTIC(cachesSpecialized,
+                         "Number of inline caches specialized by a profile");
+ALWAYS_ENABLED_STATISTIC(probesRemoved,
+                         "Number of inline cache probes removed by a profile");
+
+namespace ntsc {
+namespace {
+// This struct holds the probes of a single cache, and the number of entries
+// that their profile shows were hit.
+struct CacheProfile {
+    llvm::SmallVector<std::pair<llvm::BranchInst *, unsigned>, inlineCacheSize>
+        probes;
+    unsigned entryCount = 1;
+    bool profiled = true;
+};
+
+// This function will make a probe always miss, and remove the loads of its
+// entry along with it.
+auto removeProbe(llvm::BranchInst *probe) -> void {
+    auto *block = probe->getParent();
+    llvm::SmallVector<llvm::WeakTrackingVH, 4> dead{probe->getCondition()};
+    for (auto &phi : probe->getSuccessor(0)->phis())
+        dead.emplace_back(phi.getIncomingValueForBlock(block));
+
+    probe->setCondition(llvm::ConstantInt::getFalse(probe->getContext()));
+    probe->setMetadata(inlineCacheProbeMetadata, nullptr);
+    llvm::ConstantFoldTerminator(block);
+    llvm::RecursivelyDeleteTriviallyDeadInstructionsPermissive(dead);
+}
+} // namespace
+
+// This is the implementation of InlineCacheSpecializationPass::run. The hit
+// edge of a probe is its first successor.
+auto InlineCacheSpecializationPass::run(llvm::Module &module,
+                                        llvm::ModuleAnalysisManager &)
+    -> llvm::PreservedAnalyses {
+    auto kind = module.getContext().getMDKindID(inlineCacheProbeMetadata);
+    llvm::MapVector<llvm::GlobalVariable *, CacheProfile> caches;
+    for (auto &function : module) {
+        for (auto &block : function) {
+            auto *probe =
+                llvm::dyn_cast<llvm::BranchInst>(block.getTerminator());
+            if (!probe || !probe->isConditional())
+                continue;
+            auto *node = probe->getMetadata(kind);
+            if (!node)
+                continue;
+            auto *cache = llvm::mdconst::dyn_extract_or_null<
+                llvm::GlobalVariable>(node->getOperand(0));
+            auto *index = llvm::mdconst::dyn_extract_or_null<
+                llvm::ConstantInt>(node->getOperand(1));
+            if (!cache || !index)
+                continue;
+
+            auto &profile = caches[cache];
+            auto entry = static_cast<unsigned>(index->getZExtValue());
+            profile.probes.emplace_back(probe, entry);
+            uint64_t hits, misses;
+            if (!probe->extractProfMetadata(hits, misses))
+                profile.profiled = false;
+            else if (hits != 0)
+                profile.entryCount = std::max(profile.entryCount, entry + 1);
+        }
+    }
+
+    // The runtime fills the entries of a cache in turn, so the entries that
+    // are not probed must be left empty, which the cache is told of by its
+    // count of entries.
+    auto changed = false;
+    for (auto &[cache, profile] : caches) {
+        if (!profile.profiled || profile.entryCount >= inlineCacheSize ||
+            !cache->hasLocalLinkage() || !cache->hasInitializer() ||
+            !cache->getInitializer()->isNullValue())
+            continue;
+
+        auto *type = llvm::cast<llvm::StructType>(cache->getValueType());
+        cache->setInitializer(llvm::ConstantStruct::get(
+            type, {llvm::Constant::getNullValue(type->getElementType(0)),
+                   llvm::Constant::getNullValue(type->getElementType(1)),
+                   llvm::ConstantInt::get(type->getElementType(2),
+                                          profile.entryCount)}));
+        for (auto [probe, entry] : profile.probes) {
+            if (entry < profile.entryCount)
+                continue;
+            removeProbe(probe);
+            ++probesRemoved;
+        }
+        ++cachesSpecialized;
+        changed = true;
+    }
+    return changed ? llvm::PreservedAnalyses::none()
+                   : llvm::PreservedAnalyses::all();
+}
+} // namespace ntsc
@@ -0,0 +1,31 @@
+#ifndef NTSC_INLINECACHESPECIALIZATIONPASS_H
+#define NTSC_INLINECACHESPECIALIZATIONPASS_H
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PassManager.h"
+
+/*
+    This file defines the InlineCacheSpecializationPass, which shrinks the
+    inline caches of a program built with -fprofile-use to the shapes that
+    its profile saw. The probes of a cache are ordinary branches, so the
+    instrumented program counts how often each entry hit, and the profile
+    gives each probe its counts. Entries are filled in the order the shapes
+    are first seen, so an access that only ever hit its first k entries is
+    specialized to probe those alone, and the runtime is told through the
+    cache to fill no others. An access that sees more shapes in production
+    than in the profile still works, as a cache of fewer entries.
+*/
+
+namespace ntsc {
+// This is the kind of the metadata that ObjectLayout attaches to the branch
+// of every probe, which holds its cache and the index of its entry.
+constexpr const char *inlineCacheProbeMetadata = "ntsc.ic.probe";
+
+class InlineCacheSpecializationPass
+    : public llvm::PassInfoMixin<InlineCacheSpecializationPass> {
+  public:
+    auto run(llvm::Module &module, llvm::ModuleAnalysisManager &manager)
+        -> llvm::PreservedAnalyses;
+};
+} // namespace ntsc
+
+#endif
@@ -0,0 +1,203 @@
+#include "Int32NarrowingPass.h"
+#include "NumberRangeAnalysis.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/Casting.h"
+#include "llvm/Transforms/Utils/Local.h"
+#include <string>
+
+/*
+    This file contains the implementation of the Int32NarrowingPass. Every
+    change is decided from the ranges of the original function before any
+    is made. A narrowed value is converted back to a double for its users,
+    and a narrowed user converts its operands to i32s, so that the function
+    stays correct after every step. The pairs of conversions between
+    narrowed values are folded away at the end.
+*/
+
+namespace ntsc {
+namespace {
+// This function will return the integer predicate of a comparison of two
+// i32s. The operands can never be NaN, so an ordered and unordered
+// comparison are the same.
+auto getIntegerPredicate(llvm::CmpInst::Predicate predicate)
+    -> llvm::Optional<llvm::CmpInst::Predicate> {
+    switch (predicate) {
+    case llvm::CmpInst::FCMP_OEQ:
+    case llvm::CmpInst::FCMP_UEQ:
+        return llvm::CmpInst::ICMP_EQ;
+    case llvm::CmpInst::FCMP_ONE:
+    case llvm::CmpInst::FCMP_UNE:
+        return llvm::CmpInst::ICMP_NE;
+    case llvm::CmpInst::FCMP_OGT:
+    case llvm::CmpInst::FCMP_UGT:
+        return llvm::CmpInst::ICMP_SGT;
+    case llvm::CmpInst::FCMP_OGE:
+    case llvm::CmpInst::FCMP_UGE:
+        return llvm::CmpInst::ICMP_SGE;
+    case llvm::CmpInst::FCMP_OLT:
+    case llvm::CmpInst::FCMP_ULT:
+        return llvm::CmpInst::ICMP_SLT;
+    case llvm::CmpInst::FCMP_OLE:
+    case llvm::CmpInst::FCMP_ULE:
+        return llvm::CmpInst::ICMP_SLE;
+    default:
+        return llvm::None;
+    }
+}
+
+// This function will return a double that is known to be an i32 as an i32,
+// converting it before the given instruction if it is not one already.
+auto convertToInt32(llvm::Value *value, llvm::Instruction *before)
+    -> llvm::Value * {
+    auto *int32 = llvm::Type::getInt32Ty(value->getContext());
+    if (auto *conversion = llvm::dyn_cast<llvm::SIToFPInst>(value)) {
+        if (conversion->getSrcTy() == int32)
+            return conversion->getOperand(0);
+    }
+    if (auto *constant = llvm::dyn_cast<llvm::ConstantFP>(value)) {
+        auto integer = constant->getValueAPF().convertToDouble();
+        return llvm::ConstantInt::getSigned(int32,
+                                            static_cast<int64_t>(integer));
+    }
+    return new llvm::FPToSIInst(value, int32, "", before);
+}
+
+// This function will fold every conversion of a narrowed value to a double
+// and back into the i32 itself, and remove the conversions left unused.
+auto foldConversions(llvm::Function &function) -> void {
+    auto *int32 = llvm::Type::getInt32Ty(function.getContext());
+    llvm::SmallVector<llvm::Instruction *, 16> folded;
+    for (auto &instruction : llvm::instructions(function)) {
+        auto *conversion = llvm::dyn_cast<llvm::FPToSIInst>(&instruction);
+        if (!conversion || conversion->getDestTy() != int32)
+            continue;
+        auto *source =
+            llvm::dyn_cast<llvm::SIToFPInst>(conversion->getOperand(0));
+        if (source && source->getSrcTy() == int32) {
+            conversion->replaceAllUsesWith(source->getOperand(0));
+            folded.push_back(conversion);
+        }
+    }
+    for (auto *conversion : folded)
+        llvm::RecursivelyDeleteTriviallyDeadInstructions(conversion);
+}
+} // namespace
+
+// This is the implementation of Int32NarrowingPass::run.
+auto Int32NarrowingPass::run(llvm::Function &function,
+                             llvm::FunctionAnalysisManager &manager)
+    -> llvm::PreservedAnalyses {
+    auto &tree = manager.getResult<llvm::DominatorTreeAnalysis>(function);
+    NumberRangeAnalysis analysis{function, tree};
+
+    llvm::SmallVector<llvm::PHINode *, 8> phis;
+    llvm::SmallVector<llvm::Instruction *, 16> operations;
+    for (auto &instruction : llvm::instructions(function)) {
+        auto *block = instruction.getParent();
+        auto operandsAreInt32 = [&] {
+            return analysis.getRangeAt(instruction.getOperand(0), block)
+                       .isInt32() &&
+                   analysis.getRangeAt(instruction.getOperand(1), block)
+                       .isInt32();
+        };
+
+        if (auto *phi = llvm::dyn_cast<llvm::PHINode>(&instruction)) {
+            if (phi->getType()->isDoubleTy() &&
+                analysis.getRange(phi).isInt32())
+                phis.push_back(phi);
+            continue;
+        }
+
+        switch (instruction.getOpcode()) {
+        case llvm::Instruction::FAdd:
+        case llvm::Instruction::FSub:
+        case llvm::Instruction::FMul:
+            if (analysis.getRange(&instruction).isInt32() && operandsAreInt32())
+                operations.push_back(&instruction);
+            break;
+        case llvm::Instruction::FCmp:
+            if (getIntegerPredicate(
+                    llvm::cast<llvm::FCmpInst>(instruction).getPredicate()) &&
+                operandsAreInt32())
+                operations.push_back(&instruction);
+            break;
+        default:
+            break;
+        }
+    }
+    if (phis.empty() && operations.empty())
+        return llvm::PreservedAnalyses::all();
+
+    // Every narrowed phi is created before any is filled in, so that phis
+    // that refer to each other see the narrowed versions.
+    auto *int32 = llvm::Type::getInt32Ty(function.getContext());
+    llvm::SmallVector<llvm::PHINode *, 8> narrowedPhis;
+    for (auto *phi : phis) {
+        auto *narrowed = llvm::PHINode::Create(
+            int32, phi->getNumIncomingValues(), "", phi);
+        narrowed->takeName(phi);
+        auto *conversion = new llvm::SIToFPInst(
+            narrowed, phi->getType(), "",
+            &*phi->getParent()->getFirstInsertionPt());
+        phi->replaceAllUsesWith(conversion);
+        narrowedPhis.push_back(narrowed);
+    }
+    for (size_t i = 0; i < phis.size(); ++i) {
+        auto *phi = phis[i];
+        for (unsigned j = 0; j < phi->getNumIncomingValues(); ++j) {
+            auto *block = phi->getIncomingBlock(j);
+            narrowedPhis[i]->addIncoming(
+                convertToInt32(phi->getIncomingValue(j),
+                               block->getTerminator()),
+                block);
+        }
+        phi->eraseFromParent();
+    }
+
+    for (auto *instruction : operations) {
+        llvm::IRBuilder<> builder{instruction};
+        auto *left = convertToInt32(instruction->getOperand(0), instruction);
+        auto *right = convertToInt32(instruction->getOperand(1), instruction);
+        auto name = instruction->getName().str();
+        instruction->setName("");
+
+        llvm::Value *replacement;
+        switch (instruction->getOpcode()) {
+        case llvm::Instruction::FAdd:
+            replacement = builder.CreateSIToFP(
+                builder.CreateNSWAdd(left, right, name),
+                instruction->getType());
+            break;
+        case llvm::Instruction::FSub:
+            replacement = builder.CreateSIToFP(
+                builder.CreateNSWSub(left, right, name),
+                instruction->getType());
+            break;
+        case llvm::Instruction::FMul:
+            replacement = builder.CreateSIToFP(
+                builder.CreateNSWMul(left, right, name),
+                instruction->getType());
+            break;
+        default:
+            replacement = builder.CreateICmp(
+                *getIntegerPredicate(
+                    llvm::cast<llvm::FCmpInst>(instruction)->getPredicate()),
+                left, right, name);
+            break;
+        }
+        instruction->replaceAllUsesWith(replacement);
+        instruction->eraseFromParent();
+    }
+
+    foldConversions(function);
+
+    llvm::PreservedAnalyses preserved;
+    preserved.preserveSet<llvm::CFGAnalyses>();
+    return preserved;
+}
+} // namespace ntsc
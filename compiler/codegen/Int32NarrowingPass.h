@@ -0,0 +1,24 @@
+#ifndef NTSC_INT32NARROWINGPASS_H
+#define NTSC_INT32NARROWINGPASS_H
+#include "llvm/IR/Function.h"
+#include "llvm/IR/PassManager.h"
+
+/*
+    This file defines the Int32NarrowingPass, which computes numbers with
+    integer arithmetic wherever the NumberRangeAnalysis proves them to be
+    i32s. The code generator lowers every number to a double, and this pass
+    turns the phis, additions, subtractions, multiplications and comparisons
+    of such numbers into their integer forms, converting back to a double
+    only where a value leaves the integers. The proof rules out overflow, so
+    the results are the same as those of the floating point code.
+*/
+
+namespace ntsc {
+class Int32NarrowingPass : public llvm::PassInfoMixin<Int32NarrowingPass> {
+  public:
+    auto run(llvm::Function &function, llvm::FunctionAnalysisManager &manager)
+        -> llvm::PreservedAnalyses;
+};
+} // namespace ntsc
+
+#endif
@@ -0,0 +1,348 @@
+#include "NumberRangeAnalysis.h"
+#include "llvm/ADT/DepthFirstIterator.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/InstrTypes.h"
+#include "llvm/Support/Casting.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+/*
+    This file contains the implementation of the NumberRangeAnalysis. It is an
+    abstract interpretation over intervals. The ranges start out empty and
+    grow until they hold every value, and a phi that keeps growing has its
+    bound moved to infinity, since only a cycle through a phi can keep a
+    range growing. A few passes without the widening then recover the bounds
+    that the conditions of a loop impose, such as the bound of 'i < n' on a
+    loop counter.
+*/
+
+namespace ntsc {
+namespace {
+// Every integer up to this magnitude is exactly a double, so integer
+// arithmetic on such values gives the same result as floating point.
+constexpr double maxExactInteger = 9007199254740992.0;
+
+constexpr double infinity = std::numeric_limits<double>::infinity();
+
+// A phi is widened after its range has changed this many times.
+constexpr unsigned widenAfter = 2;
+
+// This is the number of passes that narrow the ranges after widening.
+constexpr unsigned narrowingPasses = 2;
+
+// This function will return whether every number in a range is exactly a
+// double.
+auto isExact(const NumberRange &range) -> bool {
+    return range.min >= -maxExactInteger && range.max <= maxExactInteger;
+}
+
+// This function will return the range of the result of an integral
+// operation, which is only integral while it stays exact.
+auto getIntegralResult(double min, double max) -> NumberRange {
+    NumberRange range{min, max, true};
+    return isExact(range) ? range : NumberRange::getFull();
+}
+
+// This function will return the range of the result of an arithmetic
+// operation on two ranges.
+auto computeArithmetic(unsigned opcode, const NumberRange &left,
+                       const NumberRange &right) -> NumberRange {
+    if (left.isEmpty() || right.isEmpty())
+        return NumberRange::getEmpty();
+    if (!left.integral || !right.integral)
+        return NumberRange::getFull();
+
+    switch (opcode) {
+    case llvm::Instruction::FAdd:
+        return getIntegralResult(left.min + right.min, left.max + right.max);
+    case llvm::Instruction::FSub:
+        return getIntegralResult(left.min - right.max, left.max - right.min);
+    case llvm::Instruction::FMul: {
+        // The product of 0 and a negative number is -0.
+        auto hasZero = [](const NumberRange &range) {
+            return range.min <= 0 && range.max >= 0;
+        };
+        if ((hasZero(left) && right.min < 0) ||
+            (hasZero(right) && left.min < 0))
+            return NumberRange::getFull();
+        if (!isExact(left) || !isExact(right))
+            return NumberRange::getFull();
+        double products[] = {left.min * right.min, left.min * right.max,
+                             left.max * right.min, left.max * right.max};
+        return getIntegralResult(
+            *std::min_element(std::begin(products), std::end(products)),
+            *std::max_element(std::begin(products), std::end(products)));
+    }
+    default:
+        return NumberRange::getFull();
+    }
+}
+
+// This function will return the range of an integer converted to a double.
+auto computeConversion(const llvm::CastInst &cast) -> NumberRange {
+    auto *source = cast.getOperand(0);
+    auto isSigned = cast.getOpcode() == llvm::Instruction::SIToFP;
+    if (auto *constant = llvm::dyn_cast<llvm::ConstantInt>(source)) {
+        return NumberRange::getConstant(
+            isSigned ? static_cast<double>(constant->getSExtValue())
+                     : static_cast<double>(constant->getZExtValue()));
+    }
+
+    auto bits = source->getType()->getScalarSizeInBits();
+    if (bits > 53)
+        return NumberRange::getFull();
+    if (isSigned && bits > 1) {
+        auto bound = std::ldexp(1.0, static_cast<int>(bits) - 1);
+        return {-bound, bound - 1, true};
+    }
+    if (isSigned)
+        return {-1, 0, true};
+    return {0, std::ldexp(1.0, static_cast<int>(bits)) - 1, true};
+}
+} // namespace
+
+// This is the implementation of NumberRange::getFull.
+auto NumberRange::getFull() -> NumberRange {
+    return {-infinity, infinity, false};
+}
+
+// This is the implementation of NumberRange::getEmpty.
+auto NumberRange::getEmpty() -> NumberRange {
+    return {infinity, -infinity, true};
+}
+
+// This is the implementation of NumberRange::getConstant.
+auto NumberRange::getConstant(double value) -> NumberRange {
+    if (std::isnan(value))
+        return getFull();
+    auto integral = std::isfinite(value) && std::trunc(value) == value &&
+                    !(value == 0 && std::signbit(value));
+    return {value, value, integral};
+}
+
+// This is the implementation of NumberRange::isInt32.
+auto NumberRange::isInt32() const -> bool {
+    return !isEmpty() && integral &&
+           min >= std::numeric_limits<int32_t>::min() &&
+           max <= std::numeric_limits<int32_t>::max();
+}
+
+// This is the implementation of NumberRange::unionWith.
+auto NumberRange::unionWith(const NumberRange &other) const -> NumberRange {
+    if (isEmpty())
+        return other;
+    if (other.isEmpty())
+        return *this;
+    return {std::min(min, other.min), std::max(max, other.max),
+            integral && other.integral};
+}
+
+// This is the implementation of the constructor of the NumberRangeAnalysis.
+NumberRangeAnalysis::NumberRangeAnalysis(const llvm::Function &function,
+                                         const llvm::DominatorTree &tree) {
+    collectConditions(function, tree);
+
+    std::vector<const llvm::Instruction *> order;
+    for (auto *block :
+         llvm::ReversePostOrderTraversal<const llvm::Function *>(&function)) {
+        for (auto &instruction : *block) {
+            if (instruction.getType()->isDoubleTy())
+                order.push_back(&instruction);
+        }
+    }
+
+    // Every value starts out empty, and is only allowed to grow.
+    llvm::DenseMap<const llvm::Instruction *, unsigned> updates;
+    for (auto changed = true; changed;) {
+        changed = false;
+        for (auto *instruction : order) {
+            auto old = getRange(instruction);
+            auto range = compute(*instruction).unionWith(old);
+            if (range == old)
+                continue;
+
+            if (llvm::isa<llvm::PHINode>(instruction) && !old.isEmpty() &&
+                ++updates[instruction] > widenAfter) {
+                if (range.min < old.min)
+                    range.min = -infinity;
+                if (range.max > old.max)
+                    range.max = infinity;
+            }
+            ranges[instruction] = range;
+            changed = true;
+        }
+    }
+
+    // The ranges now hold every value, so computing them again can only
+    // give ranges that still do.
+    for (unsigned pass = 0; pass < narrowingPasses; ++pass) {
+        for (auto *instruction : order)
+            ranges[instruction] = compute(*instruction);
+    }
+}
+
+// This is the implementation of NumberRangeAnalysis::collectConditions. A
+// block whose only predecessor branches on a comparison can only run when
+// the comparison went its way, and so can every block it dominates.
+auto NumberRangeAnalysis::collectConditions(const llvm::Function &function,
+                                            const llvm::DominatorTree &tree)
+    -> void {
+    if (function.empty())
+        return;
+
+    for (auto *node : llvm::depth_first(tree.getRootNode())) {
+        auto *block = node->getBlock();
+        llvm::SmallVector<Condition, 4> known;
+        if (auto *parent = node->getIDom()) {
+            auto found = conditions.find(parent->getBlock());
+            if (found != conditions.end())
+                known = found->second;
+        }
+
+        auto *predecessor = block->getSinglePredecessor();
+        auto *branch =
+            predecessor && predecessor != block
+                ? llvm::dyn_cast<llvm::BranchInst>(predecessor->getTerminator())
+                : nullptr;
+        if (branch && branch->isConditional() &&
+            branch->getSuccessor(0) != branch->getSuccessor(1)) {
+            if (auto *comparison =
+                    llvm::dyn_cast<llvm::FCmpInst>(branch->getCondition()))
+                known.push_back({comparison, branch->getSuccessor(0) == block});
+        }
+
+        if (!known.empty())
+            conditions[block] = std::move(known);
+    }
+}
+
+// This is the implementation of NumberRangeAnalysis::compute.
+auto NumberRangeAnalysis::compute(const llvm::Instruction &instruction) const
+    -> NumberRange {
+    auto *block = instruction.getParent();
+    if (auto *phi = llvm::dyn_cast<llvm::PHINode>(&instruction)) {
+        auto range = NumberRange::getEmpty();
+        for (unsigned i = 0; i < phi->getNumIncomingValues(); ++i)
+            range = range.unionWith(getRangeAt(phi->getIncomingValue(i),
+                                               phi->getIncomingBlock(i)));
+        return range;
+    }
+    if (auto *select = llvm::dyn_cast<llvm::SelectInst>(&instruction)) {
+        return getRangeAt(select->getTrueValue(), block)
+            .unionWith(getRangeAt(select->getFalseValue(), block));
+    }
+
+    switch (instruction.getOpcode()) {
+    case llvm::Instruction::FAdd:
+    case llvm::Instruction::FSub:
+    case llvm::Instruction::FMul:
+        return computeArithmetic(
+            instruction.getOpcode(),
+            getRangeAt(instruction.getOperand(0), block),
+            getRangeAt(instruction.getOperand(1), block));
+    case llvm::Instruction::FNeg: {
+        // The negation of 0 is -0.
+        auto operand = getRangeAt(instruction.getOperand(0), block);
+        if (operand.isEmpty())
+            return operand;
+        if (operand.integral && (operand.min > 0 || operand.max < 0))
+            return {-operand.max, -operand.min, true};
+        return NumberRange::getFull();
+    }
+    case llvm::Instruction::SIToFP:
+    case llvm::Instruction::UIToFP:
+        return computeConversion(llvm::cast<llvm::CastInst>(instruction));
+    default:
+        return NumberRange::getFull();
+    }
+}
+
+// This is the implementation of NumberRangeAnalysis::refine. Only an ordered
+// comparison bounds its operands, since an unordered one also holds for NaN.
+// The range of the other operand is not refined itself, so that two
+// conditions on each other cannot recurse.
+auto NumberRangeAnalysis::refine(const llvm::Value *value, NumberRange range,
+                                 const Condition &condition) const
+    -> NumberRange {
+    auto *comparison = condition.comparison;
+    auto predicate = condition.holds ? comparison->getPredicate()
+                                     : comparison->getInversePredicate();
+    auto *other = comparison->getOperand(1);
+    if (comparison->getOperand(0) != value) {
+        predicate = llvm::CmpInst::getSwappedPredicate(predicate);
+        other = comparison->getOperand(0);
+    }
+    if (other == value)
+        return range;
+
+    auto bound = getRange(other);
+    if (bound.isEmpty())
+        return NumberRange::getEmpty();
+
+    switch (predicate) {
+    case llvm::CmpInst::FCMP_OLT:
+        range.max = std::min(range.max, std::ceil(bound.max) - 1);
+        break;
+    case llvm::CmpInst::FCMP_OLE:
+        range.max = std::min(range.max, std::floor(bound.max));
+        break;
+    case llvm::CmpInst::FCMP_OGT:
+        range.min = std::max(range.min, std::floor(bound.min) + 1);
+        break;
+    case llvm::CmpInst::FCMP_OGE:
+        range.min = std::max(range.min, std::ceil(bound.min));
+        break;
+    case llvm::CmpInst::FCMP_OEQ:
+        range.min = std::max(range.min, std::ceil(bound.min));
+        range.max = std::min(range.max, std::floor(bound.max));
+        break;
+    default:
+        break;
+    }
+    return range.isEmpty() ? NumberRange::getEmpty() : range;
+}
+
+// This is the implementation of NumberRangeAnalysis::getRange. An
+// instruction that has not been reached yet has no values so far, while any
+// other value that is not a constant may be any number.
+auto NumberRangeAnalysis::getRange(const llvm::Value *value) const
+    -> NumberRange {
+    if (auto *constant = llvm::dyn_cast<llvm::ConstantFP>(value))
+        return NumberRange::getConstant(
+            constant->getValueAPF().convertToDouble());
+    if (!value->getType()->isDoubleTy())
+        return NumberRange::getFull();
+
+    auto found = ranges.find(value);
+    if (found != ranges.end())
+        return found->second;
+    return llvm::isa<llvm::Instruction>(value) ? NumberRange::getEmpty()
+                                               : NumberRange::getFull();
+}
+
+// This is the implementation of NumberRangeAnalysis::getRangeAt. Only the
+// bounds of integral ranges are refined, since those are the only ones that
+// could become an i32.
+auto NumberRangeAnalysis::getRangeAt(const llvm::Value *value,
+                                     const llvm::BasicBlock *block) const
+    -> NumberRange {
+    auto range = getRange(value);
+    if (range.isEmpty() || !range.integral)
+        return range;
+
+    auto found = conditions.find(block);
+    if (found == conditions.end())
+        return range;
+    for (auto &condition : found->second) {
+        if (condition.comparison->getOperand(0) == value ||
+            condition.comparison->getOperand(1) == value)
+            range = refine(value, range, condition);
+    }
+    return range;
+}
+} // namespace ntsc
@@ -0,0 +1,99 @@
+#ifndef NTSC_NUMBERRANGEANALYSIS_H
+#define NTSC_NUMBERRANGEANALYSIS_H
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Value.h"
+
+/*
+    This file defines the NumberRangeAnalysis interface, which finds the range
+    of the values of every double in a function. A TypeScript number is
+    always a double, but most numbers in practice are small integers, such as
+    counters and indices. Once a value is known to be an integer in the range
+    of an i32, it can be computed with integer arithmetic, which is what the
+    Int32NarrowingPass does with the result.
+*/
+
+namespace ntsc {
+// This struct is a set of numbers, as the bounds of an interval. A range is
+// integral when every number in it is an integer, which excludes -0, NaN and
+// the infinities, since integer arithmetic cannot produce them. An empty
+// range, whose minimum is above its maximum, has no numbers at all.
+struct NumberRange {
+    double min;
+    double max;
+    bool integral;
+
+    [[nodiscard]] static auto getFull() -> NumberRange;
+    [[nodiscard]] static auto getEmpty() -> NumberRange;
+    [[nodiscard]] static auto getConstant(double value) -> NumberRange;
+
+    [[nodiscard]] inline auto isEmpty() const -> bool { return min > max; }
+
+    // This method will return whether every number in the range is an i32.
+    [[nodiscard]] auto isInt32() const -> bool;
+
+    // This method will return the smallest range that holds both ranges.
+    [[nodiscard]] auto unionWith(const NumberRange &other) const
+        -> NumberRange;
+
+    inline auto operator==(const NumberRange &other) const -> bool {
+        return (isEmpty() && other.isEmpty()) ||
+               (min == other.min && max == other.max &&
+                integral == other.integral);
+    }
+    inline auto operator!=(const NumberRange &other) const -> bool {
+        return !(*this == other);
+    }
+};
+
+class NumberRangeAnalysis {
+    // This struct is a comparison known to hold in a block, because the
+    // block can only be reached through one edge of the branch on it.
+    struct Condition {
+        const llvm::FCmpInst *comparison;
+        bool holds;
+    };
+
+    llvm::DenseMap<const llvm::Value *, NumberRange> ranges;
+    llvm::DenseMap<const llvm::BasicBlock *, llvm::SmallVector<Condition, 4>>
+        conditions;
+
+    // This method will collect the conditions of every block.
+    auto collectConditions(const llvm::Function &function,
+                           const llvm::DominatorTree &tree) -> void;
+
+    // This method will compute the range of an instruction from the ranges
+    // that are known so far.
+    [[nodiscard]] auto compute(const llvm::Instruction &instruction) const
+        -> NumberRange;
+
+    // This method will narrow a range by a condition on the value.
+    [[nodiscard]] auto refine(const llvm::Value *value, NumberRange range,
+                              const Condition &condition) const
+        -> NumberRange;
+
+  public:
+    // This constructor will analyze a function. The ranges do not follow
+    // changes to the function made afterwards.
+    NumberRangeAnalysis(const llvm::Function &function,
+                        const llvm::DominatorTree &tree);
+
+    // This method will return the range of a double anywhere in the
+    // function.
+    [[nodiscard]] auto getRange(const llvm::Value *value) const
+        -> NumberRange;
+
+    // This method will return the range of a double where it is used in the
+    // given block, which may be narrower than it is elsewhere, such as
+    // inside the body of a loop that compares it.
+    [[nodiscard]] auto getRangeAt(const llvm::Value *value,
+                                  const llvm::BasicBlock *block) const
+        -> NumberRange;
+};
+} // namespace ntsc
+
+#endif
@@ -0,0 +1,329 @@
+#include "ObjectLayout.h"
+#include "InlineCacheSpecializationPass.h"
+#include "ObjectModel.h"
+#include "RuntimeFunctions.h"
+#include "ValueRepresentation.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Metadata.h"
+#include <cstdint>
+#include <string>
+
+/*
+    This file contains the implementation of the ObjectLayout. The probes of
+    an inline cache are unrolled, since the cache is small, and each probe
+    loads the offset of its entry along with the shape, which share a cache
+    line, so a hit is a chain of compares followed by a single load.
+*/
+
+namespace ntsc {
+static_assert(undefinedValue == boxing::undefinedValue &&
+                  boxedTagShift == boxing::tagShift &&
+                  boxedPointerTag == boxing::pointerTag,
+              "the runtime and the code generator box values alike");
+static_assert(sizeof(InlineCache) ==
+                  sizeof(InlineCache::Entry) * inlineCacheSize +
+                      2 * sizeof(uint32_t),
+              "an InlineCache is its entries followed by two counts");
+
+// These are the indices of the fields of an InlineCache and its entries.
+enum : unsigned {
+    entriesField = 0,
+    shapeField = 0,
+    offsetField = 1,
+};
+
+// This function will return the address of a slot of an object at its fixed
+// offset from the object.
+static auto emitSlotAddress(llvm::IRBuilderBase &builder, llvm::Value *object,
+                            unsigned slot) -> llvm::Value * {
+    auto *bytes = builder.CreatePointerCast(object, builder.getInt8PtrTy());
+    auto *address = builder.CreateConstInBoundsGEP1_64(
+        builder.getInt8Ty(), bytes,
+        sizeof(Object) + uint64_t{slot} * sizeof(uint64_t));
+    return builder.CreatePointerCast(address,
+                                     builder.getInt64Ty()->getPointerTo());
+}
+
+// This function will load the shape of an object from its header.
+static auto emitShapeLoad(llvm::IRBuilderBase &builder, llvm::Value *object)
+    -> llvm::Value * {
+    auto *pointer = builder.getInt8PtrTy();
+    return builder.CreateLoad(
+        pointer,
+        builder.CreatePointerCast(object, pointer->getPointerTo()), "shape");
+}
+
+// This is the implementation of the ObjectLayout constructor.
+ObjectLayout::ObjectLayout(llvm::Module &module,
+                           const IdentifierTable &identifiers)
+    : module{module}, identifiers{identifiers} {
+    auto &context = module.getContext();
+    auto *entry = llvm::StructType::get(
+        context, {llvm::Type::getInt8PtrTy(context),
+                  llvm::Type::getInt64Ty(context)});
+    inlineCacheType = llvm::StructType::get(
+        context, {llvm::ArrayType::get(entry, inlineCacheSize),
+                  llvm::Type::getInt32Ty(context),
+                  llvm::Type::getInt32Ty(context)});
+}
+
+// This is the implementation of ObjectLayout::getSlot. An object of an exact
+// type holds its properties in the order of the type.
+auto ObjectLayout::getSlot(const ObjectType *type, Symbol name)
+    -> llvm::Optional<unsigned> {
+    auto *property = type->getProperty(name);
+    if (!property)
+        return llvm::None;
+    return static_cast<unsigned>(property - type->getProperties().begin());
+}
+
+// This is the implementation of ObjectLayout::getPropertyName. The names are
+// linkonce_odr, so the linker keeps one of each, and the runtime can compare
+// the names of different modules by their addresses.
+auto ObjectLayout::getPropertyName(Symbol name) -> llvm::GlobalVariable * {
+    auto &global = names[name.getValue()];
+    if (global)
+        return global;
+
+    auto spelling = identifiers.getName(name);
+    auto symbol = "ntsc.name." + spelling.str();
+    global = module.getNamedGlobal(symbol);
+    if (!global) {
+        auto *string =
+            llvm::ConstantDataArray::getString(module.getContext(), spelling);
+        global = new llvm::GlobalVariable(
+            module, string->getType(), true,
+            llvm::GlobalValue::LinkOnceODRLinkage, string, symbol);
+    }
+    return global;
+}
+
+// This is the implementation of ObjectLayout::createInlineCache.
+auto ObjectLayout::createInlineCache() -> llvm::GlobalVariable * {
+    auto *cache = new llvm::GlobalVariable(
+        module, inlineCacheType, false, llvm::GlobalValue::InternalLinkage,
+        llvm::ConstantAggregateZero::get(inlineCacheType), "ntsc.ic");
+    cache->setAlignment(llvm::Align{alignof(InlineCache)});
+    return cache;
+}
+
+// This is the implementation of ObjectLayout::emitObjectLiteral. The shape of
+// the literal is only asked of the runtime the first time it runs.
+auto ObjectLayout::emitObjectLiteral(llvm::IRBuilderBase &builder,
+                                     const ObjectType *type,
+                                     llvm::ArrayRef<llvm::Value *> values)
+    -> llvm::Value * {
+    auto &context = module.getContext();
+    auto *pointer = builder.getInt8PtrTy();
+    auto properties = type->getProperties();
+    auto *object = builder.CreateCall(
+        runtime::getAllocateFunction(module),
+        {builder.getInt64(sizeof(Object) +
+                          properties.size() * sizeof(uint64_t))},
+        "object");
+
+    llvm::SmallVector<llvm::Constant *, 8> nameConstants;
+    for (auto &property : properties)
+        nameConstants.push_back(llvm::ConstantExpr::getPointerCast(
+            getPropertyName(property.name), pointer));
+    auto *namesType = llvm::ArrayType::get(pointer, nameConstants.size());
+    auto *namesArray = new llvm::GlobalVariable(
+        module, namesType, true, llvm::GlobalValue::PrivateLinkage,
+        llvm::ConstantArray::get(namesType, nameConstants),
+        "ntsc.shape.names");
+    auto *shapeCache = new llvm::GlobalVariable(
+        module, pointer, false, llvm::GlobalValue::InternalLinkage,
+        llvm::ConstantPointerNull::get(pointer), "ntsc.shape");
+
+    auto *function = builder.GetInsertBlock()->getParent();
+    auto *cached = builder.CreateLoad(pointer, shapeCache);
+    auto *start = builder.GetInsertBlock();
+    auto *miss = llvm::BasicBlock::Create(context, "shape.miss", function);
+    auto *done = llvm::BasicBlock::Create(context, "shape.done", function);
+    builder.CreateCondBr(builder.CreateIsNull(cached), miss, done);
+
+    builder.SetInsertPoint(miss);
+    auto *created = builder.CreateCall(
+        runtime::getLiteralShapeFunction(module),
+        {builder.CreatePointerCast(shapeCache, pointer),
+         builder.CreatePointerCast(namesArray, pointer),
+         builder.getInt32(static_cast<uint32_t>(properties.size()))});
+    builder.CreateBr(done);
+
+    builder.SetInsertPoint(done);
+    auto *shape = builder.CreatePHI(pointer, 2, "shape");
+    shape->addIncoming(cached, start);
+    shape->addIncoming(created, miss);
+    builder.CreateStore(
+        shape, builder.CreatePointerCast(object, pointer->getPointerTo()));
+
+    // The object is new, so it is in the nursery, and its first stores need
+    // no barrier.
+    for (unsigned i = 0; i < values.size(); ++i)
+        builder.CreateAlignedStore(values[i],
+                                   emitSlotAddress(builder, object, i),
+                                   llvm::Align{sizeof(uint64_t)});
+    return object;
+}
+
+// This is the implementation of ObjectLayout::emitSlotLoad.
+auto ObjectLayout::emitSlotLoad(llvm::IRBuilderBase &builder,
+                                llvm::Value *object, unsigned slot)
+    -> llvm::Value * {
+    return builder.CreateAlignedLoad(builder.getInt64Ty(),
+                                     emitSlotAddress(builder, object, slot),
+                                     llvm::Align{sizeof(uint64_t)});
+}
+
+// This is the implementation of ObjectLayout::emitSlotStore.
+auto ObjectLayout::emitSlotStore(llvm::IRBuilderBase &builder,
+                                 llvm::Value *object, unsigned slot,
+                                 llvm::Value *value) -> void {
+    builder.CreateAlignedStore(value, emitSlotAddress(builder, object, slot),
+                               llvm::Align{sizeof(uint64_t)});
+    emitWriteBarrier(builder, object, value);
+}
+
+// This is the implementation of ObjectLayout::emitWriteBarrier. A constant
+// that is not a pointer needs no barrier at all.
+auto ObjectLayout::emitWriteBarrier(llvm::IRBuilderBase &builder,
+                                    llvm::Value *object, llvm::Value *value)
+    -> void {
+    if (auto *constant = llvm::dyn_cast<llvm::ConstantInt>(value);
+        constant &&
+        constant->getZExtValue() >> boxing::tagShift != boxing::pointerTag)
+        return;
+
+    auto &context = module.getContext();
+    auto *function = builder.GetInsertBlock()->getParent();
+    auto *isPointer = builder.CreateICmpEQ(
+        builder.CreateLShr(value, boxing::tagShift),
+        builder.getInt64(boxing::pointerTag));
+    auto *barrier = llvm::BasicBlock::Create(context, "barrier", function);
+    auto *done = llvm::BasicBlock::Create(context, "barrier.done", function);
+    builder.CreateCondBr(isPointer, barrier, done);
+
+    builder.SetInsertPoint(barrier);
+    builder.CreateCall(
+        runtime::getWriteBarrierFunction(module),
+        {builder.CreatePointerCast(object, builder.getInt8PtrTy()), value});
+    builder.CreateBr(done);
+    builder.SetInsertPoint(done);
+}
+
+// This is the implementation of ObjectLayout::emitProbes. An empty entry has
+// a null shape, which no object has, so it always misses. Each probe is
+// tagged with its cache and entry, so that a profile of its branch tells the
+// InlineCacheSpecializationPass how often the entry hit.
+auto ObjectLayout::emitProbes(llvm::IRBuilderBase &builder,
+                              llvm::Value *object,
+                              llvm::GlobalVariable *cache,
+                              llvm::BasicBlock *&hit) -> llvm::PHINode * {
+    auto &context = module.getContext();
+    auto *function = builder.GetInsertBlock()->getParent();
+    auto *shape = emitShapeLoad(builder, object);
+    hit = llvm::BasicBlock::Create(context, "ic.hit", function);
+    auto *offset = llvm::PHINode::Create(builder.getInt64Ty(), inlineCacheSize,
+                                         "ic.offset", hit);
+
+    for (unsigned i = 0; i < inlineCacheSize; ++i) {
+        auto field = [&](unsigned index) {
+            return builder.CreateInBoundsGEP(
+                inlineCacheType, cache,
+                {builder.getInt32(0), builder.getInt32(entriesField),
+                 builder.getInt32(i), builder.getInt32(index)});
+        };
+        auto *entryShape =
+            builder.CreateLoad(builder.getInt8PtrTy(), field(shapeField));
+        auto *entryOffset =
+            builder.CreateLoad(builder.getInt64Ty(), field(offsetField));
+        auto *next = llvm::BasicBlock::Create(
+            context, i + 1 < inlineCacheSize ? "ic.probe" : "ic.miss",
+            function);
+        auto *probe = builder.CreateCondBr(
+            builder.CreateICmpEQ(entryShape, shape), hit, next);
+        probe->setMetadata(
+            inlineCacheProbeMetadata,
+            llvm::MDNode::get(context,
+                              {llvm::ConstantAsMetadata::get(cache),
+                               llvm::ConstantAsMetadata::get(
+                                   builder.getInt32(i))}));
+        offset->addIncoming(entryOffset, builder.GetInsertBlock());
+        builder.SetInsertPoint(next);
+    }
+    return offset;
+}
+
+// This is the implementation of ObjectLayout::emitCachedLoad.
+auto ObjectLayout::emitCachedLoad(llvm::IRBuilderBase &builder,
+                                  llvm::Value *object, Symbol name)
+    -> llvm::Value * {
+    auto *pointer = builder.getInt8PtrTy();
+    auto *cache = createInlineCache();
+    llvm::BasicBlock *hit;
+    auto *offset = emitProbes(builder, object, cache, hit);
+
+    auto *miss = builder.GetInsertBlock();
+    auto *missValue = builder.CreateCall(
+        runtime::getGetPropertyFunction(module),
+        {builder.CreatePointerCast(object, pointer),
+         builder.CreatePointerCast(getPropertyName(name), pointer),
+         builder.CreatePointerCast(cache, pointer)});
+    auto *done = llvm::BasicBlock::Create(module.getContext(), "ic.done",
+                                          miss->getParent());
+    builder.CreateBr(done);
+
+    builder.SetInsertPoint(hit);
+    auto *address = builder.CreateInBoundsGEP(
+        builder.getInt8Ty(), builder.CreatePointerCast(object, pointer),
+        offset);
+    auto *hitValue = builder.CreateAlignedLoad(
+        builder.getInt64Ty(),
+        builder.CreatePointerCast(address,
+                                  builder.getInt64Ty()->getPointerTo()),
+        llvm::Align{sizeof(uint64_t)});
+    builder.CreateBr(done);
+
+    builder.SetInsertPoint(done);
+    auto *value = builder.CreatePHI(builder.getInt64Ty(), 2);
+    value->addIncoming(hitValue, hit);
+    value->addIncoming(missValue, miss);
+    return value;
+}
+
+// This is the implementation of ObjectLayout::emitCachedStore.
+auto ObjectLayout::emitCachedStore(llvm::IRBuilderBase &builder,
+                                   llvm::Value *object, Symbol name,
+                                   llvm::Value *value) -> void {
+    auto *pointer = builder.getInt8PtrTy();
+    auto *cache = createInlineCache();
+    llvm::BasicBlock *hit;
+    auto *offset = emitProbes(builder, object, cache, hit);
+
+    auto *miss = builder.GetInsertBlock();
+    builder.CreateCall(
+        runtime::getSetPropertyFunction(module),
+        {builder.CreatePointerCast(object, pointer),
+         builder.CreatePointerCast(getPropertyName(name), pointer), value,
+         builder.CreatePointerCast(cache, pointer)});
+    auto *done = llvm::BasicBlock::Create(module.getContext(), "ic.done",
+                                          miss->getParent());
+    builder.CreateBr(done);
+
+    builder.SetInsertPoint(hit);
+    auto *address = builder.CreateInBoundsGEP(
+        builder.getInt8Ty(), builder.CreatePointerCast(object, pointer),
+        offset);
+    builder.CreateAlignedStore(
+        value,
+        builder.CreatePointerCast(address,
+                                  builder.getInt64Ty()->getPointerTo()),
+        llvm::Align{sizeof(uint64_t)});
+    emitWriteBarrier(builder, object, value);
+    builder.CreateBr(done);
+
+    builder.SetInsertPoint(done);
+}
+} // namespace ntsc
@@ -0,0 +1,95 @@
+#ifndef NTSC_OBJECTLAYOUT_H
+#define NTSC_OBJECTLAYOUT_H
+#include "IdentifierTable.h"
+#include "Type.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Value.h"
+
+/*
+    This file defines the ObjectLayout interface, which emits the objects and
+    property accesses of a module in the layout of ObjectModel.h. An object
+    whose exact type the type checker proved is created with its properties
+    in the order of the type, so its properties are read and written at
+    fixed offsets. Any other access goes through an inline cache of the
+    shapes it has seen, and only calls the runtime when it sees a new shape.
+
+    Every slot holds a boxed value, which ValueRepresentation unboxes. A
+    number is boxed as its own bits, so reading a number costs nothing more
+    than the load. Storing a value that may be a pointer also calls the write
+    barrier of the collector, while storing any other value does not.
+*/
+
+namespace ntsc {
+class ObjectLayout {
+    llvm::Module &module;
+    const IdentifierTable &identifiers;
+
+    // These are the globals of the property names of the module.
+    llvm::DenseMap<uint32_t, llvm::GlobalVariable *> names;
+
+    // This is the type of an InlineCache.
+    llvm::StructType *inlineCacheType;
+
+    // This method will return a new inline cache for a single access.
+    auto createInlineCache() -> llvm::GlobalVariable *;
+
+    // This method will emit the probes of an inline cache for the shape of an
+    // object. The builder is left in the block where every entry missed, and
+    // the offset of the property is returned in the block where one hit,
+    // which the caller branches to.
+    auto emitProbes(llvm::IRBuilderBase &builder, llvm::Value *object,
+                    llvm::GlobalVariable *cache, llvm::BasicBlock *&hit)
+        -> llvm::PHINode *;
+
+    // This method will emit the write barrier of a store into an object,
+    // which is only called when the value is a pointer. The builder is left
+    // in the block where the store continues.
+    auto emitWriteBarrier(llvm::IRBuilderBase &builder, llvm::Value *object,
+                          llvm::Value *value) -> void;
+
+  public:
+    // The Symbols of the properties must belong to the given table.
+    ObjectLayout(llvm::Module &module, const IdentifierTable &identifiers);
+
+    // This method will return the slot of a property in the objects of an
+    // exact type, or None if the type does not have it.
+    [[nodiscard]] static auto getSlot(const ObjectType *type, Symbol name)
+        -> llvm::Optional<unsigned>;
+
+    // This method will return the global that holds the name of a property.
+    auto getPropertyName(Symbol name) -> llvm::GlobalVariable *;
+
+    // This method will create an object of an exact type, with the boxed
+    // values of its properties in the order of the type.
+    auto emitObjectLiteral(llvm::IRBuilderBase &builder,
+                           const ObjectType *type,
+                           llvm::ArrayRef<llvm::Value *> values)
+        -> llvm::Value *;
+
+    // These methods will read and write a slot of an object of an exact type
+    // at its fixed offset. A write emits branches for its barrier, so the
+    // builder must be at the end of a block, where the write continues when
+    // it returns.
+    auto emitSlotLoad(llvm::IRBuilderBase &builder, llvm::Value *object,
+                      unsigned slot) -> llvm::Value *;
+    auto emitSlotStore(llvm::IRBuilderBase &builder, llvm::Value *object,
+                       unsigned slot, llvm::Value *value) -> void;
+
+    // These methods will read and write a property of an object of any shape
+    // through an inline cache. They emit branches, so the builder must be at
+    // the end of a block, where the access continues when they return.
+    auto emitCachedLoad(llvm::IRBuilderBase &builder, llvm::Value *object,
+                        Symbol name) -> llvm::Value *;
+    auto emitCachedStore(llvm::IRBuilderBase &builder, llvm::Value *object,
+                         Symbol name, llvm::Value *value) -> void;
+};
+} // namespace ntsc
+
+#endif
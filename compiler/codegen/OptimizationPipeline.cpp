@@ -0,0 +1,204 @@
+#include "OptimizationPipeline.h"
+#include "AllocationPromotionPass.h"
+#include "InlineCacheSpecializationPass.h"
+#include "Int32NarrowingPass.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/ModuleSummaryAnalysis.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/PGOOptions.h"
+#include "llvm/Support/SmallVectorMemoryBuffer.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetOptions.h"
+#include "llvm/Transforms/Scalar/SROA.h"
+#include <mutex>
+#include <string>
+
+/*
+    This file contains the implementation of the optimization pipelines.
+*/
+
+namespace ntsc {
+// This is the implementation of getLLVMOptimizationLevel.
+auto getLLVMOptimizationLevel(OptimizationLevel level)
+    -> llvm::OptimizationLevel {
+    switch (level) {
+    case OptimizationLevel::O0:
+        return llvm::OptimizationLevel::O0;
+    case OptimizationLevel::O1:
+        return llvm::OptimizationLevel::O1;
+    case OptimizationLevel::O2:
+        return llvm::OptimizationLevel::O2;
+    case OptimizationLevel::O3:
+        return llvm::OptimizationLevel::O3;
+    case OptimizationLevel::Os:
+        return llvm::OptimizationLevel::Os;
+    }
+    llvm_unreachable("unknown optimization level");
+}
+
+// This is the implementation of getCodeGenOptLevel. Optimizing for size
+// still selects instructions at the default level, as clang does.
+auto getCodeGenOptLevel(OptimizationLevel level) -> llvm::CodeGenOpt::Level {
+    switch (level) {
+    case OptimizationLevel::O0:
+        return llvm::CodeGenOpt::None;
+    case OptimizationLevel::O1:
+        return llvm::CodeGenOpt::Less;
+    case OptimizationLevel::O2:
+    case OptimizationLevel::Os:
+        return llvm::CodeGenOpt::Default;
+    case OptimizationLevel::O3:
+        return llvm::CodeGenOpt::Aggressive;
+    }
+    llvm_unreachable("unknown optimization level");
+}
+
+// This is the implementation of registerCompilerPasses. The numbers are
+// narrowed at the peephole extension point, which first runs once SROA has
+// turned the locals into phis, and before the loop passes, so that they see
+// integer induction variables. The allocations are promoted at the same point,
+// which runs after inlining has shown the uses of an object in its callees,
+// and SROA then breaks the objects moved to the stack into registers. The
+// inline caches are specialized last, once inlining has copied their probes
+// into every caller, and only do anything when a profile was used.
+auto registerCompilerPasses(llvm::PassBuilder &builder) -> void {
+    builder.registerPeepholeEPCallback(
+        [](llvm::FunctionPassManager &passes, llvm::OptimizationLevel) {
+            passes.addPass(Int32NarrowingPass{});
+            passes.addPass(AllocationPromotionPass{});
+            passes.addPass(llvm::SROAPass{});
+        });
+    builder.registerOptimizerLastEPCallback(
+        [](llvm::ModulePassManager &passes, llvm::OptimizationLevel level) {
+            if (level != llvm::OptimizationLevel::O0)
+                passes.addPass(InlineCacheSpecializationPass{});
+        });
+}
+
+// This is the implementation of getPGOOptions. The profile is of the IR
+// before it is optimized, so it still matches a module whose optimization
+// changed, as long as its source did not.
+auto getPGOOptions() -> llvm::Optional<llvm::PGOOptions> {
+    if (!UserOpts::profileGeneratePath.empty())
+        return llvm::PGOOptions{UserOpts::profileGeneratePath, "", "",
+                                llvm::PGOOptions::IRInstr};
+    if (!UserOpts::profileUsePath.empty())
+        return llvm::PGOOptions{UserOpts::profileUsePath, "", "",
+                                llvm::PGOOptions::IRUse};
+    return llvm::None;
+}
+
+// This is the implementation of createHostTargetMachine.
+auto createHostTargetMachine(OptimizationLevel level)
+    -> llvm::Expected<std::unique_ptr<llvm::TargetMachine>> {
+    static std::once_flag initialized;
+    std::call_once(initialized, [] {
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmPrinter();
+    });
+
+    auto triple = llvm::sys::getProcessTriple();
+    std::string error;
+    auto *target = llvm::TargetRegistry::lookupTarget(triple, error);
+    if (!target)
+        return llvm::createStringError(llvm::inconvertibleErrorCode(), error);
+
+    return std::unique_ptr<llvm::TargetMachine>{target->createTargetMachine(
+        triple, llvm::sys::getHostCPUName(), "", llvm::TargetOptions{},
+        llvm::Reloc::PIC_, llvm::None, getCodeGenOptLevel(level))};
+}
+
+namespace {
+// This struct holds the PassBuilder and the analysis managers that a pipeline
+// runs with, for a module built for the given TargetMachine.
+struct PipelineState {
+    // The analysis managers must be declared in this order, so that they are
+    // destroyed before the managers they refer to.
+    llvm::LoopAnalysisManager loops;
+    llvm::FunctionAnalysisManager functions;
+    llvm::CGSCCAnalysisManager sccs;
+    llvm::ModuleAnalysisManager modules;
+    llvm::PassBuilder builder;
+
+    PipelineState(llvm::Module &module, llvm::TargetMachine &machine)
+        : builder{&machine, llvm::PipelineTuningOptions{}, getPGOOptions()} {
+        module.setTargetTriple(machine.getTargetTriple().str());
+        module.setDataLayout(machine.createDataLayout());
+        registerCompilerPasses(builder);
+        builder.registerModuleAnalyses(modules);
+        builder.registerCGSCCAnalyses(sccs);
+        builder.registerFunctionAnalyses(functions);
+        builder.registerLoopAnalyses(loops);
+        builder.crossRegisterProxies(loops, functions, sccs, modules);
+    }
+};
+} // namespace
+
+// This is the implementation of optimizeModule.
+auto optimizeModule(llvm::Module &module, llvm::TargetMachine &machine,
+                    OptimizationLevel level) -> void {
+    PipelineState state{module, machine};
+    auto passes = level == OptimizationLevel::O0
+                      ? state.builder.buildO0DefaultPipeline(
+                            llvm::OptimizationLevel::O0)
+                      : state.builder.buildPerModuleDefaultPipeline(
+                            getLLVMOptimizationLevel(level));
+    passes.run(module, state.modules);
+}
+
+// This is the implementation of emitObjectFile. Code generation still runs on
+// the legacy pass manager.
+auto emitObjectFile(llvm::Module &module, llvm::TargetMachine &machine,
+                    llvm::StringRef path) -> llvm::Error {
+    std::error_code ec;
+    llvm::raw_fd_ostream stream{path, ec, llvm::sys::fs::OF_None};
+    if (ec)
+        return llvm::createFileError(path, ec);
+
+    llvm::legacy::PassManager passes;
+    if (machine.addPassesToEmitFile(passes, stream, nullptr,
+                                    llvm::CGFT_ObjectFile))
+        return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                       "the target cannot emit objects");
+    passes.run(module);
+
+    stream.close();
+    if (stream.has_error()) {
+        ec = stream.error();
+        stream.clear_error();
+        return llvm::createFileError(path, ec);
+    }
+    return llvm::Error::success();
+}
+
+// This is the implementation of optimizeForThinLTO.
+auto optimizeForThinLTO(llvm::Module &module, llvm::TargetMachine &machine,
+                        OptimizationLevel level)
+    -> std::unique_ptr<llvm::MemoryBuffer> {
+    PipelineState state{module, machine};
+    auto &builder = state.builder;
+    auto &modules = state.modules;
+    auto passes = level == OptimizationLevel::O0
+                      ? builder.buildO0DefaultPipeline(
+                            llvm::OptimizationLevel::O0, true)
+                      : builder.buildThinLTOPreLinkDefaultPipeline(
+                            getLLVMOptimizationLevel(level));
+    passes.run(module, modules);
+
+    // The summary tells the link which functions each module defines and
+    // calls, so that it can import functions across modules without loading
+    // every module at once.
+    auto &summary = modules.getResult<llvm::ModuleSummaryIndexAnalysis>(module);
+    llvm::SmallVector<char, 0> bitcode;
+    llvm::raw_svector_ostream stream{bitcode};
+    llvm::WriteBitcodeToFile(module, stream, false, &summary);
+    return std::make_unique<llvm::SmallVectorMemoryBuffer>(
+        std::move(bitcode), module.getModuleIdentifier(), false);
+}
+} // namespace ntsc
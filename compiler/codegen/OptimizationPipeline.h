@@ -0,0 +1,68 @@
+#ifndef NTSC_OPTIMIZATIONPIPELINE_H
+#define NTSC_OPTIMIZATIONPIPELINE_H
+#include "UserOpts.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Passes/OptimizationLevel.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/CodeGen.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/PGOOptions.h"
+#include "llvm/Target/TargetMachine.h"
+#include <memory>
+
+/*
+    This file defines the optimization pipelines of the -O levels. Each level
+    is one of the default pipelines of the LLVM new pass manager, with the
+    passes of the compiler added at their extension points, so a new level of
+    LLVM brings its improvements along without any change here.
+
+    A program built with -fprofile-generate counts how often each branch is
+    taken and which functions each indirect call reaches, which covers the
+    probes of the inline caches and the calls through union types. Built
+    again with -fprofile-use, the pipelines weigh the branches by the
+    profile, inline the calls that are hot, turn the hot targets of indirect
+    calls into direct calls, and specialize the inline caches.
+*/
+
+namespace ntsc {
+// These functions will return the LLVM levels of an optimization level, for
+// the optimizer and the code generator.
+auto getLLVMOptimizationLevel(OptimizationLevel level)
+    -> llvm::OptimizationLevel;
+auto getCodeGenOptLevel(OptimizationLevel level) -> llvm::CodeGenOpt::Level;
+
+// This function will add the passes of the compiler to the pipelines that a
+// PassBuilder builds.
+auto registerCompilerPasses(llvm::PassBuilder &builder) -> void;
+
+// This function will return the options of the profile that the pipelines
+// instrument the program to write, or optimize it with, if either was asked
+// for.
+auto getPGOOptions() -> llvm::Optional<llvm::PGOOptions>;
+
+// This function will create a TargetMachine for the host, which every module
+// is optimized and compiled for.
+auto createHostTargetMachine(OptimizationLevel level)
+    -> llvm::Expected<std::unique_ptr<llvm::TargetMachine>>;
+
+// This function will run the whole pipeline of the given level on a module
+// that is compiled on its own, without ThinLTO.
+auto optimizeModule(llvm::Module &module, llvm::TargetMachine &machine,
+                    OptimizationLevel level) -> void;
+
+// This function will compile a module into an object file at the given path.
+auto emitObjectFile(llvm::Module &module, llvm::TargetMachine &machine,
+                    llvm::StringRef path) -> llvm::Error;
+
+// This function will run the pipeline that prepares a module for ThinLTO. It
+// only simplifies the module, leaving inlining across modules and the
+// optimizations that depend on it to the link, and returns the module
+// serialized as bitcode with its summary.
+auto optimizeForThinLTO(llvm::Module &module, llvm::TargetMachine &machine,
+                        OptimizationLevel level)
+    -> std::unique_ptr<llvm::MemoryBuffer>;
+} // namespace ntsc
+
+#endif
@@ -0,0 +1,174 @@
+#include "RuntimeFunctions.h"
+#include "llvm/IR/Attributes.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/Casting.h"
+#include <initializer_list>
+
+/*
+    This file contains the implementation of the declarations of the runtime
+    functions.
+*/
+
+namespace ntsc {
+namespace runtime {
+// This function will mark the result of an allocation function as a pointer
+// that nothing else aliases, which lets LLVM optimize the memory of an
+// object it can see all the uses of.
+static auto markAllocation(llvm::FunctionCallee callee) -> void {
+    if (auto *function = llvm::dyn_cast<llvm::Function>(callee.getCallee())) {
+        function->addRetAttr(llvm::Attribute::NoAlias);
+        function->addRetAttr(llvm::Attribute::NonNull);
+        function->addFnAttr(llvm::Attribute::NoUnwind);
+    }
+}
+
+// This is the implementation of getAllocateFunction.
+auto getAllocateFunction(llvm::Module &module) -> llvm::FunctionCallee {
+    auto &context = module.getContext();
+    auto callee = module.getOrInsertFunction(
+        allocate, llvm::Type::getInt8PtrTy(context),
+        llvm::Type::getInt64Ty(context));
+    markAllocation(callee);
+    return callee;
+}
+
+// This is the implementation of getArenaAllocateFunction.
+auto getArenaAllocateFunction(llvm::Module &module) -> llvm::FunctionCallee {
+    auto &context = module.getContext();
+    auto callee = module.getOrInsertFunction(
+        arenaAllocate, llvm::Type::getInt8PtrTy(context),
+        llvm::Type::getInt8PtrTy(context), llvm::Type::getInt64Ty(context));
+    markAllocation(callee);
+    return callee;
+}
+
+// This function will mark the given parameters of a runtime function as
+// pointers that the function does not keep, so that passing an object to it
+// does not make the object escape.
+static auto markNoCapture(llvm::FunctionCallee callee,
+                          std::initializer_list<unsigned> parameters) -> void {
+    if (auto *function = llvm::dyn_cast<llvm::Function>(callee.getCallee())) {
+        for (auto parameter : parameters)
+            function->addParamAttr(parameter, llvm::Attribute::NoCapture);
+        function->addFnAttr(llvm::Attribute::NoUnwind);
+    }
+}
+
+// This is the implementation of getLiteralShapeFunction.
+auto getLiteralShapeFunction(llvm::Module &module) -> llvm::FunctionCallee {
+    auto &context = module.getContext();
+    auto *pointer = llvm::Type::getInt8PtrTy(context);
+    auto callee = module.getOrInsertFunction(literalShape, pointer, pointer,
+                                             pointer,
+                                             llvm::Type::getInt32Ty(context));
+    markNoCapture(callee, {0, 1});
+    return callee;
+}
+
+// This is the implementation of getGetPropertyFunction.
+auto getGetPropertyFunction(llvm::Module &module) -> llvm::FunctionCallee {
+    auto &context = module.getContext();
+    auto *pointer = llvm::Type::getInt8PtrTy(context);
+    auto callee = module.getOrInsertFunction(
+        getProperty, llvm::Type::getInt64Ty(context), pointer, pointer,
+        pointer);
+    markNoCapture(callee, {0, 1, 2});
+    return callee;
+}
+
+// This is the implementation of getSetPropertyFunction.
+auto getSetPropertyFunction(llvm::Module &module) -> llvm::FunctionCallee {
+    auto &context = module.getContext();
+    auto *pointer = llvm::Type::getInt8PtrTy(context);
+    auto callee = module.getOrInsertFunction(
+        setProperty, llvm::Type::getVoidTy(context), pointer, pointer,
+        llvm::Type::getInt64Ty(context), pointer);
+    markNoCapture(callee, {0, 1, 3});
+    return callee;
+}
+
+// This is the implementation of getWriteBarrierFunction. The barrier only
+// touches the memory of the collector, so the accesses of the program around
+// it may still be optimized.
+auto getWriteBarrierFunction(llvm::Module &module) -> llvm::FunctionCallee {
+    auto &context = module.getContext();
+    auto callee = module.getOrInsertFunction(
+        writeBarrier, llvm::Type::getVoidTy(context),
+        llvm::Type::getInt8PtrTy(context), llvm::Type::getInt64Ty(context));
+    markNoCapture(callee, {0});
+    if (auto *function = llvm::dyn_cast<llvm::Function>(callee.getCallee()))
+        function->addFnAttr(llvm::Attribute::InaccessibleMemOnly);
+    return callee;
+}
+
+// This is the implementation of getCoroutineAllocateFunction.
+auto getCoroutineAllocateFunction(llvm::Module &module)
+    -> llvm::FunctionCallee {
+    auto &context = module.getContext();
+    auto callee = module.getOrInsertFunction(
+        coroutineAllocate, llvm::Type::getInt8PtrTy(context),
+        llvm::Type::getInt64Ty(context));
+    markNoCapture(callee, {});
+    return callee;
+}
+
+// This is the implementation of getCoroutineFreeFunction.
+auto getCoroutineFreeFunction(llvm::Module &module) -> llvm::FunctionCallee {
+    auto &context = module.getContext();
+    auto callee = module.getOrInsertFunction(
+        coroutineFree, llvm::Type::getVoidTy(context),
+        llvm::Type::getInt8PtrTy(context), llvm::Type::getInt64Ty(context));
+    markNoCapture(callee, {0});
+    return callee;
+}
+
+// This is the implementation of getPromiseNewFunction.
+auto getPromiseNewFunction(llvm::Module &module) -> llvm::FunctionCallee {
+    auto callee = module.getOrInsertFunction(
+        promiseNew, llvm::Type::getInt8PtrTy(module.getContext()));
+    markNoCapture(callee, {});
+    return callee;
+}
+
+// This is the implementation of getPromiseResolveFunction.
+auto getPromiseResolveFunction(llvm::Module &module) -> llvm::FunctionCallee {
+    auto &context = module.getContext();
+    auto callee = module.getOrInsertFunction(
+        promiseResolve, llvm::Type::getVoidTy(context),
+        llvm::Type::getInt8PtrTy(context), llvm::Type::getInt64Ty(context));
+    markNoCapture(callee, {0});
+    return callee;
+}
+
+// This is the implementation of getPromiseAwaitFunction. The promise keeps
+// the node and the coroutine until it is settled.
+auto getPromiseAwaitFunction(llvm::Module &module) -> llvm::FunctionCallee {
+    auto &context = module.getContext();
+    auto *pointer = llvm::Type::getInt8PtrTy(context);
+    auto callee = module.getOrInsertFunction(
+        promiseAwait, llvm::Type::getVoidTy(context), pointer, pointer,
+        pointer);
+    markNoCapture(callee, {});
+    return callee;
+}
+
+// This is the implementation of getPromiseResultFunction.
+auto getPromiseResultFunction(llvm::Module &module) -> llvm::FunctionCallee {
+    auto &context = module.getContext();
+    auto callee = module.getOrInsertFunction(
+        promiseResult, llvm::Type::getInt64Ty(context),
+        llvm::Type::getInt8PtrTy(context));
+    markNoCapture(callee, {0});
+    return callee;
+}
+
+// This is the implementation of isCallTo.
+auto isCallTo(const llvm::Value *value, llvm::StringRef name) -> bool {
+    auto *call = llvm::dyn_cast<llvm::CallInst>(value);
+    if (!call)
+        return false;
+    auto *callee = call->getCalledFunction();
+    return callee && callee->getName() == name;
+}
+} // namespace runtime
+} // namespace ntsc
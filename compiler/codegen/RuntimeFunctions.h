@@ -0,0 +1,98 @@
+#ifndef NTSC_RUNTIMEFUNCTIONS_H
+#define NTSC_RUNTIMEFUNCTIONS_H
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include <cstdint>
+
+/*
+    This file defines the functions of the runtime that generated code calls,
+    and the contracts that the passes of the compiler rely on. Every object,
+    array and closure environment is allocated through one of them, so the
+    passes recognize an allocation by the function it calls.
+*/
+
+namespace ntsc {
+namespace runtime {
+// ptr ntsc_alloc(i64 size) allocates an object on the heap of the collector.
+// The memory is zeroed. The collector scans the stack and the heap
+// conservatively, since no statepoints are emitted, so an object that the
+// compiler moves to the stack still keeps the objects it refers to alive, and
+// the compiler need not keep pointers in any particular place.
+constexpr llvm::StringLiteral allocate{"ntsc_alloc"};
+
+// ptr ntsc_arena_alloc(ptr arena, i64 size) allocates an object in the arena
+// of a request, which is freed all at once when the request ends. The memory
+// is zeroed, and the collector treats every arena as a root. The code
+// generator only allocates in an arena the data that is no longer referenced
+// once the request ends, along with everything it refers to.
+constexpr llvm::StringLiteral arenaAllocate{"ntsc_arena_alloc"};
+
+// ptr ntsc_literal_shape(ptr cache, ptr names, i32 count) returns the shape of
+// the objects of an object literal, and stores it in the cache of the literal.
+constexpr llvm::StringLiteral literalShape{"ntsc_literal_shape"};
+
+// i64 ntsc_get_property(ptr object, ptr name, ptr cache) and
+// void ntsc_set_property(ptr object, ptr name, i64 value, ptr cache) access a
+// property that missed the inline cache of the access, and update the cache.
+constexpr llvm::StringLiteral getProperty{"ntsc_get_property"};
+constexpr llvm::StringLiteral setProperty{"ntsc_set_property"};
+
+// void ntsc_write_barrier(ptr object, i64 value) records that a value that may
+// be a pointer was stored in an object on the heap, for the collector. It
+// ignores objects elsewhere, such as on the stack or in an arena.
+constexpr llvm::StringLiteral writeBarrier{"ntsc_write_barrier"};
+
+// ptr ntsc_coro_alloc(i64 size) and void ntsc_coro_free(ptr frame, i64 size)
+// allocate and free the frame of a coroutine from a pool, which keeps frames
+// by size to reuse them.
+constexpr llvm::StringLiteral coroutineAllocate{"ntsc_coro_alloc"};
+constexpr llvm::StringLiteral coroutineFree{"ntsc_coro_free"};
+
+// ptr ntsc_promise_new() returns a pending promise, and
+// void ntsc_promise_resolve(ptr promise, i64 value) fulfills it.
+constexpr llvm::StringLiteral promiseNew{"ntsc_promise_new"};
+constexpr llvm::StringLiteral promiseResolve{"ntsc_promise_resolve"};
+
+// void ntsc_promise_await(ptr promise, ptr node, ptr coroutine) schedules a
+// suspended coroutine to be resumed once a promise is settled, and
+// i64 ntsc_promise_result(ptr promise) returns its value afterwards.
+constexpr llvm::StringLiteral promiseAwait{"ntsc_promise_await"};
+constexpr llvm::StringLiteral promiseResult{"ntsc_promise_result"};
+
+// This is the alignment of the memory that the allocation functions return.
+constexpr uint64_t allocationAlignment = 16;
+
+// These functions will return the declarations of the allocation functions
+// in a module, adding them the first time.
+auto getAllocateFunction(llvm::Module &module) -> llvm::FunctionCallee;
+auto getArenaAllocateFunction(llvm::Module &module) -> llvm::FunctionCallee;
+
+// These functions will return the declarations of the functions of the
+// object model in a module, adding them the first time.
+auto getLiteralShapeFunction(llvm::Module &module) -> llvm::FunctionCallee;
+auto getGetPropertyFunction(llvm::Module &module) -> llvm::FunctionCallee;
+auto getSetPropertyFunction(llvm::Module &module) -> llvm::FunctionCallee;
+
+// This function will return the declaration of the write barrier in a
+// module, adding it the first time.
+auto getWriteBarrierFunction(llvm::Module &module) -> llvm::FunctionCallee;
+
+// These functions will return the declarations of the functions that async
+// functions call in a module, adding them the first time.
+auto getCoroutineAllocateFunction(llvm::Module &module)
+    -> llvm::FunctionCallee;
+auto getCoroutineFreeFunction(llvm::Module &module) -> llvm::FunctionCallee;
+auto getPromiseNewFunction(llvm::Module &module) -> llvm::FunctionCallee;
+auto getPromiseResolveFunction(llvm::Module &module) -> llvm::FunctionCallee;
+auto getPromiseAwaitFunction(llvm::Module &module) -> llvm::FunctionCallee;
+auto getPromiseResultFunction(llvm::Module &module) -> llvm::FunctionCallee;
+
+// This function will return whether a call is to the given runtime function.
+[[nodiscard]] auto isCallTo(const llvm::Value *value, llvm::StringRef name)
+    -> bool;
+} // namespace runtime
+} // namespace ntsc
+
+#endif
@@ -0,0 +1,122 @@
+#include "ThinLTOLinker.h"
+#include "OptimizationPipeline.h"
+#include "llvm/LTO/Config.h"
+#include "llvm/LTO/LTO.h"
+#include "llvm/Support/Caching.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <utility>
+
+/*
+    This file contains the implementation of the ThinLTOLinker.
+*/
+
+namespace ntsc {
+namespace {
+// This function will return the configuration of the backends that optimize
+// and compile each module after the link. The backend pipelines only take a
+// number as the level, so optimizing for size is given as a pipeline.
+auto createConfig(OptimizationLevel level) -> llvm::lto::Config {
+    llvm::lto::Config config;
+    config.CPU = llvm::sys::getHostCPUName().str();
+    config.RelocModel = llvm::Reloc::PIC_;
+    config.CGOptLevel = getCodeGenOptLevel(level);
+    switch (level) {
+    case OptimizationLevel::O0:
+        config.OptLevel = 0;
+        break;
+    case OptimizationLevel::O1:
+        config.OptLevel = 1;
+        break;
+    case OptimizationLevel::O2:
+        config.OptLevel = 2;
+        break;
+    case OptimizationLevel::O3:
+        config.OptLevel = 3;
+        break;
+    case OptimizationLevel::Os:
+        config.OptLevel = 2;
+        config.OptPipeline = "default<Os>";
+        break;
+    }
+    return config;
+}
+} // namespace
+
+// This is the implementation of ThinLTOLinker::exportSymbol.
+auto ThinLTOLinker::exportSymbol(llvm::StringRef name) -> void {
+    exportedSymbols.insert(name);
+}
+
+// This is the implementation of ThinLTOLinker::addModule.
+auto ThinLTOLinker::addModule(size_t index,
+                              std::unique_ptr<llvm::MemoryBuffer> bitcode)
+    -> void {
+    std::lock_guard<std::mutex> lock{mutex};
+    modules[index] = std::move(bitcode);
+}
+
+// This is the implementation of ThinLTOLinker::link. Every module is compiled
+// into a single executable, so the first definition of a symbol prevails and
+// is final, as a static link would decide.
+auto ThinLTOLinker::link(llvm::StringRef outputPrefix)
+    -> llvm::Expected<std::vector<std::string>> {
+    auto backend = llvm::lto::createInProcessThinBackend(
+        llvm::heavyweight_hardware_concurrency(threadCount));
+    llvm::lto::LTO lto{createConfig(level), std::move(backend)};
+
+    llvm::StringSet<> definedSymbols;
+    for (auto &[index, bitcode] : modules) {
+        auto input =
+            llvm::lto::InputFile::create(bitcode->getMemBufferRef());
+        if (!input)
+            return input.takeError();
+
+        std::vector<llvm::lto::SymbolResolution> resolutions;
+        for (auto &symbol : (*input)->symbols()) {
+            llvm::lto::SymbolResolution resolution;
+            if (!symbol.isUndefined()) {
+                resolution.Prevailing =
+                    definedSymbols.insert(symbol.getName()).second;
+                resolution.FinalDefinitionInLinkageUnit = true;
+            }
+            resolution.VisibleToRegularObj =
+                symbol.isUndefined() ||
+                exportedSymbols.contains(symbol.getName());
+            resolutions.push_back(resolution);
+        }
+        if (auto error = lto.add(std::move(*input), resolutions))
+            return error;
+    }
+
+    // The backends run on many threads at once, and each asks for the stream
+    // of its own task.
+    std::mutex pathsMutex;
+    std::vector<std::pair<unsigned, std::string>> paths;
+    auto addStream = [&](unsigned task, auto &&...)
+        -> llvm::Expected<std::unique_ptr<llvm::CachedFileStream>> {
+        auto path = (outputPrefix + "." + llvm::Twine(task) + ".o").str();
+        std::error_code ec;
+        auto stream = std::make_unique<llvm::raw_fd_ostream>(
+            path, ec, llvm::sys::fs::OF_None);
+        if (ec)
+            return llvm::createFileError(path, ec);
+
+        std::lock_guard<std::mutex> lock{pathsMutex};
+        paths.emplace_back(task, path);
+        return std::make_unique<llvm::CachedFileStream>(std::move(stream),
+                                                        path);
+    };
+    if (auto error = lto.run(addStream))
+        return error;
+
+    std::sort(paths.begin(), paths.end());
+    std::vector<std::string> objects;
+    for (auto &[task, path] : paths)
+        objects.push_back(std::move(path));
+    return objects;
+}
+} // namespace ntsc
@@ -0,0 +1,63 @@
+#ifndef NTSC_THINLTOLINKER_H
+#define NTSC_THINLTOLINKER_H
+#include "UserOpts.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+    This file defines the ThinLTOLinker interface, which links the modules of
+    a program with ThinLTO. Each TypeScript module becomes its own LLVM
+    module, which is optimized on its own, possibly on its own thread, and
+    then added here as bitcode with its summary. The link reads only the
+    summaries to decide which functions to import into each module, so
+    functions are inlined across modules while the modules are still
+    optimized and compiled in parallel, one object file each.
+*/
+
+namespace ntsc {
+class ThinLTOLinker {
+    OptimizationLevel level;
+    unsigned threadCount;
+
+    // These are the modules to link, by the index they were added with.
+    std::mutex mutex;
+    std::map<size_t, std::unique_ptr<llvm::MemoryBuffer>> modules;
+
+    // These are the symbols that code outside of the link refers to, such as
+    // the entry point. Every other symbol may be internalized.
+    llvm::StringSet<> exportedSymbols;
+
+  public:
+    // This constructor will prepare a link that compiles the modules on the
+    // given number of threads, where zero uses every core.
+    ThinLTOLinker(OptimizationLevel level, unsigned threadCount)
+        : level{level}, threadCount{threadCount} {}
+    ThinLTOLinker(const ThinLTOLinker &) = delete;
+    auto operator=(const ThinLTOLinker &) -> ThinLTOLinker & = delete;
+
+    // This method will keep a symbol visible to code outside of the link.
+    auto exportSymbol(llvm::StringRef name) -> void;
+
+    // This method will add a module that optimizeForThinLTO has prepared. It
+    // is safe to call from any thread. The modules are linked in the order of
+    // their indices, so the output does not depend on which thread finished
+    // first.
+    auto addModule(size_t index, std::unique_ptr<llvm::MemoryBuffer> bitcode)
+        -> void;
+
+    // This method will link the modules and write an object file for each
+    // one, named after the output prefix. It will return the paths of the
+    // object files.
+    auto link(llvm::StringRef outputPrefix)
+        -> llvm::Expected<std::vector<std::string>>;
+};
+} // namespace ntsc
+
+#endif
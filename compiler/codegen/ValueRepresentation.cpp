@@ -0,0 +1,151 @@
+#include "ValueRepresentation.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/Support/Casting.h"
+#include "llvm/Support/ErrorHandling.h"
+
+/*
+    This file contains the implementation of the ValueRepresentation.
+*/
+
+namespace ntsc {
+// This is the implementation of ValueRepresentation::getRepresentation. A
+// union can only stay unboxed when every member is a pointer, since the
+// pointers are told apart through the objects they point to. A chain of
+// aliases is followed to the type it names, up to a limit that only a cycle
+// of aliases, which the type checker reports, can reach.
+auto ValueRepresentation::getRepresentation(const Type *type)
+    -> Representation {
+    for (auto depth = 0; depth < 64; ++depth) {
+        switch (type->getKind()) {
+        case TypeKind::Void:
+        case TypeKind::Never:
+            return Representation::None;
+        case TypeKind::Number:
+            return Representation::Number;
+        case TypeKind::Boolean:
+            return Representation::Boolean;
+        case TypeKind::BigInt:
+        case TypeKind::String:
+        case TypeKind::Array:
+        case TypeKind::Function:
+        case TypeKind::Object:
+            return Representation::Pointer;
+        case TypeKind::Any:
+        case TypeKind::Unknown:
+        case TypeKind::Undefined:
+        case TypeKind::Null:
+            return Representation::Boxed;
+        case TypeKind::Union:
+            for (auto *member : llvm::cast<UnionType>(type)->getMembers()) {
+                if (getRepresentation(member) != Representation::Pointer)
+                    return Representation::Boxed;
+            }
+            return Representation::Pointer;
+        case TypeKind::Named:
+            type = llvm::cast<NamedType>(type)->getTarget();
+            if (!type)
+                return Representation::Boxed;
+            break;
+        }
+    }
+    return Representation::Boxed;
+}
+
+// This is the implementation of ValueRepresentation::getLLVMType.
+auto ValueRepresentation::getLLVMType(Representation representation) const
+    -> llvm::Type * {
+    switch (representation) {
+    case Representation::None:
+        return llvm::Type::getVoidTy(context);
+    case Representation::Number:
+        return llvm::Type::getDoubleTy(context);
+    case Representation::Boolean:
+        return llvm::Type::getInt1Ty(context);
+    case Representation::Pointer:
+        return llvm::PointerType::getUnqual(context);
+    case Representation::Boxed:
+        return llvm::Type::getInt64Ty(context);
+    }
+    llvm_unreachable("unknown representation");
+}
+
+// This is the implementation of ValueRepresentation::getBoxedConstant.
+auto ValueRepresentation::getBoxedConstant(uint64_t bits) const
+    -> llvm::Constant * {
+    return llvm::ConstantInt::get(llvm::Type::getInt64Ty(context), bits);
+}
+
+// This is the implementation of ValueRepresentation::emitBox.
+auto ValueRepresentation::emitBox(llvm::IRBuilderBase &builder,
+                                  llvm::Value *value,
+                                  Representation representation) const
+    -> llvm::Value * {
+    auto *int64 = builder.getInt64Ty();
+    switch (representation) {
+    case Representation::None:
+        return getBoxedConstant(boxing::undefinedValue);
+    case Representation::Number: {
+        // Constants are folded by the builder, so a literal costs nothing.
+        auto *isNaN = builder.CreateFCmpUNO(value, value);
+        auto *bits = builder.CreateBitCast(value, int64);
+        return builder.CreateSelect(
+            isNaN, getBoxedConstant(boxing::canonicalNaN), bits);
+    }
+    case Representation::Boolean:
+        return builder.CreateOr(
+            builder.CreateZExt(value, int64),
+            getBoxedConstant(boxing::booleanTag << boxing::tagShift));
+    case Representation::Pointer:
+        return builder.CreateOr(
+            builder.CreatePtrToInt(value, int64),
+            getBoxedConstant(boxing::pointerTag << boxing::tagShift));
+    case Representation::Boxed:
+        return value;
+    }
+    llvm_unreachable("unknown representation");
+}
+
+// This is the implementation of ValueRepresentation::emitIsRepresentation.
+auto ValueRepresentation::emitIsRepresentation(
+    llvm::IRBuilderBase &builder, llvm::Value *boxed,
+    Representation representation) const -> llvm::Value * {
+    auto *tag = builder.CreateLShr(boxed, boxing::tagShift);
+    switch (representation) {
+    case Representation::None:
+        return builder.CreateICmpEQ(tag,
+                                    builder.getInt64(boxing::undefinedTag));
+    case Representation::Number:
+        return builder.CreateICmpULT(tag, builder.getInt64(boxing::firstTag));
+    case Representation::Boolean:
+        return builder.CreateICmpEQ(tag, builder.getInt64(boxing::booleanTag));
+    case Representation::Pointer:
+        return builder.CreateICmpEQ(tag, builder.getInt64(boxing::pointerTag));
+    case Representation::Boxed:
+        return builder.getTrue();
+    }
+    llvm_unreachable("unknown representation");
+}
+
+// This is the implementation of ValueRepresentation::emitUnbox.
+auto ValueRepresentation::emitUnbox(llvm::IRBuilderBase &builder,
+                                    llvm::Value *boxed,
+                                    Representation representation) const
+    -> llvm::Value * {
+    switch (representation) {
+    case Representation::None:
+        return nullptr;
+    case Representation::Number:
+        return builder.CreateBitCast(boxed, builder.getDoubleTy());
+    case Representation::Boolean:
+        return builder.CreateTrunc(boxed, builder.getInt1Ty());
+    case Representation::Pointer:
+        return builder.CreateIntToPtr(
+            builder.CreateAnd(boxed, builder.getInt64(boxing::payloadMask)),
+            llvm::PointerType::getUnqual(context));
+    case Representation::Boxed:
+        return boxed;
+    }
+    llvm_unreachable("unknown representation");
+}
+} // namespace ntsc
@@ -0,0 +1,98 @@
+#ifndef NTSC_VALUEREPRESENTATION_H
+#define NTSC_VALUEREPRESENTATION_H
+#include "Type.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Type.h"
+#include "llvm/IR/Value.h"
+#include <cstdint>
+
+/*
+    This file defines the ValueRepresentation interface, which decides how the
+    values of each type are held in LLVM IR. A value whose static type is
+    known is held unboxed, so a number is a double, a boolean is an i1, and an
+    object is a pointer. Only the values of types such as any, unknown and
+    unions of different representations are boxed into a single i64, and the
+    code generator converts between the two at those boundaries alone.
+*/
+
+namespace ntsc {
+// This enum holds the ways a value may be held in LLVM IR.
+enum class Representation : uint8_t {
+    // The type has no values, such as void.
+    None,
+    // A double.
+    Number,
+    // An i1.
+    Boolean,
+    // A pointer to the heap, for objects, arrays, functions, strings and
+    // BigInts.
+    Pointer,
+    // An i64 with the value boxed as described below.
+    Boxed,
+};
+
+// A boxed value is NaN boxed. A number is held as the bits of its double,
+// with every NaN made canonical so that no number has its top 16 bits at or
+// above firstTag. Every other value has a tag in its top 16 bits and a
+// payload in the rest, which for a pointer is its address.
+namespace boxing {
+constexpr unsigned tagShift = 48;
+constexpr uint64_t payloadMask = (uint64_t{1} << tagShift) - 1;
+constexpr uint64_t canonicalNaN = 0x7ff8000000000000;
+
+constexpr uint64_t firstTag = 0xfff9;
+constexpr uint64_t booleanTag = 0xfff9;
+constexpr uint64_t undefinedTag = 0xfffa;
+constexpr uint64_t nullTag = 0xfffb;
+constexpr uint64_t pointerTag = 0xfffc;
+
+constexpr uint64_t undefinedValue = undefinedTag << tagShift;
+constexpr uint64_t nullValue = nullTag << tagShift;
+} // namespace boxing
+
+class ValueRepresentation {
+    llvm::LLVMContext &context;
+
+  public:
+    explicit ValueRepresentation(llvm::LLVMContext &context)
+        : context{context} {}
+
+    // This method will return the representation of the values of a type.
+    [[nodiscard]] static auto getRepresentation(const Type *type)
+        -> Representation;
+
+    // These methods will return the LLVM type that holds a representation.
+    [[nodiscard]] auto getLLVMType(Representation representation) const
+        -> llvm::Type *;
+    [[nodiscard]] inline auto getLLVMType(const Type *type) const
+        -> llvm::Type * {
+        return getLLVMType(getRepresentation(type));
+    }
+
+    // This method will return the boxed value of a constant undefined or
+    // null.
+    [[nodiscard]] auto getBoxedConstant(uint64_t bits) const
+        -> llvm::Constant *;
+
+    // This method will box an unboxed value. A boxed value is returned as it
+    // is.
+    auto emitBox(llvm::IRBuilderBase &builder, llvm::Value *value,
+                 Representation representation) const -> llvm::Value *;
+
+    // This method will return an i1 that is set when a boxed value holds a
+    // value of the given representation.
+    auto emitIsRepresentation(llvm::IRBuilderBase &builder,
+                              llvm::Value *boxed,
+                              Representation representation) const
+        -> llvm::Value *;
+
+    // This method will unbox a value. The caller must have checked that the
+    // boxed value holds the representation, either with
+    // emitIsRepresentation or because the type checker narrowed it.
+    auto emitUnbox(llvm::IRBuilderBase &builder, llvm::Value *boxed,
+                   Representation representation) const -> llvm::Value *;
+};
+} // namespace ntsc
+
+#endif
@@ -1,16 +1,31 @@
 #ifndef NTSC_USEROPTS_H
 #define NTSC_USEROPTS_H
+#include <cstdint>
+#include <string>
 
 /*
     This file defines the static interface for storing user CLI options.
 */
 
 namespace ntsc {
+// This enum holds the optimization levels of the -O options.
+enum class OptimizationLevel : uint8_t { O0, O1, O2, O3, Os };
+
 struct UserOpts {
     // This option controls whether to enable TypeScript strict mode. It is
     // enabled by default.
     static inline auto strictModeEnabled = true;
+
+    // This option controls how much the generated code is optimized. It is
+    // -O0 by default.
+    static inline auto optimizationLevel = OptimizationLevel::O0;
+
+    // These options hold the path that an instrumented program writes its
+    // profile to, and the merged profile that the program is optimized with.
+    // Each is empty when it was not given, and at most one may be given.
+    static inline std::string profileGeneratePath;
+    static inline std::string profileUsePath;
 };
 } // namespace ntsc
 
-#endif
\ No newline at end of file
+#endif
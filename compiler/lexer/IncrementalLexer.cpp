@@ -0,0 +1,227 @@
+#include "IncrementalLexer.h"
+#include "Lexer.h"
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+
+/*
+    This file implements the IncrementalLexer interface for keeping the token
+    stream of an edited document up to date.
+*/
+
+namespace ntsc {
+// This is the implementation of the primary constructor.
+IncrementalLexer::IncrementalLexer(const SourceFile &source,
+                                   const SourceManager &sourceManager,
+                                   IdentifierTable &identifiers)
+    : text{source.getBuffer().str()}, diags{sourceManager},
+      identifiers{identifiers} {
+    file = std::make_unique<SourceFile>(source.getPath(), text.data(),
+                                        text.data() + text.size(),
+                                        source.getID());
+    Lexer lexer{*file, diags, identifiers};
+    tokens.reserve(text.size() / 4 + 1);
+    while (true) {
+        if (tokens.size() % checkpointInterval == 0)
+            checkpoints.emplace_back(tokens.size(), lexer.getState());
+        if (!lexToken(lexer, tokens, tokens.size(), diagnostics,
+                      diagnosticTokens))
+            break;
+    }
+}
+
+// This is the implementation of the method to lex a single token. The Lexer
+// only reports errors, so the diagnostics are only taken from the engine when
+// its count of errors grew.
+auto IncrementalLexer::lexToken(Lexer &lexer, TokenBuffer &buffer,
+                                size_t index,
+                                std::vector<Diagnostic> &tokenDiagnostics,
+                                std::vector<size_t> &tokenIndices) -> bool {
+    auto more = lexer.lexChunk(buffer, 1);
+    if (diags.getErrorCount() != takenErrorCount) {
+        takenErrorCount = diags.getErrorCount();
+        for (auto &diagnostic : diags.takeDiagnostics()) {
+            tokenDiagnostics.push_back(diagnostic);
+            tokenIndices.push_back(index);
+        }
+    }
+    return more;
+}
+
+// This is the implementation of the method to rebuild the state of the Lexer
+// before a token. The state depends on the parentheses and templates that are
+// still open there, so the kinds after the checkpoint are replayed, which
+// reads a byte per token.
+auto IncrementalLexer::getStateBefore(size_t index) const -> LexerState {
+    auto checkpoint =
+        std::upper_bound(checkpoints.begin(), checkpoints.end(), index,
+                         [](size_t index, const auto &checkpoint) {
+                             return index < checkpoint.first;
+                         }) -
+        1;
+    auto state = checkpoint->second;
+    for (auto i = checkpoint->first; i < index; ++i)
+        state.advance(tokens.kind(i));
+    return state;
+}
+
+// This is the implementation of the method to apply an edit. The Lexer only
+// keeps a LexerState between tokens besides its position, and it never stops
+// inside a comment or literal. So the end of any token is a safe place to
+// restart it, and once it reaches the start of an old token after the edit
+// with the state it had there before, the rest of the old stream is unchanged
+// apart from its offsets. The copy of the text still moves everything after
+// the edit, but that is a single pass over memory.
+auto IncrementalLexer::applyEdit(uint32_t offset, uint32_t removedLength,
+                                 llvm::StringRef insertedText)
+    -> TokenStreamEdit {
+    // The old text may be freed by the edit, so its address is only kept as a
+    // number, to find the arguments of the diagnostics that point into it.
+    auto oldText = reinterpret_cast<uintptr_t>(text.data());
+    auto oldSize = text.size();
+    text.replace(offset, removedLength, insertedText.data(),
+                 insertedText.size());
+    file->applyEdit(text.data(), text.data() + text.size(), offset,
+                    removedLength, static_cast<uint32_t>(insertedText.size()));
+    auto offsetDelta = static_cast<int64_t>(insertedText.size()) -
+                       static_cast<int64_t>(removedLength);
+    auto insertedEnd = offset + static_cast<uint32_t>(insertedText.size());
+
+    // The first token that is affected is the first one that does not end
+    // before the edit, since the edit may extend it. A token may also look up
+    // to two characters past its end, as in '?.' or '...', so the token before
+    // it is re-lexed too.
+    size_t lo = 0, hi = tokens.size();
+    while (lo < hi) {
+        auto mid = lo + (hi - lo) / 2;
+        if (tokens.offset(mid) + tokens.length(mid) < offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    auto first = lo == 0 ? 0 : lo - 1;
+    auto restartOffset =
+        first == 0 ? 0 : tokens.offset(first - 1) + tokens.length(first - 1);
+
+    // Now, we re-lex until a new token starts where an old token after the
+    // edit started. Any token that starts after the inserted text maps to an
+    // offset after the removed text. The old stream always ends with the end
+    // of the file, so this will terminate.
+    relexedTokens.clear();
+    relexedDiagnostics.clear();
+    relexedDiagnosticTokens.clear();
+    auto oldState = getStateBefore(first);
+    Lexer lexer{*file, diags, identifiers, restartOffset, oldState};
+    auto last = first;
+    while (true) {
+        auto newState = lexer.getState();
+        lexToken(lexer, relexedTokens, first + relexedTokens.size(),
+                 relexedDiagnostics, relexedDiagnosticTokens);
+        auto newOffset = relexedTokens.offset(relexedTokens.size() - 1);
+
+        // The end of the file replaces the old one, even if an unterminated
+        // template leaves the state different.
+        if (relexedTokens.kind(relexedTokens.size() - 1) ==
+            TokenKind::FileEnd) {
+            last = tokens.size() - 1;
+            break;
+        }
+        if (newOffset < insertedEnd)
+            continue;
+
+        auto oldOffset = static_cast<uint32_t>(newOffset - offsetDelta);
+        while (last < tokens.size() && tokens.offset(last) < oldOffset)
+            oldState.advance(tokens.kind(last++));
+        if (last < tokens.size() && tokens.offset(last) == oldOffset &&
+            newState == oldState)
+            break;
+    }
+
+    // The synchronizing token is replaced too, since whether it follows a line
+    // terminator depends on the text before it.
+    ++last;
+    spliceDiagnostics(first, last, oldText, oldSize, offset + removedLength,
+                      offsetDelta);
+    tokens.splice(first, last, relexedTokens, offsetDelta);
+    spliceCheckpoints(first, last);
+    return {first, last - first, relexedTokens.size()};
+}
+
+// This is the implementation of the method to splice the checkpoints. The
+// state before the first re-lexed token and before the synchronizing token is
+// the same as before the edit, so the checkpoints outside of the replaced
+// range stay valid. The gap between them is at most the re-lexed tokens and
+// two intervals, so this costs no more than the re-lexing did.
+auto IncrementalLexer::spliceCheckpoints(size_t first, size_t last) -> void {
+    auto begin = std::upper_bound(checkpoints.begin(), checkpoints.end(),
+                                  first,
+                                  [](size_t index, const auto &checkpoint) {
+                                      return index < checkpoint.first;
+                                  });
+    auto end = std::lower_bound(begin, checkpoints.end(), last,
+                                [](const auto &checkpoint, size_t index) {
+                                    return checkpoint.first < index;
+                                });
+    for (auto it = end; it != checkpoints.end(); ++it)
+        it->first = it->first - (last - first) + relexedTokens.size();
+    begin = checkpoints.erase(begin, end);
+
+    auto next = begin == checkpoints.end() ? tokens.size() : begin->first;
+    auto previous = begin[-1].first;
+    auto state = begin[-1].second;
+    std::vector<std::pair<size_t, LexerState>> filled;
+    for (auto i = previous; i < next;) {
+        state.advance(tokens.kind(i++));
+        if (i - previous == checkpointInterval && i < next) {
+            filled.emplace_back(i, state);
+            previous = i;
+        }
+    }
+    checkpoints.insert(begin, std::make_move_iterator(filled.begin()),
+                       std::make_move_iterator(filled.end()));
+}
+
+// This is the implementation of the method to splice the diagnostics. They are
+// in the order of their tokens, so those of the re-lexed tokens are a single
+// range.
+auto IncrementalLexer::spliceDiagnostics(size_t first, size_t last,
+                                         uintptr_t oldText, size_t oldSize,
+                                         uint32_t removedEnd,
+                                         int64_t offsetDelta) -> void {
+    auto begin = std::lower_bound(diagnosticTokens.begin(),
+                                  diagnosticTokens.end(), first) -
+                 diagnosticTokens.begin();
+    auto end = std::lower_bound(diagnosticTokens.begin() + begin,
+                                diagnosticTokens.end(), last) -
+               diagnosticTokens.begin();
+    auto tokenDelta = relexedTokens.size() - (last - first);
+    for (auto i = static_cast<size_t>(end); i < diagnostics.size(); ++i) {
+        diagnostics[i].offset =
+            static_cast<uint32_t>(diagnostics[i].offset + offsetDelta);
+        diagnosticTokens[i] += tokenDelta;
+    }
+    diagnostics.erase(diagnostics.begin() + begin, diagnostics.begin() + end);
+    diagnosticTokens.erase(diagnosticTokens.begin() + begin,
+                           diagnosticTokens.begin() + end);
+
+    // The arguments that quote the old text are moved to the same bytes in
+    // the new one. The tokens that are kept do not overlap the removed text.
+    for (auto &diagnostic : diagnostics) {
+        for (unsigned i = 0; i < diagnostic.argCount; ++i) {
+            auto &arg = diagnostic.args[i];
+            auto position = reinterpret_cast<uintptr_t>(arg.data()) - oldText;
+            if (position > oldSize)
+                continue;
+            if (position >= removedEnd)
+                position += offsetDelta;
+            arg = {text.data() + position, arg.size()};
+        }
+    }
+
+    diagnostics.insert(diagnostics.begin() + begin, relexedDiagnostics.begin(),
+                       relexedDiagnostics.end());
+    diagnosticTokens.insert(diagnosticTokens.begin() + begin,
+                            relexedDiagnosticTokens.begin(),
+                            relexedDiagnosticTokens.end());
+}
+} // namespace ntsc
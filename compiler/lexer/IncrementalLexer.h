@@ -0,0 +1,136 @@
+#ifndef NTSC_INCREMENTALLEXER_H
+#define NTSC_INCREMENTALLEXER_H
+#include "Diagnostics.h"
+#include "IdentifierTable.h"
+#include "Lexer.h"
+#include "SourceFile.h"
+#include "TokenBuffer.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+    This file defines the IncrementalLexer interface. It owns the text and the
+    token stream of a document that is being edited, such as a file open in an
+    editor, and only re-lexes the tokens around each edit.
+*/
+
+namespace ntsc {
+// This struct describes how the token stream changed after an edit. The tokens
+// in [first, first + removedCount) of the old stream were replaced by the
+// tokens in [first, first + insertedCount) of the new one. The tokens after
+// them are unchanged apart from their offsets.
+struct TokenStreamEdit {
+    size_t first;
+    size_t removedCount;
+    size_t insertedCount;
+};
+
+class IncrementalLexer {
+    // This is the current text of the document. A std::string always keeps a
+    // null character after its last byte, which the Lexer relies on.
+    std::string text;
+
+    // This is the view of the current text that the Lexer scans. It keeps the
+    // path and handle of the original file, so diagnostics are reported
+    // against the same handle. It is updated after every edit, which keeps its
+    // line table and what it knows of the validity of the text.
+    std::unique_ptr<SourceFile> file;
+
+    // This is a private engine that the Lexer reports to, so the diagnostics
+    // of each token can be told apart. This is the number of errors that it
+    // had reported when its diagnostics were last taken.
+    DiagnosticsEngine diags;
+    size_t takenErrorCount = 0;
+
+    IdentifierTable &identifiers;
+
+    // These are the diagnostics of the current text in the order they were
+    // reported, and the index of the token that the Lexer was scanning when
+    // it reported each of them. A diagnostic may lie at the end of its token,
+    // where the next token starts, so its offset alone does not tell which
+    // token it belongs to.
+    std::vector<Diagnostic> diagnostics;
+    std::vector<size_t> diagnosticTokens;
+
+    // This is the token stream of the current text.
+    TokenBuffer tokens;
+
+    // These are the states of the Lexer before some of the tokens, sorted by
+    // the index of the token. The first is before the first token, and no
+    // token is more than checkpointInterval tokens past the last one before
+    // it, so the state before any token is rebuilt by replaying a bounded
+    // number of kinds.
+    std::vector<std::pair<size_t, LexerState>> checkpoints;
+    static constexpr size_t checkpointInterval = 256;
+
+    // This buffer holds the re-lexed tokens of an edit until they are spliced
+    // into the stream. It is kept to reuse its memory.
+    TokenBuffer relexedTokens;
+
+    // These buffers hold the re-lexed diagnostics of an edit until they are
+    // spliced into the list. They are kept to reuse their memory.
+    std::vector<Diagnostic> relexedDiagnostics;
+    std::vector<size_t> relexedDiagnosticTokens;
+
+    // This method will lex the next token into the buffer, and append the
+    // diagnostics that the Lexer reported for it, with the index that the
+    // token has in the stream. It returns false after the end of the file.
+    auto lexToken(Lexer &lexer, TokenBuffer &buffer, size_t index,
+                  std::vector<Diagnostic> &tokenDiagnostics,
+                  std::vector<size_t> &tokenIndices) -> bool;
+
+    // This method will rebuild the state of the Lexer before the token at the
+    // given index, from the checkpoint before it.
+    [[nodiscard]] auto getStateBefore(size_t index) const -> LexerState;
+
+    // This method will update the checkpoints after the old tokens in
+    // [first, last) were replaced by the re-lexed ones. Those in the replaced
+    // range are dropped, those after it are moved, and the gap between them is
+    // filled again.
+    auto spliceCheckpoints(size_t first, size_t last) -> void;
+
+    // This method will replace the diagnostics of the old tokens in
+    // [first, last) with the re-lexed ones, and move those after them. The
+    // arguments that point into the old text are moved into the new one.
+    auto spliceDiagnostics(size_t first, size_t last, uintptr_t oldText,
+                           size_t oldSize, uint32_t removedEnd,
+                           int64_t offsetDelta) -> void;
+
+  public:
+    // This constructor will copy the text of the given file and lex it in
+    // full. The SourceManager is the one that owns the file.
+    IncrementalLexer(const SourceFile &source,
+                     const SourceManager &sourceManager,
+                     IdentifierTable &identifiers);
+
+    // This method will replace removedLength bytes at the given offset with
+    // the inserted text, and update the token stream and its diagnostics. The
+    // diagnostics of the re-lexed tokens are replaced, and those after them
+    // are moved along with their tokens.
+    auto applyEdit(uint32_t offset, uint32_t removedLength,
+                   llvm::StringRef insertedText) -> TokenStreamEdit;
+
+    // These methods will return the current text and token stream.
+    [[nodiscard]] inline auto getFile() const -> const SourceFile & {
+        return *file;
+    }
+    [[nodiscard]] inline auto getTokens() const -> const TokenBuffer & {
+        return tokens;
+    }
+
+    // This method will return the diagnostics of the current text, in the
+    // order they were reported. Their arguments point into the text, so they
+    // are only valid until the next edit.
+    [[nodiscard]] inline auto getDiagnostics() const
+        -> llvm::ArrayRef<Diagnostic> {
+        return diagnostics;
+    }
+};
+} // namespace ntsc
+
+#endif
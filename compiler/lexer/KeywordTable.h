@@ -0,0 +1,101 @@
+#ifndef NTSC_KEYWORDTABLE_H
+#define NTSC_KEYWORDTABLE_H
+#include "Token.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/*
+    This file defines the perfect hash table used by the Lexer to recognize
+    keywords. The table is built at compile time from TokenKinds.def, and a
+    static_assert guarantees that no two keywords share a slot, so every lookup
+    is a single probe followed by a single comparison.
+*/
+
+namespace ntsc {
+namespace keywords {
+// This struct describes a single keyword.
+struct Keyword {
+    const char *spelling;
+    size_t length;
+    TokenKind kind;
+};
+
+// This is the list of every reserved and contextual keyword.
+constexpr Keyword list[] = {
+#define KEYWORD(name, spelling)                                                \
+    {spelling, sizeof(spelling) - 1, TokenKind::name},
+#include "TokenKinds.def"
+};
+constexpr size_t count = sizeof(list) / sizeof(list[0]);
+
+// These are the shortest and longest keywords. Identifiers outside of this
+// range are never looked up.
+constexpr size_t minLength = 2, maxLength = 11;
+
+// The hash mixes the first two characters, the last character and the length
+// into one word, and takes the top bits of its product with an odd constant.
+// The multiplier was found by a brute force search. If a new keyword causes a
+// collision, the static_assert below will fail and a new multiplier must be
+// chosen.
+constexpr uint32_t hashMultiplier = 0x9be3cecb;
+constexpr unsigned hashBits = 9;
+constexpr size_t tableSize = size_t{1} << hashBits;
+
+// This function will compute the slot of a word with at least two characters.
+[[nodiscard]] constexpr auto hash(const char *ptr, size_t length) -> uint32_t {
+    auto key = uint32_t{static_cast<uint8_t>(ptr[0])} |
+               uint32_t{static_cast<uint8_t>(ptr[1])} << 8 |
+               uint32_t{static_cast<uint8_t>(ptr[length - 1])} << 16 |
+               static_cast<uint32_t>(length) << 24;
+    return (key * hashMultiplier) >> (32 - hashBits);
+}
+
+// This function will build the table. Each slot holds the index of a keyword
+// in the list plus one, and 0 marks an empty slot.
+[[nodiscard]] constexpr auto buildTable() -> std::array<uint8_t, tableSize> {
+    std::array<uint8_t, tableSize> table{};
+    for (size_t i = 0; i < count; ++i)
+        table[hash(list[i].spelling, list[i].length)] =
+            static_cast<uint8_t>(i + 1);
+    return table;
+}
+
+constexpr auto table = buildTable();
+
+// This function will check that every keyword can be found in its own slot,
+// and that the length bounds hold for every keyword.
+[[nodiscard]] constexpr auto isPerfect() -> bool {
+    for (size_t i = 0; i < count; ++i) {
+        if (list[i].length < minLength || list[i].length > maxLength)
+            return false;
+        if (table[hash(list[i].spelling, list[i].length)] != i + 1)
+            return false;
+    }
+    return true;
+}
+
+static_assert(count < 255, "the keyword table uses 8 bit slots");
+static_assert(isPerfect(), "the keyword hash has a collision");
+
+// This function will return the kind of the given ASCII word, which is either
+// a keyword or an identifier.
+[[nodiscard]] inline auto lookup(const char *ptr, size_t length) -> TokenKind {
+    if (length < minLength || length > maxLength)
+        return TokenKind::Identifier;
+
+    auto slot = table[hash(ptr, length)];
+    if (slot == 0)
+        return TokenKind::Identifier;
+
+    auto &keyword = list[slot - 1];
+    return keyword.length == length &&
+                   std::memcmp(keyword.spelling, ptr, length) == 0
+               ? keyword.kind
+               : TokenKind::Identifier;
+}
+} // namespace keywords
+} // namespace ntsc
+
+#endif
@@ -1,70 +1,293 @@
 #include "Lexer.h"
+#include "FastScan.h"
+#include "KeywordTable.h"
+#include "LexerStatistics.h"
+#include "PunctuatorTable.h"
 #include "Token.h"
+#include "UnicodeCharSets.h"
 #include "UserOpts.h"
 #include "llvm/Support/ConvertUTF.h"
-#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
 
 /*
     This file implements the Lexer interface for scanning TypeScript Source
    Files.
 */
 
-// This Macro Function will be used to inline UTF8 decoding.
+// This Macro Function will be used to inline checked UTF8 decoding. It is only
+// used for text after an invalid sequence, which is the slow path counted for
+// --stats.
 #define decodeUTF8(x, y, z)                                                    \
-    (llvm::convertUTF8Sequence((const llvm::UTF8 **)&x, (const llvm::UTF8 *)y, \
-                               z, llvm::strictConversion))
+    (NTSC_STAT(++lexstats::threadCounters.slowDecodes, )                       \
+         llvm::convertUTF8Sequence((const llvm::UTF8 **)&x,                    \
+                                   (const llvm::UTF8 *)y, z,                   \
+                                   llvm::strictConversion))
 
 // This Macro Function will be used to check whether a given CodePoint is a line
 // terminator.
 #define isUnicodeLT(x) (x == 0x2028 || x == 0x2029)
 
+// This Macro Function will be used to check whether valid UTF-8 text at a
+// pointer begins with a line terminator, which is E2 80 A8 or E2 80 A9.
+#define isUnicodeLTSequence(x)                                                 \
+    (x[0] == '\xe2' && x[1] == '\x80' && (x[2] == '\xa8' || x[2] == '\xa9'))
+
+// This Macro Function will be used to convert pointer differences to sizes.
+#define SIZE_T(x) (static_cast<size_t>(x))
+
+#define isDigit(x) ((static_cast<uint32_t>(x) - '0') < 10)
+#define isOctalDigit(x) ((static_cast<uint32_t>(x) - '0') < 8)
+#define isBinaryDigit(x) (x == '0' || x == '1')
+
+// This Macro Function will be used to find the value of a Hex Digit.
+#define hexDigitValue(x)                                                       \
+    (static_cast<unsigned>(x <= '9' ? x - '0' : (x | 0x20) - 'a' + 10))
+
 namespace ntsc {
+// This table classifies bytes for identifier scanning. Bit 0 marks the ASCII
+// characters that may begin an identifier, and bit 1 marks the ASCII
+// characters that may continue one. Non-ASCII bytes are always 0, so they fall
+// back to UTF-8 decoding.
+static constexpr auto identifierTable = [] {
+    std::array<uint8_t, 256> table{};
+    for (auto c = 'a'; c <= 'z'; ++c)
+        table[static_cast<uint8_t>(c)] = 3;
+    for (auto c = 'A'; c <= 'Z'; ++c)
+        table[static_cast<uint8_t>(c)] = 3;
+    for (auto c = '0'; c <= '9'; ++c)
+        table[static_cast<uint8_t>(c)] = 2;
+    table['$'] = table['_'] = 3;
+    return table;
+}();
+
+// This function will determine whether the given ASCII character may continue
+// an identifier.
+[[nodiscard]] static inline auto isIdentifierPart(char c) -> bool {
+    return identifierTable[static_cast<uint8_t>(c)] & 2;
+}
+
+// These are the classes of the first byte of a token. The DFA dispatches on the
+// class of a byte instead of the byte itself, so the switch compiles to one
+// small, dense jump table, and every punctuator shares a single case.
+enum class CharClass : uint8_t {
+    Invalid,
+    Null,
+    LineFeed,
+    CarriageReturn,
+    Whitespace,
+    Punctuator,
+    Dot,
+    Slash,
+    Zero,
+    Digit,
+    Quote,
+    Backtick,
+    RightCurly,
+    IdentifierStart,
+    NonAscii
+};
+
+// This table holds the class of every byte. The punctuators are taken from the
+// first characters of the punctuator trie, and '.' and '/' are given their own
+// classes since they may also begin a literal or a comment. '}' may continue a
+// template literal, so it has its own class too.
+static constexpr auto charClasses = [] {
+    std::array<CharClass, 256> table{};
+    for (size_t c = 0; c < 256; ++c) {
+        auto column = punctuators::columns[c];
+        if (column != 0 && punctuators::trie.next[0][column - 1] != 0)
+            table[c] = CharClass::Punctuator;
+        if (identifierTable[c] & 1)
+            table[c] = CharClass::IdentifierStart;
+        if (c >= 0x80)
+            table[c] = CharClass::NonAscii;
+    }
+    for (auto c = '1'; c <= '9'; ++c)
+        table[static_cast<uint8_t>(c)] = CharClass::Digit;
+    table[0] = CharClass::Null;
+    table['\n'] = CharClass::LineFeed;
+    table['\r'] = CharClass::CarriageReturn;
+    table['\t'] = table['\v'] = table['\f'] = table[' '] =
+        CharClass::Whitespace;
+    table['.'] = CharClass::Dot;
+    table['/'] = CharClass::Slash;
+    table['0'] = CharClass::Zero;
+    table['"'] = table['\''] = CharClass::Quote;
+    table['`'] = CharClass::Backtick;
+    table['}'] = CharClass::RightCurly;
+    return table;
+}();
+
+// This table marks the kinds of tokens that may end an expression. A slash
+// after one of them is a division, and after any other token it begins a
+// regular expression literal. Contextual keywords are nearly always
+// identifiers, so they are treated like them. A right parenthesis that
+// closes the head of an if, for, while or with statement is told apart by
+// the LexerState.
+static constexpr auto endsExpression = [] {
+    std::array<bool, 256> table{};
+#define CONTEXTUAL_KEYWORD(name, spelling)                                     \
+    table[static_cast<uint8_t>(TokenKind::name)] = true;
+#define LITERAL(name) table[static_cast<uint8_t>(TokenKind::name)] = true;
+#include "TokenKinds.def"
+    for (auto kind :
+         {TokenKind::Identifier, TokenKind::RightParenthasis,
+          TokenKind::RightSquare, TokenKind::RightCurly, TokenKind::PlusPlus,
+          TokenKind::MinusMinus, TokenKind::ThisKeyword,
+          TokenKind::SuperKeyword, TokenKind::TrueKeyword,
+          TokenKind::FalseKeyword, TokenKind::NullKeyword})
+        table[static_cast<uint8_t>(kind)] = true;
+
+    // A template substitution begins an expression.
+    table[static_cast<uint8_t>(TokenKind::TemplateHead)] = false;
+    table[static_cast<uint8_t>(TokenKind::TemplateMiddle)] = false;
+    return table;
+}();
+
+// These are the sets of non-ASCII code points that may begin or continue an
+// identifier.
+static const llvm::sys::UnicodeCharSet identifierStartSet{
+    identifierStartRanges};
+static const llvm::sys::UnicodeCharSet identifierContinueSet{
+    identifierContinueRanges};
+
+// This function will determine whether the given non-ASCII code point is
+// whitespace according to the TypeScript standard. These are U+00A0, U+FEFF
+// and the space separators.
+[[nodiscard]] static inline auto isUnicodeWhitespace(llvm::UTF32 cp) -> bool {
+    return cp == 0xa0 || cp == 0xfeff || cp == 0x1680 ||
+           (cp >= 0x2000 && cp <= 0x200a) || cp == 0x202f || cp == 0x205f ||
+           cp == 0x3000;
+}
+
+// This function will decode a non-ASCII character that is known to be valid
+// UTF-8 and move the pointer past it. The length of the sequence only depends
+// on the high nibble of its lead byte, and the continuation bytes are not
+// checked.
+[[nodiscard]] static inline auto decodeValidUTF8(char *&ptr) -> llvm::UTF32 {
+    auto *bytes = reinterpret_cast<const uint8_t *>(ptr);
+    auto lead = static_cast<llvm::UTF32>(bytes[0]);
+    switch (lead >> 4) {
+    case 0xf:
+        ptr += 4;
+        return (lead & 0x07) << 18 | (bytes[1] & 0x3fu) << 12 |
+               (bytes[2] & 0x3fu) << 6 | (bytes[3] & 0x3fu);
+    case 0xe:
+        ptr += 3;
+        return (lead & 0x0f) << 12 | (bytes[1] & 0x3fu) << 6 |
+               (bytes[2] & 0x3fu);
+    default:
+        ptr += 2;
+        return (lead & 0x1f) << 6 | (bytes[1] & 0x3fu);
+    }
+}
+
+// This function will append the UTF-8 encoding of a code point to the cooked
+// value of a string. Strings are sequences of UTF-16 code units, so a lone
+// surrogate is encoded on its own, as WTF-8 does, instead of being rejected.
+static auto appendCodePoint(llvm::SmallVectorImpl<char> &out, uint32_t cp)
+    -> void {
+    if (cp < 0x80) {
+        out.push_back(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+        out.push_back(static_cast<char>(0xc0 | cp >> 6));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+    } else if (cp < 0x10000) {
+        out.push_back(static_cast<char>(0xe0 | cp >> 12));
+        out.push_back(static_cast<char>(0x80 | (cp >> 6 & 0x3f)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+    } else {
+        out.push_back(static_cast<char>(0xf0 | cp >> 18));
+        out.push_back(static_cast<char>(0x80 | (cp >> 12 & 0x3f)));
+        out.push_back(static_cast<char>(0x80 | (cp >> 6 & 0x3f)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+    }
+}
+
 // This is the implementation of the primary constructor.
-Lexer::Lexer(const char *bufPtr, const char *endPtr, llvm::StringRef filePath)
-    : bufPtr{bufPtr}, endPtr{endPtr}, filePath{filePath} {
-    // Here, we must check for the UTF-8 BOM.
-    // If it exists, we will remove it.
-    ptr = const_cast<char *>(llvm::StringRef{bufPtr}.startswith("\xef\xbb\xbf")
-                                 ? bufPtr + 3
-                                 : bufPtr);
+Lexer::Lexer(const SourceFile &file, DiagnosticsEngine &diags,
+             IdentifierTable &identifiers)
+    : Lexer{file, diags, identifiers, 0} {}
+
+// This is the implementation of the constructor that resumes at an offset. The
+// BOM is only skipped at the start of the file, and only its three bytes are
+// read, so resuming costs nothing that grows with the file.
+Lexer::Lexer(const SourceFile &file, DiagnosticsEngine &diags,
+             IdentifierTable &identifiers, uint32_t startOffset,
+             LexerState state)
+    : bufPtr{file.getBufferStart()}, endPtr{file.getBufferEnd()},
+      validUTF8End{file.getValidUTF8End()}, file{file}, diags{diags},
+      identifiers{identifiers}, state{std::move(state)} {
+    ptr = const_cast<char *>(bufPtr + startOffset);
+    if (startOffset == 0 &&
+        llvm::StringRef{bufPtr, static_cast<size_t>(endPtr - bufPtr)}
+            .startswith("\xef\xbb\xbf"))
+        ptr += 3;
+}
+
+// This is the implementation of the method to record a diagnostic. Only the
+// offset is recorded, so the line and column are not computed unless the
+// diagnostic is rendered.
+auto Lexer::report(DiagID id, const char *at,
+                   std::initializer_list<llvm::StringRef> args) -> void {
+    diags.report(id, file.getID(), static_cast<uint32_t>(at - bufPtr), args);
+    lexerFailed = true;
 }
 
 // This is the implementation of the inline method that diagnoses errors related
 // to unexpected null characters in the source file. It will also update the
 // Lexer's tracker for error recovery and move to the next character.
 auto Lexer::diagnoseUnexpectedNull() -> void {
-    llvm::errs() << llvm::raw_ostream::Colors::RED
-                 << "error: " << llvm::raw_ostream::Colors::WHITE << filePath
-                 << ": " << line << ":" << col
-                 << ": unexpected null character in source\n";
-    lexerFailed = true;
-    ++line;
-    ++col;
+    report(DiagID::err_unexpected_null, ptr);
+    ++ptr;
+}
+
+// This is the implementation of the method to decode a character. Files are
+// almost always valid, so the check against the end of the valid text is the
+// only branch that most characters take.
+auto Lexer::decodeCharacter(llvm::UTF32 &cp) -> bool {
+    if (LLVM_UNLIKELY(ptr >= validUTF8End))
+        return decodeUTF8(ptr, endPtr, &cp) == llvm::conversionOK;
+    cp = decodeValidUTF8(ptr);
+    return true;
 }
 
 // This is the implementation of the function to diagnose UTF-8 sequence errors.
 // It will update the lexer's tracker for error recovery. We will also skip the
-// current character.
+// current character. The text after it is validated again, so that one bad
+// byte does not send the rest of the file down the slow path.
 auto Lexer::diagnoseInvalidUTF8() -> void {
-    llvm::errs() << llvm::raw_ostream::Colors::RED
-                 << "error: " << llvm::raw_ostream::Colors::WHITE << filePath
-                 << ": " << line << ":" << col
-                 << ": invalid UTF-8 byte sequence\n";
-    lexerFailed = true;
+    report(DiagID::err_invalid_utf8, ptr);
     ++ptr;
-    // In this case, we will not increment the column because there is no
-    // character!
+    validUTF8End = scanKernels.findInvalidUTF8(ptr, endPtr);
+}
+
+// This is the implementation of the function to diagnose characters that cannot
+// begin a token. Non-ASCII characters will be decoded so that the entire
+// sequence is skipped.
+auto Lexer::diagnoseInvalidCharacter() -> void {
+    auto *charStart = ptr;
+    if (isAscii(ptr[0])) {
+        ++ptr;
+    } else {
+        llvm::UTF32 cp;
+        if (!decodeCharacter(cp)) {
+            diagnoseInvalidUTF8();
+            return;
+        }
+    }
+
+    report(DiagID::err_invalid_character, charStart,
+           {{charStart, SIZE_T(ptr - charStart)}});
 }
 
 // This is the implementation of the function to diagnose lexical errors when a
 // numeric separator is not followed by a valid digit.
 auto Lexer::diagnoseInvalidNumericSeparator() -> void {
-    llvm::errs() << llvm::raw_ostream::Colors::RED
-                 << "error: " << llvm::raw_ostream::Colors::WHITE << filePath
-                 << ": " << line << ":" << ++col
-                 << ": expected digit after numeric separator but found '"
-                 << ptr[0] << "' instead\n";
-    lexerFailed = true;
+    // The pointer is at the separator, so the error is at the next character.
+    report(DiagID::err_invalid_numeric_separator, ptr + 1, {{ptr + 1, 1}});
 
     // We don't need to move the pointer forward here.
 }
@@ -73,12 +296,7 @@ auto Lexer::diagnoseInvalidNumericSeparator() -> void {
 // Numeric Base specifier is not followed by a valid digit from that base.
 auto Lexer::diagnoseMalformedRadixInt(const char type[], const char prefix[])
     -> void {
-    llvm::errs() << llvm::raw_ostream::Colors::RED
-                 << "error: " << llvm::raw_ostream::Colors::WHITE << filePath
-                 << ": " << line << ":" << col << ": expected " << type
-                 << " digit after prefix '" << prefix << "' but found '"
-                 << ptr[0] << "' instead\n";
-    lexerFailed = true;
+    report(DiagID::err_malformed_radix_int, ptr, {type, prefix, {ptr, 1}});
 
     // Since this is the end of the literal, we don't need to move the pointer
     // forward.
@@ -89,25 +307,38 @@ auto Lexer::diagnoseMalformedRadixInt(const char type[], const char prefix[])
 // Since most code is unlikely to use Unicode codepoints, we will optimize the
 // Lexer for ASCII and treat unicode as a special case rather than integrating
 // UTF-8 decoding throughout.
-auto Lexer::lexToken(Token &tok) -> void {
+auto Lexer::scanToken(Token &tok) -> void {
     // Since TypeScript allows Semicolon Insertion, we need to keep track of
     // whether the current token is preceded by a valid line terminator.
     bool afterLineTerminator = false;
+    // The payloads are reset here, so that placeholder tokens and the zero
+    // literals always hold a value of zero.
+    tok.symbol = Symbol{};
+    tok.intValue = 0;
+    tok.isFloatValue = false;
+    tok.bigIntLimbs = {};
+    tok.value = {};
 beginLexer:
-    // First, we must skip all horizontal whitespace.
-    while (isHorizontalWhitespace(ptr[0])) {
-        ++col;
-        ++ptr;
+    // First, we must skip all horizontal whitespace. Most tokens are separated
+    // by a single space, so only longer runs such as indentation are handed to
+    // the scanning kernel.
+    if (isHorizontalWhitespace(ptr[0])) {
+        auto *whitespaceEnd =
+            isHorizontalWhitespace(ptr[1])
+                ? scanKernels.skipHorizontalWhitespace(ptr + 2, endPtr)
+                : ptr + 1;
+        ptr = const_cast<char *>(whitespaceEnd);
     }
 
     // Now that we have removed horizontal whitespace, we can start simulating
     // the DFA for the Lexer. Line terminators will also be part of this DFA.
-    switch (ptr[0]) {
+    tokenStart = ptr;
+    switch (charClasses[static_cast<uint8_t>(ptr[0])]) {
     // First, we will handle potential EOFs.
-    case 0:
+    case CharClass::Null:
         // We need to check if this is really the end of the file.
         if (ptr == endPtr) {
-            tok.set(TokenKind::FileEnd, line, col, afterLineTerminator);
+            tok.set(TokenKind::FileEnd, tokenOffset(), afterLineTerminator);
             return;
         }
 
@@ -117,15 +348,11 @@ beginLexer:
         goto beginLexer;
 
     // Next, we will handle line terminators.
-    case '\n':
-        ++line;
-        col = 1;
+    case CharClass::LineFeed:
         ++ptr;
         afterLineTerminator = true;
         goto beginLexer;
-    case '\r':
-        ++line;
-        col = 1;
+    case CharClass::CarriageReturn:
         afterLineTerminator = true;
         // According to the TypeScript standard, \r\n should be treated as a
         // single line terminator.
@@ -135,242 +362,21 @@ beginLexer:
             ++ptr;
         goto beginLexer;
 
-    // Here, we will handle punctuators
-    case '{':
-        tok.set(TokenKind::LeftCurly, line, col++, afterLineTerminator);
-        ++ptr;
-        return;
-    case '}':
-        tok.set(TokenKind::RightCurly, line, col++, afterLineTerminator);
-        ++ptr;
-        return;
-    case '(':
-        tok.set(TokenKind::LeftParenthasis, line, col++, afterLineTerminator);
-        ++ptr;
-        return;
-    case ')':
-        tok.set(TokenKind::RightParenthasis, line, col++, afterLineTerminator);
-        ++ptr;
-        return;
-    case '[':
-        tok.set(TokenKind::LeftSquare, line, col++, afterLineTerminator);
-        ++ptr;
-        return;
-    case ']':
-        tok.set(TokenKind::RightSquare, line, col++, afterLineTerminator);
-        ++ptr;
-        return;
-    case ';':
-        tok.set(TokenKind::Semicolon, line, col++, afterLineTerminator);
-        ++ptr;
-        return;
-    case ',':
-        tok.set(TokenKind::Comma, line, col++, afterLineTerminator);
-        ++ptr;
-        return;
-    case ':':
-        tok.set(TokenKind::Colon, line, col++, afterLineTerminator);
-        ++ptr;
-        return;
-    case '.':
-        // If we encounter only two dots, we must treat it as 2 separate tokens.
-        if (ptr[1] == '.' && ptr[2] == '.') {
-            tok.set(TokenKind::DotDotDot, line, col, afterLineTerminator);
-            ptr += 3;
-            col += 3;
-            return;
-        }
-
-        tok.set(TokenKind::Dot, line, col++, afterLineTerminator);
-        ++ptr;
-        return;
-    case '<':
-        if (ptr[1] == '=') {
-            tok.set(TokenKind::LessEquals, line, col, afterLineTerminator);
-            ptr += 2;
-            col += 2;
-            return;
-        }
-        if (ptr[1] == '<') {
-            if (ptr[2] == '=') {
-                tok.set(TokenKind::LessLessEquals, line, col,
-                        afterLineTerminator);
-                ptr += 3;
-                col += 3;
-                return;
-            }
+    // Whitespace has already been skipped, but we will handle it here too so
+    // that every class has a case.
+    case CharClass::Whitespace:
+        goto beginLexer;
 
-            tok.set(TokenKind::LessLess, line, col, afterLineTerminator);
-            col += 2;
-            ptr += 2;
-            return;
-        }
+    // Here, we will handle comments and punctuators. A slash may begin a
+    // comment, and a floating point followed by a digit begins a Float
+    // literal. Otherwise, both are scanned like every other punctuator.
+    case CharClass::Slash:
         if (ptr[1] == '/') {
-            tok.set(TokenKind::LessSlash, line, col, afterLineTerminator);
-            ptr += 2;
-            col += 2;
-            return;
-        }
-
-        tok.set(TokenKind::Less, line, col++, afterLineTerminator);
-        ++ptr;
-        return;
-    case '>':
-        if (ptr[1] == '=') {
-            tok.set(TokenKind::GreaterEquals, line, col, afterLineTerminator);
-            ptr += 2;
-            col += 2;
-            return;
-        }
-        if (ptr[1] == '>') {
-            if (ptr[2] == '>') {
-                if (ptr[3] == '=') {
-                    tok.set(TokenKind::GreaterGreaterGreaterEquals, line, col,
-                            afterLineTerminator);
-                    ptr += 4;
-                    col += 4;
-                    return;
-                }
-
-                tok.set(TokenKind::GreaterGreaterGreater, line, col,
-                        afterLineTerminator);
-                ptr += 3;
-                col += 3;
-                return;
-            }
-            if (ptr[2] == '=') {
-                tok.set(TokenKind::GreaterGreaterEquals, line, col,
-                        afterLineTerminator);
-                ptr += 3;
-                col += 3;
-                return;
-            }
-
-            tok.set(TokenKind::GreaterGreater, line, col, afterLineTerminator);
-            ptr += 2;
-            col += 2;
-            return;
-        }
-
-        tok.set(TokenKind::Greater, line, col++, afterLineTerminator);
-        ++ptr;
-        return;
-    case '=':
-        if (ptr[1] == '=') {
-            if (ptr[2] == '=') {
-                tok.set(TokenKind::EqualsEqualsEquals, line, col,
-                        afterLineTerminator);
-                ptr += 3;
-                col += 3;
-                return;
-            }
-
-            tok.set(TokenKind::EqualsEquals, line, col, afterLineTerminator);
-            ptr += 2;
-            col += 2;
-            return;
-        }
-        if (ptr[1] == '>') {
-            tok.set(TokenKind::EqualsGreater, line, col, afterLineTerminator);
-            ptr += 2;
-            col += 2;
-            return;
-        }
-
-        tok.set(TokenKind::Equals, line, col++, afterLineTerminator);
-        ++ptr;
-        return;
-    case '!':
-        if (ptr[1] == '=') {
-            if (ptr[2] == '=') {
-                tok.set(TokenKind::ExclaimationEqualsEquals, line, col,
-                        afterLineTerminator);
-                ptr += 3;
-                col += 3;
-                return;
-            }
-
-            tok.set(TokenKind::ExclaimationEquals, line, col,
-                    afterLineTerminator);
-            ptr += 2;
-            col += 2;
-            return;
-        }
-
-        tok.set(TokenKind::Exclaimation, line, col++, afterLineTerminator);
-        ++ptr;
-        return;
-
-    case '+':
-        if (ptr[1] == '+') {
-            tok.set(TokenKind::PlusPlus, line, col, afterLineTerminator);
-            ptr += 2;
-            col += 2;
-            return;
-        }
-        if (ptr[1] == '=') {
-            tok.set(TokenKind::PlusEquals, line, col, afterLineTerminator);
-            ptr += 2;
-            col += 2;
-            return;
-        }
-
-        tok.set(TokenKind::Plus, line, col++, afterLineTerminator);
-        ++ptr;
-        return;
-    case '-':
-        if (ptr[1] == '-') {
-            tok.set(TokenKind::MinusMinus, line, col, afterLineTerminator);
-            ptr += 2;
-            col += 2;
-            return;
-        }
-        if (ptr[1] == '=') {
-            tok.set(TokenKind::MinusEquals, line, col, afterLineTerminator);
-            ptr += 2;
-            col += 2;
-            return;
-        }
-
-        tok.set(TokenKind::Minus, line, col++, afterLineTerminator);
-        ++ptr;
-        return;
-    case '*':
-        if (ptr[1] == '*') {
-            if (ptr[2] == '=') {
-                tok.set(TokenKind::AsteriskAsteriskEquals, line, col,
-                        afterLineTerminator);
-                ptr += 3;
-                col += 3;
-                return;
-            }
-
-            tok.set(TokenKind::AsteriskAsterisk, line, col,
-                    afterLineTerminator);
-            ptr += 2;
-            col += 2;
-            return;
-        }
-        if (ptr[1] == '=') {
-            tok.set(TokenKind::AsteriskEquals, line, col, afterLineTerminator);
-            ptr += 2;
-            col += 2;
-            return;
-        }
-
-        tok.set(TokenKind::Asterisk, line, col++, afterLineTerminator);
-        ++ptr;
-        return;
-    case '/':
-        switch (ptr[1]) {
-        case '=':
-            tok.set(TokenKind::SlashEquals, line, col, afterLineTerminator);
-            ptr += 2;
-            col += 2;
-            return;
-        case '/':
             // Single Line Comment
-            if (lexSingleLineComment(tok, afterLineTerminator)) {
+            NTSC_STAT(auto commentStart = lexstats::readCycleCounter());
+            auto more = lexSingleLineComment(tok, afterLineTerminator);
+            NTSC_STAT(lexstats::recordComment(commentStart));
+            if (more) {
                 // Since Single line comments are ended by line terminators, we
                 // can automatically update afterLineTerminator.
                 afterLineTerminator = true;
@@ -378,141 +384,58 @@ beginLexer:
             }
 
             return;
-        case '*':
+        }
+        if (ptr[1] == '*') {
             // Multi Line Comment
-            if (lexMultiLineComment(tok, afterLineTerminator))
+            NTSC_STAT(auto commentStart = lexstats::readCycleCounter());
+            auto more = lexMultiLineComment(tok, afterLineTerminator);
+            NTSC_STAT(lexstats::recordComment(commentStart));
+            if (more)
                 goto beginLexer;
 
             return;
-        default:
-            tok.set(TokenKind::Slash, line, col++, afterLineTerminator);
-            ++ptr;
-            return;
-        }
-    case '%':
-        if (ptr[1] == '=') {
-            tok.set(TokenKind::PercentEquals, line, col, afterLineTerminator);
-            ptr += 2;
-            col += 2;
-            return;
-        }
-
-        tok.set(TokenKind::Percent, line, col++, afterLineTerminator);
-        ++ptr;
-        return;
-    case '&':
-        if (ptr[1] == '=') {
-            tok.set(TokenKind::AmpersandEquals, line, col, afterLineTerminator);
-            ptr += 2;
-            col += 2;
-            return;
-        }
-        if (ptr[1] == '&') {
-            if (ptr[2] == '=') {
-                tok.set(TokenKind::AmpersandAmpersandEquals, line, col,
-                        afterLineTerminator);
-                ptr += 3;
-                col += 3;
-                return;
-            }
-
-            tok.set(TokenKind::AmpersandAmpersand, line, col,
-                    afterLineTerminator);
-            ptr += 2;
-            col += 2;
-            return;
-        }
-
-        tok.set(TokenKind::Ampersand, line, col++, afterLineTerminator);
-        ++ptr;
-        return;
-    case '|':
-        if (ptr[1] == '=') {
-            tok.set(TokenKind::BarEquals, line, col, afterLineTerminator);
-            ptr += 2;
-            col += 2;
-            return;
-        }
-        if (ptr[1] == '|') {
-            if (ptr[2] == '=') {
-                tok.set(TokenKind::BarBarEquals, line, col,
-                        afterLineTerminator);
-                ptr += 3;
-                col += 3;
-                return;
-            }
-
-            tok.set(TokenKind::BarBar, line, col, afterLineTerminator);
-            ptr += 2;
-            col += 2;
-            return;
-        }
-
-        tok.set(TokenKind::Bar, line, col++, afterLineTerminator);
-        ++ptr;
-        return;
-    case '^':
-        if (ptr[1] == '=') {
-            tok.set(TokenKind::CaretEquals, line, col, afterLineTerminator);
-            ptr += 2;
-            col += 2;
-            return;
         }
-
-        tok.set(TokenKind::Caret, line, col++, afterLineTerminator);
-        ++ptr;
-        return;
-    case '~':
-        tok.set(TokenKind::Tilde, line, col++, afterLineTerminator);
-        ++ptr;
-        return;
-    case '?':
-        if (ptr[1] == '?') {
-            if (ptr[2] == '=') {
-                tok.set(TokenKind::QuestionQuestionEquals, line, col,
-                        afterLineTerminator);
-                ptr += 3;
-                col += 3;
-                return;
-            }
-
-            tok.set(TokenKind::QuestionQuestion, line, col,
-                    afterLineTerminator);
-            ptr += 2;
-            col += 2;
+        [[fallthrough]];
+    case CharClass::Dot:
+        if (ptr[0] == '.' && isDigit(ptr[1])) {
+            lexFloatLiteral(tok, ptr, IntegerAccumulator{}, afterLineTerminator);
             return;
         }
-        if (ptr[1] == '.') {
-            tok.set(TokenKind::QuestionDot, line, col, afterLineTerminator);
-            ptr += 2;
-            col += 2;
-            return;
+        [[fallthrough]];
+    case CharClass::Punctuator: {
+        // The trie finds the longest punctuator, so '..' is two dots and '>>>='
+        // is a single token. Every byte of this class begins a punctuator, so
+        // the match is never empty.
+        TokenKind kind;
+        auto length = punctuators::match(ptr, kind);
+
+        // '?.' followed by a digit is a conditional followed by a number, as
+        // in 'a?.5:b'.
+        if (kind == TokenKind::QuestionDot && isDigit(ptr[2])) {
+            kind = TokenKind::Question;
+            length = 1;
         }
-
-        tok.set(TokenKind::Question, line, col++, afterLineTerminator);
-        ++col;
+        tok.set(kind, tokenOffset(), afterLineTerminator);
+        ptr += length;
         return;
+    }
 
     // Next, we will scan literals. We will begin with numeric literals.
     // '0' is the special literal character, so it has to be dealt with
     // separately.
-    case '1':
-    case '2':
-    case '3':
-    case '4':
-    case '5':
-    case '6':
-    case '7':
-    case '8':
-    case '9':
+    case CharClass::Digit:
         lexNumericLiteral(tok, afterLineTerminator);
         return;
 
-    case '0':
+    case CharClass::Zero:
         switch (ptr[1]) {
         case '.':
+        case 'e':
+        case 'E':
             // lexFloatLiteral requires the pointer to be at the floating point
-            lexFloatLiteral(tok, ptr++, col++, afterLineTerminator);
+            // or the exponent prefix.
+            lexFloatLiteral(tok, ptr++, IntegerAccumulator{},
+                            afterLineTerminator);
             return;
         // Hex Literal
         case 'x':
@@ -534,10 +457,9 @@ beginLexer:
 
         // Zero BigInt literal
         case 'n':
-            tok.set(TokenKind::ZeroBigIntLiteral, line, col,
+            tok.set(TokenKind::ZeroBigIntLiteral, tokenOffset(),
                     afterLineTerminator);
             ptr += 2;
-            col += 2;
             return;
 
         // Legacy Octal Literals
@@ -554,19 +476,118 @@ beginLexer:
 
         default:
             // Simple Zero Literal
-            tok.set(TokenKind::ZeroLiteral, line, col, afterLineTerminator);
+            tok.set(TokenKind::ZeroLiteral, tokenOffset(), afterLineTerminator);
+            ++ptr;
             return;
         }
 
     // String literals
-    case '"':
-        lexDoubleQuoteStrLiteral(tok, afterLineTerminator);
+    case CharClass::Quote:
+        lexStringLiteral(tok, afterLineTerminator);
+        return;
+
+    // Template literals. A right brace that closes a substitution continues
+    // its template, and any other is a punctuator.
+    case CharClass::Backtick:
+        lexTemplateChunk(tok, afterLineTerminator);
+        return;
+
+    case CharClass::RightCurly:
+        if (state.isAtTemplateContinuation()) {
+            lexTemplateChunk(tok, afterLineTerminator);
+            return;
+        }
+        tok.set(TokenKind::RightCurly, tokenOffset(), afterLineTerminator);
+        ++ptr;
         return;
 
-    case '\'':
-        lexSingleQuoteStrLiteral(tok, afterLineTerminator);
+    // Identifiers and keywords
+    case CharClass::IdentifierStart:
+        ++ptr;
+        lexIdentifier(tok, afterLineTerminator);
         return;
+
+    case CharClass::NonAscii: {
+        // We must decode the character to find out what it is. Unicode line
+        // terminators and whitespace are skipped like their ASCII
+        // counterparts.
+        llvm::UTF32 cp;
+        if (!decodeCharacter(cp)) {
+            diagnoseInvalidUTF8();
+            goto beginLexer;
+        }
+        if (isUnicodeLT(cp)) {
+            afterLineTerminator = true;
+            goto beginLexer;
+        }
+        if (isUnicodeWhitespace(cp))
+            goto beginLexer;
+        if (identifierStartSet.contains(cp)) {
+            lexIdentifier(tok, afterLineTerminator);
+            return;
+        }
+
+        // The character will be decoded again when it is diagnosed.
+        ptr = const_cast<char *>(tokenStart);
+        diagnoseInvalidCharacter();
+        goto beginLexer;
+    }
+
+    // Any other character cannot begin a token, so we will diagnose it and
+    // continue with the next character.
+    case CharClass::Invalid:
+        diagnoseInvalidCharacter();
+        goto beginLexer;
+
+    // Every class has a case above, so this tells the compiler that it does
+    // not need to check the range of the jump table.
+    default:
+        LLVM_BUILTIN_UNREACHABLE;
+    }
+}
+
+// This is the implementation of the single token entry point. It will simply
+// run the DFA.
+auto Lexer::lexToken(Token &tok) -> void {
+    NTSC_STAT(auto startCycles = lexstats::readCycleCounter());
+    scanToken(tok);
+    state.advance(tok.kind);
+    NTSC_STAT(lexstats::recordToken(tok.kind, startCycles));
+    NTSC_STAT(lexstats::flushThreadCounters());
+}
+
+// This is the implementation of the batch entry point. The Token instance only
+// lives for the duration of this method, so it will be kept in registers while
+// the DFA is inlined into the loop.
+auto Lexer::lexChunk(TokenBuffer &tokens, size_t maxTokens) -> bool {
+    Token tok;
+    for (size_t i = 0; i < maxTokens; ++i) {
+        NTSC_STAT(auto startCycles = lexstats::readCycleCounter());
+        scanToken(tok);
+        if (LLVM_UNLIKELY(tok.kind == TokenKind::Slash ||
+                          tok.kind == TokenKind::SlashEquals) &&
+            (!endsExpression[static_cast<uint8_t>(state.previousKind)] ||
+             state.closedCondition))
+            rescanSlashAsRegex(tok);
+        state.advance(tok.kind);
+        NTSC_STAT(lexstats::recordToken(tok.kind, startCycles));
+        tokens.push(tok, static_cast<uint32_t>(tokenStart - bufPtr),
+                    static_cast<uint32_t>(ptr - tokenStart));
+        if (tok.kind == TokenKind::FileEnd) {
+            NTSC_STAT(lexstats::flushThreadCounters());
+            return false;
+        }
     }
+    NTSC_STAT(lexstats::flushThreadCounters());
+    return true;
+}
+
+// This is the implementation of the method to scan the entire file. Source
+// files average several bytes per token, so we can reserve a good estimate up
+// front.
+auto Lexer::lexAll(TokenBuffer &tokens) -> void {
+    tokens.reserve(tokens.size() + SIZE_T(endPtr - ptr) / 4 + 1);
+    lexChunk(tokens, SIZE_MAX);
 }
 
 // This is the implementation of the method to scan single line comments
@@ -576,15 +597,25 @@ beginLexer:
 auto Lexer::lexSingleLineComment(Token &tok, bool afterLineTerminator) -> bool {
     // First, we must consume the two slash characters.
     ptr += 2;
-    col += 2;
 
     // Now, we will consume all characters until a line terminator is found.
     while (true) {
+        // The scanning kernel will consume all other ASCII characters in bulk,
+        // so we will only see the interesting bytes here. In valid text, it
+        // only needs to stop at the lead byte of the Unicode Line Terminators,
+        // and it is cut off where the valid text ends.
+        auto *stopPtr = ptr < validUTF8End
+                            ? std::min(scanKernels.findLineBreak(ptr, endPtr),
+                                       validUTF8End)
+                            : scanKernels.skipLineComment(ptr, endPtr);
+        ptr = const_cast<char *>(stopPtr);
+
         switch (ptr[0]) {
         case 0:
             // We must check if this is really the end of the file.
             if (ptr == endPtr) {
-                tok.set(TokenKind::FileEnd, line, col, afterLineTerminator);
+                tokenStart = ptr;
+                tok.set(TokenKind::FileEnd, tokenOffset(), afterLineTerminator);
                 return false;
             }
 
@@ -594,44 +625,40 @@ auto Lexer::lexSingleLineComment(Token &tok, bool afterLineTerminator) -> bool {
 
         // Line terminators
         case '\n':
-            ++line;
-            col = 1;
             ++ptr;
             return true;
         case '\r':
-            ++line;
-            col = 1;
             if (ptr[1] == '\n')
                 ptr += 2;
             else
                 ++ptr;
             return true;
         default:
-            // If the current byte is an ASCII character, we can move past
-            // it.
-            if (isAscii(ptr[0])) {
-                ++ptr;
-                ++col;
+            // In valid text, the kernel only stops at the byte 0xE2 otherwise,
+            // which is the lead byte of a three byte sequence.
+            if (ptr < validUTF8End) {
+                auto isLineTerminator = isUnicodeLTSequence(ptr);
+                ptr += 3;
+                if (isLineTerminator)
+                    return true;
                 continue;
             }
 
+            // The kernel only stops at non-ASCII bytes otherwise, so we must
+            // decode the codepoint.
             llvm::UTF32 cp;
-            if (decodeUTF8(ptr, endPtr, &cp) != llvm::conversionOK) {
+            if (!decodeCharacter(cp)) {
                 diagnoseInvalidUTF8();
                 continue;
             }
 
             // Now that we have obtained the codepoint, we can check if it's
             // a Unicode Line Terminator.
-            if (isUnicodeLT(cp)) {
-                ++line;
-                col = 1;
+            if (isUnicodeLT(cp))
                 return true;
-            }
 
             // Otherwise, we can just continue. We have already moved the
-            // pointer forward, so we must move the column forward.
-            ++col;
+            // pointer forward.
         }
     }
 } // namespace ntsc
@@ -643,65 +670,61 @@ auto Lexer::lexMultiLineComment(Token &tok, bool &afterLineTerminator) -> bool {
     // First, we need to move the pointer forward to consume the comment
     // opening.
     ptr += 2;
-    col += 2;
 
     while (true) {
+        // The scanning kernel will consume ASCII characters and line
+        // terminators in bulk, and it will record whether it has crossed a
+        // line terminator.
+        // In valid text, the kernel does not stop at non-ASCII bytes other than
+        // 0xE2, and it is cut off where the valid text ends.
+        auto *stopPtr =
+            ptr < validUTF8End
+                ? std::min(scanKernels.skipValidBlockComment(
+                               ptr, endPtr, afterLineTerminator),
+                           validUTF8End)
+                : scanKernels.skipBlockComment(ptr, endPtr,
+                                               afterLineTerminator);
+        ptr = const_cast<char *>(stopPtr);
+
         switch (ptr[0]) {
         case '*':
             if (ptr[1] == '/') {
                 // End of the comment
                 ptr += 2;
-                col += 2;
                 return true;
             }
             // If the asterisk is not followed by a slash, we will only
             // consume the asterisk.
             ++ptr;
-            ++col;
             continue;
         case 0:
             // We must check if this is really the end of the file.
             if (ptr == endPtr) {
-                llvm::errs()
-                    << llvm::raw_ostream::Colors::RED
-                    << "error: " << llvm::raw_ostream::Colors::WHITE << filePath
-                    << ": " << line << ":" << col
-                    << ": unexpected end of file in multi line comment\n";
-                tok.set(TokenKind::FileEnd, line, col, afterLineTerminator);
+                report(DiagID::err_unterminated_block_comment, ptr);
+                tokenStart = ptr;
+                tok.set(TokenKind::FileEnd, tokenOffset(), afterLineTerminator);
                 return false;
             }
 
             // Otherwise, we can treat it like a regular null character.
-            diagnoseUnexpectedNull();
-            continue;
-        case '\n':
-            ++line;
-            col = 1;
-            ++ptr;
-            afterLineTerminator = true;
-            continue;
-        case '\r':
-            ++line;
-            col = 1;
-            afterLineTerminator = true;
-            if (ptr[1] == '\n')
-                ptr += 2;
-            else
-                ++ptr;
+            diagnoseUnexpectedNull();
             continue;
         default:
-            // If this is an ASCII character, we know for sure it's not a
-            // Unicode Line Terminator.
-            if (isAscii(ptr[0])) {
-                ++ptr;
-                ++col;
+            // In valid text, the kernel only stops at the byte 0xE2 otherwise,
+            // which is the lead byte of a three byte sequence.
+            if (ptr < validUTF8End) {
+                if (isUnicodeLTSequence(ptr))
+                    afterLineTerminator = true;
+                ptr += 3;
                 continue;
             }
 
+            // The kernel only stops at non-ASCII bytes otherwise, so we must
+            // check for Unicode Line Terminators.
             llvm::UTF32 cp;
 
             // Now, we need to try to decode the UTF-8.
-            if (decodeUTF8(ptr, endPtr, &cp) != llvm::conversionOK) {
+            if (!decodeCharacter(cp)) {
                 diagnoseInvalidUTF8();
                 continue;
             }
@@ -709,34 +732,27 @@ auto Lexer::lexMultiLineComment(Token &tok, bool &afterLineTerminator) -> bool {
             // Once we have the codepoint, we need to check if it's a line
             // terminator.
             if (isUnicodeLT(cp)) {
-                ++line;
-                col = 1;
                 afterLineTerminator = true;
                 // Since we have already moved  the pointer forward, we can
                 // just continue.
                 continue;
             }
 
-            // The Unicode Decoding has moved the pointer, so we only need
-            // to move the column.
-            ++col;
+            // The Unicode Decoding has already moved the pointer.
         }
     }
 }
 
-#define isDigit(x) ((static_cast<uint32_t>(x) - '0') < 10)
-#define isOctalDigit(x) ((static_cast<uint32_t>(x) - '0') < 8)
-#define isBinaryDigit(x) (x == '0' || x == '1')
-#define SIZE_T(x) (static_cast<size_t>(x))
-
 // This is the implementation of the method which will scan numeric literals.
 // The basic idea is to begin with simple integer literals and then if a
 // floating point is found, we will fork to a floating point literal.
 auto Lexer::lexNumericLiteral(Token &tok, bool afterLineTerminator) -> void {
     // Since we have already scanned the previous character, we can set the
-    // start pointer and column to this position and then move forward.
-    auto *startPtr = ptr++;
-    auto startCol = col++;
+    // start pointer to this position and then move forward.
+    // The value is accumulated as the digits are consumed.
+    auto *startPtr = ptr;
+    IntegerAccumulator integer;
+    integer.addDecimalDigit(*ptr++);
 
     // All digits and numeric separators (underscores) will be part of the
     // current literal.
@@ -753,8 +769,8 @@ auto Lexer::lexNumericLiteral(Token &tok, bool afterLineTerminator) -> void {
         case '7':
         case '8':
         case '9':
+            integer.addDecimalDigit(ptr[0]);
             ++ptr;
-            ++col;
             continue;
         case '_':
             // If we find a Numeric Separator, it must be followed by a digit
@@ -764,9 +780,10 @@ auto Lexer::lexNumericLiteral(Token &tok, bool afterLineTerminator) -> void {
                 // Since this is the end of the separator, we must end the
                 // literal here. The placeholder literal, however, will not
                 // contain the underscore.
-                tok.set(TokenKind::DecimalLiteral, line, startCol,
+                tok.set(TokenKind::DecimalLiteral, tokenOffset(),
                         afterLineTerminator,
                         {startPtr, SIZE_T(ptr - startPtr)});
+                setIntegerValue(tok, integer, 0);
                 // Also, we need to consume the underscore.
                 ++ptr;
                 return;
@@ -774,106 +791,149 @@ auto Lexer::lexNumericLiteral(Token &tok, bool afterLineTerminator) -> void {
 
             // If we find a digit, we can just consume both the underscore and
             // the digit.
+            integer.addDecimalDigit(ptr[1]);
             ptr += 2;
-            col += 2;
             continue;
         case 'n':
             // This is the delimeter for a BigInt literal.
-            tok.set(TokenKind::DecimalBigIntLiteral, line, startCol,
+            tok.set(TokenKind::DecimalBigIntLiteral, tokenOffset(),
                     // Here, we will actually omit the BigInt suffix from the
                     // Token lexeme to simplify the Integer parsing.
                     afterLineTerminator, {startPtr, SIZE_T(ptr - startPtr)});
+            setBigIntValue(tok, integer, 10);
             // We also need to consume the BigInt suffix.
             ++ptr;
-            ++col;
             return;
         case '.':
+        case 'e':
+        case 'E':
             // Here, we need to fork the routine to scan Floating Point
             // literals.
-            lexFloatLiteral(tok, startPtr, startCol, afterLineTerminator);
+            lexFloatLiteral(tok, startPtr, integer, afterLineTerminator);
             return;
         default:
             // For all other characters, we can simply end the integer literal.
-            tok.set(TokenKind::DecimalLiteral, line, startCol,
+            tok.set(TokenKind::DecimalLiteral, tokenOffset(),
                     afterLineTerminator, {startPtr, SIZE_T(ptr - startPtr)});
+            setIntegerValue(tok, integer, 0);
             return;
         }
     }
 }
 
 // This method is a fork from the primary lexNumericLiteral method to scan the
-// back half of floating point literals.
-auto Lexer::lexFloatLiteral(Token &tok, char *startPtr, int startCol,
+// back half of floating point literals. The significand and the exponent are
+// accumulated as the digits are consumed, and the value is converted once at
+// the end.
+auto Lexer::lexFloatLiteral(Token &tok, char *startPtr,
+                            const IntegerAccumulator &integer,
                             bool afterLineTerminator) -> void {
+    // If the integer part did not fit in 64 bits, the value will be converted
+    // from the lexeme. The exponent only needs the right sign in that case.
+    DecimalAccumulator decimal;
+    decimal.significand = integer.value;
+    if (integer.overflowed) {
+        decimal.truncated = true;
+        decimal.exponent = ptr - startPtr;
+    }
+
     // First, we must consume the floating point and all of the optional digits.
-    do {
+    if (ptr[0] == '.') {
         ++ptr;
-        ++col;
-    } while (isDigit(ptr[0]));
+        while (isDigit(ptr[0]))
+            decimal.addFractionDigit(*ptr++);
+    }
 
     // After, we need to scan the exponent portion.
     // If the current character is not an exponent prefix, we can end the
     // literal here.
-    if (ptr[0] != 'e' && ptr[0] != 'E') {
-        tok.set(TokenKind::FloatLiteral, line, startCol, afterLineTerminator,
-                {startPtr, SIZE_T(ptr - startPtr)});
-        return;
-    }
+    auto *literalEnd = ptr;
+    if (ptr[0] == 'e' || ptr[0] == 'E') {
+        // We can also check for the exponent sign here and consume it if it
+        // exists.
+        auto negativeExponent = ptr[1] == '-';
+        if (ptr[1] == '+' || ptr[1] == '-') {
+            ptr += 2;
+        } else {
+            ++ptr;
+        }
 
-    // We can also check for the exponent sign here and consume it if it exists.
-    if (ptr[1] == '+' || ptr[1] == '-') {
-        ptr += 2;
-        col += 2;
-    } else {
-        ++ptr;
-        ++col;
-    }
+        // Lastly, we need to consume the actual exponent, which is consists of
+        // digits and numeric separators. Any exponent past the clamp already
+        // overflows or underflows a double.
+        int64_t exponent = 0;
+        while (true) {
+            if (isDigit(ptr[0])) {
+                if (exponent < 100000)
+                    exponent = exponent * 10 + (ptr[0] - '0');
+                ++ptr;
+                continue;
+            }
 
-    // Lastly, we need to consume the actual exponent, which is consists of
-    // digits and numeric separators.
-    while (true) {
-        switch (ptr[0]) {
-        case '0':
-        case '1':
-        case '2':
-        case '3':
-        case '4':
-        case '5':
-        case '6':
-        case '7':
-        case '8':
-        case '9':
-            ++ptr;
-            ++col;
-            continue;
-        case '_':
-            // If we find a Numeric Separator, it must be followed by a digit
-            // according to the TypeScript standard.
-            if (!isDigit(ptr[1])) {
-                diagnoseInvalidNumericSeparator();
-                // Since this is the end of the separator, we must end the
-                // literal here. The placeholder literal, however, will not
-                // contain the underscore.
-                tok.set(TokenKind::FloatLiteral, line, startCol,
-                        afterLineTerminator,
-                        {startPtr, SIZE_T(ptr - startPtr)});
-                // Also, we need to consume the underscore.
+            if (ptr[0] == '_') {
+                // If we find a Numeric Separator, it must be followed by a
+                // digit according to the TypeScript standard.
+                if (!isDigit(ptr[1])) {
+                    diagnoseInvalidNumericSeparator();
+                    // Since this is the end of the separator, we must end the
+                    // literal here. The placeholder literal, however, will not
+                    // contain the underscore.
+                    literalEnd = ptr++;
+                    break;
+                }
+
+                // If we find a digit, we can just consume the underscore and
+                // the digit will be consumed next.
                 ++ptr;
-                return;
+                continue;
             }
 
-            // If we find a digit, we can just consume both the underscore and
-            // the digit.
-            ptr += 2;
-            col += 2;
-            continue;
-        default:
             // For all other characters, we will end the Float literal.
-            tok.set(TokenKind::FloatLiteral, line, startCol,
-                    afterLineTerminator, {startPtr, SIZE_T(ptr - startPtr)});
-            return;
+            literalEnd = ptr;
+            break;
         }
+        decimal.exponent += negativeExponent ? -exponent : exponent;
     }
+
+    tok.set(TokenKind::FloatLiteral, tokenOffset(), afterLineTerminator,
+            {startPtr, SIZE_T(literalEnd - startPtr)});
+    tok.floatValue = convertDecimalToDouble(decimal, tok.text);
+    tok.isFloatValue = true;
+}
+
+// This is the implementation of the method to store the value of an integer
+// literal. Decimal literals are marked by 0 bits per digit, and if they
+// overflow they are converted from their digits like a float literal.
+auto Lexer::setIntegerValue(Token &tok, const IntegerAccumulator &integer,
+                            unsigned bitsPerDigit) -> void {
+    if (!integer.overflowed) {
+        tok.intValue = integer.value;
+        tok.isFloatValue = false;
+        return;
+    }
+
+    if (bitsPerDigit == 0) {
+        DecimalAccumulator decimal;
+        decimal.truncated = true;
+        decimal.exponent = static_cast<int64_t>(tok.text.size());
+        tok.floatValue = convertDecimalToDouble(decimal, tok.text);
+    } else {
+        tok.floatValue = integer.toRadixDouble();
+    }
+    tok.isFloatValue = true;
+}
+
+// This is the implementation of the method to store the value of a BigInt
+// literal. Most BigInt literals fit in a single limb, so the digits are only
+// scanned again for the ones that do not.
+auto Lexer::setBigIntValue(Token &tok, const IntegerAccumulator &integer,
+                           unsigned radix) -> void {
+    bigIntLimbs.clear();
+    if (integer.overflowed)
+        computeBigIntLimbs(tok.text, radix, bigIntLimbs);
+    else if (integer.value != 0)
+        bigIntLimbs.push_back(integer.value);
+    tok.bigIntLimbs = bigIntLimbs;
 }
 
 // This is the implementation of the method that will scan Hexadecimal Numeric
@@ -881,9 +941,7 @@ auto Lexer::lexFloatLiteral(Token &tok, char *startPtr, int startCol,
 // bigint suffix is found, it will return a BigInt literal.
 auto Lexer::lexHexNumericLiteral(Token &tok, bool afterLineTerminator) -> void {
     // Since the prefix cannot be part of the Token lexeme, we must consume it.
-    auto startCol = col;
     ptr += 2;
-    col += 2;
     auto *startPtr = ptr;
 
     // The next character must be a Hex Digit
@@ -891,13 +949,14 @@ auto Lexer::lexHexNumericLiteral(Token &tok, bool afterLineTerminator) -> void {
         diagnoseMalformedRadixInt("hexadecimal", "0x");
 
         // For placeholder purposes, we will return a zero literal.
-        tok.set(TokenKind::ZeroLiteral, line, startCol, afterLineTerminator);
+        tok.set(TokenKind::ZeroLiteral, tokenOffset(), afterLineTerminator);
         return;
     }
 
     // Since we have one hex digit for sure, we can consume it.
+    IntegerAccumulator integer;
+    integer.addRadixDigit(4, hexDigitValue(ptr[0]));
     ++ptr;
-    ++col;
 
     // Now, we can consume all hex digits and numeric separators.
     while (true) {
@@ -924,8 +983,8 @@ auto Lexer::lexHexNumericLiteral(Token &tok, bool afterLineTerminator) -> void {
         case 'D':
         case 'E':
         case 'F':
+            integer.addRadixDigit(4, hexDigitValue(ptr[0]));
             ++ptr;
-            ++col;
             continue;
         case '_':
             // We must check if the numeric separator is followed by a valid Hex
@@ -935,34 +994,35 @@ auto Lexer::lexHexNumericLiteral(Token &tok, bool afterLineTerminator) -> void {
 
                 // Now, we must mark this as the end of the literal. The
                 // underscore will be ommited from the literal text.
-                tok.set(TokenKind::HexLiteral, line, startCol,
+                tok.set(TokenKind::HexLiteral, tokenOffset(),
                         afterLineTerminator,
                         {startPtr, SIZE_T(ptr - startPtr)});
+                setIntegerValue(tok, integer, 4);
                 // Finally, we need to consume the underscore
                 ++ptr;
-                ++col;
                 return;
             }
 
             // If there is a hex digit, we have pre-scanned it and we can
             // consume it.
+            integer.addRadixDigit(4, hexDigitValue(ptr[1]));
             ptr += 2;
-            col += 2;
             continue;
         case 'n':
             // Big Int literal suffix
-            tok.set(TokenKind::HexBigIntLiteral, line, startCol,
+            tok.set(TokenKind::HexBigIntLiteral, tokenOffset(),
                     // The BigInt suffix must be ommited  from the token lexeme.
                     afterLineTerminator, {startPtr, SIZE_T(ptr - startPtr)});
+            setBigIntValue(tok, integer, 16);
             // We also need to consume the big int suffix
             ++ptr;
-            ++col;
             return;
         default:
             // For all other characters, we will mark it as the end for Integer
             // Literals.
-            tok.set(TokenKind::HexLiteral, line, startCol, afterLineTerminator,
+            tok.set(TokenKind::HexLiteral, tokenOffset(), afterLineTerminator,
                     {startPtr, SIZE_T(ptr - startPtr)});
+            setIntegerValue(tok, integer, 4);
             return;
         }
     }
@@ -974,9 +1034,7 @@ auto Lexer::lexHexNumericLiteral(Token &tok, bool afterLineTerminator) -> void {
 auto Lexer::lexOctalNumericLiteral(Token &tok, bool afterLineTerminator)
     -> void {
     // First, we need to consume the prefix.
-    auto startCol = col;
     ptr += 2;
-    col += 2;
     auto *startPtr = ptr;
 
     // The first digit must be a valid octal digit.
@@ -984,13 +1042,14 @@ auto Lexer::lexOctalNumericLiteral(Token &tok, bool afterLineTerminator)
         diagnoseMalformedRadixInt("octal", "0o");
 
         // As a placeholder, we will return the zero literal.
-        tok.set(TokenKind::ZeroLiteral, line, startCol, afterLineTerminator);
+        tok.set(TokenKind::ZeroLiteral, tokenOffset(), afterLineTerminator);
         return;
     }
 
     // We have one octal digit for sure, so we can consume it.
+    IntegerAccumulator integer;
+    integer.addRadixDigit(3, static_cast<unsigned>(ptr[0] - '0'));
     ++ptr;
-    ++col;
 
     // Now, we need to consume all hex digits and seperators.
     while (true) {
@@ -1003,39 +1062,40 @@ auto Lexer::lexOctalNumericLiteral(Token &tok, bool afterLineTerminator)
         case '5':
         case '6':
         case '7':
+            integer.addRadixDigit(3, static_cast<unsigned>(ptr[0] - '0'));
             ++ptr;
-            ++col;
             continue;
         case '_':
             // Numeric Separator must be followed by an octal digit.
             if (!isOctalDigit(ptr[1])) {
                 diagnoseInvalidNumericSeparator();
 
-                tok.set(TokenKind::OctalLiteral, line, startCol,
+                tok.set(TokenKind::OctalLiteral, tokenOffset(),
                         afterLineTerminator,
                         {startPtr, SIZE_T(ptr - startPtr)});
+                setIntegerValue(tok, integer, 3);
                 // Consume underscore
                 ++ptr;
-                ++col;
                 return;
             }
 
             // We have a valid octal digit for sure, so consume both.
+            integer.addRadixDigit(3, static_cast<unsigned>(ptr[1] - '0'));
             ptr += 2;
-            col += 2;
             continue;
         case 'n':
             // Big Int suffix
-            tok.set(TokenKind::OctalBigIntLiteral, line, startCol,
+            tok.set(TokenKind::OctalBigIntLiteral, tokenOffset(),
                     afterLineTerminator, {startPtr, SIZE_T(ptr - startPtr)});
+            setBigIntValue(tok, integer, 8);
             // Consume suffix
             ++ptr;
-            ++col;
             return;
         default:
             // End of the literal.
-            tok.set(TokenKind::OctalLiteral, line, startCol,
-                    afterLineTerminator, {startPtr, SIZE_T(ptr - startPtr)});
+            tok.set(TokenKind::OctalLiteral, tokenOffset(), afterLineTerminator,
+                    {startPtr, SIZE_T(ptr - startPtr)});
+            setIntegerValue(tok, integer, 3);
             return;
         }
     }
@@ -1046,9 +1106,7 @@ auto Lexer::lexOctalNumericLiteral(Token &tok, bool afterLineTerminator)
 auto Lexer::lexBinaryNumericLiteral(Token &tok, bool afterLineTerminator)
     -> void {
     // First, we need to consume the prefix.
-    auto startCol = col;
     ptr += 2;
-    col += 2;
     auto *startPtr = ptr;
 
     // The first character must be a binary digit.
@@ -1056,52 +1114,54 @@ auto Lexer::lexBinaryNumericLiteral(Token &tok, bool afterLineTerminator)
         diagnoseMalformedRadixInt("binary", "0b");
 
         // Placeholder 0 literal.
-        tok.set(TokenKind::ZeroLiteral, line, startCol, afterLineTerminator);
+        tok.set(TokenKind::ZeroLiteral, tokenOffset(), afterLineTerminator);
         return;
     }
 
     // We know there is a binary digit, so we can consume it.
+    IntegerAccumulator integer;
+    integer.addRadixDigit(1, static_cast<unsigned>(ptr[0] - '0'));
     ++ptr;
-    ++col;
 
     // Now we need to consume all digits and separators.
     while (true) {
         switch (ptr[0]) {
         case '0':
         case '1':
+            integer.addRadixDigit(1, static_cast<unsigned>(ptr[0] - '0'));
             ++ptr;
-            ++col;
             continue;
         case '_':
             // Numeric separators must be followed by a binary digit.
             if (!isBinaryDigit(ptr[1])) {
                 diagnoseInvalidNumericSeparator();
 
-                tok.set(TokenKind::BinaryLiteral, line, startCol,
+                tok.set(TokenKind::BinaryLiteral, tokenOffset(),
                         afterLineTerminator,
                         {startPtr, SIZE_T(ptr - startPtr)});
+                setIntegerValue(tok, integer, 1);
                 // Consume underscore
                 ++ptr;
-                ++col;
                 return;
             }
 
             // We have 2 valid characters, so we can consume both.
+            integer.addRadixDigit(1, static_cast<unsigned>(ptr[1] - '0'));
             ptr += 2;
-            col += 2;
             continue;
         case 'n':
             // BigInt literal
-            tok.set(TokenKind::BinaryBigIntLiteral, line, startCol,
+            tok.set(TokenKind::BinaryBigIntLiteral, tokenOffset(),
                     afterLineTerminator, {startPtr, SIZE_T(ptr - startPtr)});
+            setBigIntValue(tok, integer, 2);
             // Consume suffix
             ++ptr;
-            ++col;
             return;
         default:
             // End of the regular binary literal.
-            tok.set(TokenKind::BinaryLiteral, line, startCol,
+            tok.set(TokenKind::BinaryLiteral, tokenOffset(),
                     afterLineTerminator, {startPtr, SIZE_T(ptr - startPtr)});
+            setIntegerValue(tok, integer, 1);
             return;
         }
     }
@@ -1112,13 +1172,13 @@ auto Lexer::lexBinaryNumericLiteral(Token &tok, bool afterLineTerminator)
 // will be an error.
 auto Lexer::lexLegacyOctalLiteral(Token &tok, bool afterLineTerminator)
     -> void {
-    // First, we need to move the column ahead for the prefix.
+    // First, we need to move the pointer ahead for the prefix.
     auto *startPtr = ++ptr;
-    auto startCol = col;
 
     // Since we have an octal digit for sure, we can consume it.
+    IntegerAccumulator integer;
+    integer.addRadixDigit(3, static_cast<unsigned>(ptr[0] - '0'));
     ++ptr;
-    col += 2;
 
     // Now, we need to consume all octal digits and numeric separatators.
     while (true) {
@@ -1131,131 +1191,548 @@ auto Lexer::lexLegacyOctalLiteral(Token &tok, bool afterLineTerminator)
         case '5':
         case '6':
         case '7':
+            integer.addRadixDigit(3, static_cast<unsigned>(ptr[0] - '0'));
             ++ptr;
-            ++col;
             continue;
         case '_':
             // Numeric Separator must be followed by an octal digit.
             if (!isOctalDigit(ptr[1])) {
                 diagnoseInvalidNumericSeparator();
 
-                tok.set(TokenKind::OctalLiteral, line, startCol,
+                tok.set(TokenKind::OctalLiteral, tokenOffset(),
                         afterLineTerminator,
                         {startPtr, SIZE_T(ptr - startPtr)});
+                setIntegerValue(tok, integer, 3);
                 // Consume underscore
                 ++ptr;
-                ++col;
                 return;
             }
 
             // We have a valid octal digit for sure, so consume both.
+            integer.addRadixDigit(3, static_cast<unsigned>(ptr[1] - '0'));
             ptr += 2;
-            col += 2;
             continue;
         // Legacy literals cannot have the bigint suffix.
         default:
-            tok.set(TokenKind::OctalLiteral, line, startCol,
-                    afterLineTerminator, {startPtr, SIZE_T(ptr - startPtr)});
+            tok.set(TokenKind::OctalLiteral, tokenOffset(), afterLineTerminator,
+                    {startPtr, SIZE_T(ptr - startPtr)});
+            setIntegerValue(tok, integer, 3);
             // Here, we must check if Strict mode is enabled.
-            if (UserOpts::strictModeEnabled) {
-                llvm::errs() << llvm::raw_ostream::Colors::RED
-                             << "error: " << llvm::raw_ostream::Colors::WHITE
-                             << filePath << ": " << line << ":" << startCol
-                             << ": legacy octal literals are not permitted in "
-                                "strict mode. Consider using the prefix '0o' "
-                                "or pass the argument '-no-strict-mode'\n";
-                lexerFailed = true;
-            }
+            if (UserOpts::strictModeEnabled)
+                report(DiagID::err_legacy_octal_strict, tokenStart);
             return;
         }
     }
 }
 
-// This is the implementation of the method to scan double quote string
-// literals. First, we will scan only ascii and if needed, we will switch to
-// unicode.
-auto Lexer::lexDoubleQuoteStrLiteral(Token &tok, bool afterLineTerminator)
-    -> void {
-    // First, we will move the pointer past the quote.
-    // The column should begin at the quote, but the text should not contain the
-    // quote.
-    auto *startPtr = ++ptr;
-    auto startCol = col++;
-
-    // Now, we need to consume all ASCII characters, and if unicode is found, we
-    // should switch to unicode.
+// This is the implementation of the method to scan identifiers. ASCII
+// characters are consumed with a table lookup, and we only decode UTF-8 when a
+// non-ASCII byte is found. Keywords are always ASCII, so identifiers with
+// Unicode characters are never looked up.
+auto Lexer::lexIdentifier(Token &tok, bool afterLineTerminator) -> void {
+    auto isAsciiOnly = isAscii(tokenStart[0]);
     while (true) {
-        if (ptr[0] == '"') {
-            // End of the double quoted string.
-            tok.set(TokenKind::StringLiteral, line, startCol,
-                    afterLineTerminator, {startPtr, SIZE_T(ptr - startPtr)});
+        while (isIdentifierPart(ptr[0]))
+            ++ptr;
+        if (isAscii(ptr[0]))
+            break;
 
-            // Consume the quote
+        // The identifier ends at a character that cannot continue it, or at an
+        // invalid sequence, which will be diagnosed by the next token.
+        auto *charStart = ptr;
+        llvm::UTF32 cp;
+        if (!decodeCharacter(cp) ||
+            !identifierContinueSet.contains(cp)) {
+            ptr = charStart;
+            break;
+        }
+        isAsciiOnly = false;
+    }
+
+    auto length = SIZE_T(ptr - tokenStart);
+    auto kind = isAsciiOnly ? keywords::lookup(tokenStart, length)
+                            : TokenKind::Identifier;
+    tok.set(kind, tokenOffset(), afterLineTerminator, {tokenStart, length});
+    tok.symbol = identifiers.intern(tok.text);
+}
+
+// This is the implementation of the method to store the value of a string
+// literal or template chunk. Most strings have no escape sequences, so their
+// cooked value is their text and nothing is copied. The others were decoded
+// into cookedValue as they were scanned, and the interned copy becomes their
+// value, so each one is decoded once and stored once.
+auto Lexer::setStringValue(Token &tok, const char *runStart, bool hasEscapes,
+                           bool isValid) -> void {
+    if (!isValid)
+        return;
+    if (!hasEscapes) {
+        tok.value = tok.text;
+        tok.symbol = identifiers.intern(tok.text);
+        return;
+    }
+
+    cookedValue.append(runStart, tok.text.end());
+    tok.symbol = identifiers.intern(cookedValue);
+    tok.value = identifiers.getName(tok.symbol);
+}
+
+// This is the implementation of the method to decode the digits of a unicode
+// escape sequence. It is either four hexadecimal digits, or any number of them
+// in braces up to 0x10FFFF. On failure, the pointer is left at the character
+// that is wrong, which is scanned as part of the string.
+auto Lexer::lexUnicodeEscapeValue(bool diagnose, uint32_t &value) -> bool {
+    if (ptr[0] != '{') {
+        value = 0;
+        for (auto i = 0; i < 4; ++i) {
+            if (!isHexDigit(ptr[0])) {
+                if (diagnose)
+                    report(DiagID::err_malformed_hex_escape, ptr, {{ptr, 1}});
+                return false;
+            }
+            value = value << 4 | hexDigitValue(ptr[0]);
             ++ptr;
-            ++col;
-            return;
         }
-        // If its ASCII, we can just move forward.
-        if (isAscii(ptr[0])) {
+        return true;
+    }
+
+    auto *escapeStart = ptr - 2;
+    ++ptr;
+    if (!isHexDigit(ptr[0])) {
+        if (diagnose)
+            report(DiagID::err_malformed_hex_escape, ptr, {{ptr, 1}});
+        return false;
+    }
+
+    // The value is clamped once it is too large, so that it cannot overflow.
+    value = 0;
+    while (isHexDigit(ptr[0])) {
+        value = std::min<uint32_t>(value << 4 | hexDigitValue(ptr[0]),
+                                   0x110000);
+        ++ptr;
+    }
+    if (ptr[0] != '}') {
+        if (diagnose)
+            report(DiagID::err_unterminated_unicode_escape, ptr);
+        return false;
+    }
+    ++ptr;
+    if (value > 0x10ffff) {
+        if (diagnose)
+            report(DiagID::err_unicode_escape_out_of_range, escapeStart);
+        return false;
+    }
+    return true;
+}
+
+// This is the implementation of the method to decode an escape sequence. A
+// malformed sequence only consumes the characters before the error, and the
+// rest is scanned like the other characters of the string.
+auto Lexer::lexEscapeSequence(bool inTemplate) -> bool {
+    // The backslash is never part of the value.
+    auto *escapeStart = ptr++;
+    switch (ptr[0]) {
+    case 'b':
+        cookedValue.push_back('\b');
+        ++ptr;
+        return true;
+    case 'f':
+        cookedValue.push_back('\f');
+        ++ptr;
+        return true;
+    case 'n':
+        cookedValue.push_back('\n');
+        ++ptr;
+        return true;
+    case 'r':
+        cookedValue.push_back('\r');
+        ++ptr;
+        return true;
+    case 't':
+        cookedValue.push_back('\t');
+        ++ptr;
+        return true;
+    case 'v':
+        cookedValue.push_back('\v');
+        ++ptr;
+        return true;
+
+    // An escaped line terminator is a line continuation, which adds nothing to
+    // the value. '\r\n' is a single line terminator.
+    case '\r':
+        ptr += ptr[1] == '\n' ? 2 : 1;
+        return true;
+    case '\n':
+        ++ptr;
+        return true;
+
+    case 'x':
+        if (!isHexDigit(ptr[1]) || !isHexDigit(ptr[2])) {
+            auto *badPtr = isHexDigit(ptr[1]) ? ptr + 2 : ptr + 1;
+            if (!inTemplate)
+                report(DiagID::err_malformed_hex_escape, badPtr, {{badPtr, 1}});
             ++ptr;
-            ++col;
-            continue;
+            return false;
+        }
+        appendCodePoint(cookedValue,
+                        hexDigitValue(ptr[1]) << 4 | hexDigitValue(ptr[2]));
+        ptr += 3;
+        return true;
+
+    case 'u': {
+        ++ptr;
+        uint32_t value;
+        if (!lexUnicodeEscapeValue(!inTemplate, value))
+            return false;
+
+        // A high surrogate followed by an escaped low surrogate is a single
+        // code point, as the pair would be in a UTF-16 string.
+        if (value >= 0xd800 && value <= 0xdbff && ptr[0] == '\\' &&
+            ptr[1] == 'u') {
+            auto *pairPtr = ptr;
+            ptr += 2;
+            uint32_t low;
+            if (lexUnicodeEscapeValue(false, low) && low >= 0xdc00 &&
+                low <= 0xdfff)
+                value = 0x10000 + ((value - 0xd800) << 10) + (low - 0xdc00);
+            else
+                ptr = pairPtr;
+        }
+        appendCodePoint(cookedValue, value);
+        return true;
+    }
+
+    // '\0' is the null character unless a digit follows, which makes it a
+    // legacy octal escape sequence.
+    case '0':
+        if (!isDigit(ptr[1])) {
+            cookedValue.push_back(0);
+            ++ptr;
+            return true;
+        }
+        [[fallthrough]];
+    case '1':
+    case '2':
+    case '3':
+    case '4':
+    case '5':
+    case '6':
+    case '7': {
+        if (inTemplate)
+            return false;
+        if (UserOpts::strictModeEnabled)
+            report(DiagID::err_octal_escape_strict, escapeStart);
+
+        // A sequence that begins with 0 to 3 may have three digits, and the
+        // others may have two, so the value always fits in a byte.
+        auto digitLimit = ptr[0] <= '3' ? 3 : 2;
+        uint32_t value = 0;
+        for (auto i = 0; i < digitLimit && isOctalDigit(ptr[0]); ++i)
+            value = value * 8 + static_cast<uint32_t>(*ptr++ - '0');
+        appendCodePoint(cookedValue, value);
+        return true;
+    }
+    case '8':
+    case '9':
+        if (inTemplate)
+            return false;
+        if (UserOpts::strictModeEnabled)
+            report(DiagID::err_octal_escape_strict, escapeStart);
+        cookedValue.push_back(*ptr++);
+        return true;
+
+    case 0:
+        // The end of the file is diagnosed by the caller.
+        if (ptr == endPtr)
+            return true;
+        cookedValue.push_back(*ptr++);
+        return true;
+
+    default: {
+        // Any other character stands for itself.
+        if (isAscii(ptr[0])) {
+            cookedValue.push_back(*ptr++);
+            return true;
         }
 
+        // Escaped Unicode Line Terminators are line continuations too.
+        auto *charStart = ptr;
         llvm::UTF32 cp;
-        if (decodeUTF8(ptr, endPtr, &cp) != llvm::conversionOK) {
-            // Conversion failure
+        if (!decodeCharacter(cp)) {
             diagnoseInvalidUTF8();
-            // Treat this character like it didn't exist.
-        } else {
-            // Since the decoding function handles the pointer, we just need to
-            // increment the column
-            ++col;
+            return true;
         }
+        if (!isUnicodeLT(cp))
+            cookedValue.append(charStart, ptr);
+        return true;
+    }
     }
 }
 
-// This is the implementation of the method to scan single quote string
-// literals. Similar to double quotes, we will begin with ascii and then do
-// unicode if needed.
-auto Lexer::lexSingleQuoteStrLiteral(Token &tok, bool afterLineTerminator)
-    -> void {
+// This is the implementation of the method to scan string literals. The
+// scanning kernel consumes the plain ASCII characters in bulk, and stops at
+// everything else. The text between escape sequences is copied into the cooked
+// value in one piece when the next escape sequence or the closing quote is
+// found.
+auto Lexer::lexStringLiteral(Token &tok, bool afterLineTerminator) -> void {
     // First, we will move the pointer past the quote.
-    // The column should begin at the quote, but the text should not contain the
+    // The token should begin at the quote, but the text should not contain the
     // quote.
+    auto quote = ptr[0];
     auto *startPtr = ++ptr;
-    auto startCol = col++;
+    auto *runStart = startPtr;
+    auto hasEscapes = false;
 
-    // Now, we need to consume all ASCII characters, and if unicode is found, we
-    // should switch to unicode.
     while (true) {
-        if (ptr[0] == '\'') {
-            // End of the single quoted string.
-            tok.set(TokenKind::StringLiteral, line, startCol,
+        // In valid text, the kernel does not stop at non-ASCII bytes, and it
+        // is cut off where the valid text ends.
+        auto *stopPtr =
+            ptr < validUTF8End
+                ? std::min(scanKernels.skipValidStringBody(ptr, endPtr, quote),
+                           validUTF8End)
+                : scanKernels.skipStringBody(ptr, endPtr, quote);
+        ptr = const_cast<char *>(stopPtr);
+
+        if (ptr[0] == quote) {
+            // End of the string.
+            tok.set(TokenKind::StringLiteral, tokenOffset(),
                     afterLineTerminator, {startPtr, SIZE_T(ptr - startPtr)});
+            setStringValue(tok, runStart, hasEscapes, true);
 
             // Consume the quote
             ++ptr;
-            ++col;
             return;
         }
-        // If its ASCII, we can just move forward.
-        if (isAscii(ptr[0])) {
+
+        switch (ptr[0]) {
+        case '\\':
+            if (!hasEscapes) {
+                cookedValue.clear();
+                hasEscapes = true;
+            }
+            cookedValue.append(runStart, ptr);
+            lexEscapeSequence(false);
+            runStart = ptr;
+            continue;
+
+        case 0:
+            // A null character is allowed in a string, unless it is really the
+            // end of the file.
+            if (ptr != endPtr) {
+                ++ptr;
+                continue;
+            }
+            [[fallthrough]];
+        case '\n':
+        case '\r':
+            // A string cannot span lines, so the string ends before the line
+            // terminator, which is scanned as usual.
+            report(DiagID::err_unterminated_string, tokenStart);
+            tok.set(TokenKind::StringLiteral, tokenOffset(),
+                    afterLineTerminator, {startPtr, SIZE_T(ptr - startPtr)});
+            setStringValue(tok, runStart, hasEscapes, true);
+            return;
+
+        default: {
+            // The kernel only stops at non-ASCII bytes otherwise. Unicode Line
+            // Terminators are allowed in strings, so the decoding function
+            // only needs to be checked for conversion failures.
+            llvm::UTF32 cp;
+            if (!decodeCharacter(cp)) {
+                // Treat this character like it didn't exist.
+                diagnoseInvalidUTF8();
+            }
+        }
+        }
+    }
+}
+
+// This is the implementation of the method to scan a template chunk. The chunk
+// ends at the backtick that closes the template, or at the '${' that opens a
+// substitution. Unlike strings, templates may span lines, but a carriage
+// return is cooked to a line feed, so it is treated like an escape sequence.
+// The raw value is the text of the token.
+auto Lexer::lexTemplateChunk(Token &tok, bool afterLineTerminator) -> void {
+    // A chunk that begins at the backtick is the first of its template.
+    auto isFirst = ptr[0] == '`';
+    auto *startPtr = ++ptr;
+    auto *runStart = startPtr;
+    auto hasEscapes = false, isValid = true;
+
+    while (true) {
+        auto *stopPtr =
+            ptr < validUTF8End
+                ? std::min(scanKernels.skipValidTemplateBody(ptr, endPtr),
+                           validUTF8End)
+                : scanKernels.skipTemplateBody(ptr, endPtr);
+        ptr = const_cast<char *>(stopPtr);
+
+        switch (ptr[0]) {
+        case '`':
+            tok.set(isFirst ? TokenKind::NoSubstitutionTemplate
+                            : TokenKind::TemplateTail,
+                    tokenOffset(), afterLineTerminator,
+                    {startPtr, SIZE_T(ptr - startPtr)});
+            setStringValue(tok, runStart, hasEscapes, isValid);
+            ++ptr;
+            return;
+
+        case '$':
+            if (ptr[1] != '{') {
+                ++ptr;
+                continue;
+            }
+            tok.set(isFirst ? TokenKind::TemplateHead
+                            : TokenKind::TemplateMiddle,
+                    tokenOffset(), afterLineTerminator,
+                    {startPtr, SIZE_T(ptr - startPtr)});
+            setStringValue(tok, runStart, hasEscapes, isValid);
+            ptr += 2;
+            return;
+
+        case '\\':
+        case '\r':
+            if (!hasEscapes) {
+                cookedValue.clear();
+                hasEscapes = true;
+            }
+            cookedValue.append(runStart, ptr);
+            if (ptr[0] == '\\') {
+                isValid &= lexEscapeSequence(true);
+            } else {
+                cookedValue.push_back('\n');
+                ptr += ptr[1] == '\n' ? 2 : 1;
+            }
+            runStart = ptr;
+            continue;
+
+        case 0:
+            if (ptr != endPtr) {
+                ++ptr;
+                continue;
+            }
+
+            // The template is closed at the end of the file, so that the
+            // substitutions it opened are closed too.
+            report(DiagID::err_unterminated_template, tokenStart);
+            tok.set(isFirst ? TokenKind::NoSubstitutionTemplate
+                            : TokenKind::TemplateTail,
+                    tokenOffset(), afterLineTerminator,
+                    {startPtr, SIZE_T(ptr - startPtr)});
+            setStringValue(tok, runStart, hasEscapes, isValid);
+            return;
+
+        default: {
+            // The kernel only stops at non-ASCII bytes otherwise.
+            llvm::UTF32 cp;
+            if (!decodeCharacter(cp))
+                diagnoseInvalidUTF8();
+        }
+        }
+    }
+}
+
+// This is the implementation of the method to rescan a slash as a regular
+// expression literal. The body is only checked for where it ends, since the
+// pattern is compiled when the RegExp is created. A slash inside a class does
+// not end it, and an escaped character never ends the literal or a class.
+auto Lexer::rescanSlashAsRegex(Token &tok) -> void {
+    assert((tok.kind == TokenKind::Slash ||
+            tok.kind == TokenKind::SlashEquals) &&
+           "only a slash can begin a regular expression literal");
+    ptr = const_cast<char *>(tokenStart) + 1;
+
+    auto inClass = false, terminated = false;
+    while (!terminated) {
+        switch (ptr[0]) {
+        case '/':
+            terminated = !inClass;
+            ++ptr;
+            continue;
+        case '[':
+            inClass = true;
+            ++ptr;
+            continue;
+        case ']':
+            inClass = false;
+            ++ptr;
+            continue;
+        case '\\':
             ++ptr;
-            ++col;
+            if (ptr[0] != '\n' && ptr[0] != '\r' && isAscii(ptr[0]) &&
+                ptr != endPtr)
+                ++ptr;
             continue;
+        case '\n':
+        case '\r':
+            break;
+        case 0:
+            if (ptr != endPtr) {
+                ++ptr;
+                continue;
+            }
+            break;
+        default: {
+            if (isAscii(ptr[0])) {
+                ++ptr;
+                continue;
+            }
+
+            auto *charStart = ptr;
+            llvm::UTF32 cp;
+            if (!decodeCharacter(cp)) {
+                diagnoseInvalidUTF8();
+                continue;
+            }
+            if (!isUnicodeLT(cp))
+                continue;
+            ptr = charStart;
+            break;
+        }
         }
 
-        llvm::UTF32 cp;
-        if (decodeUTF8(ptr, endPtr, &cp) != llvm::conversionOK) {
-            // Conversion failure
-            diagnoseInvalidUTF8();
-            // Treat this character like it didn't exist.
-        } else {
-            // Since the decoding function handles the pointer, we just need to
-            // increment the column
-            ++col;
+        // The literal ends before a line terminator or the end of the file.
+        report(DiagID::err_unterminated_regex, tokenStart);
+        break;
+    }
+
+    // The flags are the identifier characters after the closing slash, and
+    // each may only appear once.
+    if (terminated) {
+        llvm::StringRef validFlags{"dgimsuyv"};
+        unsigned seenFlags = 0;
+        while (isIdentifierPart(ptr[0])) {
+            auto index = validFlags.find(ptr[0]);
+            if (index == llvm::StringRef::npos)
+                report(DiagID::err_invalid_regex_flag, ptr, {{ptr, 1}});
+            else if (seenFlags & 1u << index)
+                report(DiagID::err_duplicate_regex_flag, ptr, {{ptr, 1}});
+            else
+                seenFlags |= 1u << index;
+            ++ptr;
         }
     }
+
+    // The value is the whole literal, since the pattern and the flags are
+    // handed to the RegExp together.
+    tok.set(TokenKind::RegularExpressionLiteral, tokenOffset(),
+            tok.afterLineTerminator,
+            {tokenStart, SIZE_T(ptr - tokenStart)});
+    tok.symbol = identifiers.intern(tok.text);
+    state.previousKind = tok.kind;
+}
+
+// This is the implementation of the method to split a token after its first
+// '>'. Every punctuator that begins with '>' is one of these, and the rest of
+// it is scanned again as the next token.
+auto Lexer::rescanGreaterThan(Token &tok) -> void {
+    assert((tok.kind == TokenKind::GreaterGreater ||
+            tok.kind == TokenKind::GreaterGreaterGreater ||
+            tok.kind == TokenKind::GreaterEquals ||
+            tok.kind == TokenKind::GreaterGreaterEquals ||
+            tok.kind == TokenKind::GreaterGreaterGreaterEquals) &&
+           "only a punctuator that begins with '>' can be split");
+    ptr = const_cast<char *>(tokenStart) + 1;
+    tok.kind = TokenKind::Greater;
+    state.previousKind = tok.kind;
 }
-} // namespace ntsc
\ No newline at end of file
+} // namespace ntsc
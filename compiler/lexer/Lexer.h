@@ -1,27 +1,138 @@
 #ifndef NTSC_LEXER_H
 #define NTSC_LEXER_H
+#include "Diagnostics.h"
+#include "NumericLiterals.h"
+#include "SourceFile.h"
 #include "Token.h"
+#include "TokenBuffer.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Compiler.h"
+#include "llvm/Support/ConvertUTF.h"
 
 /*
     This file defines the Lexer interface for scanning TypeScript source files.
 */
 
 namespace ntsc {
+// This struct holds the state that the Lexer carries from one token to the
+// next, other than its position. It only depends on the kinds of the tokens
+// scanned so far, so it can be rebuilt for any point in a token stream, and a
+// Lexer can be restarted there.
+struct LexerState {
+    // This is the kind of the last token. When there is no Parser to ask, it
+    // decides whether a slash begins a regular expression literal.
+    TokenKind previousKind = TokenKind::FileEnd;
+
+    // These are the numbers of unclosed braces in each open template
+    // substitution, innermost last. A right brace that closes none of them
+    // continues the template instead.
+    llvm::SmallVector<uint32_t, 2> templateBraces;
+
+    // These record whether each open parenthesis, innermost last, follows if,
+    // for, while or with. The parenthesis that closes one of them ends the
+    // head of a statement rather than an expression, so a slash after it
+    // begins a regular expression literal.
+    llvm::SmallVector<bool, 8> conditionParentheses;
+
+    // This is set when the last token closed the head of such a statement.
+    bool closedCondition = false;
+
+    // This method will update the state after a token of the given kind.
+    inline auto advance(TokenKind kind) -> void {
+        auto previous = previousKind;
+        previousKind = kind;
+        closedCondition = false;
+        switch (kind) {
+        case TokenKind::LeftParenthasis:
+            conditionParentheses.push_back(
+                previous == TokenKind::IfKeyword ||
+                previous == TokenKind::ForKeyword ||
+                previous == TokenKind::WhileKeyword ||
+                previous == TokenKind::WithKeyword);
+            break;
+        case TokenKind::RightParenthasis:
+            if (!conditionParentheses.empty()) {
+                closedCondition = conditionParentheses.back();
+                conditionParentheses.pop_back();
+            }
+            break;
+        case TokenKind::TemplateHead:
+            templateBraces.push_back(0);
+            break;
+        case TokenKind::TemplateTail:
+            templateBraces.pop_back();
+            break;
+        case TokenKind::LeftCurly:
+            if (!templateBraces.empty())
+                ++templateBraces.back();
+            break;
+        case TokenKind::RightCurly:
+            if (!templateBraces.empty())
+                --templateBraces.back();
+            break;
+        default:
+            break;
+        }
+    }
+
+    // This method will determine whether a right brace would continue a
+    // template.
+    [[nodiscard]] inline auto isAtTemplateContinuation() const -> bool {
+        return !templateBraces.empty() && templateBraces.back() == 0;
+    }
+
+    inline auto operator==(const LexerState &other) const -> bool {
+        return previousKind == other.previousKind &&
+               templateBraces == other.templateBraces &&
+               conditionParentheses == other.conditionParentheses &&
+               closedCondition == other.closedCondition;
+    }
+    inline auto operator!=(const LexerState &other) const -> bool {
+        return !(*this == other);
+    }
+};
+
 class Lexer {
     // These are the current pointer, buffer start pointer, and buffer end
     // pointer.
     char *ptr;
     const char *bufPtr, *endPtr;
 
-    // This is a reference to the file path.
-    // It is either from the CLI or from another source file.
-    llvm::StringRef filePath;
+    // This points to the first UTF-8 sequence that is not known to be valid.
+    // The text from the pointer up to it is valid, so it is decoded without
+    // checks, and the scanning kernels do not stop at non-ASCII bytes there.
+    // It starts at the end of the text that the SourceFile validated, and it is
+    // moved forward past each invalid sequence as it is diagnosed.
+    const char *validUTF8End;
+
+    // This is the pointer to the first character of the most recently scanned
+    // token. It is used to record the full lexeme in a TokenBuffer.
+    const char *tokenStart;
+
+    // This is a reference to the source file being scanned. Its handle is
+    // recorded with every diagnostic.
+    const SourceFile &file;
+
+    // This is the engine that records the Lexer's diagnostics.
+    DiagnosticsEngine &diags;
+
+    // This is the table that interns identifiers and string literal values.
+    IdentifierTable &identifiers;
 
     // This tracks whether the lexer has recovered from an error.
     bool lexerFailed = false;
 
-    // These track the current line and column of the Lexer.
-    int line = 1, col = 1;
+    // This is the state that is carried between tokens.
+    LexerState state;
+
+    // This holds the limbs of the most recent BigInt literal.
+    llvm::SmallVector<uint64_t, 2> bigIntLimbs;
+
+    // This holds the cooked value of the current string literal or template
+    // chunk while its escape sequences are decoded. It is only used once the
+    // first escape sequence is found.
+    llvm::SmallString<128> cookedValue;
 
     // This method will determine whether the given character is ASCII
     // horizontal whitespace according to the TypeScript standard.
@@ -43,6 +154,22 @@ class Lexer {
         return decimalPart <= 9 || hexPart <= 5;
     }
 
+    // This method is the DFA that scans a single token. It is forced inline so
+    // that lexToken and lexChunk both get a copy without a call per token.
+    LLVM_ATTRIBUTE_ALWAYS_INLINE auto scanToken(Token &tok) -> void;
+
+    // This method will return the offset of the current token in the source
+    // file.
+    [[nodiscard]] inline auto tokenOffset() const -> uint32_t {
+        return static_cast<uint32_t>(tokenStart - bufPtr);
+    }
+
+    // This method will record a diagnostic at the given pointer into the
+    // source buffer and mark the Lexer as failed.
+    inline auto report(DiagID id, const char *at,
+                       std::initializer_list<llvm::StringRef> args = {})
+        -> void;
+
     // This method will scan Single Line comments from the source code
     [[nodiscard]] inline auto lexSingleLineComment(Token &tok,
                                                    bool afterLineTerminator)
@@ -58,10 +185,22 @@ class Lexer {
     // and big integer literals as needed.
     inline auto lexNumericLiteral(Token &tok, bool afterLineTerminator) -> void;
 
-    // This method will scan Floating Point Literals after the floating point.
-    inline auto lexFloatLiteral(Token &tok, char *startPtr, int startCol,
+    // This method will scan Floating Point Literals after the integer part. The
+    // pointer must be at the floating point or the exponent prefix.
+    inline auto lexFloatLiteral(Token &tok, char *startPtr,
+                                const IntegerAccumulator &integer,
                                 bool afterLineTerminator) -> void;
 
+    // This method will store the value of an integer literal in the token.
+    // The token's text must already be set to the digits of the literal.
+    inline auto setIntegerValue(Token &tok, const IntegerAccumulator &integer,
+                                unsigned bitsPerDigit) -> void;
+
+    // This method will store the value of a BigInt literal in the token. The
+    // token's text must already be set to the digits of the literal.
+    inline auto setBigIntValue(Token &tok, const IntegerAccumulator &integer,
+                               unsigned radix) -> void;
+
     // This method will scan Hexadecimal numeric literals.
     inline auto lexHexNumericLiteral(Token &tok, bool afterLineTerminator)
         -> void;
@@ -78,13 +217,44 @@ class Lexer {
     inline auto lexLegacyOctalLiteral(Token &tok, bool afterLineTerminator)
         -> void;
 
-    // This method will scan double quote string literals.
-    inline auto lexDoubleQuoteStrLiteral(Token &tok, bool afterLineTerminator)
-        -> void;
+    // This method will scan identifiers and keywords. The pointer must be
+    // just past the first character of the identifier.
+    inline auto lexIdentifier(Token &tok, bool afterLineTerminator) -> void;
 
-    // This method will scan single quote string literals.
-    inline auto lexSingleQuoteStrLiteral(Token &tok, bool afterLineTerminator)
-        -> void;
+    // This method will scan string literals of either quote. The pointer must
+    // be at the opening quote.
+    inline auto lexStringLiteral(Token &tok, bool afterLineTerminator) -> void;
+
+    // This method will scan a chunk of a template literal. The pointer must be
+    // at the backtick that opens the template, or at the right brace that
+    // ends a substitution.
+    inline auto lexTemplateChunk(Token &tok, bool afterLineTerminator) -> void;
+
+    // This method will decode the escape sequence at the pointer, which must
+    // be at the backslash, and append its value to cookedValue. It will return
+    // false if the sequence is malformed. That is only reported in string
+    // literals, since a tagged template may hold any escape sequence, and the
+    // Parser reports it for the other templates.
+    inline auto lexEscapeSequence(bool inTemplate) -> bool;
+
+    // This method will decode the hexadecimal digits of a unicode escape
+    // sequence, with the pointer just past the 'u'. It will return false if
+    // they are malformed, which is reported if diagnose is set.
+    inline auto lexUnicodeEscapeValue(bool diagnose, uint32_t &value) -> bool;
+
+    // This method will store the cooked value of a string literal or template
+    // chunk. The token's text must already be set to its raw value. If it has
+    // escape sequences, the text after the last one starts at runStart and is
+    // still to be appended to cookedValue. A template chunk with a malformed
+    // escape sequence is not valid and has no cooked value.
+    inline auto setStringValue(Token &tok, const char *runStart,
+                               bool hasEscapes, bool isValid) -> void;
+
+    // This method will decode the non-ASCII character at the pointer and move
+    // past it. Valid text is decoded without checks, and anything after it is
+    // checked with LLVM. It will return false without moving the pointer if
+    // the sequence is invalid.
+    inline auto decodeCharacter(llvm::UTF32 &cp) -> bool;
 
     // This method will diagnose errors related to unexpected null characters.
     // Since it will only be used locally in Lexer.cpp, the definition can be
@@ -92,10 +262,14 @@ class Lexer {
     inline auto diagnoseUnexpectedNull() -> void;
 
     // This method will diagnose errors related to invalid UTF8 sequences. This
-    // will be called when the LLVM conversion function fails. It will be
-    // defined locally in Lexer.cpp.
+    // will be called when decodeCharacter fails. It will be defined locally in
+    // Lexer.cpp.
     inline auto diagnoseInvalidUTF8() -> void;
 
+    // This method will diagnose characters that cannot begin a token. It will
+    // skip the entire character so the Lexer can continue.
+    inline auto diagnoseInvalidCharacter() -> void;
+
     // This method will diagnose errors in the source when numeric seperators
     // are not followed by valid digits.
     inline auto diagnoseInvalidNumericSeparator() -> void;
@@ -106,9 +280,25 @@ class Lexer {
                                           const char prefix[]) -> void;
 
   public:
-    // This constructor will be used to instantiate Lexer instances with a start
-    // pointer, end pointer, and a file path.
-    Lexer(const char *bufPtr, const char *endPtr, llvm::StringRef filePath);
+    // This constructor will be used to instantiate Lexer instances over a
+    // source file. Diagnostics are recorded in the given engine, and names
+    // and string values are interned in the given table.
+    Lexer(const SourceFile &file, DiagnosticsEngine &diags,
+          IdentifierTable &identifiers);
+
+    // This constructor will instantiate a Lexer that resumes scanning at the
+    // given offset. The offset must be the end of a token in a previous scan
+    // of the same text, or 0, and the state must be the one the Lexer had
+    // there, which LexerState::advance rebuilds from the kinds of the tokens
+    // before it.
+    Lexer(const SourceFile &file, DiagnosticsEngine &diags,
+          IdentifierTable &identifiers, uint32_t startOffset,
+          LexerState state = {});
+
+    // This method will return the state that is carried to the next token.
+    [[nodiscard]] inline auto getState() const -> const LexerState & {
+        return state;
+    }
 
     // This method will return to the caller whether the Lexer has recovered
     // from one or more errors.
@@ -117,6 +307,29 @@ class Lexer {
     // This method is the main Lexer routine. It will take a reference to a
     // Token instance from the Parser and mutate that instance.
     auto lexToken(Token &tok) -> void;
+
+    // This method will scan the last token again as a regular expression
+    // literal. The Parser calls it when a Slash or SlashEquals token is found
+    // where an expression may begin. The token's start and preceding line
+    // terminator are reused, so the comments and whitespace before it are not
+    // scanned again.
+    auto rescanSlashAsRegex(Token &tok) -> void;
+
+    // This method will shorten the last token to its first '>'. The Parser
+    // calls it when a token such as '>>' or '>=' ends a list of type
+    // arguments, and the next token will begin right after the '>'.
+    auto rescanGreaterThan(Token &tok) -> void;
+
+    // This method will scan up to the given number of tokens and append them to
+    // the TokenBuffer. It will return false once the end of the file has been
+    // appended. There is no Parser to ask whether a slash begins a regular
+    // expression, so it is decided from the tokens before it, as a Parser
+    // would for every case but a regular expression after a block.
+    auto lexChunk(TokenBuffer &tokens, size_t maxTokens) -> bool;
+
+    // This method will scan the rest of the source file into the TokenBuffer.
+    // The last token in the buffer will always be the end of the file.
+    auto lexAll(TokenBuffer &tokens) -> void;
 };
 }; // namespace ntsc
 
@@ -0,0 +1,72 @@
+#include "LexerStatistics.h"
+#include "llvm/ADT/Statistic.h"
+
+/*
+    This file implements the Lexer counters. They are LLVM statistics, so they
+    are printed along with those of any later phase. The statistics are always
+    tracked rather than only in assertion builds, since they are enabled at run
+    time by --stats.
+*/
+
+#define DEBUG_TYPE "lexer"
+
+ALWAYS_ENABLED_STATISTIC(bytesLexed, "Number of bytes lexed");
+ALWAYS_ENABLED_STATISTIC(tokensLexed, "Number of tokens lexed");
+ALWAYS_ENABLED_STATISTIC(slowDecodes,
+                         "Number of characters decoded by the UTF-8 slow path");
+
+// These are the counts of each TokenKind.
+static llvm::TrackingStatistic tokenKindCounts[] = {
+#define TOKEN(name) {DEBUG_TYPE, #name, "Number of " #name " tokens"},
+#include "TokenKinds.def"
+};
+
+// These are the times spent in each category, in thousands of cycles, since
+// statistics are only 32 bits wide.
+static llvm::TrackingStatistic categoryKilocycles[] = {
+    {DEBUG_TYPE, "commentKilocycles", "Thousands of cycles in comments"},
+    {DEBUG_TYPE, "stringKilocycles", "Thousands of cycles in strings"},
+    {DEBUG_TYPE, "numberKilocycles", "Thousands of cycles in numbers"},
+    {DEBUG_TYPE, "punctuatorKilocycles", "Thousands of cycles in punctuators"},
+    {DEBUG_TYPE, "identifierKilocycles",
+     "Thousands of cycles in identifiers and keywords"},
+    {DEBUG_TYPE, "otherKilocycles", "Thousands of cycles in other tokens"}};
+static_assert(std::size(categoryKilocycles) == ntsc::lexstats::categoryCount,
+              "every category needs a statistic");
+
+namespace ntsc {
+namespace lexstats {
+thread_local ThreadCounters threadCounters;
+
+// This is the implementation of the function to flush the thread counters.
+// The cycles below a thousand are kept for the next flush, so that short
+// batches still add up.
+auto flushThreadCounters() -> void {
+    auto &counters = threadCounters;
+    for (size_t i = 0; i < categoryCount; ++i) {
+        if (counters.cycles[i] >= 1000) {
+            categoryKilocycles[i] += counters.cycles[i] / 1000;
+            counters.cycles[i] %= 1000;
+        }
+    }
+    if (counters.slowDecodes != 0) {
+        slowDecodes += counters.slowDecodes;
+        counters.slowDecodes = 0;
+    }
+}
+
+// This is the implementation of the function to count the tokens of a buffer.
+// They are counted locally first, so each statistic is only updated once.
+auto recordTokens(const TokenBuffer &tokens, size_t bytes) -> void {
+    std::array<unsigned, std::size(tokenKindCounts)> counts{};
+    for (size_t i = 0; i < tokens.size(); ++i)
+        ++counts[static_cast<uint8_t>(tokens.kind(i))];
+    for (size_t i = 0; i < counts.size(); ++i) {
+        if (counts[i] != 0)
+            tokenKindCounts[i] += counts[i];
+    }
+    tokensLexed += tokens.size();
+    bytesLexed += bytes;
+}
+} // namespace lexstats
+} // namespace ntsc
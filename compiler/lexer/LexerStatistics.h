@@ -0,0 +1,115 @@
+#ifndef NTSC_LEXERSTATISTICS_H
+#define NTSC_LEXERSTATISTICS_H
+#include "Token.h"
+#include "TokenBuffer.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*
+    This file defines the counters that the Lexer reports for --stats. The
+    token counts are taken from finished TokenBuffers, so they cost nothing
+    while lexing. The counters inside the scanning loops, which time each
+    category of token and count the UTF-8 slow path, are only compiled in when
+    NTSC_ENABLE_STATS is defined, since even a few instructions per token show
+    up in the hot loops.
+*/
+
+// This macro will expand to its arguments only in builds with the hot loop
+// counters enabled.
+#ifdef NTSC_ENABLE_STATS
+#define NTSC_STAT(...) __VA_ARGS__
+#else
+#define NTSC_STAT(...)
+#endif
+
+namespace ntsc {
+namespace lexstats {
+// This enum holds the categories that lexing time is split into. Whitespace
+// and line terminators are counted with the token that follows them.
+enum class Category : uint8_t {
+    Comments,
+    Strings,
+    Numbers,
+    Punctuators,
+    Identifiers,
+    Other
+};
+constexpr size_t categoryCount = 6;
+
+// This table maps each TokenKind to its category. Keywords are scanned as
+// identifiers, so they are counted with them.
+constexpr auto categories = [] {
+    std::array<Category, 256> table{};
+    for (auto &category : table)
+        category = Category::Other;
+#define PUNCTUATOR(name, spelling)                                             \
+    table[static_cast<uint8_t>(TokenKind::name)] = Category::Punctuators;
+#define KEYWORD(name, spelling)                                                \
+    table[static_cast<uint8_t>(TokenKind::name)] = Category::Identifiers;
+#define LITERAL(name)                                                          \
+    table[static_cast<uint8_t>(TokenKind::name)] = Category::Numbers;
+#include "TokenKinds.def"
+    table[static_cast<uint8_t>(TokenKind::Identifier)] = Category::Identifiers;
+    table[static_cast<uint8_t>(TokenKind::StringLiteral)] = Category::Strings;
+    table[static_cast<uint8_t>(TokenKind::NoSubstitutionTemplate)] =
+        Category::Strings;
+    table[static_cast<uint8_t>(TokenKind::TemplateHead)] = Category::Strings;
+    table[static_cast<uint8_t>(TokenKind::TemplateMiddle)] = Category::Strings;
+    table[static_cast<uint8_t>(TokenKind::TemplateTail)] = Category::Strings;
+    table[static_cast<uint8_t>(TokenKind::RegularExpressionLiteral)] =
+        Category::Strings;
+    return table;
+}();
+
+// This struct holds the hot loop counters of a single thread. They are plain
+// integers, and they are added to the shared statistics once per batch.
+struct ThreadCounters {
+    std::array<uint64_t, categoryCount> cycles{};
+    uint64_t pendingCommentCycles = 0;
+    uint64_t slowDecodes = 0;
+};
+extern thread_local ThreadCounters threadCounters;
+
+// This function will read the time stamp counter, or return 0 if the target
+// has none. The category times are only reported when it is available.
+[[nodiscard]] inline auto readCycleCounter() -> uint64_t {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// This function will record the time spent in a comment. It is subtracted
+// from the token that the comment precedes.
+inline auto recordComment(uint64_t startCycles) -> void {
+    threadCounters.pendingCommentCycles += readCycleCounter() - startCycles;
+}
+
+// This function will record the time spent scanning a token, including its
+// leading trivia.
+inline auto recordToken(TokenKind kind, uint64_t startCycles) -> void {
+    auto &counters = threadCounters;
+    auto cycles = readCycleCounter() - startCycles;
+    auto commentCycles = counters.pendingCommentCycles;
+    counters.cycles[static_cast<size_t>(Category::Comments)] += commentCycles;
+    counters.cycles[static_cast<size_t>(
+        categories[static_cast<uint8_t>(kind)])] += cycles - commentCycles;
+    counters.pendingCommentCycles = 0;
+}
+
+// This function will add the counters of the calling thread to the shared
+// statistics, and then clear them.
+auto flushThreadCounters() -> void;
+
+// This function will count the tokens of a finished TokenBuffer by kind,
+// along with the bytes of source text they were lexed from.
+auto recordTokens(const TokenBuffer &tokens, size_t bytes) -> void;
+} // namespace lexstats
+} // namespace ntsc
+
+#endif
@@ -0,0 +1,72 @@
+#include "NumericLiterals.h"
+#include "llvm/ADT/SmallString.h"
+#include <charconv>
+#include <cmath>
+
+/*
+    This file implements the helpers for computing numeric literal values.
+*/
+
+namespace ntsc {
+// These are the powers of 10 that are exactly representable as doubles.
+static constexpr double exactPowersOfTen[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+// This is the implementation of the method to round an overflowed literal.
+auto IntegerAccumulator::toRadixDouble() const -> double {
+    if (!overflowed)
+        return static_cast<double>(value);
+    return std::ldexp(static_cast<double>(value | (sticky != 0)), droppedBits);
+}
+
+// This is the implementation of the function to convert decimal literals.
+// Both the significand and the power of 10 are exact doubles in the fast path,
+// so IEEE arithmetic gives the correctly rounded result. The slow path uses
+// std::from_chars, which is correctly rounded as well.
+auto convertDecimalToDouble(const DecimalAccumulator &decimal,
+                            llvm::StringRef lexeme) -> double {
+    if (!decimal.truncated && decimal.significand <= (uint64_t{1} << 53) &&
+        decimal.exponent >= -22 && decimal.exponent <= 22) {
+        auto significand = static_cast<double>(decimal.significand);
+        return decimal.exponent < 0
+                   ? significand / exactPowersOfTen[-decimal.exponent]
+                   : significand * exactPowersOfTen[decimal.exponent];
+    }
+    if (decimal.significand == 0 && !decimal.truncated)
+        return 0.0;
+
+    llvm::SmallString<64> digits;
+    for (auto c : lexeme)
+        if (c != '_')
+            digits.push_back(c);
+
+    double value = 0.0;
+    auto result =
+        std::from_chars(digits.begin(), digits.end(), value,
+                        std::chars_format::general);
+    if (result.ec == std::errc::result_out_of_range)
+        return decimal.exponent > 0 ? HUGE_VAL : 0.0;
+    return value;
+}
+
+// This is the implementation of the function to compute BigInt limbs. Each
+// digit multiplies the limbs by the radix and adds the digit, carrying between
+// limbs with 128-bit arithmetic.
+auto computeBigIntLimbs(llvm::StringRef digits, unsigned radix,
+                        llvm::SmallVectorImpl<uint64_t> &limbs) -> void {
+    limbs.clear();
+    for (auto c : digits) {
+        if (c == '_')
+            continue;
+        uint64_t carry = c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10;
+        for (auto &limb : limbs) {
+            auto product = static_cast<unsigned __int128>(limb) * radix + carry;
+            limb = static_cast<uint64_t>(product);
+            carry = static_cast<uint64_t>(product >> 64);
+        }
+        if (carry)
+            limbs.push_back(carry);
+    }
+}
+} // namespace ntsc
@@ -0,0 +1,99 @@
+#ifndef NTSC_NUMERICLITERALS_H
+#define NTSC_NUMERICLITERALS_H
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include <cstdint>
+
+/*
+    This file defines the helpers used by the Lexer to compute the values of
+    numeric literals while their digits are scanned, so that no later stage has
+    to scan the digits again.
+*/
+
+namespace ntsc {
+// This struct accumulates the value of an integer literal one digit at a time.
+// It holds the exact value while it fits in 64 bits. For the power of two
+// radixes, it then keeps the leading bits, whether any dropped bit was set and
+// how many bits were dropped, which is enough to round the value to a double.
+struct IntegerAccumulator {
+    uint64_t value = 0;
+    uint64_t sticky = 0;
+    int droppedBits = 0;
+    bool overflowed = false;
+
+    // This method will append a decimal digit. Decimal literals that overflow
+    // are converted from their lexeme instead.
+    inline auto addDecimalDigit(char c) -> void {
+        uint64_t next;
+        if (__builtin_mul_overflow(value, 10, &next) ||
+            __builtin_add_overflow(next, static_cast<uint64_t>(c - '0'),
+                                   &next)) {
+            overflowed = true;
+            return;
+        }
+        value = next;
+    }
+
+    // This method will append a digit of a radix with the given number of bits
+    // per digit.
+    inline auto addRadixDigit(unsigned bitsPerDigit, unsigned digit) -> void {
+        if (!overflowed && (value >> (64 - bitsPerDigit)) == 0) {
+            value = value << bitsPerDigit | digit;
+            return;
+        }
+        overflowed = true;
+        sticky |= digit;
+        droppedBits += static_cast<int>(bitsPerDigit);
+    }
+
+    // This method will return the nearest double to an overflowed literal of
+    // a power of two radix. The dropped bits only matter for rounding, so they
+    // are folded into the lowest bit, which is far below the rounding point.
+    [[nodiscard]] auto toRadixDouble() const -> double;
+};
+
+// This struct accumulates the significand and the decimal exponent of a float
+// literal. Only the first 19 or so significant digits fit in the significand.
+// If a dropped digit is not zero, the value is marked as truncated and it will
+// be converted from its lexeme instead.
+struct DecimalAccumulator {
+    uint64_t significand = 0;
+    int64_t exponent = 0;
+    bool truncated = false;
+
+    // This method will append a digit before the decimal point.
+    inline auto addIntegerDigit(char c) -> void {
+        if (significand <= (UINT64_MAX - 9) / 10) {
+            significand = significand * 10 + static_cast<uint64_t>(c - '0');
+            return;
+        }
+        truncated |= c != '0';
+        ++exponent;
+    }
+
+    // This method will append a digit after the decimal point.
+    inline auto addFractionDigit(char c) -> void {
+        if (significand <= (UINT64_MAX - 9) / 10) {
+            significand = significand * 10 + static_cast<uint64_t>(c - '0');
+            --exponent;
+            return;
+        }
+        truncated |= c != '0';
+    }
+};
+
+// This function will return the nearest double to a decimal literal. When the
+// significand and the exponent are small enough, the result is computed with a
+// single exact double operation. Otherwise, the lexeme is parsed with its
+// numeric separators removed.
+auto convertDecimalToDouble(const DecimalAccumulator &decimal,
+                            llvm::StringRef lexeme) -> double;
+
+// This function will compute the 64-bit limbs of a BigInt literal whose value
+// does not fit in a single limb. The digits may contain numeric separators but
+// no prefix or suffix. The limbs are stored least significant first.
+auto computeBigIntLimbs(llvm::StringRef digits, unsigned radix,
+                        llvm::SmallVectorImpl<uint64_t> &limbs) -> void;
+} // namespace ntsc
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef NTSC_PUNCTUATORTABLE_H
+#define NTSC_PUNCTUATORTABLE_H
+#include "Token.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/*
+    This file defines the trie used by the Lexer to scan punctuators. The trie
+    is built at compile time from TokenKinds.def, so adding a punctuator there
+    is all that is needed for the Lexer to recognize it. A match walks one
+    state per character and remembers the last accepting state, which gives
+    the longest punctuator at the pointer.
+*/
+
+namespace ntsc {
+namespace punctuators {
+// This struct describes a single punctuator.
+struct Punctuator {
+    const char *spelling;
+    size_t length;
+    TokenKind kind;
+};
+
+// This is the list of every punctuator.
+constexpr Punctuator list[] = {
+#define PUNCTUATOR(name, spelling)                                             \
+    {spelling, sizeof(spelling) - 1, TokenKind::name},
+#include "TokenKinds.def"
+};
+constexpr size_t count = sizeof(list) / sizeof(list[0]);
+
+// This table maps each character that appears in a punctuator to a column of
+// the transition table plus one. Every other character maps to 0, which ends
+// a match. This keeps the transition table small enough to stay in the L1
+// cache.
+constexpr auto columns = [] {
+    std::array<uint8_t, 256> table{};
+    uint8_t nextColumn = 1;
+    for (auto &punctuator : list) {
+        for (size_t i = 0; i < punctuator.length; ++i) {
+            auto &column = table[static_cast<uint8_t>(punctuator.spelling[i])];
+            if (column == 0)
+                column = nextColumn++;
+        }
+    }
+    return table;
+}();
+
+// This function will count the distinct characters of every punctuator.
+[[nodiscard]] constexpr auto countColumns() -> size_t {
+    size_t columnCount = 0;
+    for (auto column : columns)
+        columnCount = column > columnCount ? column : columnCount;
+    return columnCount;
+}
+constexpr size_t columnCount = countColumns();
+
+// The trie cannot have more states than the root plus one state per
+// character of every spelling.
+[[nodiscard]] constexpr auto countMaxStates() -> size_t {
+    size_t stateCount = 1;
+    for (auto &punctuator : list)
+        stateCount += punctuator.length;
+    return stateCount;
+}
+constexpr size_t maxStateCount = countMaxStates();
+
+// This value marks the states that do not end a punctuator.
+constexpr uint8_t noKind = 0xff;
+
+// This struct is the trie. State 0 is the root, so a transition to 0 marks a
+// missing edge, since no edge can lead back to the root.
+struct Trie {
+    std::array<std::array<uint8_t, columnCount>, maxStateCount> next{};
+    std::array<uint8_t, maxStateCount> kinds{};
+    size_t stateCount = 1;
+};
+
+// This function will build the trie by inserting every spelling.
+[[nodiscard]] constexpr auto buildTrie() -> Trie {
+    Trie trie{};
+    for (auto &kind : trie.kinds)
+        kind = noKind;
+    for (auto &punctuator : list) {
+        size_t state = 0;
+        for (size_t i = 0; i < punctuator.length; ++i) {
+            auto column =
+                columns[static_cast<uint8_t>(punctuator.spelling[i])] - 1;
+            if (trie.next[state][column] == 0)
+                trie.next[state][column] =
+                    static_cast<uint8_t>(trie.stateCount++);
+            state = trie.next[state][column];
+        }
+        trie.kinds[state] = static_cast<uint8_t>(punctuator.kind);
+    }
+    return trie;
+}
+
+constexpr auto trie = buildTrie();
+
+// This function will find the longest punctuator at the pointer, and return
+// its length, or 0 if there is none. The buffer must be null terminated, and
+// the null character never continues a match.
+[[nodiscard]] constexpr auto match(const char *ptr, TokenKind &kind)
+    -> size_t {
+    size_t state = 0, length = 0;
+    for (size_t i = 0;; ++i) {
+        auto column = columns[static_cast<uint8_t>(ptr[i])];
+        if (column == 0)
+            return length;
+        state = trie.next[state][column - 1];
+        if (state == 0)
+            return length;
+        if (trie.kinds[state] != noKind) {
+            kind = static_cast<TokenKind>(trie.kinds[state]);
+            length = i + 1;
+        }
+    }
+}
+
+// This function will check that every punctuator matches itself in full. This
+// fails if two punctuators share a spelling.
+[[nodiscard]] constexpr auto isComplete() -> bool {
+    for (auto &punctuator : list) {
+        TokenKind kind{};
+        if (match(punctuator.spelling, kind) != punctuator.length ||
+            kind != punctuator.kind)
+            return false;
+    }
+    return true;
+}
+
+static_assert(maxStateCount < 256, "the punctuator trie uses 8 bit states");
+static_assert(isComplete(), "a punctuator cannot be matched by the trie");
+} // namespace punctuators
+} // namespace ntsc
+
+#endif
@@ -0,0 +1,154 @@
+#include "StreamingLexer.h"
+#include <cstring>
+
+/*
+    This file implements the StreamingLexer interface. Each batch lexes the
+    whole window, which ends with a null character like any other buffer.
+    Unless the input has ended, the tokens near the end of the window may be
+    cut short by that null character, so they are dropped and lexed again with
+    the next chunk. The window only grows when a single token, together with
+    the comments and whitespace before it, is longer than a chunk.
+*/
+
+namespace ntsc {
+// A token never depends on more than this many characters past its end, as in
+// '?.5'. Tokens that end closer than this to the end of the window are lexed
+// again once more input has been read.
+static constexpr size_t lookaheadMargin = 4;
+
+// This is the implementation of the primary constructor.
+StreamingLexer::StreamingLexer(llvm::sys::fs::file_t input,
+                               const SourceFile &file,
+                               DiagnosticsEngine &diags,
+                               IdentifierTable &identifiers, size_t chunkSize)
+    : input{input}, chunkSize{std::max<size_t>(chunkSize, 4096)}, file{file},
+      diags{diags}, identifiers{identifiers},
+      stagedDiags{diags.getSourceManager()} {}
+
+// This is the implementation of the method to read the input. The window is
+// reallocated when it is too small, which only happens for very long tokens.
+auto StreamingLexer::fill(size_t size) -> std::error_code {
+    if (capacity < size + 1) {
+        auto newCapacity = std::max(size + 1, capacity * 2);
+        auto newWindow = std::make_unique<char[]>(newCapacity);
+        std::memcpy(newWindow.get(), window.get(), dataSize);
+        window = std::move(newWindow);
+        capacity = newCapacity;
+    }
+
+    while (!inputDone && dataSize < size) {
+        auto bytesRead = llvm::sys::fs::readNativeFile(
+            input, {window.get() + dataSize, capacity - 1 - dataSize});
+        if (!bytesRead)
+            return llvm::errorToErrorCode(bytesRead.takeError());
+        if (*bytesRead == 0)
+            inputDone = true;
+        dataSize += *bytesRead;
+    }
+
+    // Offsets are 32 bits wide, so inputs must be smaller than 4 GiB.
+    if (uint64_t{windowOffset} + dataSize > UINT32_MAX)
+        return std::make_error_code(std::errc::file_too_large);
+    window[dataSize] = 0;
+    return {};
+}
+
+// This is the implementation of the method to forward diagnostics. Their
+// locations are found while the text is still in the window, and the
+// arguments that point into it are copied into the file.
+auto StreamingLexer::forwardDiagnostics() -> void {
+    for (auto diagnostic : stagedDiags.takeDiagnostics()) {
+        auto offset = windowOffset + diagnostic.offset;
+        locations.advance(window.get() + (locations.getOffset() - windowOffset),
+                          window.get() + dataSize, offset);
+        file.recordLocation(offset, locations.getLocation());
+
+        for (uint8_t i = 0; i < diagnostic.argCount; ++i) {
+            auto &arg = diagnostic.args[i];
+            if (arg.data() >= window.get() &&
+                arg.data() < window.get() + capacity)
+                arg = file.retainText(arg);
+        }
+        diagnostic.offset = offset;
+        diags.report(diagnostic);
+        lexerFailed = true;
+    }
+}
+
+// This is the implementation of the method to lex the next batch.
+auto StreamingLexer::lexNext(TokenBuffer &tokens) -> llvm::ErrorOr<bool> {
+    tokens.clear();
+    if (finished)
+        return false;
+
+    // The text of the last batch is released now that the caller is done with
+    // it. The location tracker must first be moved past it.
+    if (consumedSize != 0) {
+        locations.advance(window.get() + (locations.getOffset() - windowOffset),
+                          window.get() + dataSize,
+                          windowOffset + static_cast<uint32_t>(consumedSize));
+        std::memmove(window.get(), window.get() + consumedSize,
+                     dataSize - consumedSize);
+        dataSize -= consumedSize;
+        windowOffset += static_cast<uint32_t>(consumedSize);
+        consumedSize = 0;
+    }
+
+    auto size = chunkSize + lookaheadMargin;
+    while (true) {
+        if (auto ec = fill(size))
+            return ec;
+
+        SourceFile windowFile{file.getPath(), window.get(),
+                              window.get() + dataSize, file.getID()};
+        Lexer lexer{windowFile, stagedDiags, identifiers, 0, state};
+        lexer.lexAll(tokens);
+
+        // Once the input has ended, the null character is the real end of the
+        // file, so every token is accepted. Otherwise, the end of the file
+        // token and every token that ends too close to the end of the window
+        // are dropped.
+        auto accepted = tokens.size();
+        if (!inputDone) {
+            auto limit = dataSize - std::min(dataSize, lookaheadMargin);
+            while (accepted != 0 &&
+                   (tokens.kind(accepted - 1) == TokenKind::FileEnd ||
+                    tokens.offset(accepted - 1) +
+                            tokens.length(accepted - 1) >
+                        limit))
+                --accepted;
+
+            // If not even one token fits, the window is grown by a chunk and
+            // lexed again.
+            if (accepted == 0) {
+                tokens.clear();
+                stagedDiags.takeDiagnostics();
+                size = dataSize + chunkSize;
+                continue;
+            }
+
+            // A diagnostic cannot be matched to its token by offset alone,
+            // since one may point just past the token it belongs to. So, if
+            // there are any, the accepted tokens are lexed again on their own,
+            // which only reports the diagnostics that belong to them.
+            if (!stagedDiags.takeDiagnostics().empty()) {
+                tokens.clear();
+                Lexer lexer{windowFile, stagedDiags, identifiers, 0, state};
+                lexer.lexChunk(tokens, accepted);
+            }
+        }
+
+        auto acceptedSize = inputDone ? dataSize
+                                      : tokens.offset(accepted - 1) +
+                                            tokens.length(accepted - 1);
+        tokens.truncate(accepted);
+        for (auto kind : tokens.getKinds())
+            state.advance(kind);
+        forwardDiagnostics();
+        tokens.shiftOffsets(0, windowOffset);
+        consumedSize = acceptedSize;
+        finished = inputDone;
+        return true;
+    }
+}
+} // namespace ntsc
@@ -0,0 +1,95 @@
+#ifndef NTSC_STREAMINGLEXER_H
+#define NTSC_STREAMINGLEXER_H
+#include "Diagnostics.h"
+#include "IdentifierTable.h"
+#include "Lexer.h"
+#include "SourceFile.h"
+#include "TokenBuffer.h"
+#include "llvm/Support/ErrorOr.h"
+#include "llvm/Support/FileSystem.h"
+#include <memory>
+
+/*
+    This file defines the StreamingLexer interface. It lexes an input that is
+    read in fixed-size chunks, such as a pipe or stdin, so that only a window
+    of the text is in memory at any time. The Lexer still scans a contiguous,
+    null terminated buffer, so its inner loops are unchanged.
+*/
+
+namespace ntsc {
+class StreamingLexer {
+    // This is the input, which is read a chunk at a time.
+    llvm::sys::fs::file_t input;
+    size_t chunkSize;
+
+    // This is the window of the input that is in memory. It holds dataSize
+    // bytes of text starting at windowOffset in the input, followed by a null
+    // character.
+    std::unique_ptr<char[]> window;
+    size_t capacity = 0, dataSize = 0;
+    uint32_t windowOffset = 0;
+
+    // This is the size of the prefix of the window that holds the tokens of
+    // the last batch. It is released when the next batch is lexed.
+    size_t consumedSize = 0;
+
+    // This is the state of the Lexer after the last batch, which the Lexer of
+    // the next batch starts with.
+    LexerState state;
+
+    // These track whether the end of the input has been read, whether the
+    // last batch has been returned, and whether any diagnostic was reported.
+    bool inputDone = false, finished = false, lexerFailed = false;
+
+    // This is the streamed file, which records the locations of diagnostics
+    // and keeps their arguments.
+    const SourceFile &file;
+
+    DiagnosticsEngine &diags;
+    IdentifierTable &identifiers;
+
+    // This engine holds the diagnostics of the current window until it is
+    // known which tokens are accepted.
+    DiagnosticsEngine stagedDiags;
+
+    // This finds the locations of diagnostics as the text streams past.
+    LocationTracker locations;
+
+    // This method will read from the input until the window holds at least
+    // the given number of bytes, or the input ends.
+    auto fill(size_t size) -> std::error_code;
+
+    // This method will forward the staged diagnostics to the real engine.
+    auto forwardDiagnostics() -> void;
+
+  public:
+    // This is the default chunk size.
+    static constexpr size_t defaultChunkSize = 1 << 20;
+
+    // This constructor will be used to instantiate a StreamingLexer over an
+    // open input. The file must be a streamed file of the engine's
+    // SourceManager.
+    StreamingLexer(llvm::sys::fs::file_t input, const SourceFile &file,
+                   DiagnosticsEngine &diags, IdentifierTable &identifiers,
+                   size_t chunkSize = defaultChunkSize);
+
+    // This method will replace the contents of the TokenBuffer with the next
+    // batch of tokens. Their offsets are from the start of the input, and
+    // their text stays valid until the next call. The last batch ends with
+    // the end of the file, and after it, this returns false with an empty
+    // buffer.
+    auto lexNext(TokenBuffer &tokens) -> llvm::ErrorOr<bool>;
+
+    // This method will return the text at the given range of the input. The
+    // range must be within the last batch.
+    [[nodiscard]] inline auto getText(uint32_t offset, uint32_t length) const
+        -> llvm::StringRef {
+        return {window.get() + (offset - windowOffset), length};
+    }
+
+    // This method will return whether any diagnostic has been reported.
+    [[nodiscard]] inline auto failed() const -> bool { return lexerFailed; }
+};
+} // namespace ntsc
+
+#endif
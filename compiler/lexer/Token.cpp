@@ -0,0 +1,17 @@
+#include "Token.h"
+
+/*
+    This file implements the helper functions for the Token interface.
+*/
+
+namespace ntsc {
+// This is the implementation of the function that returns the name of a
+// TokenKind. The names are generated from TokenKinds.def.
+auto getTokenKindName(TokenKind kind) -> const char * {
+    static const char *const names[] = {
+#define TOKEN(name) #name,
+#include "TokenKinds.def"
+    };
+    return names[static_cast<uint8_t>(kind)];
+}
+} // namespace ntsc
@@ -1,6 +1,9 @@
 #ifndef NTSC_TOKEN_H
 #define NTSC_TOKEN_H
+#include "IdentifierTable.h"
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/StringRef.h"
+#include <cstdint>
 
 /*
     This file defines the Token and TokenKind interfaces.
@@ -9,105 +12,92 @@
 
 namespace ntsc {
 
-enum class TokenKind {
-    FileEnd,
+enum class TokenKind : uint8_t {
+#define TOKEN(name) name,
+#include "TokenKinds.def"
+};
 
-    // Punctuators
-    LeftCurly,
-    RightCurly,
-    LeftParenthasis,
-    RightParenthasis,
-    LeftSquare,
-    RightSquare,
-    Dot,
-    DotDotDot,
-    Semicolon,
-    Comma,
-    Less,
-    Greater,
-    LessEquals,
-    GreaterEquals,
-    EqualsEquals,
-    ExclaimationEquals,
-    EqualsEqualsEquals,
-    ExclaimationEqualsEquals,
-    EqualsGreater,
-    Plus,
-    Minus,
-    AsteriskAsterisk,
-    Asterisk,
-    Slash,
-    Percent,
-    PlusPlus,
-    MinusMinus,
-    LessLess,
-    LessSlash,
-    GreaterGreater,
-    GreaterGreaterGreater,
-    Ampersand,
-    Bar,
-    Caret,
-    Exclaimation,
-    Tilde,
-    AmpersandAmpersand,
-    BarBar,
-    Question,
-    QuestionQuestion,
-    QuestionDot,
-    Colon,
-    Equals,
-    PlusEquals,
-    MinusEquals,
-    AsteriskEquals,
-    AsteriskAsteriskEquals,
-    SlashEquals,
-    PercentEquals,
-    LessLessEquals,
-    GreaterGreaterEquals,
-    GreaterGreaterGreaterEquals,
-    AmpersandEquals,
-    BarEquals,
-    CaretEquals,
-    BarBarEquals,
-    AmpersandAmpersandEquals,
-    QuestionQuestionEquals,
+// This function will return the name of the given TokenKind for debugging
+// purposes.
+auto getTokenKindName(TokenKind kind) -> const char *;
 
-    // Literals
-    // We will add these special zero literals to eliminate the need for parsing
-    // the value.
-    ZeroLiteral,
-    ZeroBigIntLiteral,
-    DecimalLiteral,
-    DecimalBigIntLiteral,
-    FloatLiteral,
-    HexLiteral,
-    HexBigIntLiteral,
-    OctalLiteral,
-    OctalBigIntLiteral,
-    BinaryLiteral,
-    BinaryBigIntLiteral,
-    StringLiteral
-};
+// This function will determine whether the given kind is a BigInt literal.
+[[nodiscard]] inline auto isBigIntLiteral(TokenKind kind) -> bool {
+    switch (kind) {
+    case TokenKind::ZeroBigIntLiteral:
+    case TokenKind::DecimalBigIntLiteral:
+    case TokenKind::HexBigIntLiteral:
+    case TokenKind::OctalBigIntLiteral:
+    case TokenKind::BinaryBigIntLiteral:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// This function will determine whether the given kind is a numeric literal
+// other than a BigInt literal.
+[[nodiscard]] inline auto isNumberLiteral(TokenKind kind) -> bool {
+    switch (kind) {
+    case TokenKind::ZeroLiteral:
+    case TokenKind::DecimalLiteral:
+    case TokenKind::FloatLiteral:
+    case TokenKind::HexLiteral:
+    case TokenKind::OctalLiteral:
+    case TokenKind::BinaryLiteral:
+        return true;
+    default:
+        return false;
+    }
+}
 
 struct Token {
     TokenKind kind;
-    int line, col;
-    llvm::StringRef text;
     bool afterLineTerminator;
 
-    inline auto set(TokenKind kind, int line, int col, bool afterLineTerminator)
+    // This is the byte offset of the first character of the token's lexeme in
+    // the source file. Lines and columns are computed from it on demand.
+    uint32_t offset;
+    llvm::StringRef text;
+
+    // This is the interned name of an identifier or keyword, or the interned
+    // value of a string literal, template chunk or regular expression literal.
+    // It is invalid for every other token, and for a template chunk with an
+    // invalid escape sequence, whose cooked value is undefined.
+    Symbol symbol;
+
+    // This is the cooked value of a string literal or template chunk, with its
+    // escape sequences decoded. It is the same as text when there are none, so
+    // most strings are never copied. Otherwise, it is the interned string,
+    // which lives as long as the IdentifierTable.
+    llvm::StringRef value;
+
+    // This is the value of a numeric literal. Integer literals hold their
+    // exact value in intValue. If it does not fit in 64 bits, isFloatValue is
+    // set and floatValue holds the nearest double instead, as it does for
+    // float literals.
+    union {
+        uint64_t intValue;
+        double floatValue;
+    };
+    bool isFloatValue;
+
+    // This is the value of a BigInt literal as 64-bit limbs, least significant
+    // first. Zero has no limbs. The limbs are owned by the Lexer and are only
+    // valid until the next token is scanned, so TokenBuffer copies them.
+    llvm::ArrayRef<uint64_t> bigIntLimbs;
+
+    inline auto set(TokenKind kind, uint32_t offset, bool afterLineTerminator)
         -> void {
         this->kind = kind;
-        this->line = line;
-        this->col = col;
+        this->offset = offset;
         this->afterLineTerminator = afterLineTerminator;
     }
 
-    inline auto set(TokenKind kind, int line, int col, bool afterLineTerminator,
+    inline auto set(TokenKind kind, uint32_t offset, bool afterLineTerminator,
                     llvm::StringRef text) -> void {
         this->kind = kind;
-        this->line = line;
-        this->col = col;
+        this->offset = offset;
         this->afterLineTerminator = afterLineTerminator;
         this->text = text;
     }
@@ -0,0 +1,140 @@
+#include "TokenBuffer.h"
+
+/*
+    This file implements the parts of the TokenBuffer interface that are too
+    large to inline.
+*/
+
+namespace ntsc {
+// This function will read the given number of bits, at most 64, starting at an
+// arbitrary bit index of the bitset.
+[[nodiscard]] static inline auto readBits(const std::vector<uint64_t> &bits,
+                                          size_t index, size_t count)
+    -> uint64_t {
+    auto shift = index % 64;
+    auto value = bits[index / 64] >> shift;
+    if (shift != 0 && shift + count > 64)
+        value |= bits[index / 64 + 1] << (64 - shift);
+    return count == 64 ? value : value & ((uint64_t{1} << count) - 1);
+}
+
+// This function will copy a range of bits from one bitset into a zeroed range
+// of another, a word at a time.
+static auto copyBits(const std::vector<uint64_t> &source, size_t sourceIndex,
+                     std::vector<uint64_t> &dest, size_t destIndex,
+                     size_t count) -> void {
+    while (count != 0) {
+        auto chunk = std::min<size_t>(count, 64);
+        auto value = readBits(source, sourceIndex, chunk);
+        auto shift = destIndex % 64;
+        dest[destIndex / 64] |= value << shift;
+        if (shift != 0 && shift + chunk > 64)
+            dest[destIndex / 64 + 1] |= value >> (64 - shift);
+        sourceIndex += chunk;
+        destIndex += chunk;
+        count -= chunk;
+    }
+}
+
+// This is the implementation of the method to splice a token stream. An edit
+// inside a token usually keeps the number of tokens, in which case the columns
+// are overwritten in place. Otherwise, the plain columns are moved with a
+// single erase and insert each. The payloads of the inserted numeric literals
+// index into the value tables of the replacement, so their values are
+// appended to ours and the payloads are rebased.
+auto TokenBuffer::splice(size_t first, size_t last,
+                         const TokenBuffer &replacement, int64_t offsetDelta)
+    -> void {
+    auto oldSize = size(), count = replacement.size();
+    auto newSize = oldSize - (last - first) + count;
+    auto inPlace = count == last - first;
+    for (auto i = first; i < last; ++i)
+        deadValueCount +=
+            isNumberLiteral(kinds[i]) || isBigIntLiteral(kinds[i]);
+
+    // The bitset cannot be shifted in place by a number of bits that is not a
+    // multiple of 64, so it is rebuilt from its three parts unless the number
+    // of tokens stays the same.
+    if (inPlace) {
+        for (size_t i = 0; i < count; ++i) {
+            auto &word = lineTerminatorBits[(first + i) / 64];
+            auto bit = uint64_t{1} << ((first + i) % 64);
+            word = replacement.afterLineTerminator(i) ? word | bit
+                                                      : word & ~bit;
+        }
+    } else {
+        std::vector<uint64_t> bits((newSize + 63) / 64, 0);
+        copyBits(lineTerminatorBits, 0, bits, 0, first);
+        copyBits(replacement.lineTerminatorBits, 0, bits, first, count);
+        copyBits(lineTerminatorBits, last, bits, first + count,
+                 oldSize - last);
+        lineTerminatorBits = std::move(bits);
+    }
+
+    auto spliceColumn = [&](auto &column, const auto &replacementColumn) {
+        if (inPlace) {
+            std::copy(replacementColumn.begin(), replacementColumn.end(),
+                      column.begin() + first);
+            return;
+        }
+        column.erase(column.begin() + first, column.begin() + last);
+        column.insert(column.begin() + first, replacementColumn.begin(),
+                      replacementColumn.end());
+    };
+    spliceColumn(kinds, replacement.kinds);
+    spliceColumn(offsets, replacement.offsets);
+    spliceColumn(lengths, replacement.lengths);
+    spliceColumn(payloads, replacement.payloads);
+
+    auto numberBase = static_cast<uint32_t>(numberValues.size());
+    auto bigIntBase = static_cast<uint32_t>(bigIntValues.size());
+    numberValues.insert(numberValues.end(), replacement.numberValues.begin(),
+                        replacement.numberValues.end());
+    for (auto limbs : replacement.bigIntValues) {
+        auto *copy = bigIntAllocator.Allocate<uint64_t>(limbs.size());
+        std::copy(limbs.begin(), limbs.end(), copy);
+        bigIntValues.emplace_back(copy, limbs.size());
+    }
+    for (auto i = first; i < first + count; ++i) {
+        if (isNumberLiteral(kinds[i]))
+            payloads[i] += numberBase;
+        else if (isBigIntLiteral(kinds[i]))
+            payloads[i] += bigIntBase;
+    }
+
+    shiftOffsets(first + count, offsetDelta);
+
+    // The dead values are only reclaimed once they are most of the values and
+    // an eighth as many as the tokens, so a compaction, which reads every
+    // token, costs a constant amount for each value that it reclaims.
+    if (deadValueCount * 2 > numberValues.size() + bigIntValues.size() &&
+        deadValueCount * 8 > size())
+        compactValues();
+}
+
+// This is the implementation of the method to compact the value tables. The
+// limbs of the BigInt literals are copied to a new allocator, which releases
+// those of the removed literals along with the old one.
+auto TokenBuffer::compactValues() -> void {
+    std::vector<uint64_t> numbers;
+    std::vector<llvm::ArrayRef<uint64_t>> bigInts;
+    llvm::BumpPtrAllocator allocator;
+    for (size_t i = 0; i < size(); ++i) {
+        if (isNumberLiteral(kinds[i])) {
+            auto index = static_cast<uint32_t>(numbers.size());
+            numbers.push_back(numberValues[payloads[i] & ~floatValueBit]);
+            payloads[i] = (payloads[i] & floatValueBit) | index;
+        } else if (isBigIntLiteral(kinds[i])) {
+            auto limbs = bigIntValues[payloads[i]];
+            auto *copy = allocator.Allocate<uint64_t>(limbs.size());
+            std::copy(limbs.begin(), limbs.end(), copy);
+            payloads[i] = static_cast<uint32_t>(bigInts.size());
+            bigInts.emplace_back(copy, limbs.size());
+        }
+    }
+    numberValues = std::move(numbers);
+    bigIntValues = std::move(bigInts);
+    bigIntAllocator = std::move(allocator);
+    deadValueCount = 0;
+}
+} // namespace ntsc
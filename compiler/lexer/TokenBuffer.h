@@ -0,0 +1,216 @@
+#ifndef NTSC_TOKENBUFFER_H
+#define NTSC_TOKENBUFFER_H
+#include "Token.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/Support/Allocator.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/*
+    This file defines the TokenBuffer interface, which stores a whole token
+    stream as a struct of arrays. It is filled by Lexer::lexChunk and
+    Lexer::lexAll, so the Parser can look ahead and backtrack by index instead
+    of re-lexing.
+*/
+
+namespace ntsc {
+class TokenBuffer {
+    // The TokenCache reads and writes the columns directly.
+    friend class TokenCache;
+
+    // These are the columns of the token stream. The offset and length of each
+    // token describe its full lexeme in the source buffer, including quotes,
+    // radix prefixes and BigInt suffixes.
+    std::vector<TokenKind> kinds;
+    std::vector<uint32_t> offsets, lengths;
+
+    // This is the payload of each token. It holds the Symbol of identifiers,
+    // keywords, and string, template and regular expression literals. For
+    // numeric literals, it holds the index of the value in the tables below,
+    // and for number literals the top bit is set when the value is stored as
+    // a double.
+    std::vector<uint32_t> payloads;
+    static constexpr uint32_t floatValueBit = 1u << 31;
+
+    // These are the values of the numeric literals. Number literals store
+    // either a uint64_t or the bits of a double, while BigInt literals store
+    // their limbs in the allocator.
+    std::vector<uint64_t> numberValues;
+    std::vector<llvm::ArrayRef<uint64_t>> bigIntValues;
+    llvm::BumpPtrAllocator bigIntAllocator;
+
+    // This is the number of values in the tables above whose tokens were
+    // removed by splice. They are reclaimed once they are too many.
+    size_t deadValueCount = 0;
+
+    // This is a bitset that tracks which tokens follow a line terminator. It is
+    // needed for Automatic Semicolon Insertion.
+    std::vector<uint64_t> lineTerminatorBits;
+
+    // This method will rebuild the value tables with only the values that a
+    // token still refers to.
+    auto compactValues() -> void;
+
+  public:
+    // This method will return the number of tokens in the buffer.
+    [[nodiscard]] inline auto size() const -> size_t { return kinds.size(); }
+
+    // This method will return the kinds of every token, so that they can be
+    // scanned in bulk.
+    [[nodiscard]] inline auto getKinds() const -> llvm::ArrayRef<TokenKind> {
+        return kinds;
+    }
+
+    // These methods will return the columns of the token at the given index.
+    [[nodiscard]] inline auto kind(size_t i) const -> TokenKind {
+        return kinds[i];
+    }
+    [[nodiscard]] inline auto offset(size_t i) const -> uint32_t {
+        return offsets[i];
+    }
+    [[nodiscard]] inline auto length(size_t i) const -> uint32_t {
+        return lengths[i];
+    }
+    [[nodiscard]] inline auto symbol(size_t i) const -> Symbol {
+        return Symbol{payloads[i]};
+    }
+
+    // These methods will return the value of the number literal at the given
+    // index. intValue is only valid when isFloatValue is false, and
+    // numberValue converts either representation to a double.
+    [[nodiscard]] inline auto isFloatValue(size_t i) const -> bool {
+        return payloads[i] & floatValueBit;
+    }
+    [[nodiscard]] inline auto intValue(size_t i) const -> uint64_t {
+        return numberValues[payloads[i] & ~floatValueBit];
+    }
+    [[nodiscard]] inline auto floatValue(size_t i) const -> double {
+        double value;
+        std::memcpy(&value, &numberValues[payloads[i] & ~floatValueBit],
+                    sizeof(value));
+        return value;
+    }
+    [[nodiscard]] inline auto numberValue(size_t i) const -> double {
+        return isFloatValue(i) ? floatValue(i)
+                               : static_cast<double>(intValue(i));
+    }
+
+    // This method will return the limbs of the BigInt literal at the given
+    // index, least significant first.
+    [[nodiscard]] inline auto bigIntLimbs(size_t i) const
+        -> llvm::ArrayRef<uint64_t> {
+        return bigIntValues[payloads[i]];
+    }
+    [[nodiscard]] inline auto afterLineTerminator(size_t i) const -> bool {
+        return (lineTerminatorBits[i / 64] >> (i % 64)) & 1;
+    }
+
+    // This method will append a token to the end of the buffer. The offset
+    // and length describe the full lexeme of the token.
+    inline auto push(const Token &tok, uint32_t offset, uint32_t length)
+        -> void {
+        auto i = kinds.size();
+        if (i % 64 == 0)
+            lineTerminatorBits.push_back(0);
+        lineTerminatorBits.back() |= uint64_t{tok.afterLineTerminator}
+                                     << (i % 64);
+        kinds.push_back(tok.kind);
+        offsets.push_back(offset);
+        lengths.push_back(length);
+
+        if (isNumberLiteral(tok.kind)) {
+            // The value is copied as raw bits, since it may be a double.
+            uint64_t bits;
+            std::memcpy(&bits, &tok.intValue, sizeof(bits));
+            auto index = static_cast<uint32_t>(numberValues.size());
+            numberValues.push_back(bits);
+            payloads.push_back(tok.isFloatValue ? index | floatValueBit
+                                                : index);
+        } else if (isBigIntLiteral(tok.kind)) {
+            auto *limbs =
+                bigIntAllocator.Allocate<uint64_t>(tok.bigIntLimbs.size());
+            std::copy(tok.bigIntLimbs.begin(), tok.bigIntLimbs.end(), limbs);
+            payloads.push_back(static_cast<uint32_t>(bigIntValues.size()));
+            bigIntValues.emplace_back(limbs, tok.bigIntLimbs.size());
+        } else {
+            payloads.push_back(tok.symbol.getValue());
+        }
+    }
+
+    // This method will replace the tokens in [first, last) with every token of
+    // the given buffer, and shift the offsets of the tokens after them by the
+    // given amount. It is used to reuse the token stream after an edit, so the
+    // values of the removed numeric literals are reclaimed as it goes.
+    auto splice(size_t first, size_t last, const TokenBuffer &replacement,
+                int64_t offsetDelta) -> void;
+
+    // This method will add the given amount to the offsets of every token
+    // from the given index onwards.
+    inline auto shiftOffsets(size_t first, int64_t offsetDelta) -> void {
+        for (auto i = first; i < offsets.size(); ++i)
+            offsets[i] = static_cast<uint32_t>(offsets[i] + offsetDelta);
+    }
+
+    // This method will remove every token after the first count tokens. The
+    // values of removed numeric literals are only reclaimed by clear().
+    inline auto truncate(size_t count) -> void {
+        kinds.resize(count);
+        offsets.resize(count);
+        lengths.resize(count);
+        payloads.resize(count);
+        lineTerminatorBits.resize((count + 63) / 64);
+        if (count % 64 != 0)
+            lineTerminatorBits.back() &= (uint64_t{1} << (count % 64)) - 1;
+    }
+
+    // This method will reserve space for the given number of tokens.
+    inline auto reserve(size_t count) -> void {
+        kinds.reserve(count);
+        offsets.reserve(count);
+        lengths.reserve(count);
+        payloads.reserve(count);
+        lineTerminatorBits.reserve(count / 64 + 1);
+    }
+
+    // This method will release the space reserved past the last token, for
+    // buffers that are kept after they are filled.
+    inline auto shrinkToFit() -> void {
+        kinds.shrink_to_fit();
+        offsets.shrink_to_fit();
+        lengths.shrink_to_fit();
+        payloads.shrink_to_fit();
+        numberValues.shrink_to_fit();
+        bigIntValues.shrink_to_fit();
+        lineTerminatorBits.shrink_to_fit();
+    }
+
+    // This method will return the number of bytes that the buffer holds.
+    [[nodiscard]] inline auto getMemorySize() const -> size_t {
+        return kinds.capacity() * sizeof(TokenKind) +
+               (offsets.capacity() + lengths.capacity() +
+                payloads.capacity()) *
+                   sizeof(uint32_t) +
+               numberValues.capacity() * sizeof(uint64_t) +
+               bigIntValues.capacity() * sizeof(llvm::ArrayRef<uint64_t>) +
+               bigIntAllocator.getTotalMemory() +
+               lineTerminatorBits.capacity() * sizeof(uint64_t);
+    }
+
+    // This method will remove all tokens from the buffer.
+    inline auto clear() -> void {
+        kinds.clear();
+        offsets.clear();
+        lengths.clear();
+        payloads.clear();
+        numberValues.clear();
+        bigIntValues.clear();
+        bigIntAllocator.Reset();
+        deadValueCount = 0;
+        lineTerminatorBits.clear();
+    }
+};
+} // namespace ntsc
+
+#endif
@@ -0,0 +1,319 @@
+#include "TokenCache.h"
+#include "UserOpts.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/xxhash.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+/*
+    This file implements the TokenCache interface. An entry is a header
+    followed by the columns of the token stream, each aligned to its element
+    size, so that a hit is a single mapping of the file, a validation pass and
+    a bulk copy of every column. The entries use the byte order of the host,
+    so a cache directory must not be shared between architectures.
+*/
+
+namespace ntsc {
+// This is the version of the entry format. It must be bumped whenever the
+// format or the output of the Lexer changes, so stale entries are rejected.
+static constexpr uint32_t entryVersion = 3;
+static constexpr char entryMagic[8] = {'N', 'T', 'S', 'C', 'T', 'O', 'K', 0};
+
+// This is the number of token kinds, which is used to validate the kinds
+// column.
+static constexpr uint8_t tokenKindCount = 0
+#define TOKEN(name) +1
+#include "TokenKinds.def"
+    ;
+
+// This struct is the header of an entry. The columns follow in this order:
+// the number values, the BigInt limbs and the line terminator bits as 64 bit
+// words, then the offsets, lengths and payloads, the BigInt ranges and the
+// name ranges as 32 bit words, and finally the kinds and the name bytes. The
+// payloads of names hold the index of the name in the entry plus one, since
+// Symbols are only valid within one IdentifierTable.
+struct EntryHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t optionsKey;
+    uint64_t key;
+    uint64_t sourceSize;
+    uint32_t tokenCount;
+    uint32_t numberCount;
+    uint32_t bigIntCount;
+    uint32_t limbCount;
+    uint32_t nameCount;
+    uint32_t nameBytes;
+};
+static_assert(sizeof(EntryHeader) % 8 == 0, "the columns must stay aligned");
+
+// This struct is a range of limbs or name bytes in an entry.
+struct EntryRange {
+    uint32_t start;
+    uint32_t length;
+};
+
+// This class reads the columns of an entry in order. The entry may be
+// truncated or corrupted, so every read is checked against its end. Once a
+// read fails, every later read fails too.
+class EntryReader {
+    const char *ptr, *endPtr;
+
+  public:
+    EntryReader(const char *ptr, const char *endPtr)
+        : ptr{ptr}, endPtr{endPtr} {}
+
+    // This method will return the next column of count elements, or nullptr
+    // if the entry is too short.
+    template <typename T>
+    [[nodiscard]] auto read(uint64_t count) -> const T * {
+        auto size = count * sizeof(T);
+        if (static_cast<uint64_t>(endPtr - ptr) < size) {
+            ptr = endPtr = nullptr;
+            return nullptr;
+        }
+        auto *column = reinterpret_cast<const T *>(ptr);
+        ptr += size;
+        return column;
+    }
+};
+
+// This function will append a column to an entry.
+template <typename T>
+static auto appendColumn(std::string &entry, const T *column, size_t count)
+    -> void {
+    entry.append(reinterpret_cast<const char *>(column), count * sizeof(T));
+}
+
+// This is the implementation of the method to compute the options key. Strict
+// mode changes how legacy octal literals are lexed.
+auto TokenCache::getOptionsKey() -> uint32_t {
+    return UserOpts::strictModeEnabled ? 1 : 0;
+}
+
+// This is the implementation of the method to compute the key of a file.
+auto TokenCache::getKey(const SourceFile &file) -> uint64_t {
+    return llvm::xxHash64(file.getBuffer());
+}
+
+// This is the implementation of the method to find the path of an entry. The
+// options are part of the name, so entries for both modes can coexist.
+auto TokenCache::getEntryPath(uint64_t key) const -> std::string {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx-%x.ntok",
+             static_cast<unsigned long long>(key), getOptionsKey());
+    llvm::SmallString<128> path{directory};
+    llvm::sys::path::append(path, name);
+    return std::string{path};
+}
+
+// This is the implementation of the method to load an entry. The whole entry is
+// validated before the TokenBuffer is touched, so a corrupted entry can never
+// produce an out of bounds payload.
+auto TokenCache::load(uint64_t key, const SourceFile &file,
+                      IdentifierTable &identifiers, TokenBuffer &tokens)
+    -> bool {
+    // Large entries are memory mapped by LLVM.
+    auto bufferResult =
+        llvm::MemoryBuffer::getFile(getEntryPath(key), /*IsText=*/false,
+                                    /*RequiresNullTerminator=*/false);
+    if (!bufferResult) {
+        ++missCount;
+        return false;
+    }
+
+    auto reject = [&] {
+        ++rejectedCount;
+        ++missCount;
+        return false;
+    };
+
+    auto &buffer = *bufferResult;
+    EntryReader reader{buffer->getBufferStart(), buffer->getBufferEnd()};
+    auto *header = reader.read<EntryHeader>(1);
+    if (!header || std::memcmp(header->magic, entryMagic, 8) != 0 ||
+        header->version != entryVersion ||
+        header->optionsKey != getOptionsKey() || header->key != key ||
+        header->sourceSize != file.getBuffer().size() ||
+        header->tokenCount == 0)
+        return reject();
+
+    auto tokenCount = header->tokenCount;
+    auto *numberValues = reader.read<uint64_t>(header->numberCount);
+    auto *limbs = reader.read<uint64_t>(header->limbCount);
+    auto *lineTerminatorBits = reader.read<uint64_t>((tokenCount + 63) / 64);
+    auto *offsets = reader.read<uint32_t>(tokenCount);
+    auto *lengths = reader.read<uint32_t>(tokenCount);
+    auto *payloads = reader.read<uint32_t>(tokenCount);
+    auto *bigInts = reader.read<EntryRange>(header->bigIntCount);
+    auto *names = reader.read<EntryRange>(header->nameCount);
+    auto *kinds = reader.read<uint8_t>(tokenCount);
+    auto *nameBytes = reader.read<char>(header->nameBytes);
+    if (!nameBytes)
+        return reject();
+
+    if (kinds[tokenCount - 1] != static_cast<uint8_t>(TokenKind::FileEnd))
+        return reject();
+    for (uint32_t i = 0; i < tokenCount; ++i) {
+        if (kinds[i] >= tokenKindCount ||
+            uint64_t{offsets[i]} + lengths[i] > header->sourceSize)
+            return reject();
+        auto kind = static_cast<TokenKind>(kinds[i]);
+        auto payload = payloads[i];
+        auto valid =
+            isNumberLiteral(kind)
+                ? (payload & ~TokenBuffer::floatValueBit) < header->numberCount
+            : isBigIntLiteral(kind) ? payload < header->bigIntCount
+                                    : payload <= header->nameCount;
+        if (!valid)
+            return reject();
+    }
+    for (uint32_t i = 0; i < header->bigIntCount; ++i) {
+        if (uint64_t{bigInts[i].start} + bigInts[i].length > header->limbCount)
+            return reject();
+    }
+    for (uint32_t i = 0; i < header->nameCount; ++i) {
+        if (uint64_t{names[i].start} + names[i].length > header->nameBytes)
+            return reject();
+    }
+
+    // Each distinct name is interned once, and the payloads of the names are
+    // mapped to their Symbols.
+    std::vector<uint32_t> symbols(header->nameCount + 1, 0);
+    for (uint32_t i = 0; i < header->nameCount; ++i)
+        symbols[i + 1] =
+            identifiers
+                .intern({nameBytes + names[i].start, names[i].length})
+                .getValue();
+
+    tokens.clear();
+    tokens.kinds.assign(reinterpret_cast<const TokenKind *>(kinds),
+                        reinterpret_cast<const TokenKind *>(kinds) +
+                            tokenCount);
+    tokens.offsets.assign(offsets, offsets + tokenCount);
+    tokens.lengths.assign(lengths, lengths + tokenCount);
+    tokens.payloads.assign(payloads, payloads + tokenCount);
+    tokens.lineTerminatorBits.assign(lineTerminatorBits,
+                                     lineTerminatorBits +
+                                         (tokenCount + 63) / 64);
+    tokens.numberValues.assign(numberValues,
+                               numberValues + header->numberCount);
+    for (uint32_t i = 0; i < tokenCount; ++i) {
+        auto kind = tokens.kinds[i];
+        if (!isNumberLiteral(kind) && !isBigIntLiteral(kind))
+            tokens.payloads[i] = symbols[tokens.payloads[i]];
+    }
+
+    auto *limbCopy = tokens.bigIntAllocator.Allocate<uint64_t>(
+        header->limbCount);
+    std::copy(limbs, limbs + header->limbCount, limbCopy);
+    tokens.bigIntValues.reserve(header->bigIntCount);
+    for (uint32_t i = 0; i < header->bigIntCount; ++i)
+        tokens.bigIntValues.emplace_back(limbCopy + bigInts[i].start,
+                                         bigInts[i].length);
+
+    ++hitCount;
+    return true;
+}
+
+// This is the implementation of the method to store an entry. The entry is
+// written to a temporary file and renamed into place, so concurrent
+// compilations sharing the directory never see a partial entry.
+auto TokenCache::store(uint64_t key, const SourceFile &file,
+                       const IdentifierTable &identifiers,
+                       const TokenBuffer &tokens) -> void {
+    auto tokenCount = static_cast<uint32_t>(tokens.size());
+
+    // The Symbols are replaced by indices into a table of the distinct names
+    // in this file.
+    llvm::DenseMap<uint32_t, uint32_t> nameIndices;
+    std::vector<EntryRange> names;
+    std::string nameBytes;
+    std::vector<uint32_t> payloads{tokens.payloads};
+    for (uint32_t i = 0; i < tokenCount; ++i) {
+        auto kind = tokens.kinds[i];
+        if (isNumberLiteral(kind) || isBigIntLiteral(kind) || !payloads[i])
+            continue;
+
+        auto inserted = nameIndices.try_emplace(
+            payloads[i], static_cast<uint32_t>(names.size() + 1));
+        if (inserted.second) {
+            auto name = identifiers.getName(Symbol{payloads[i]});
+            names.push_back({static_cast<uint32_t>(nameBytes.size()),
+                             static_cast<uint32_t>(name.size())});
+            nameBytes += name;
+        }
+        payloads[i] = inserted.first->second;
+    }
+
+    std::vector<uint64_t> limbs;
+    std::vector<EntryRange> bigInts;
+    for (auto value : tokens.bigIntValues) {
+        bigInts.push_back({static_cast<uint32_t>(limbs.size()),
+                           static_cast<uint32_t>(value.size())});
+        limbs.insert(limbs.end(), value.begin(), value.end());
+    }
+
+    EntryHeader header{};
+    std::memcpy(header.magic, entryMagic, 8);
+    header.version = entryVersion;
+    header.optionsKey = getOptionsKey();
+    header.key = key;
+    header.sourceSize = file.getBuffer().size();
+    header.tokenCount = tokenCount;
+    header.numberCount = static_cast<uint32_t>(tokens.numberValues.size());
+    header.bigIntCount = static_cast<uint32_t>(bigInts.size());
+    header.limbCount = static_cast<uint32_t>(limbs.size());
+    header.nameCount = static_cast<uint32_t>(names.size());
+    header.nameBytes = static_cast<uint32_t>(nameBytes.size());
+
+    std::string entry;
+    entry.reserve(sizeof(header) + size_t{tokenCount} * 17 + nameBytes.size());
+    appendColumn(entry, &header, 1);
+    appendColumn(entry, tokens.numberValues.data(), header.numberCount);
+    appendColumn(entry, limbs.data(), limbs.size());
+    appendColumn(entry, tokens.lineTerminatorBits.data(),
+                 (tokenCount + 63) / 64);
+    appendColumn(entry, tokens.offsets.data(), tokenCount);
+    appendColumn(entry, tokens.lengths.data(), tokenCount);
+    appendColumn(entry, payloads.data(), tokenCount);
+    appendColumn(entry, bigInts.data(), bigInts.size());
+    appendColumn(entry, names.data(), names.size());
+    appendColumn(entry, tokens.kinds.data(), tokenCount);
+    entry += nameBytes;
+
+    int fd;
+    llvm::SmallString<128> tempPath;
+    llvm::SmallString<128> model{directory};
+    llvm::sys::path::append(model, "%%%%%%%%%%%%.tmp");
+    if (llvm::sys::fs::createUniqueFile(model, fd, tempPath))
+        return;
+    {
+        llvm::raw_fd_ostream os{fd, /*shouldClose=*/true};
+        os << entry;
+        os.close();
+        if (os.has_error()) {
+            os.clear_error();
+            llvm::sys::fs::remove(tempPath);
+            return;
+        }
+    }
+    if (llvm::sys::fs::rename(tempPath, getEntryPath(key))) {
+        llvm::sys::fs::remove(tempPath);
+        return;
+    }
+    ++storeCount;
+}
+
+// This is the implementation of the method to print the statistics.
+auto TokenCache::printStatistics(llvm::raw_ostream &os) const -> void {
+    os << "token cache: " << hitCount.load() << " hits, " << missCount.load()
+       << " misses, " << storeCount.load() << " stores, "
+       << rejectedCount.load() << " rejected entries\n";
+}
+} // namespace ntsc
@@ -0,0 +1,62 @@
+#ifndef NTSC_TOKENCACHE_H
+#define NTSC_TOKENCACHE_H
+#include "IdentifierTable.h"
+#include "SourceFile.h"
+#include "TokenBuffer.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/*
+    This file defines the TokenCache interface. It stores the token stream of
+    every file that lexed without errors in a cache directory, keyed by a hash
+    of the file's contents and the options that affect the Lexer, so unchanged
+    files do not need to be lexed again in later compilations.
+*/
+
+namespace ntsc {
+class TokenCache {
+    // This is the directory that holds the cache entries. It must exist.
+    std::string directory;
+
+    // These are the statistics that are printed at exit. Files are looked up
+    // and stored from worker threads.
+    std::atomic<uint64_t> hitCount{0}, missCount{0}, storeCount{0},
+        rejectedCount{0};
+
+    // This method will return the path of the entry for the given key.
+    [[nodiscard]] auto getEntryPath(uint64_t key) const -> std::string;
+
+  public:
+    explicit TokenCache(llvm::StringRef directory) : directory{directory} {}
+    TokenCache(const TokenCache &) = delete;
+    auto operator=(const TokenCache &) -> TokenCache & = delete;
+
+    // This method will return the bits of the user options that change the
+    // output of the Lexer.
+    [[nodiscard]] static auto getOptionsKey() -> uint32_t;
+
+    // This method will compute the cache key of the given file from its
+    // contents.
+    [[nodiscard]] static auto getKey(const SourceFile &file) -> uint64_t;
+
+    // This method will try to fill the TokenBuffer from the cache. The names
+    // of the tokens are interned in the given table. If there is no valid
+    // entry for the key, it will return false and leave the buffer empty.
+    auto load(uint64_t key, const SourceFile &file,
+              IdentifierTable &identifiers, TokenBuffer &tokens) -> bool;
+
+    // This method will write the token stream of the given file to the cache.
+    // Failures are not diagnosed, since the cache is only an optimization.
+    auto store(uint64_t key, const SourceFile &file,
+               const IdentifierTable &identifiers, const TokenBuffer &tokens)
+        -> void;
+
+    // This method will print the hit and miss statistics.
+    auto printStatistics(llvm::raw_ostream &os) const -> void;
+};
+} // namespace ntsc
+
+#endif
@@ -1,31 +1,593 @@
+#include "CompileServer.h"
+#include "Diagnostics.h"
+#include "FileCache.h"
+#include "IdentifierTable.h"
 #include "Lexer.h"
+#include "LexerStatistics.h"
+#include "PhaseTimer.h"
+#include "SourceFile.h"
+#include "SourceManager.h"
+#include "StreamingLexer.h"
 #include "Token.h"
+#include "ThreadPool.h"
+#include "TokenBuffer.h"
+#include "TokenCache.h"
+#include "UserOpts.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Path.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <numeric>
+
+// These are the command line options for the driver. Each one has an initial
+// value, since the server resets the options to it between requests.
+static llvm::cl::OptionCategory ntscCategory{"ntsc options"};
+
+static llvm::cl::list<std::string> inputPaths{
+    llvm::cl::Positional, llvm::cl::desc("<source files>"),
+    llvm::cl::cat(ntscCategory)};
+
+static llvm::cl::opt<bool> dumpTokens{
+    "dump-tokens", llvm::cl::desc("Print the token stream of the source file"),
+    llvm::cl::init(false), llvm::cl::cat(ntscCategory)};
+
+static llvm::cl::opt<bool> noStrictMode{
+    "no-strict-mode", llvm::cl::desc("Disable TypeScript strict mode"),
+    llvm::cl::init(false), llvm::cl::cat(ntscCategory)};
+
+static llvm::cl::opt<unsigned> jobCount{
+    "j",
+    llvm::cl::desc("Process source files on N threads (0 uses every core)"),
+    llvm::cl::value_desc("N"), llvm::cl::init(1), llvm::cl::Prefix,
+    llvm::cl::cat(ntscCategory)};
+
+static llvm::cl::opt<unsigned> errorLimit{
+    "ferror-limit",
+    llvm::cl::desc("Stop reporting errors after N errors (0 means no limit)"),
+    llvm::cl::value_desc("N"), llvm::cl::init(20),
+    llvm::cl::cat(ntscCategory)};
+
+static llvm::cl::opt<ntsc::DiagnosticsFormat> diagnosticsFormat{
+    "fdiagnostics-format", llvm::cl::desc("The format of diagnostics"),
+    llvm::cl::values(
+        clEnumValN(ntsc::DiagnosticsFormat::Text, "text", "Plain text"),
+        clEnumValN(ntsc::DiagnosticsFormat::JSON, "json", "A JSON array"),
+        clEnumValN(ntsc::DiagnosticsFormat::SARIF, "sarif",
+                   "A SARIF 2.1.0 log")),
+    llvm::cl::init(ntsc::DiagnosticsFormat::Text),
+    llvm::cl::cat(ntscCategory)};
+
+static llvm::cl::opt<std::string> cacheDir{
+    "cache-dir",
+    llvm::cl::desc("Reuse the token streams of unchanged files from the given "
+                   "directory"),
+    llvm::cl::value_desc("directory"), llvm::cl::init(""),
+    llvm::cl::cat(ntscCategory)};
+
+static llvm::cl::opt<bool> streamInputs{
+    "stream",
+    llvm::cl::desc("Lex the source files in chunks instead of loading them "
+                   "(the path - always reads stdin this way)"),
+    llvm::cl::init(false), llvm::cl::cat(ntscCategory)};
+
+static llvm::cl::opt<size_t> streamChunkSize{
+    "stream-chunk-size",
+    llvm::cl::desc("Read streamed files N bytes at a time (at least 4096)"),
+    llvm::cl::value_desc("N"),
+    llvm::cl::init(ntsc::StreamingLexer::defaultChunkSize),
+    llvm::cl::cat(ntscCategory)};
+
+static llvm::cl::opt<bool> timeReport{
+    "ftime-report", llvm::cl::desc("Print the time taken by every phase"),
+    llvm::cl::init(false), llvm::cl::cat(ntscCategory)};
+
+static llvm::cl::opt<ntsc::OptimizationLevel> optimizationLevel{
+    llvm::cl::desc("Optimization level:"),
+    llvm::cl::values(
+        clEnumValN(ntsc::OptimizationLevel::O0, "O0", "No optimization"),
+        clEnumValN(ntsc::OptimizationLevel::O1, "O1", "Light optimization"),
+        clEnumValN(ntsc::OptimizationLevel::O2, "O2", "Full optimization"),
+        clEnumValN(ntsc::OptimizationLevel::O3, "O3",
+                   "Full optimization, trading size for speed"),
+        clEnumValN(ntsc::OptimizationLevel::Os, "Os",
+                   "Full optimization without growing the code")),
+    llvm::cl::init(ntsc::OptimizationLevel::O0), llvm::cl::ZeroOrMore,
+    llvm::cl::cat(ntscCategory)};
+
+static llvm::cl::opt<std::string> profileGenerate{
+    "fprofile-generate",
+    llvm::cl::desc("Build programs that write a profile of their branches, "
+                   "calls and inline caches to the given directory, which "
+                   "llvm-profdata merges for -fprofile-use"),
+    llvm::cl::value_desc("directory"), llvm::cl::ValueOptional,
+    llvm::cl::init(""), llvm::cl::cat(ntscCategory)};
+
+static llvm::cl::opt<std::string> profileUse{
+    "fprofile-use",
+    llvm::cl::desc("Optimize with the profile in the given file"),
+    llvm::cl::value_desc("file"), llvm::cl::init(""),
+    llvm::cl::cat(ntscCategory)};
+
+static llvm::cl::opt<std::string> serverSocket{
+    "server",
+    llvm::cl::desc("Stay resident and run the compilations sent to the given "
+                   "socket, reusing the files that have not changed"),
+    llvm::cl::value_desc("socket"), llvm::cl::init(""),
+    llvm::cl::cat(ntscCategory)};
+
+static llvm::cl::opt<std::string> connectSocket{
+    "connect",
+    llvm::cl::desc("Run the compilation on the server listening on the given "
+                   "socket, or here if there is none"),
+    llvm::cl::value_desc("socket"), llvm::cl::init(""),
+    llvm::cl::cat(ntscCategory)};
+
+static llvm::cl::opt<size_t> serverCacheSize{
+    "server-cache-size",
+    llvm::cl::desc("Keep up to N MiB of files in memory with --server"),
+    llvm::cl::value_desc("N"), llvm::cl::init(1024),
+    llvm::cl::cat(ntscCategory)};
+
+// This struct holds the result of running the front end on a single file.
+// Each job writes only to its own result, so no locking is needed.
+struct FileResult {
+    ntsc::TokenBuffer tokens;
+    bool failed = false;
+
+    // When the file is kept by a server, this is its entry, and the tokens
+    // are those of the entry. Otherwise, it is null, and the status of the
+    // file is read before it is loaded, so that it can be added.
+    const ntsc::CachedFile *cached = nullptr;
+    llvm::sys::fs::file_status status;
+
+    // This method will return the token stream of the file.
+    [[nodiscard]] auto getTokens() const -> const ntsc::TokenBuffer & {
+        return cached ? cached->tokens : tokens;
+    }
+};
+
+// This function will lex a single source file. If a cache is given, the token
+// stream is loaded from it when possible. Only files that lexed without
+// errors are stored, so a hit never has diagnostics to replay.
+static auto processFile(const ntsc::SourceFile &file,
+                        ntsc::DiagnosticsEngine &diags,
+                        ntsc::IdentifierTable &identifiers,
+                        ntsc::TokenCache *cache, FileResult &result) -> void {
+    if (result.cached) {
+        if (llvm::AreStatisticsEnabled())
+            ntsc::lexstats::recordTokens(result.cached->tokens,
+                                         file.getBuffer().size());
+        return;
+    }
+
+    uint64_t key = 0;
+    if (cache) {
+        key = ntsc::TokenCache::getKey(file);
+        if (cache->load(key, file, identifiers, result.tokens)) {
+            if (llvm::AreStatisticsEnabled())
+                ntsc::lexstats::recordTokens(result.tokens,
+                                             file.getBuffer().size());
+            return;
+        }
+    }
+
+    ntsc::Lexer lexer{file, diags, identifiers};
+    lexer.lexAll(result.tokens);
+    result.failed = lexer.failed();
+    if (llvm::AreStatisticsEnabled())
+        ntsc::lexstats::recordTokens(result.tokens, file.getBuffer().size());
+    if (cache && !result.failed)
+        cache->store(key, file, identifiers, result.tokens);
+}
+
+// This function will print a single token along with its location and
+// lexeme.
+static auto printToken(llvm::raw_ostream &out, const ntsc::TokenBuffer &tokens,
+                       size_t i, llvm::StringRef text,
+                       ntsc::LineAndColumn loc) -> void {
+    out << ntsc::getTokenKindName(tokens.kind(i)) << ' ' << loc.line << ':'
+        << loc.col << ' ' << tokens.offset(i) << ':' << tokens.length(i);
+    if (tokens.afterLineTerminator(i))
+        out << " [LT]";
+    out << " '";
+    out.write_escaped(text);
+    out << "'";
+
+    // Numeric literals are followed by the value computed by the Lexer.
+    if (ntsc::isNumberLiteral(tokens.kind(i))) {
+        if (tokens.isFloatValue(i))
+            out << " = " << llvm::format("%.17g", tokens.floatValue(i));
+        else
+            out << " = " << tokens.intValue(i);
+    } else if (ntsc::isBigIntLiteral(tokens.kind(i))) {
+        auto limbs = tokens.bigIntLimbs(i);
+        out << " = 0x";
+        if (limbs.empty())
+            out << '0';
+        for (size_t j = limbs.size(); j-- > 0;)
+            out << llvm::format(j + 1 == limbs.size() ? "%llx" : "%016llx",
+                                limbs[j]);
+    }
+    out << '\n';
+}
+
+// This function will print every token in the buffer.
+static auto printTokens(llvm::raw_ostream &out,
+                        const ntsc::TokenBuffer &tokens,
+                        const ntsc::SourceFile &file) -> void {
+    auto *bufPtr = file.getBufferStart();
+    for (size_t i = 0; i < tokens.size(); ++i)
+        printToken(out, tokens, i,
+                   {bufPtr + tokens.offset(i), tokens.length(i)},
+                   file.getLineAndColumn(tokens.offset(i)));
+}
+
+// This struct describes a file that is lexed by a StreamingLexer.
+struct StreamedInput {
+    llvm::sys::fs::file_t handle;
+    const ntsc::SourceFile *file;
+    bool isStdin;
+};
+
+// This function will lex a streamed file, and print each batch of tokens
+// before the next one replaces it. The locations of the tokens are tracked as
+// the text streams past, since it cannot be scanned again. It will return
+// whether the file failed.
+static auto processStreamedFile(llvm::raw_ostream &out, llvm::raw_ostream &err,
+                                const StreamedInput &input,
+                                ntsc::DiagnosticsEngine &diags,
+                                ntsc::IdentifierTable &identifiers) -> bool {
+    ntsc::StreamingLexer lexer{input.handle, *input.file, diags, identifiers,
+                               streamChunkSize};
+    ntsc::TokenBuffer tokens;
+    ntsc::LocationTracker locations;
+    uint32_t batchStart = 0;
+    while (true) {
+        auto batch = lexer.lexNext(tokens);
+        if (auto ec = batch.getError()) {
+            err << llvm::raw_ostream::Colors::RED
+                << "fatal error: " << llvm::raw_ostream::Colors::WHITE
+                << input.file->getPath() << ": " << ec.message() << '\n';
+            return true;
+        }
+        if (!*batch)
+            return lexer.failed();
+
+        // Each batch ends where the next one starts, so the bytes it was
+        // lexed from run from the end of the last batch to its last token.
+        auto last = tokens.size() - 1;
+        auto batchEnd = tokens.offset(last) + tokens.length(last);
+        if (llvm::AreStatisticsEnabled())
+            ntsc::lexstats::recordTokens(tokens, batchEnd - batchStart);
+        batchStart = batchEnd;
+        if (!dumpTokens)
+            continue;
+
+        for (size_t i = 0; i < tokens.size(); ++i) {
+            auto text = lexer.getText(tokens.offset(i), tokens.length(i));
+            locations.advance(lexer.getText(locations.getOffset(), 0).data(),
+                              text.end(), tokens.offset(i));
+            printToken(out, tokens, i, text, locations.getLocation());
+        }
+
+        // The tracker is moved to the end of the batch, which is where the
+        // next batch starts.
+        auto text = lexer.getText(tokens.offset(last), tokens.length(last));
+        locations.advance(text.data(), text.end(), batchEnd);
+    }
+}
+
+// This function will run a compilation with the options that were parsed,
+// and print its output to the given streams. If a FileCache is given, the
+// files are reused from it when they have not changed, and every file that
+// lexed without errors is added to it. It will return the exit code.
+static auto compile(llvm::raw_ostream &out, llvm::raw_ostream &err,
+                    ntsc::IdentifierTable &identifiers,
+                    ntsc::FileCache *fileCache) -> int {
+    if (inputPaths.empty()) {
+        err << llvm::raw_ostream::Colors::RED
+            << "fatal error: " << llvm::raw_ostream::Colors::WHITE
+            << " no source file given\n";
+        return 1;
+    }
+    ntsc::UserOpts::strictModeEnabled = !noStrictMode;
+    ntsc::UserOpts::optimizationLevel = optimizationLevel;
+
+    // Each run of an instrumented program writes a profile of its own, named
+    // after its module, as clang names them.
+    ntsc::UserOpts::profileGeneratePath.clear();
+    ntsc::UserOpts::profileUsePath.clear();
+    if (profileGenerate.getNumOccurrences() && profileUse.getNumOccurrences()) {
+        err << llvm::raw_ostream::Colors::RED
+            << "fatal error: " << llvm::raw_ostream::Colors::WHITE
+            << "-fprofile-generate and -fprofile-use cannot be used together\n";
+        return 1;
+    }
+    if (profileGenerate.getNumOccurrences()) {
+        llvm::SmallString<256> path{profileGenerate};
+        llvm::sys::path::append(path, "default_%m.profraw");
+        ntsc::UserOpts::profileGeneratePath = std::string{path};
+    }
+    if (profileUse.getNumOccurrences()) {
+        if (auto ec = llvm::sys::fs::access(
+                profileUse, llvm::sys::fs::AccessMode::Exist)) {
+            err << llvm::raw_ostream::Colors::RED
+                << "fatal error: " << llvm::raw_ostream::Colors::WHITE
+                << profileUse << ": " << ec.message() << '\n';
+            return 1;
+        }
+        ntsc::UserOpts::profileUsePath = profileUse;
+    }
+    ntsc::PhaseTimer::enabled = timeReport;
+
+    std::unique_ptr<ntsc::TokenCache> cache;
+    if (!cacheDir.empty()) {
+        if (auto ec = llvm::sys::fs::create_directories(cacheDir)) {
+            err << llvm::raw_ostream::Colors::RED
+                << "fatal error: " << llvm::raw_ostream::Colors::WHITE
+                << cacheDir << ": " << ec.message() << '\n';
+            return 1;
+        }
+        cache = std::make_unique<ntsc::TokenCache>(cacheDir);
+    }
+
+    // The files are loaded in the order they were given, so that their
+    // FileIDs, and therefore the order of their diagnostics, do not depend on
+    // scheduling. Large files are only mapped here, so this is cheap. A file
+    // kept by the server is added from its entry instead of being read.
+    ntsc::SourceManager sourceManager;
+    ntsc::DiagnosticsEngine diags{sourceManager};
+    diags.setErrorLimit(errorLimit);
+    std::vector<const ntsc::SourceFile *> files;
+    std::vector<FileResult> results;
+    std::vector<StreamedInput> streamedInputs;
+    auto failed = false;
+    {
+        ntsc::PhaseTimer timer{"load", "Loading source files"};
+        for (auto &path : inputPaths) {
+            if (streamInputs || path == "-") {
+                auto isStdin = path == "-";
+                auto handle = isStdin
+                                  ? llvm::sys::fs::getStdinHandle()
+                                  : llvm::sys::fs::openNativeFileForRead(path);
+                if (!handle) {
+                    err << llvm::raw_ostream::Colors::RED
+                        << "fatal error: " << llvm::raw_ostream::Colors::WHITE
+                        << path << ": " << llvm::toString(handle.takeError())
+                        << '\n';
+                    failed = true;
+                    continue;
+                }
+                streamedInputs.push_back(
+                    {*handle,
+                     &sourceManager.getFile(sourceManager.addStreamedFile(
+                         isStdin ? llvm::StringRef{"<stdin>"} : path)),
+                     isStdin});
+                continue;
+            }
+
+            FileResult result;
+            if (fileCache) {
+                result.cached = fileCache->lookup(path, result.status);
+                if (result.cached) {
+                    auto text = llvm::MemoryBuffer::getMemBuffer(
+                        result.cached->text->getBuffer(), path);
+                    files.push_back(&sourceManager.getFile(
+                        sourceManager.addBuffer(std::move(text))));
+                    results.push_back(std::move(result));
+                    continue;
+                }
+            }
+
+            auto fileResult = sourceManager.loadFile(path);
+            if (auto ec = fileResult.getError()) {
+                err << llvm::raw_ostream::Colors::RED
+                    << "fatal error: " << llvm::raw_ostream::Colors::WHITE
+                    << path << ": " << ec.message() << '\n';
+                failed = true;
+                continue;
+            }
+            files.push_back(&sourceManager.getFile(*fileResult));
+            results.push_back(std::move(result));
+        }
+    }
+
+    // The files are scheduled from largest to smallest, so that a large file
+    // started last does not leave the other threads idle at the end.
+    std::vector<size_t> schedule(files.size());
+    std::iota(schedule.begin(), schedule.end(), 0);
+    std::stable_sort(schedule.begin(), schedule.end(),
+                     [&](size_t a, size_t b) {
+                         return files[a]->getBuffer().size() >
+                                files[b]->getBuffer().size();
+                     });
+
+    {
+        ntsc::PhaseTimer timer{"lex", "Lexing"};
+        if (jobCount == 1 || files.size() <= 1) {
+            for (auto i : schedule)
+                processFile(*files[i], diags, identifiers, cache.get(),
+                            results[i]);
+        } else {
+            ntsc::ThreadPool pool{jobCount};
+            for (auto i : schedule)
+                pool.async([&, i] {
+                    processFile(*files[i], diags, identifiers, cache.get(),
+                                results[i]);
+                });
+            pool.wait();
+        }
+
+        // Streamed files are lexed one at a time on this thread, since their
+        // tokens are printed as they are lexed, before any of the other output.
+        for (auto &input : streamedInputs) {
+            failed |= processStreamedFile(out, err, input, diags, identifiers);
+            if (!input.isStdin) {
+                auto handle = input.handle;
+                llvm::sys::fs::closeFile(handle);
+            }
+        }
+    }
+
+    // The files that were lexed again are kept for the next compilation, like
+    // the TokenCache, only if they have no diagnostics to replay.
+    if (fileCache)
+        for (size_t i = 0; i < files.size(); ++i)
+            if (!results[i].cached && !results[i].failed)
+                results[i].cached =
+                    fileCache->insert(files[i]->getPath(), results[i].status,
+                                      *files[i], std::move(results[i].tokens));
+
+    // The diagnostics are rendered once every file is done. They are sorted by
+    // file and offset, so the output does not depend on scheduling.
+    {
+        ntsc::PhaseTimer timer{"emit", "Emitting diagnostics"};
+        diags.emit(err, diagnosticsFormat);
+    }
+
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (dumpTokens)
+            printTokens(out, results[i].getTokens(), *files[i]);
+        failed |= results[i].failed;
+    }
+
+    if (cache)
+        cache->printStatistics(err);
+    if (llvm::AreStatisticsEnabled())
+        llvm::PrintStatistics(err);
+    if (timeReport)
+        llvm::TimerGroup::printAll(err);
+
+    return failed ? 1 : 0;
+}
+
+// This function will run a compilation that a client sent to the server. The
+// options are global, so every option is reset before the arguments of the
+// request are parsed, along with the statistics and timers of the last
+// compilation.
+static auto handleRequest(const ntsc::CompileRequest &request,
+                          llvm::raw_ostream &out, llvm::raw_ostream &err,
+                          ntsc::FileCache &fileCache) -> int {
+    // The client prints the output as its own, so it is colored as it would
+    // be if the compilation ran there.
+    err.enable_colors(llvm::errs().colors_enabled());
+
+    // The client has already parsed the arguments, so these only reach the
+    // server if it was sent something else, and they would exit it.
+    for (auto &argument : request.arguments) {
+        auto name = llvm::StringRef{argument}.ltrim('-');
+        if (llvm::StringRef{argument}.startswith("-") &&
+            (name.startswith("help") || name.startswith("version") ||
+             name.startswith("print-"))) {
+            err << llvm::raw_ostream::Colors::RED
+                << "fatal error: " << llvm::raw_ostream::Colors::WHITE
+                << argument << " is not supported by the server\n";
+            return 1;
+        }
+    }
+    if (auto ec = llvm::sys::fs::set_current_path(request.workingDirectory)) {
+        err << llvm::raw_ostream::Colors::RED
+            << "fatal error: " << llvm::raw_ostream::Colors::WHITE
+            << request.workingDirectory << ": " << ec.message() << '\n';
+        return 1;
+    }
+
+    llvm::cl::ResetAllOptionOccurrences();
+    llvm::ResetStatistics();
+    llvm::TimerGroup::clearAll();
+    std::vector<const char *> argv;
+    for (auto &argument : request.arguments)
+        argv.push_back(argument.c_str());
+    if (!llvm::cl::ParseCommandLineOptions(static_cast<int>(argv.size()),
+                                           argv.data(), "Native-TS Compiler\n",
+                                           &err))
+        return 1;
+
+    // Only files that the server can read itself are supported.
+    if (!serverSocket.empty() || !connectSocket.empty() ||
+        llvm::is_contained(inputPaths, "-")) {
+        err << llvm::raw_ostream::Colors::RED
+            << "fatal error: " << llvm::raw_ostream::Colors::WHITE
+            << "--server, --connect and - are not supported by the server\n";
+        return 1;
+    }
+
+    auto exitCode = compile(out, err, fileCache.getIdentifiers(), &fileCache);
+    fileCache.evict();
+    return exitCode;
+}
+
+// This function will return whether the argument at the given index names the
+// option with the given name, and how many arguments the option takes up.
+static auto matchOption(llvm::ArrayRef<const char *> arguments, size_t i,
+                        llvm::StringRef name) -> size_t {
+    auto argument = llvm::StringRef{arguments[i]};
+    if (!argument.consume_front("-"))
+        return 0;
+    argument.consume_front("-");
+    if (!argument.consume_front(name))
+        return 0;
+    if (argument.startswith("="))
+        return 1;
+    return argument.empty() && i + 1 < arguments.size() ? 2 : 0;
+}
 
 auto main(int argc, char **argv) -> int {
-    if (argc < 2) {
+    // The --stats option is registered by LLVM, which sets the flag that the
+    // statistics check, so it is only moved into our category.
+    auto &statsOption = *llvm::cl::getRegisteredOptions()["stats"];
+    statsOption.setDescription("Print the statistics of every phase on exit");
+    statsOption.setHiddenFlag(llvm::cl::NotHidden);
+    statsOption.addCategory(ntscCategory);
+    llvm::cl::HideUnrelatedOptions(ntscCategory);
+    llvm::cl::ParseCommandLineOptions(argc, argv, "Native-TS Compiler\n");
+
+    if (!serverSocket.empty() && !connectSocket.empty()) {
         llvm::errs() << llvm::raw_ostream::Colors::RED
                      << "fatal error: " << llvm::raw_ostream::Colors::WHITE
-                     << " no source file given\n";
+                     << "--server and --connect cannot be used together\n";
         return 1;
     }
-    // For initial testing, we will use argv[1] as the source path.
-    auto fileResult = llvm::MemoryBuffer::getFile(argv[1]);
-    if (auto ec = fileResult.getError()) {
+    if (!serverSocket.empty()) {
+        ntsc::FileCache fileCache{serverCacheSize << 20};
+        auto ec = ntsc::runCompileServer(
+            serverSocket, [&](const ntsc::CompileRequest &request,
+                              llvm::raw_ostream &out, llvm::raw_ostream &err) {
+                return handleRequest(request, out, err, fileCache);
+            });
         llvm::errs() << llvm::raw_ostream::Colors::RED
                      << "fatal error: " << llvm::raw_ostream::Colors::WHITE
-                     << argv[1] << ": " << ec.message() << '\n';
+                     << serverSocket << ": " << ec.message() << '\n';
         return 1;
     }
 
-    auto fileBuffer = fileResult->get();
-    ntsc::Lexer lexer{fileBuffer->getBufferStart(), fileBuffer->getBufferEnd(),
-                      argv[1]};
-    ntsc::Token tok;
-
-    lexer.lexToken(tok);
+    // The arguments were parsed here as well, so a mistake is reported
+    // without a round trip. Everything but --connect is sent to the server,
+    // and the compilation runs here if no server is listening, or if it reads
+    // stdin, which the server cannot.
+    if (!connectSocket.empty() && !llvm::is_contained(inputPaths, "-")) {
+        ntsc::CompileRequest request;
+        llvm::SmallString<256> workingDirectory;
+        llvm::ArrayRef<const char *> arguments{argv, static_cast<size_t>(argc)};
+        if (!llvm::sys::fs::current_path(workingDirectory)) {
+            request.workingDirectory = std::string{workingDirectory};
+            for (size_t i = 0; i < arguments.size(); ++i) {
+                if (auto count = matchOption(arguments, i, "connect")) {
+                    i += count - 1;
+                    continue;
+                }
+                request.arguments.emplace_back(arguments[i]);
+            }
+            if (auto exitCode = ntsc::sendCompileRequest(
+                    connectSocket, request, llvm::outs(), llvm::errs()))
+                return *exitCode;
+        }
+    }
 
-    llvm::outs() << "Token: " << static_cast<int>(tok.kind) << '\n';
-    llvm::outs() << "text: " << tok.text << '\n';
-}
\ No newline at end of file
+    ntsc::IdentifierTable identifiers;
+    return compile(llvm::outs(), llvm::errs(), identifiers, nullptr);
+}
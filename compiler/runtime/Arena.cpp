@@ -0,0 +1,76 @@
+#include "Arena.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+/*
+    This file contains the implementation of the Arena. Objects are bump
+    allocated from chunks, and an object larger than a chunk gets a chunk of
+    its own.
+*/
+
+namespace ntsc {
+// This is the size of a chunk of an arena.
+static constexpr uint64_t chunkSize = uint64_t{64} << 10;
+
+// This is the alignment of the objects of an arena, which matches the heap.
+static constexpr uint64_t arenaAlignment = gc::granuleSize;
+
+// This is the implementation of the Arena constructor.
+Arena::Arena() { gc::getCollector().addRootSource(this); }
+
+// This is the implementation of the Arena destructor.
+Arena::~Arena() {
+    gc::getCollector().removeRootSource(this);
+    for (auto &chunk : chunks)
+        std::free(chunk.data);
+}
+
+// This function will allocate a zeroed chunk.
+static auto allocateChunk(uint64_t capacity) -> uint8_t * {
+    auto *data = static_cast<uint8_t *>(std::calloc(1, capacity));
+    if (!data) {
+        std::fputs("ntsc: out of memory\n", stderr);
+        std::abort();
+    }
+    return data;
+}
+
+// This is the implementation of Arena::allocate. A chunk of its own goes in
+// front of the last chunk, which keeps its free space.
+auto Arena::allocate(uint64_t size) -> void * {
+    size = std::max((size + arenaAlignment - 1) & ~(arenaAlignment - 1),
+                    arenaAlignment);
+    if (size > chunkSize) {
+        Chunk chunk{allocateChunk(size), size, size};
+        chunks.insert(chunks.empty() ? chunks.end() : chunks.end() - 1, chunk);
+        return chunk.data;
+    }
+    if (chunks.empty() || chunks.back().capacity - chunks.back().used < size)
+        chunks.push_back(Chunk{allocateChunk(chunkSize), 0, chunkSize});
+    auto &chunk = chunks.back();
+    auto *object = chunk.data + chunk.used;
+    chunk.used += size;
+    return object;
+}
+
+// This is the implementation of Arena::getRanges.
+auto Arena::getRanges(
+    std::vector<std::pair<const void *, const void *>> &ranges) const -> void {
+    for (auto &chunk : chunks)
+        ranges.emplace_back(chunk.data, chunk.data + chunk.used);
+}
+
+extern "C" {
+// This is the implementation of ntsc_arena_create.
+auto ntsc_arena_create() -> Arena * { return new Arena; }
+
+// This is the implementation of ntsc_arena_alloc.
+auto ntsc_arena_alloc(Arena *arena, uint64_t size) -> void * {
+    return arena->allocate(size);
+}
+
+// This is the implementation of ntsc_arena_destroy.
+auto ntsc_arena_destroy(Arena *arena) -> void { delete arena; }
+}
+} // namespace ntsc
@@ -0,0 +1,47 @@
+#ifndef NTSC_ARENA_H
+#define NTSC_ARENA_H
+#include "Collector.h"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/*
+    This file defines the Arena interface. An arena holds the objects of a
+    single request, which the code generator proved are not referred to once
+    the request ends, so they are all freed at once with the arena. The
+    objects of an arena may refer to the heap, so the collector scans every
+    arena as a root.
+*/
+
+namespace ntsc {
+class Arena : public gc::RootSource {
+    struct Chunk {
+        uint8_t *data;
+        uint64_t used;
+        uint64_t capacity;
+    };
+    std::vector<Chunk> chunks;
+
+  public:
+    Arena();
+    ~Arena() override;
+    Arena(const Arena &) = delete;
+    auto operator=(const Arena &) -> Arena & = delete;
+
+    // This method will allocate a zeroed object in the arena.
+    auto allocate(uint64_t size) -> void *;
+
+    auto getRanges(std::vector<std::pair<const void *, const void *>> &ranges)
+        const -> void override;
+};
+
+extern "C" {
+// These functions will create an arena for a request, allocate in it, and
+// free it along with its objects once the request ends.
+auto ntsc_arena_create() -> Arena *;
+auto ntsc_arena_alloc(Arena *arena, uint64_t size) -> void *;
+auto ntsc_arena_destroy(Arena *arena) -> void;
+}
+} // namespace ntsc
+
+#endif
@@ -0,0 +1,516 @@
+#include "Collector.h"
+#include "ObjectModel.h"
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+
+/*
+    This file contains the implementation of the Collector. Every word of an
+    object, a root or the stack that refers to the heap keeps its object
+    alive, whether it is a boxed pointer or a raw one such as the overflow
+    slots of an object, so the collector needs no map of where the pointers
+    are. The price is that a word which only looks like a pointer, such as a
+    double whose bits match a boxed pointer or an integer that happens to
+    hold the address of an object, keeps that object alive too. Such an
+    object is never freed early, only late.
+*/
+
+namespace ntsc {
+namespace gc {
+// This function will return the time in nanoseconds.
+static auto now() -> uint64_t {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+// This function will return the end of the stack of the calling thread,
+// which is its highest address.
+static auto findStackTop() -> const uint8_t * {
+#if defined(__APPLE__)
+    return static_cast<const uint8_t *>(
+        pthread_get_stackaddr_np(pthread_self()));
+#else
+    pthread_attr_t attributes;
+    void *address = nullptr;
+    size_t size = 0;
+    pthread_getattr_np(pthread_self(), &attributes);
+    pthread_attr_getstack(&attributes, &address, &size);
+    pthread_attr_destroy(&attributes);
+    return static_cast<const uint8_t *>(address) + size;
+#endif
+}
+
+// This function will call a function on every word of a range. The stack is
+// read past the variables that the sanitizer knows of, which is not an error.
+template <typename Function>
+__attribute__((no_sanitize("address"))) static auto
+forEachWord(const void *start, const void *end, Function function) -> void {
+    auto address = (reinterpret_cast<uintptr_t>(start) + sizeof(uint64_t) - 1) &
+                   ~(sizeof(uint64_t) - 1);
+    for (auto *word = reinterpret_cast<const uint64_t *>(address);
+         word + 1 <= static_cast<const uint64_t *>(end); ++word)
+        function(*word);
+}
+
+// This is the implementation of the Collector constructor.
+Collector::Collector() : stackTop{findStackTop()} {}
+
+// This is the implementation of Collector::findReferent.
+auto Collector::findReferent(uint64_t word) const -> void * {
+    if ((word >> boxedTagShift) == boxedPointerTag)
+        word &= boxedPayloadMask;
+    auto *address = reinterpret_cast<const void *>(word);
+    if (!heap.contains(address))
+        return nullptr;
+    return heap.findObject(address);
+}
+
+// This is the implementation of Collector::findRoots. The builtin spills
+// every register that a callee would save, so the stack holds every pointer
+// that the program has in registers.
+auto Collector::findRoots(std::vector<void *> &objects) -> void {
+    auto find = [&](uint64_t word) {
+        if (auto *object = findReferent(word))
+            objects.push_back(object);
+    };
+    for (auto [start, end] : roots)
+        forEachWord(start, end, find);
+    std::vector<std::pair<const void *, const void *>> ranges;
+    for (auto *source : rootSources)
+        source->getRanges(ranges);
+    for (auto [start, end] : ranges)
+        forEachWord(start, end, find);
+
+    __builtin_unwind_init();
+    scanStack(objects);
+}
+
+// This is the implementation of Collector::scanStack. Its frame is below the
+// frame of its caller, which holds the spilled registers.
+__attribute__((noinline, no_sanitize("address"))) auto
+Collector::scanStack(std::vector<void *> &objects) -> void {
+    volatile uint64_t marker = 0;
+    forEachWord(const_cast<const uint64_t *>(&marker), stackTop,
+                [&](uint64_t word) {
+                    if (auto *object = findReferent(word))
+                        objects.push_back(object);
+                });
+}
+
+// This is the implementation of Collector::visitYoung. An object in the
+// nursery is promoted where it is. During marking, an object that is
+// promoted is also marked, and it is scanned here, so an old object that it
+// refers to is marked too.
+auto Collector::visitYoung(void *object) -> void {
+    auto *block = Heap::getBlockOf(object);
+    auto granule = Heap::getGranuleOf(object);
+    if (!testBit(block->old, granule)) {
+        setBit(block->old, granule);
+        if (marking)
+            setBit(block->marks, granule);
+        auto size = Heap::getObjectSize(object);
+        oldBytes += size;
+        stats.bytesPromoted += size;
+        promotedStack.push_back(object);
+    } else if (marking && !testBit(block->marks, granule)) {
+        setBit(block->marks, granule);
+        markStack.push_back(object);
+    }
+}
+
+// This is the implementation of Collector::visitOld. The nursery is left to
+// its own collection, since every old object that refers to it is
+// remembered.
+auto Collector::visitOld(void *object) -> void {
+    auto *block = Heap::getBlockOf(object);
+    auto granule = Heap::getGranuleOf(object);
+    if (testBit(block->old, granule) && !testBit(block->marks, granule)) {
+        setBit(block->marks, granule);
+        markStack.push_back(object);
+    }
+}
+
+// This is the implementation of Collector::allocate.
+auto Collector::allocate(uint64_t size) -> void * {
+    auto bytes = std::max((size + granuleSize - 1) & ~(granuleSize - 1),
+                          granuleSize);
+    stats.bytesAllocated += bytes;
+    if (bytes > largeObjectSize) {
+        prepareAllocation(bytes);
+        auto *block = heap.allocateLarge(bytes);
+        setBit(block->starts, firstGranule);
+        nurseryLargeObjects.push_back(block);
+        nurseryBytes += bytes;
+        return Heap::getAddress(block, firstGranule);
+    }
+
+    if (static_cast<uint64_t>(limit - cursor) < bytes)
+        refill(bytes);
+    auto *object = cursor;
+    cursor += bytes;
+    auto *block = Heap::getBlockOf(object);
+    auto granule = Heap::getGranuleOf(object);
+    setBit(block->starts, granule);
+    setBit(block->ends, granule + bytes / granuleSize - 1);
+    return object;
+}
+
+// This is the implementation of Collector::refill. A hole starts after the
+// end of an object and ends at the start of the next one.
+auto Collector::refill(uint64_t size) -> void {
+    prepareAllocation(size);
+    auto granules = size / granuleSize;
+    auto from = allocationBlock ? Heap::getGranuleOf(limit - 1) + 1 : 0;
+    while (true) {
+        if (!allocationBlock) {
+            if (!recyclableBlocks.empty()) {
+                allocationBlock = recyclableBlocks.back();
+                recyclableBlocks.pop_back();
+                allocationBlockIsClear = false;
+            } else {
+                allocationBlock = heap.allocateBlock();
+                allocationBlockIsClear = true;
+                nurseryBlocks.push_back(allocationBlock);
+            }
+            from = firstGranule;
+        }
+
+        while (from < granulesPerBlock) {
+            auto start = findNextBit(allocationBlock->starts, from);
+            if (start == from) {
+                from = findNextBit(allocationBlock->ends, start) + 1;
+                continue;
+            }
+            if (start - from >= granules) {
+                cursor = Heap::getAddress(allocationBlock, from);
+                limit = Heap::getAddress(allocationBlock, start);
+                if (!allocationBlockIsClear) {
+                    std::memset(cursor, 0, limit - cursor);
+                    if (nurseryBlocks.empty() ||
+                        nurseryBlocks.back() != allocationBlock)
+                        nurseryBlocks.push_back(allocationBlock);
+                }
+                nurseryBytes += limit - cursor;
+                return;
+            }
+            from = start;
+        }
+        allocationBlock = nullptr;
+    }
+}
+
+// This is the implementation of Collector::prepareAllocation.
+auto Collector::prepareAllocation(uint64_t size) -> void {
+    auto nurseryIsFull = nurseryBytes + size >= nurserySize;
+    if (!nurseryIsFull && !marking)
+        return;
+
+    auto start = now();
+    if (nurseryIsFull) {
+        collectNursery();
+        if (!marking && oldBytes >= markingThreshold)
+            startMarking();
+    }
+    if (marking) {
+        markingCredit += size * markingRate;
+        markSlice(markingCredit);
+    }
+    recordPause(start);
+}
+
+// This is the implementation of Collector::collectNursery. The remembered
+// objects are scanned whole, since the barrier does not record which of
+// their slots changed.
+auto Collector::collectNursery() -> void {
+    std::vector<void *> rootObjects;
+    findRoots(rootObjects);
+    for (auto *object : rootObjects)
+        visitYoung(object);
+    for (auto *object : rememberedSet) {
+        clearBit(Heap::getBlockOf(object)->remembered,
+                 Heap::getGranuleOf(object));
+        auto *start = static_cast<uint8_t *>(object);
+        forEachWord(start, start + Heap::getObjectSize(object),
+                    [&](uint64_t word) {
+                        if (auto *referent = findReferent(word))
+                            visitYoung(referent);
+                    });
+    }
+    rememberedSet.clear();
+    while (!promotedStack.empty()) {
+        auto *object = static_cast<uint8_t *>(promotedStack.back());
+        promotedStack.pop_back();
+        forEachWord(object, object + Heap::getObjectSize(object),
+                    [&](uint64_t word) {
+                        if (auto *referent = findReferent(word))
+                            visitYoung(referent);
+                    });
+    }
+
+    // The objects that were not promoted are freed by clearing their bits.
+    for (auto *block : nurseryBlocks) {
+        bool empty = true;
+        for (uint64_t i = 0; i < bitmapWords; ++i) {
+            auto dead = block->starts[i] & ~block->old[i];
+            block->starts[i] &= block->old[i];
+            while (dead) {
+                auto start = i * 64 + __builtin_ctzll(dead);
+                dead &= dead - 1;
+                clearBit(block->ends, findNextBit(block->ends, start));
+            }
+            empty &= !block->starts[i];
+        }
+        if (empty)
+            heap.release(block);
+        else
+            recyclableBlocks.push_back(block);
+    }
+    for (auto *block : nurseryLargeObjects) {
+        if (!testBit(block->old, firstGranule))
+            heap.release(block);
+    }
+    nurseryBlocks.clear();
+    nurseryLargeObjects.clear();
+    nurseryBytes = 0;
+    cursor = limit = nullptr;
+    allocationBlock = nullptr;
+    ++stats.minorCollections;
+}
+
+// This is the implementation of Collector::startMarking. Only the bitmaps of
+// the marks are cleared, which is a small fraction of the heap.
+auto Collector::startMarking() -> void {
+    for (uint32_t index = 0; index < heap.getBlockCount(); ++index) {
+        auto kind = heap.getKind(index);
+        if (kind == BlockKind::Small || kind == BlockKind::Large)
+            std::memset(heap.getBlock(index)->marks, 0, sizeof(Bitmap));
+    }
+    marking = true;
+    markingCredit = 0;
+
+    std::vector<void *> rootObjects;
+    findRoots(rootObjects);
+    for (auto *object : rootObjects)
+        visitOld(object);
+}
+
+// This is the implementation of Collector::markSlice.
+auto Collector::markSlice(uint64_t budget) -> void {
+    while (!markStack.empty() && budget) {
+        auto *object = static_cast<uint8_t *>(markStack.back());
+        markStack.pop_back();
+        auto size = Heap::getObjectSize(object);
+        forEachWord(object, object + size, [&](uint64_t word) {
+            if (auto *referent = findReferent(word))
+                visitOld(referent);
+        });
+        budget -= std::min(budget, size);
+    }
+    markingCredit = budget;
+    if (markStack.empty())
+        finishMarking();
+}
+
+// This is the implementation of Collector::finishMarking. Collecting the
+// nursery empties it and marks every old object that the roots refer to, so
+// once the marking is drained every live object is marked.
+auto Collector::finishMarking() -> void {
+    collectNursery();
+    while (!markStack.empty()) {
+        auto *object = static_cast<uint8_t *>(markStack.back());
+        markStack.pop_back();
+        forEachWord(object, object + Heap::getObjectSize(object),
+                    [&](uint64_t word) {
+                        if (auto *referent = findReferent(word))
+                            visitOld(referent);
+                    });
+    }
+
+    recyclableBlocks.clear();
+    for (uint32_t index = 0; index < heap.getBlockCount(); ++index) {
+        auto *block = heap.getBlock(index);
+        auto kind = heap.getKind(index);
+        if (kind == BlockKind::Large) {
+            if (!testBit(block->marks, firstGranule)) {
+                oldBytes -= block->largeSize;
+                heap.release(block);
+            }
+            continue;
+        }
+        if (kind != BlockKind::Small)
+            continue;
+
+        bool empty = true;
+        for (uint64_t i = 0; i < bitmapWords; ++i) {
+            auto dead = block->starts[i] & ~block->marks[i];
+            block->starts[i] &= block->marks[i];
+            block->old[i] &= block->marks[i];
+            while (dead) {
+                auto start = i * 64 + __builtin_ctzll(dead);
+                dead &= dead - 1;
+                auto end = findNextBit(block->ends, start);
+                clearBit(block->ends, end);
+                oldBytes -= (end + 1 - start) * granuleSize;
+            }
+            empty &= !block->starts[i];
+        }
+        if (empty)
+            heap.release(block);
+        else
+            recyclableBlocks.push_back(block);
+    }
+
+    marking = false;
+    markingThreshold =
+        std::max(oldBytes * heapGrowthFactor, minimumMarkingThreshold);
+    stats.oldBytes = oldBytes;
+    ++stats.majorCollections;
+}
+
+// This is the implementation of Collector::recordPause.
+auto Collector::recordPause(uint64_t start) -> void {
+    auto pause = now() - start;
+    ++stats.pauses;
+    stats.totalPauseNanoseconds += pause;
+    stats.maxPauseNanoseconds = std::max(stats.maxPauseNanoseconds, pause);
+    stats.oldBytes = oldBytes;
+}
+
+// This is the implementation of Collector::writeBarrier. A store into an
+// object in the nursery needs nothing, since the object is scanned whole
+// when it is promoted.
+auto Collector::writeBarrier(void *object, uint64_t value) -> void {
+    if (!heap.contains(object))
+        return;
+    auto *block = Heap::getBlockOf(object);
+    auto granule = Heap::getGranuleOf(object);
+    if (!testBit(block->old, granule))
+        return;
+    auto *referent = findReferent(value);
+    if (!referent)
+        return;
+
+    auto *referentBlock = Heap::getBlockOf(referent);
+    auto referentGranule = Heap::getGranuleOf(referent);
+    if (!testBit(referentBlock->old, referentGranule)) {
+        if (!testBit(block->remembered, granule)) {
+            setBit(block->remembered, granule);
+            rememberedSet.push_back(object);
+        }
+    } else if (marking && !testBit(referentBlock->marks, referentGranule)) {
+        setBit(referentBlock->marks, referentGranule);
+        markStack.push_back(referent);
+    }
+}
+
+// This is the implementation of Collector::collect.
+auto Collector::collect() -> void {
+    auto start = now();
+    if (!marking)
+        startMarking();
+    finishMarking();
+    recordPause(start);
+}
+
+// This is the implementation of Collector::addRoots.
+auto Collector::addRoots(const void *start, uint64_t size) -> void {
+    roots.emplace_back(start, static_cast<const uint8_t *>(start) + size);
+}
+
+// This is the implementation of Collector::removeRoots.
+auto Collector::removeRoots(const void *start) -> void {
+    roots.erase(std::remove_if(roots.begin(), roots.end(),
+                               [&](auto &range) {
+                                   return range.first == start;
+                               }),
+                roots.end());
+}
+
+// This is the implementation of Collector::addRootSource.
+auto Collector::addRootSource(const RootSource *source) -> void {
+    rootSources.push_back(source);
+}
+
+// This is the implementation of Collector::removeRootSource.
+auto Collector::removeRootSource(const RootSource *source) -> void {
+    rootSources.erase(
+        std::remove(rootSources.begin(), rootSources.end(), source),
+        rootSources.end());
+}
+
+// This function will print the statistics of the collector.
+static auto printStats() -> void {
+    auto &stats = getCollector().getStats();
+    std::fprintf(stderr,
+                 "gc: %" PRIu64 " minor, %" PRIu64 " major collections\n"
+                 "gc: %" PRIu64 " pauses, %.3f ms total, %.3f ms max\n"
+                 "gc: %" PRIu64 " bytes allocated, %" PRIu64
+                 " promoted, %" PRIu64 " old\n",
+                 stats.minorCollections, stats.majorCollections, stats.pauses,
+                 stats.totalPauseNanoseconds / 1e6,
+                 stats.maxPauseNanoseconds / 1e6, stats.bytesAllocated,
+                 stats.bytesPromoted, stats.oldBytes);
+}
+
+// This is the thread that created the collector. Its stack is the only one
+// that is scanned.
+static pthread_t collectorThread;
+
+// This is the implementation of getCollector. The collector is created by the
+// first allocation, on the thread of the program. Another thread would use
+// the nursery without a lock, and its stack would never be scanned, so the
+// program is ended rather than left to free objects that are still in use.
+auto getCollector() -> Collector & {
+    static Collector *collector = [] {
+        collectorThread = pthread_self();
+        auto *collector = new Collector;
+        if (std::getenv("NTSC_GC_STATS"))
+            std::atexit(printStats);
+        return collector;
+    }();
+    if (!pthread_equal(pthread_self(), collectorThread)) {
+        std::fputs("ntsc: the heap was used from a thread other than the "
+                   "program's\n",
+                   stderr);
+        std::abort();
+    }
+    return *collector;
+}
+} // namespace gc
+
+extern "C" {
+// This is the implementation of ntsc_alloc.
+auto ntsc_alloc(uint64_t size) -> void * {
+    return gc::getCollector().allocate(size);
+}
+
+// This is the implementation of ntsc_write_barrier.
+auto ntsc_write_barrier(void *object, uint64_t value) -> void {
+    gc::getCollector().writeBarrier(object, value);
+}
+
+// This is the implementation of ntsc_gc_collect.
+auto ntsc_gc_collect() -> void { gc::getCollector().collect(); }
+
+// This is the implementation of ntsc_gc_add_roots.
+auto ntsc_gc_add_roots(const void *start, uint64_t size) -> void {
+    gc::getCollector().addRoots(start, size);
+}
+
+// This is the implementation of ntsc_gc_remove_roots.
+auto ntsc_gc_remove_roots(const void *start) -> void {
+    gc::getCollector().removeRoots(start);
+}
+
+// This is the implementation of ntsc_gc_get_stats.
+auto ntsc_gc_get_stats(GCStats *stats) -> void {
+    *stats = gc::getCollector().getStats();
+}
+}
+} // namespace ntsc
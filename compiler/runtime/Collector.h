@@ -0,0 +1,206 @@
+#ifndef NTSC_COLLECTOR_H
+#define NTSC_COLLECTOR_H
+#include "Heap.h"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/*
+    This file defines the Collector interface, which is the generational
+    garbage collector of the runtime. It does not move objects, since it
+    scans the stack conservatively, and the code generator moves objects to
+    the stack that hold pointers to the heap in memory.
+
+    New objects are bump allocated in the nursery, which is made of the empty
+    blocks and the holes between the old objects of partly used blocks. Once
+    enough has been allocated, the nursery is collected: the objects reached
+    from the roots and the remembered set become old where they are, and the
+    rest of the nursery is reused.
+
+    The old generation is marked incrementally, a slice at a time in step
+    with allocation, so no pause grows with the size of the heap. The write
+    barrier both remembers the old objects that refer to the nursery and
+    shades the old objects that are stored during marking. The marking ends
+    with a collection of the nursery, which scans the roots again, and a sweep
+    of the bitmaps that never touches the objects themselves.
+
+    Programs run their code on a single thread, as JavaScript does, so the
+    nursery belongs to that thread and nothing is synchronized. The first
+    thread to allocate owns the collector, and the program is ended if any
+    other thread uses it.
+
+    The collector is conservative everywhere, not only on the stack. The code
+    generator emits no statepoints or stack maps, and objects carry no map of
+    their pointer fields, so every word of the roots, the stack and the heap
+    is treated as a possible pointer. A double or an integer whose bits look
+    like a pointer into the heap keeps the object it points to alive. This
+    costs memory, never correctness, and the objects it keeps are freed once
+    the word changes.
+*/
+
+namespace ntsc {
+// This struct holds the statistics of the collector. Every collection of the
+// nursery, slice of marking and end of marking is a pause.
+struct GCStats {
+    uint64_t minorCollections;
+    uint64_t majorCollections;
+    uint64_t pauses;
+    uint64_t totalPauseNanoseconds;
+    uint64_t maxPauseNanoseconds;
+    uint64_t bytesAllocated;
+    uint64_t bytesPromoted;
+    uint64_t oldBytes;
+};
+
+namespace gc {
+// This class is a part of the runtime that keeps pointers to the heap in
+// memory of its own, such as an arena, whose ranges are scanned as roots.
+class RootSource {
+  public:
+    virtual ~RootSource() = default;
+
+    // This method will add the ranges of memory that may refer to the heap.
+    virtual auto getRanges(
+        std::vector<std::pair<const void *, const void *>> &ranges) const
+        -> void = 0;
+};
+
+// This is the memory that is allocated between collections of the nursery.
+constexpr uint64_t nurserySize = uint64_t{4} << 20;
+
+// The old generation is marked once it has grown by this factor since the
+// last marking ended, or has reached the minimum.
+constexpr uint64_t minimumMarkingThreshold = uint64_t{64} << 20;
+constexpr uint64_t heapGrowthFactor = 2;
+
+// This is the number of bytes of objects that are marked for every byte that
+// is allocated during marking, which ends the marking well before the heap
+// has grown by the factor above.
+constexpr uint64_t markingRate = 2;
+
+class Collector {
+    Heap heap;
+
+    // These are the hole that objects are bump allocated from, and the
+    // block that holds it.
+    uint8_t *cursor = nullptr;
+    uint8_t *limit = nullptr;
+    BlockHeader *allocationBlock = nullptr;
+    bool allocationBlockIsClear = false;
+
+    // These are the blocks that the nursery was allocated in, the large
+    // objects of the nursery, and the partly used blocks that it may be
+    // allocated in next.
+    std::vector<BlockHeader *> nurseryBlocks;
+    std::vector<BlockHeader *> nurseryLargeObjects;
+    std::vector<BlockHeader *> recyclableBlocks;
+    uint64_t nurseryBytes = 0;
+
+    uint64_t oldBytes = 0;
+    uint64_t markingThreshold = minimumMarkingThreshold;
+    bool marking = false;
+    uint64_t markingCredit = 0;
+
+    // These are the old objects that were marked but not yet scanned, the
+    // objects promoted by the current collection of the nursery that were not
+    // yet scanned, and the old objects that may refer to the nursery.
+    std::vector<void *> markStack;
+    std::vector<void *> promotedStack;
+    std::vector<void *> rememberedSet;
+
+    // These are the roots outside of the stack.
+    std::vector<std::pair<const void *, const void *>> roots;
+    std::vector<const RootSource *> rootSources;
+    const uint8_t *stackTop;
+
+    GCStats stats{};
+
+    // This method will return the object that a word refers to, either as a
+    // boxed or as a raw pointer, or null if it does not refer to one.
+    [[nodiscard]] auto findReferent(uint64_t word) const -> void *;
+
+    // This method will add the objects that the roots refer to, including
+    // the registers and the stack of the program.
+    auto findRoots(std::vector<void *> &objects) -> void;
+    auto scanStack(std::vector<void *> &objects) -> void;
+
+    // These methods will visit an object that is referred to, during a
+    // collection of the nursery and during marking.
+    auto visitYoung(void *object) -> void;
+    auto visitOld(void *object) -> void;
+
+    // This method will find the next hole of at least the given size, and
+    // allocate from it.
+    auto refill(uint64_t size) -> void;
+
+    // This method will run the collections and the marking that are due
+    // before the given number of bytes is allocated.
+    auto prepareAllocation(uint64_t size) -> void;
+
+    // This method will collect the nursery.
+    auto collectNursery() -> void;
+
+    // These methods will start the marking, run a slice of it, and end it
+    // with a sweep.
+    auto startMarking() -> void;
+    auto markSlice(uint64_t budget) -> void;
+    auto finishMarking() -> void;
+
+    // This method will record the pause that started at the given time.
+    auto recordPause(uint64_t start) -> void;
+
+  public:
+    Collector();
+    Collector(const Collector &) = delete;
+    auto operator=(const Collector &) -> Collector & = delete;
+
+    // This method will allocate a zeroed object in the nursery.
+    auto allocate(uint64_t size) -> void *;
+
+    // This method will record that a value was stored in an object, which
+    // must be the start of the object.
+    auto writeBarrier(void *object, uint64_t value) -> void;
+
+    // This method will collect the whole heap, finishing any marking that is
+    // under way.
+    auto collect() -> void;
+
+    // These methods will add and remove a range of words that may refer to
+    // the heap.
+    auto addRoots(const void *start, uint64_t size) -> void;
+    auto removeRoots(const void *start) -> void;
+
+    // These methods will add and remove a source of roots.
+    auto addRootSource(const RootSource *source) -> void;
+    auto removeRootSource(const RootSource *source) -> void;
+
+    [[nodiscard]] inline auto getStats() const -> const GCStats & {
+        return stats;
+    }
+};
+
+// This function will return the collector of the program.
+auto getCollector() -> Collector &;
+} // namespace gc
+
+extern "C" {
+// This function will record that a boxed or raw pointer was stored in an
+// object. The code generator calls it only for values that may be pointers.
+auto ntsc_write_barrier(void *object, uint64_t value) -> void;
+
+// This function will collect the whole heap.
+auto ntsc_gc_collect() -> void;
+
+// These functions will add and remove a range of memory outside of the heap,
+// such as a global, whose words may refer to the heap.
+auto ntsc_gc_add_roots(const void *start, uint64_t size) -> void;
+auto ntsc_gc_remove_roots(const void *start) -> void;
+
+// This function will copy the statistics of the collector. When the
+// NTSC_GC_STATS environment variable is set, they are also printed when the
+// program exits.
+auto ntsc_gc_get_stats(GCStats *stats) -> void;
+}
+} // namespace ntsc
+
+#endif
@@ -0,0 +1,222 @@
+#include "EventLoop.h"
+#include "ObjectModel.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+/*
+    This file contains the implementation of the EventLoop. The timers are a
+    binary heap ordered by deadline. A file descriptor stays registered with
+    epoll only while a promise waits on it, and is waited on level triggered,
+    so an event that arrives before the wait is not lost.
+*/
+
+namespace ntsc {
+// This function will return the time in milliseconds.
+static auto now() -> uint64_t {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+// This compares timers, so that the heap holds the earliest one first.
+static auto isLater = [](const auto &left, const auto &right) {
+    if (left.deadline != right.deadline)
+        return left.deadline > right.deadline;
+    return left.sequence > right.sequence;
+};
+
+// This is the implementation of the EventLoop constructor.
+EventLoop::EventLoop() : epoll{epoll_create1(EPOLL_CLOEXEC)} {
+    if (epoll < 0) {
+        std::perror("ntsc: epoll_create1");
+        std::abort();
+    }
+    gc::getCollector().addRootSource(this);
+}
+
+// This is the implementation of the EventLoop destructor.
+EventLoop::~EventLoop() {
+    gc::getCollector().removeRootSource(this);
+    close(epoll);
+}
+
+// This is the implementation of EventLoop::sleep.
+auto EventLoop::sleep(uint64_t milliseconds) -> Promise * {
+    auto *promise = ntsc_promise_new();
+    timers.push_back(Timer{now() + milliseconds, timerSequence++, promise});
+    std::push_heap(timers.begin(), timers.end(), isLater);
+    return promise;
+}
+
+// This is the implementation of EventLoop::waitFor.
+auto EventLoop::waitFor(int descriptor, bool writable) -> Promise * {
+    if (descriptor < 0) {
+        auto *promise = ntsc_promise_new();
+        ntsc_promise_reject(promise, undefinedValue);
+        return promise;
+    }
+    if (static_cast<size_t>(descriptor) >= descriptors.size())
+        descriptors.resize(descriptor + 1, Descriptor{nullptr, nullptr});
+    auto &waiting = descriptors[descriptor];
+    auto wasWaiting = waiting.readable || waiting.writable;
+    auto *&promise = writable ? waiting.writable : waiting.readable;
+    if (promise)
+        return promise;
+
+    // The promise is settled and forgotten at once if epoll cannot wait on
+    // the descriptor.
+    auto *created = ntsc_promise_new();
+    promise = created;
+    updateDescriptor(descriptor, wasWaiting);
+    return created;
+}
+
+// This is the implementation of EventLoop::updateDescriptor.
+auto EventLoop::updateDescriptor(int descriptor, bool wasWaiting) -> void {
+    auto &waiting = descriptors[descriptor];
+    epoll_event event{};
+    event.events = (waiting.readable ? EPOLLIN : 0u) |
+                   (waiting.writable ? EPOLLOUT : 0u);
+    event.data.fd = descriptor;
+    auto isWaiting = event.events != 0;
+    int result;
+    if (!isWaiting) {
+        result = epoll_ctl(epoll, EPOLL_CTL_DEL, descriptor, nullptr);
+        --waitingDescriptors;
+    } else if (wasWaiting) {
+        result = epoll_ctl(epoll, EPOLL_CTL_MOD, descriptor, &event);
+    } else {
+        result = epoll_ctl(epoll, EPOLL_CTL_ADD, descriptor, &event);
+        ++waitingDescriptors;
+    }
+
+    // A descriptor that epoll cannot wait on, such as a regular file, is
+    // always ready, and one that was closed is an error. Closing a descriptor
+    // also drops it from epoll, so a later waiter fails to modify it, and
+    // both of its promises are settled then. The descriptor is removed in
+    // case epoll still has it, so that it is not counted as waited on.
+    if (result != 0 && isWaiting) {
+        auto ready = errno == EPERM;
+        if (wasWaiting)
+            epoll_ctl(epoll, EPOLL_CTL_DEL, descriptor, nullptr);
+        --waitingDescriptors;
+        for (auto **promise : {&waiting.readable, &waiting.writable}) {
+            if (!*promise)
+                continue;
+            if (ready)
+                ntsc_promise_resolve(*promise, undefinedValue);
+            else
+                ntsc_promise_reject(*promise, undefinedValue);
+            *promise = nullptr;
+        }
+    }
+}
+
+// This is the implementation of EventLoop::fireTimers.
+auto EventLoop::fireTimers() -> void {
+    auto time = now();
+    while (!timers.empty() && timers.front().deadline <= time) {
+        std::pop_heap(timers.begin(), timers.end(), isLater);
+        auto *promise = timers.back().promise;
+        timers.pop_back();
+        ntsc_promise_resolve(promise, undefinedValue);
+    }
+}
+
+// This is the implementation of EventLoop::poll. The deadlines are kept in
+// whole milliseconds, which is what epoll waits for.
+auto EventLoop::poll() -> void {
+    int timeout = -1;
+    if (!timers.empty()) {
+        auto time = now();
+        auto deadline = timers.front().deadline;
+        timeout = deadline <= time ? 0
+                                   : static_cast<int>(std::min<uint64_t>(
+                                         deadline - time, INT32_MAX));
+    }
+
+    epoll_event events[64];
+    auto count = waitingDescriptors || timeout != 0
+                     ? epoll_wait(epoll, events, 64, timeout)
+                     : 0;
+    if (count < 0 && errno != EINTR) {
+        std::perror("ntsc: epoll_wait");
+        std::abort();
+    }
+    for (int i = 0; i < count; ++i) {
+        auto descriptor = events[i].data.fd;
+        auto &waiting = descriptors[descriptor];
+        auto flags = events[i].events;
+        auto failed = (flags & (EPOLLERR | EPOLLHUP)) != 0;
+        if (waiting.readable && (flags & EPOLLIN || failed)) {
+            ntsc_promise_resolve(waiting.readable, undefinedValue);
+            waiting.readable = nullptr;
+        }
+        if (waiting.writable && (flags & EPOLLOUT || failed)) {
+            ntsc_promise_resolve(waiting.writable, undefinedValue);
+            waiting.writable = nullptr;
+        }
+        updateDescriptor(descriptor, true);
+    }
+    fireTimers();
+}
+
+// This is the implementation of EventLoop::run. A coroutine resumed by this
+// turn that becomes ready again runs on the same turn, as the microtasks of
+// JavaScript do. The switched resumption of LLVM puts the resume function at
+// the start of every frame.
+auto EventLoop::run() -> void {
+    while (true) {
+        while (!ready.empty()) {
+            auto *coroutine = ready.front();
+            ready.pop_front();
+            auto resume = *static_cast<void (**)(void *)>(coroutine);
+            resume(coroutine);
+        }
+        if (timers.empty() && !waitingDescriptors)
+            return;
+        poll();
+    }
+}
+
+// This is the implementation of EventLoop::getRanges.
+auto EventLoop::getRanges(
+    std::vector<std::pair<const void *, const void *>> &ranges) const
+    -> void {
+    ranges.emplace_back(timers.data(), timers.data() + timers.size());
+    ranges.emplace_back(descriptors.data(),
+                        descriptors.data() + descriptors.size());
+}
+
+// This is the implementation of getEventLoop.
+auto getEventLoop() -> EventLoop & {
+    static auto *loop = new EventLoop;
+    return *loop;
+}
+
+extern "C" {
+// This is the implementation of ntsc_sleep.
+auto ntsc_sleep(uint64_t milliseconds) -> Promise * {
+    return getEventLoop().sleep(milliseconds);
+}
+
+// This is the implementation of ntsc_wait_readable.
+auto ntsc_wait_readable(int descriptor) -> Promise * {
+    return getEventLoop().waitFor(descriptor, false);
+}
+
+// This is the implementation of ntsc_wait_writable.
+auto ntsc_wait_writable(int descriptor) -> Promise * {
+    return getEventLoop().waitFor(descriptor, true);
+}
+
+// This is the implementation of ntsc_run_event_loop.
+auto ntsc_run_event_loop() -> void { getEventLoop().run(); }
+}
+} // namespace ntsc
@@ -0,0 +1,96 @@
+#ifndef NTSC_EVENTLOOP_H
+#define NTSC_EVENTLOOP_H
+#include "Collector.h"
+#include "Promise.h"
+#include <cstdint>
+#include <deque>
+#include <utility>
+#include <vector>
+
+/*
+    This file defines the EventLoop interface, which drives the coroutines of
+    async functions. Each turn resumes every coroutine that is ready, in the
+    order it became ready, and then waits on epoll for a file descriptor or
+    the next timer. Timers and file descriptors settle promises, so their
+    coroutines are resumed through the same queue.
+
+    The loop keeps the promises of its timers and file descriptors, which no
+    coroutine may refer to yet, so the collector scans them as roots.
+*/
+
+namespace ntsc {
+class EventLoop : public gc::RootSource {
+    struct Timer {
+        uint64_t deadline;
+        // This orders the timers with the same deadline by when they were
+        // added.
+        uint64_t sequence;
+        Promise *promise;
+    };
+
+    // This struct holds the promises that wait on a file descriptor, which
+    // are indexed by the descriptor.
+    struct Descriptor {
+        Promise *readable;
+        Promise *writable;
+    };
+
+    std::deque<void *> ready;
+    std::vector<Timer> timers;
+    uint64_t timerSequence = 0;
+    std::vector<Descriptor> descriptors;
+    uint64_t waitingDescriptors = 0;
+    int epoll;
+
+    // This method will update the events that epoll waits for on a file
+    // descriptor.
+    auto updateDescriptor(int descriptor, bool wasWaiting) -> void;
+
+    // This method will settle the promises of the timers that are due.
+    auto fireTimers() -> void;
+
+    // This method will wait for a file descriptor or a timer, and settle
+    // their promises.
+    auto poll() -> void;
+
+  public:
+    EventLoop();
+    ~EventLoop() override;
+    EventLoop(const EventLoop &) = delete;
+    auto operator=(const EventLoop &) -> EventLoop & = delete;
+
+    // This method will add a coroutine to be resumed on the next turn.
+    inline auto schedule(void *coroutine) -> void {
+        ready.push_back(coroutine);
+    }
+
+    // This method will return a promise that is fulfilled after the given
+    // number of milliseconds.
+    auto sleep(uint64_t milliseconds) -> Promise *;
+
+    // This method will return a promise that is fulfilled once a file
+    // descriptor is readable or writable. Waiting twice for the same event
+    // returns the same promise.
+    auto waitFor(int descriptor, bool writable) -> Promise *;
+
+    // This method will run the loop until no coroutine is ready and nothing
+    // is waited for.
+    auto run() -> void;
+
+    auto getRanges(std::vector<std::pair<const void *, const void *>> &ranges)
+        const -> void override;
+};
+
+// This function will return the event loop of the program.
+auto getEventLoop() -> EventLoop &;
+
+extern "C" {
+// These functions give generated code access to the event loop.
+auto ntsc_sleep(uint64_t milliseconds) -> Promise *;
+auto ntsc_wait_readable(int descriptor) -> Promise *;
+auto ntsc_wait_writable(int descriptor) -> Promise *;
+auto ntsc_run_event_loop() -> void;
+}
+} // namespace ntsc
+
+#endif
@@ -0,0 +1,118 @@
+#include "FramePool.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+/*
+    This file contains the implementation of the FramePool. The slabs are
+    never returned, since the number of frames that are live at once is
+    bounded by the requests that a program serves at once.
+*/
+
+namespace ntsc {
+// This function will allocate zeroed memory, or end the program.
+static auto allocateZeroed(uint64_t size) -> uint8_t * {
+    auto *memory = static_cast<uint8_t *>(std::calloc(1, size));
+    if (!memory) {
+        std::fputs("ntsc: out of memory\n", stderr);
+        std::abort();
+    }
+    return memory;
+}
+
+// This is the implementation of the FramePool constructor.
+FramePool::FramePool() { gc::getCollector().addRootSource(this); }
+
+// This is the implementation of the FramePool destructor.
+FramePool::~FramePool() {
+    gc::getCollector().removeRootSource(this);
+    for (auto *slab : slabs)
+        std::free(slab);
+    for (auto [frame, size] : largeFrames)
+        std::free(frame);
+}
+
+// This is the implementation of FramePool::refill. The frames are pushed in
+// reverse, so they are handed out in address order.
+auto FramePool::refill(uint64_t sizeClass) -> void {
+    auto size = (sizeClass + 1) * classSize;
+    auto *slab = allocateZeroed(slabSize);
+    slabs.push_back(slab);
+    for (auto offset = (slabSize / size) * size; offset != 0; offset -= size) {
+        auto *frame = reinterpret_cast<FreeFrame *>(slab + offset - size);
+        frame->next = freeLists[sizeClass];
+        freeLists[sizeClass] = frame;
+    }
+}
+
+// This is the implementation of FramePool::allocate.
+auto FramePool::allocate(uint64_t size) -> void * {
+    auto sizeClass = (std::max(size, uint64_t{1}) - 1) / classSize;
+    if (sizeClass >= classCount) {
+        auto *frame = allocateZeroed(size);
+        largeFrames.emplace_back(frame, size);
+        return frame;
+    }
+    if (!freeLists[sizeClass])
+        refill(sizeClass);
+    auto *frame = freeLists[sizeClass];
+    freeLists[sizeClass] = frame->next;
+    frame->next = nullptr;
+    return frame;
+}
+
+// This is the implementation of FramePool::free. A large frame that is not
+// in the list was freed twice, or never came from the pool.
+auto FramePool::free(void *frame, uint64_t size) -> void {
+    if (!frame)
+        return;
+    auto sizeClass = (std::max(size, uint64_t{1}) - 1) / classSize;
+    if (sizeClass >= classCount) {
+        auto found = std::find_if(
+            largeFrames.begin(), largeFrames.end(),
+            [&](auto &large) { return large.first == frame; });
+        if (found == largeFrames.end()) {
+            std::fputs("ntsc: freed a coroutine frame that is not live\n",
+                       stderr);
+            std::abort();
+        }
+        *found = largeFrames.back();
+        largeFrames.pop_back();
+        std::free(frame);
+        return;
+    }
+    std::memset(frame, 0, (sizeClass + 1) * classSize);
+    auto *free = static_cast<FreeFrame *>(frame);
+    free->next = freeLists[sizeClass];
+    freeLists[sizeClass] = free;
+}
+
+// This is the implementation of FramePool::getRanges.
+auto FramePool::getRanges(
+    std::vector<std::pair<const void *, const void *>> &ranges) const
+    -> void {
+    for (auto *slab : slabs)
+        ranges.emplace_back(slab, slab + slabSize);
+    for (auto [frame, size] : largeFrames)
+        ranges.emplace_back(frame, frame + size);
+}
+
+// This function will return the frame pool of the program.
+static auto getFramePool() -> FramePool & {
+    static auto *pool = new FramePool;
+    return *pool;
+}
+
+extern "C" {
+// This is the implementation of ntsc_coro_alloc.
+auto ntsc_coro_alloc(uint64_t size) -> void * {
+    return getFramePool().allocate(size);
+}
+
+// This is the implementation of ntsc_coro_free.
+auto ntsc_coro_free(void *frame, uint64_t size) -> void {
+    getFramePool().free(frame, size);
+}
+}
+} // namespace ntsc
@@ -0,0 +1,62 @@
+#ifndef NTSC_FRAMEPOOL_H
+#define NTSC_FRAMEPOOL_H
+#include "Collector.h"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/*
+    This file defines the FramePool interface, which allocates the frames of
+    the coroutines that async functions are lowered to. Frames are kept in
+    free lists by size class, so calling an async function does not allocate
+    once a frame of its size has been freed.
+
+    A frame holds the locals of its function across an await, so the
+    collector scans every frame as a root. A frame is cleared when it is
+    freed, so a free frame keeps nothing alive.
+*/
+
+namespace ntsc {
+class FramePool : public gc::RootSource {
+    // This is the size of every class, and of the slabs that they are cut
+    // from.
+    static constexpr uint64_t classSize = 64;
+    static constexpr uint64_t classCount = 32;
+    static constexpr uint64_t slabSize = uint64_t{64} << 10;
+
+    struct FreeFrame {
+        FreeFrame *next;
+    };
+    FreeFrame *freeLists[classCount] = {};
+    std::vector<uint8_t *> slabs;
+
+    // These are the frames larger than every class, which are allocated on
+    // their own.
+    std::vector<std::pair<uint8_t *, uint64_t>> largeFrames;
+
+    // This method will cut a new slab into frames of a class.
+    auto refill(uint64_t sizeClass) -> void;
+
+  public:
+    FramePool();
+    ~FramePool() override;
+    FramePool(const FramePool &) = delete;
+    auto operator=(const FramePool &) -> FramePool & = delete;
+
+    // These methods will allocate and free a frame of the given size.
+    auto allocate(uint64_t size) -> void *;
+    auto free(void *frame, uint64_t size) -> void;
+
+    auto getRanges(std::vector<std::pair<const void *, const void *>> &ranges)
+        const -> void override;
+};
+
+extern "C" {
+// These functions will allocate and free the frame of a coroutine. A null
+// frame, which the coroutine passes when its frame was elided, is ignored.
+auto ntsc_coro_alloc(uint64_t size) -> void *;
+auto ntsc_coro_free(void *frame, uint64_t size) -> void;
+}
+} // namespace ntsc
+
+#endif
@@ -0,0 +1,169 @@
+#include "Heap.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
+
+/*
+    This file contains the implementation of the Heap. The reserved addresses
+    are only backed by memory once they are touched, so reserving far more
+    than a program uses costs nothing.
+*/
+
+namespace ntsc {
+namespace gc {
+// This is the implementation of findNextBit.
+auto findNextBit(const Bitmap &bitmap, uint64_t bit) -> uint64_t {
+    if (bit >= granulesPerBlock)
+        return granulesPerBlock;
+    auto index = bit / 64;
+    auto word = bitmap[index] & (~uint64_t{0} << (bit % 64));
+    while (!word) {
+        if (++index == bitmapWords)
+            return granulesPerBlock;
+        word = bitmap[index];
+    }
+    return index * 64 + static_cast<uint64_t>(__builtin_ctzll(word));
+}
+
+// This is the implementation of findPreviousBit.
+auto findPreviousBit(const Bitmap &bitmap, uint64_t bit) -> uint64_t {
+    auto index = bit / 64;
+    auto word = bitmap[index] & (~uint64_t{0} >> (63 - bit % 64));
+    while (!word) {
+        if (index-- == 0)
+            return granulesPerBlock;
+        word = bitmap[index];
+    }
+    return index * 64 + 63 - static_cast<uint64_t>(__builtin_clzll(word));
+}
+
+// This is the implementation of the Heap constructor. The reservation is
+// aligned to the size of a block by reserving an extra block.
+Heap::Heap() {
+    auto *reservation = mmap(nullptr, reservedSize + blockSize,
+                             PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1,
+                             0);
+    if (reservation == MAP_FAILED) {
+        std::fputs("ntsc: unable to reserve the heap\n", stderr);
+        std::abort();
+    }
+    auto address = reinterpret_cast<uintptr_t>(reservation);
+    base = reinterpret_cast<uint8_t *>((address + blockSize - 1) &
+                                       ~(blockSize - 1));
+    end = base + reservedSize;
+    kinds.resize(reservedSize / blockSize, BlockKind::Free);
+    spanStarts.resize(reservedSize / blockSize);
+}
+
+// This is the implementation of Heap::findFreeRun. Spans are rare, so the
+// blocks are searched in order.
+auto Heap::findFreeRun(uint32_t count) -> uint32_t {
+    uint32_t run = 0;
+    for (uint32_t index = 0; index < blockCount; ++index) {
+        run = kinds[index] == BlockKind::Free ? run + 1 : 0;
+        if (run == count)
+            return index + 1 - count;
+    }
+    auto start = blockCount - run;
+    if (start + count > kinds.size()) {
+        std::fputs("ntsc: out of memory\n", stderr);
+        std::abort();
+    }
+    blockCount = start + count;
+    return start;
+}
+
+// This is the implementation of Heap::findObject. A pointer past the end of
+// the object before it lands in a hole, which holds no object.
+auto Heap::findObject(const void *address) const -> void * {
+    auto index = static_cast<uint32_t>(
+        (static_cast<const uint8_t *>(address) - base) / blockSize);
+    switch (kinds[index]) {
+    case BlockKind::Free:
+    case BlockKind::Dirty:
+        return nullptr;
+    case BlockKind::Continuation:
+        index = spanStarts[index];
+        [[fallthrough]];
+    case BlockKind::Large: {
+        auto *block = getBlock(index);
+        auto *object = getAddress(block, firstGranule);
+        auto *byte = static_cast<const uint8_t *>(address);
+        if (byte < object || byte >= object + block->largeSize)
+            return nullptr;
+        return testBit(block->starts, firstGranule) ? object : nullptr;
+    }
+    case BlockKind::Small:
+        break;
+    }
+
+    auto *block = getBlock(index);
+    auto granule = getGranuleOf(address);
+    auto start = findPreviousBit(block->starts, granule);
+    if (start == granulesPerBlock || findNextBit(block->ends, start) < granule)
+        return nullptr;
+    return getAddress(block, start);
+}
+
+// This is the implementation of Heap::getObjectSize.
+auto Heap::getObjectSize(const void *object) -> uint64_t {
+    auto *block = getBlockOf(object);
+    if (block->kind == BlockKind::Large)
+        return block->largeSize;
+    auto start = getGranuleOf(object);
+    return (findNextBit(block->ends, start) + 1 - start) * granuleSize;
+}
+
+// This is the implementation of Heap::allocateBlock.
+auto Heap::allocateBlock() -> BlockHeader * {
+    uint32_t index;
+    if (!dirtyBlocks.empty()) {
+        index = dirtyBlocks.back();
+        dirtyBlocks.pop_back();
+        std::memset(getBlock(index), 0, blockSize);
+    } else {
+        index = findFreeRun(1);
+    }
+    kinds[index] = BlockKind::Small;
+    auto *block = getBlock(index);
+    block->kind = BlockKind::Small;
+    block->spanBlocks = 1;
+    return block;
+}
+
+// This is the implementation of Heap::allocateLarge. A span is never made of
+// dirty blocks, so it is always clear.
+auto Heap::allocateLarge(uint64_t size) -> BlockHeader * {
+    auto count = static_cast<uint32_t>(
+        (firstGranule * granuleSize + size + blockSize - 1) / blockSize);
+    auto index = findFreeRun(count);
+    kinds[index] = BlockKind::Large;
+    for (uint32_t i = 1; i < count; ++i) {
+        kinds[index + i] = BlockKind::Continuation;
+        spanStarts[index + i] = index;
+    }
+    auto *block = getBlock(index);
+    block->kind = BlockKind::Large;
+    block->spanBlocks = count;
+    block->largeSize = size;
+    return block;
+}
+
+// This is the implementation of Heap::release. Clearing a small block when it
+// is reused is cheaper than faulting in its pages again.
+auto Heap::release(BlockHeader *block) -> void {
+    auto index = getIndex(block);
+    if (block->kind == BlockKind::Small) {
+        kinds[index] = BlockKind::Dirty;
+        dirtyBlocks.push_back(index);
+        return;
+    }
+    auto count = block->spanBlocks;
+    for (uint32_t i = 0; i < count; ++i)
+        kinds[index + i] = BlockKind::Free;
+    madvise(block, count * blockSize, MADV_DONTNEED);
+}
+} // namespace gc
+} // namespace ntsc
@@ -0,0 +1,176 @@
+#ifndef NTSC_HEAP_H
+#define NTSC_HEAP_H
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+    This file defines the Heap interface, which holds the memory of the
+    garbage collector. The heap reserves a single range of addresses up front
+    and divides it into blocks aligned to their size, so a word is checked
+    for being a pointer to the heap with a compare, and the block of an object
+    is found by masking its address.
+
+    A block is either small, holding many objects, or the first of a span of
+    blocks that holds one large object. Objects have no headers. Instead, the
+    header of each block has a bitmap for each of the following, with a bit
+    for every 16 bytes, which is the alignment of every object:
+    - starts: the first granule of every object.
+    - ends: the last granule of every object, so the size of an object is the
+      distance to the next end.
+    - old: the objects that survived a collection of the nursery.
+    - marks: the objects that the current full collection reached.
+    - remembered: the old objects that may refer to the nursery.
+    A large object uses the bits of its first granule, and its size is kept in
+    the header of its span instead of in the ends.
+*/
+
+namespace ntsc {
+namespace gc {
+constexpr uint64_t granuleSize = 16;
+constexpr uint64_t blockSize = uint64_t{1} << 18;
+constexpr uint64_t granulesPerBlock = blockSize / granuleSize;
+constexpr uint64_t bitmapWords = granulesPerBlock / 64;
+
+// This is the size of the addresses that the heap reserves, which bounds the
+// memory that a program may use.
+constexpr uint64_t reservedSize = uint64_t{32} << 30;
+
+// This is the size of the largest object that is allocated in a small block.
+constexpr uint64_t largeObjectSize = blockSize / 8;
+
+enum class BlockKind : uint8_t {
+    Free,
+    // A free block that still holds the data of its last use, which must be
+    // cleared before it is used again. Every other free block was returned to
+    // the system, which clears it.
+    Dirty,
+    Small,
+    Large,
+    // A block after the first of a span that holds a large object.
+    Continuation,
+};
+
+using Bitmap = uint64_t[bitmapWords];
+
+struct BlockHeader {
+    BlockKind kind;
+    // This is the number of blocks in the span of a large object, and the
+    // size of the object.
+    uint32_t spanBlocks;
+    uint64_t largeSize;
+    Bitmap starts;
+    Bitmap ends;
+    Bitmap old;
+    Bitmap marks;
+    Bitmap remembered;
+};
+
+// This is the first granule of a block after its header, where its objects
+// begin.
+constexpr uint64_t firstGranule =
+    (sizeof(BlockHeader) + granuleSize - 1) / granuleSize;
+
+// These functions will read, set and clear a bit of a bitmap.
+inline auto testBit(const Bitmap &bitmap, uint64_t bit) -> bool {
+    return (bitmap[bit / 64] >> (bit % 64)) & 1;
+}
+inline auto setBit(Bitmap &bitmap, uint64_t bit) -> void {
+    bitmap[bit / 64] |= uint64_t{1} << (bit % 64);
+}
+inline auto clearBit(Bitmap &bitmap, uint64_t bit) -> void {
+    bitmap[bit / 64] &= ~(uint64_t{1} << (bit % 64));
+}
+
+// This function will return the first set bit of a bitmap at or after the
+// given one, or granulesPerBlock if there is none.
+auto findNextBit(const Bitmap &bitmap, uint64_t bit) -> uint64_t;
+
+// This function will return the last set bit of a bitmap at or before the
+// given one, or granulesPerBlock if there is none.
+auto findPreviousBit(const Bitmap &bitmap, uint64_t bit) -> uint64_t;
+
+class Heap {
+    uint8_t *base = nullptr;
+    uint8_t *end = nullptr;
+
+    // This is the number of blocks that have ever been used, which are the
+    // only ones that must be visited.
+    uint32_t blockCount = 0;
+
+    // These are the kind of each block, along with the first block of the
+    // span that each continuation belongs to.
+    std::vector<BlockKind> kinds;
+    std::vector<uint32_t> spanStarts;
+
+    // These are the dirty blocks, which are reused before any other.
+    std::vector<uint32_t> dirtyBlocks;
+
+    // This method will return the index of a run of free blocks, growing the
+    // heap if there is none.
+    auto findFreeRun(uint32_t count) -> uint32_t;
+
+  public:
+    Heap();
+    Heap(const Heap &) = delete;
+    auto operator=(const Heap &) -> Heap & = delete;
+
+    [[nodiscard]] inline auto contains(const void *address) const -> bool {
+        auto *byte = static_cast<const uint8_t *>(address);
+        return byte >= base && byte < end;
+    }
+
+    [[nodiscard]] inline auto getBlockCount() const -> uint32_t {
+        return blockCount;
+    }
+    [[nodiscard]] inline auto getKind(uint32_t index) const -> BlockKind {
+        return kinds[index];
+    }
+    [[nodiscard]] inline auto getBlock(uint32_t index) const
+        -> BlockHeader * {
+        return reinterpret_cast<BlockHeader *>(base + index * blockSize);
+    }
+    [[nodiscard]] inline auto getIndex(const BlockHeader *block) const
+        -> uint32_t {
+        return static_cast<uint32_t>(
+            (reinterpret_cast<const uint8_t *>(block) - base) / blockSize);
+    }
+
+    // These functions will return the block of an object that starts in it,
+    // and the granule of the object in its block.
+    static inline auto getBlockOf(const void *object) -> BlockHeader * {
+        return reinterpret_cast<BlockHeader *>(
+            reinterpret_cast<uintptr_t>(object) & ~(blockSize - 1));
+    }
+    static inline auto getGranuleOf(const void *object) -> uint64_t {
+        return (reinterpret_cast<uintptr_t>(object) & (blockSize - 1)) /
+               granuleSize;
+    }
+    static inline auto getAddress(BlockHeader *block, uint64_t granule)
+        -> uint8_t * {
+        return reinterpret_cast<uint8_t *>(block) + granule * granuleSize;
+    }
+
+    // This method will return the start of the object that holds an address
+    // in the heap, or null if it is not in an object.
+    [[nodiscard]] auto findObject(const void *address) const -> void *;
+
+    // This method will return the size of an object in bytes.
+    [[nodiscard]] static auto getObjectSize(const void *object) -> uint64_t;
+
+    // This method will return a small block that holds no objects.
+    auto allocateBlock() -> BlockHeader *;
+
+    // This method will return a span that holds a single large object of the
+    // given size, with the bits of its first granule clear.
+    auto allocateLarge(uint64_t size) -> BlockHeader *;
+
+    // This method will free a small block or the span of a large object.
+    // Small blocks are kept to be reused, while spans are returned to the
+    // system.
+    auto release(BlockHeader *block) -> void;
+};
+} // namespace gc
+} // namespace ntsc
+
+#endif
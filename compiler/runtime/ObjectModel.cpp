@@ -0,0 +1,109 @@
+#include "ObjectModel.h"
+#include "Collector.h"
+#include "Shape.h"
+#include <cstring>
+
+/*
+    This file contains the implementation of the property accesses that miss
+    their inline caches. The slots that do not fit in an object grow by
+    doubling, so the capacity of an object's overflow slots is implied by
+    their number, and is not stored. Every store of a value goes through the
+    write barrier of the collector, on the object that holds the slot.
+*/
+
+namespace ntsc {
+// This function will return the capacity of the given number of overflow
+// slots.
+static auto getOverflowCapacity(uint32_t count) -> uint32_t {
+    if (count == 0)
+        return 0;
+    uint32_t capacity = 4;
+    while (capacity < count)
+        capacity *= 2;
+    return capacity;
+}
+
+// This function will return the offset of an inline slot from its object.
+static auto getInlineOffset(int64_t slot) -> uint64_t {
+    return sizeof(Object) + static_cast<uint64_t>(slot) * sizeof(uint64_t);
+}
+
+// This function will add a shape to an inline cache, replacing the oldest
+// entry once the cache is full.
+static auto addToCache(InlineCache *cache, const Shape *shape, uint64_t offset)
+    -> void {
+    auto count = cache->entryCount ? cache->entryCount : inlineCacheSize;
+    auto &entry = cache->entries[cache->nextEntry % count];
+    entry.shape = shape;
+    entry.offset = offset;
+    ++cache->nextEntry;
+}
+
+extern "C" {
+// This is the implementation of ntsc_literal_shape.
+auto ntsc_literal_shape(const Shape **cache, const PropertyName *names,
+                        uint32_t count) -> const Shape * {
+    auto *shape = Shape::getRoot(count);
+    for (uint32_t i = 0; i < count; ++i)
+        shape = shape->addProperty(names[i]);
+    *cache = shape;
+    return shape;
+}
+
+// This is the implementation of ntsc_get_property.
+auto ntsc_get_property(const Object *object, PropertyName name,
+                       InlineCache *cache) -> uint64_t {
+    auto *shape = object->shape;
+    auto slot = shape->findSlot(name);
+    if (slot < 0)
+        return undefinedValue;
+    if (slot < shape->getInlineCapacity()) {
+        addToCache(cache, shape, getInlineOffset(slot));
+        return object->getInlineSlots()[slot];
+    }
+    return object->overflowSlots[slot - shape->getInlineCapacity()];
+}
+
+// This is the implementation of ntsc_set_property.
+auto ntsc_set_property(Object *object, PropertyName name, uint64_t value,
+                       InlineCache *cache) -> void {
+    auto *shape = object->shape;
+    auto slot = shape->findSlot(name);
+    if (slot >= 0) {
+        auto capacity = shape->getInlineCapacity();
+        if (slot < capacity) {
+            addToCache(cache, shape, getInlineOffset(slot));
+            object->getInlineSlots()[slot] = value;
+            ntsc_write_barrier(object, value);
+        } else {
+            object->overflowSlots[slot - capacity] = value;
+            ntsc_write_barrier(object->overflowSlots, value);
+        }
+        return;
+    }
+
+    auto *child = shape->addProperty(name);
+    slot = shape->getSlotCount();
+    auto capacity = shape->getInlineCapacity();
+    if (slot < capacity) {
+        object->getInlineSlots()[slot] = value;
+        ntsc_write_barrier(object, value);
+    } else {
+        auto count = static_cast<uint32_t>(slot - capacity);
+        if (count == getOverflowCapacity(count)) {
+            auto newCapacity = getOverflowCapacity(count + 1);
+            auto *slots = static_cast<uint64_t *>(
+                ntsc_alloc(newCapacity * sizeof(uint64_t)));
+            if (count != 0)
+                std::memcpy(slots, object->overflowSlots,
+                            count * sizeof(uint64_t));
+            object->overflowSlots = slots;
+            ntsc_write_barrier(object, reinterpret_cast<uintptr_t>(slots));
+        }
+        object->overflowSlots[count] = value;
+        ntsc_write_barrier(object->overflowSlots, value);
+    }
+    object->shape = child;
+}
+}
+} // namespace ntsc
@@ -0,0 +1,94 @@
+#ifndef NTSC_OBJECTMODEL_H
+#define NTSC_OBJECTMODEL_H
+#include <cstddef>
+#include <cstdint>
+
+/*
+    This file defines the layout of objects in generated code, which the code
+    generator and the runtime both rely on. An object is a pointer to its
+    Shape, a pointer to the slots that do not fit in the object, and then its
+    inline slots. Every slot holds a boxed value, so an object reads the same
+    whether its properties are found at fixed offsets, because the type
+    checker proved its exact type, or through an inline cache.
+
+    The runtime is linked into every program, so it only depends on the
+    standard library and POSIX.
+*/
+
+namespace ntsc {
+class Shape;
+
+// A property name is a null terminated string that is interned by its
+// address. The code generator emits every name as a global that the linker
+// merges with the same name from every other module.
+using PropertyName = const char *;
+
+// These are the parts of a boxed value that the runtime relies on, which must
+// match those of ValueRepresentation.h.
+constexpr unsigned boxedTagShift = 48;
+constexpr uint64_t boxedPayloadMask = (uint64_t{1} << boxedTagShift) - 1;
+constexpr uint64_t boxedPointerTag = 0xfffc;
+constexpr uint64_t undefinedValue = uint64_t{0xfffa} << boxedTagShift;
+
+struct Object {
+    const Shape *shape;
+    uint64_t *overflowSlots;
+
+    // This method will return the inline slots, which follow the header.
+    inline auto getInlineSlots() -> uint64_t * {
+        return reinterpret_cast<uint64_t *>(this + 1);
+    }
+    inline auto getInlineSlots() const -> const uint64_t * {
+        return reinterpret_cast<const uint64_t *>(this + 1);
+    }
+};
+static_assert(sizeof(Object) == 16, "the object header is two pointers");
+
+// This is the number of shapes that an access remembers before it replaces
+// the oldest one.
+constexpr unsigned inlineCacheSize = 4;
+
+// This struct is the inline cache of a single property access in generated
+// code, which starts out zeroed. Each entry holds a shape that the access has
+// seen, along with the offset of the property in the objects of that shape.
+// Only the properties in inline slots are cached.
+struct InlineCache {
+    struct Entry {
+        const Shape *shape;
+        uint64_t offset;
+    };
+    Entry entries[inlineCacheSize];
+    uint32_t nextEntry;
+
+    // This is the number of entries that the access probes, where zero means
+    // every entry. A profile that shows an access seeing fewer shapes lets the
+    // compiler drop the probes it never hit, and the runtime then only fills
+    // the entries that are left.
+    uint32_t entryCount;
+};
+
+extern "C" {
+// This function will return the shape of the objects created by an object
+// literal, with the given properties in inline slots in order. Generated code
+// keeps the shape of every literal in its own cache, which this fills.
+auto ntsc_literal_shape(const Shape **cache, const PropertyName *names,
+                        uint32_t count) -> const Shape *;
+
+// This function will read a property that the inline cache of the access did
+// not hold, and add its shape to the cache.
+auto ntsc_get_property(const Object *object, PropertyName name,
+                       InlineCache *cache) -> uint64_t;
+
+// This function will write a property that the inline cache of the access did
+// not hold. A new property changes the shape of the object, so only writes to
+// properties that already exist are cached.
+auto ntsc_set_property(Object *object, PropertyName name, uint64_t value,
+                       InlineCache *cache) -> void;
+
+// This function is the allocator of the heap, which the runtime also uses
+// for the slots that do not fit in an object.
+auto ntsc_alloc(uint64_t size) -> void *;
+}
+} // namespace ntsc
+
+#endif
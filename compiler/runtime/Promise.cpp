@@ -0,0 +1,74 @@
+#include "Promise.h"
+#include "Collector.h"
+#include "EventLoop.h"
+#include "ObjectModel.h"
+#include <cstdio>
+#include <cstdlib>
+
+/*
+    This file contains the implementation of promises. The waiters are
+    scheduled in the order they awaited, which is the reverse of their list.
+*/
+
+namespace ntsc {
+// This function will settle a promise and schedule its waiters.
+static auto settle(Promise *promise, PromiseState state, uint64_t value)
+    -> void {
+    if (promise->state != PromiseState::Pending)
+        return;
+    promise->state = state;
+    promise->value = value;
+    ntsc_write_barrier(promise, value);
+
+    AwaitNode *ordered = nullptr;
+    for (auto *node = promise->waiters; node;) {
+        auto *next = node->next;
+        node->next = ordered;
+        ordered = node;
+        node = next;
+    }
+    promise->waiters = nullptr;
+    auto &loop = getEventLoop();
+    for (auto *node = ordered; node; node = node->next)
+        loop.schedule(node->coroutine);
+}
+
+extern "C" {
+// This is the implementation of ntsc_promise_new. The heap is zeroed, which
+// makes the promise pending.
+auto ntsc_promise_new() -> Promise * {
+    return static_cast<Promise *>(ntsc_alloc(sizeof(Promise)));
+}
+
+// This is the implementation of ntsc_promise_resolve.
+auto ntsc_promise_resolve(Promise *promise, uint64_t value) -> void {
+    settle(promise, PromiseState::Fulfilled, value);
+}
+
+// This is the implementation of ntsc_promise_reject.
+auto ntsc_promise_reject(Promise *promise, uint64_t reason) -> void {
+    settle(promise, PromiseState::Rejected, reason);
+}
+
+// This is the implementation of ntsc_promise_await.
+auto ntsc_promise_await(Promise *promise, AwaitNode *node, void *coroutine)
+    -> void {
+    node->coroutine = coroutine;
+    if (promise->state != PromiseState::Pending) {
+        getEventLoop().schedule(coroutine);
+        return;
+    }
+    node->next = promise->waiters;
+    promise->waiters = node;
+}
+
+// This is the implementation of ntsc_promise_result.
+auto ntsc_promise_result(const Promise *promise) -> uint64_t {
+    if (promise->state == PromiseState::Rejected) {
+        std::fputs("ntsc: uncaught rejection in an async function\n", stderr);
+        std::abort();
+    }
+    return promise->value;
+}
+}
+} // namespace ntsc
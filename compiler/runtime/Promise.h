@@ -0,0 +1,59 @@
+#ifndef NTSC_PROMISE_H
+#define NTSC_PROMISE_H
+#include <cstdint>
+
+/*
+    This file defines the layout of promises, which the code generator and
+    the runtime both rely on. An async function is lowered to a coroutine
+    that returns its promise, and every await suspends the coroutine until
+    the awaited promise is settled. As in JavaScript, a coroutine is never
+    resumed from within the call that settles its promise, and an await of a
+    promise that is already settled still waits for the event loop.
+
+    A promise lives on the heap. The coroutines that await it are linked
+    through nodes in their own frames, so awaiting allocates nothing.
+*/
+
+namespace ntsc {
+enum class PromiseState : uint64_t {
+    Pending,
+    Fulfilled,
+    Rejected,
+};
+
+// This struct is the record of a coroutine that awaits a promise. The code
+// generator keeps one in the frame of the coroutine for each await.
+struct AwaitNode {
+    void *coroutine;
+    AwaitNode *next;
+};
+
+struct Promise {
+    PromiseState state;
+    // This is the boxed value or reason once the promise is settled.
+    uint64_t value;
+    // These are the coroutines that await the promise, the last one first.
+    AwaitNode *waiters;
+};
+
+extern "C" {
+// This function will return a new pending promise.
+auto ntsc_promise_new() -> Promise *;
+
+// These functions will settle a promise, scheduling the coroutines that
+// await it. A promise that is already settled is left as it is.
+auto ntsc_promise_resolve(Promise *promise, uint64_t value) -> void;
+auto ntsc_promise_reject(Promise *promise, uint64_t reason) -> void;
+
+// This function will suspend a coroutine on a promise, until it is settled.
+// The node must stay valid until then.
+auto ntsc_promise_await(Promise *promise, AwaitNode *node, void *coroutine)
+    -> void;
+
+// This function will return the value of a promise that was awaited. Async
+// functions cannot catch yet, so a rejection ends the program.
+auto ntsc_promise_result(const Promise *promise) -> uint64_t;
+}
+} // namespace ntsc
+
+#endif
@@ -0,0 +1,41 @@
+#include "Shape.h"
+
+/*
+    This file contains the implementation of the Shape interface. A property
+    is found by walking from a shape to the root, which only happens when an
+    inline cache misses.
+*/
+
+namespace ntsc {
+// This is the implementation of Shape::getRoot.
+auto Shape::getRoot(uint32_t inlineCapacity) -> const Shape * {
+    static std::vector<std::unique_ptr<Shape>> roots;
+    if (roots.size() <= inlineCapacity)
+        roots.resize(inlineCapacity + 1);
+    auto &root = roots[inlineCapacity];
+    if (!root)
+        root.reset(new Shape{nullptr, nullptr, 0, inlineCapacity});
+    return root.get();
+}
+
+// This is the implementation of Shape::addProperty.
+auto Shape::addProperty(PropertyName property) const -> const Shape * {
+    for (auto &[name, child] : transitions) {
+        if (name == property)
+            return child.get();
+    }
+    auto *child = new Shape{this, property, slotCount + 1, inlineCapacity};
+    transitions.emplace_back(property, std::unique_ptr<Shape>{child});
+    return child;
+}
+
+// This is the implementation of Shape::findSlot. The shape that added a
+// property holds it in its last slot.
+auto Shape::findSlot(PropertyName property) const -> int64_t {
+    for (auto *shape = this; shape->parent; shape = shape->parent) {
+        if (shape->name == property)
+            return static_cast<int64_t>(shape->slotCount) - 1;
+    }
+    return -1;
+}
+} // namespace ntsc
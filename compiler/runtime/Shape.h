@@ -0,0 +1,65 @@
+#ifndef NTSC_SHAPE_H
+#define NTSC_SHAPE_H
+#include "ObjectModel.h"
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/*
+    This file defines the Shape interface. A shape, or hidden class, is the
+    list of the properties of an object in the order they were added, and
+    maps each one to a slot. Objects that gain the same properties in the
+    same order share a shape, since adding a property to a shape always
+    leads to the same child, so an inline cache that compares shapes knows
+    where a property is without looking it up.
+
+    Programs run their code on a single thread, as JavaScript does, so the
+    shapes are not synchronized.
+*/
+
+namespace ntsc {
+class Shape {
+    const Shape *parent;
+    PropertyName name;
+    uint32_t slotCount;
+    uint32_t inlineCapacity;
+
+    // These are the shapes that adding a property to this one leads to. Most
+    // shapes have one at most, so they are searched in order. They are only
+    // a record of the children made so far, so they do not change the shape.
+    mutable std::vector<std::pair<PropertyName, std::unique_ptr<Shape>>>
+        transitions;
+
+    Shape(const Shape *parent, PropertyName name, uint32_t slotCount,
+          uint32_t inlineCapacity)
+        : parent{parent}, name{name}, slotCount{slotCount},
+          inlineCapacity{inlineCapacity} {}
+
+  public:
+    Shape(const Shape &) = delete;
+    auto operator=(const Shape &) -> Shape & = delete;
+
+    // This function will return the shape of the objects without properties
+    // that have the given number of inline slots.
+    static auto getRoot(uint32_t inlineCapacity) -> const Shape *;
+
+    // This method will return the shape of an object of this shape once the
+    // given property is added, which takes the next slot.
+    [[nodiscard]] auto addProperty(PropertyName property) const
+        -> const Shape *;
+
+    // This method will return the slot of a property, or -1 if the objects
+    // of this shape do not have it.
+    [[nodiscard]] auto findSlot(PropertyName property) const -> int64_t;
+
+    [[nodiscard]] inline auto getSlotCount() const -> uint32_t {
+        return slotCount;
+    }
+    [[nodiscard]] inline auto getInlineCapacity() const -> uint32_t {
+        return inlineCapacity;
+    }
+};
+} // namespace ntsc
+
+#endif
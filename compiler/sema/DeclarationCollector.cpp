@@ -0,0 +1,204 @@
+#include "DeclarationCollector.h"
+#include "llvm/Support/Casting.h"
+#include <algorithm>
+
+/*
+    This file contains the implementation of the DeclarationCollector.
+    Names are resolved to the top-level declarations of the program without
+    regard for local scopes, so a local that shadows a top-level name adds a
+    dependency that is not needed. That only costs some parallelism, whereas
+    a missed dependency would let a unit be checked before a type it needs.
+*/
+
+namespace ntsc {
+namespace {
+// This function will return the child of a node that holds a name it
+// declares or a property name, which is not a reference to a declaration.
+auto getNameChild(const Node *node) -> NodeRef {
+    switch (node->kind) {
+    case NodeKind::Parameter:
+        return llvm::cast<Parameter>(node)->name;
+    case NodeKind::VariableDeclaration:
+        return llvm::cast<VariableDeclaration>(node)->name;
+    case NodeKind::PropertyAssignment:
+        return llvm::cast<PropertyAssignment>(node)->name;
+    case NodeKind::BreakStatement:
+        return llvm::cast<BreakStatement>(node)->label;
+    case NodeKind::ContinueStatement:
+        return llvm::cast<ContinueStatement>(node)->label;
+    case NodeKind::FunctionDeclaration:
+        return llvm::cast<FunctionDeclaration>(node)->name;
+    case NodeKind::ClassDeclaration:
+        return llvm::cast<ClassDeclaration>(node)->name;
+    case NodeKind::PropertyDeclaration:
+        return llvm::cast<PropertyDeclaration>(node)->name;
+    case NodeKind::MethodDeclaration:
+        return llvm::cast<MethodDeclaration>(node)->name;
+    case NodeKind::TypeAliasDeclaration:
+        return llvm::cast<TypeAliasDeclaration>(node)->name;
+    case NodeKind::PropertyAccessExpression:
+        return llvm::cast<PropertyAccessExpression>(node)->name;
+    default:
+        return {};
+    }
+}
+} // namespace
+
+// This is the implementation of DeclarationCollector::addUnit.
+auto DeclarationCollector::addUnit(const ASTContext &context, NodeRef node,
+                                   CheckUnitKind kind) -> UnitID {
+    auto unit = graph.addUnit();
+    units.push_back({&context, node, kind});
+    return unit;
+}
+
+// This is the implementation of DeclarationCollector::declare.
+auto DeclarationCollector::declare(const ASTContext &context, NodeRef name,
+                                   UnitID unit) -> void {
+    if (auto *identifier = context.getIfPresent<Identifier>(name))
+        declarations[identifier->name.getValue()].push_back(unit);
+}
+
+// This is the implementation of DeclarationCollector::collectReferences.
+auto DeclarationCollector::collectReferences(const ASTContext &context,
+                                             NodeRef node, UnitID unit)
+    -> void {
+    if (!node.isValid())
+        return;
+
+    llvm::SmallVector<NodeRef, 32> worklist{node};
+    while (!worklist.empty()) {
+        auto ref = worklist.pop_back_val();
+        auto *current = context.get(ref);
+        if (auto *identifier = llvm::dyn_cast<Identifier>(current)) {
+            references.emplace_back(unit, identifier->name);
+            continue;
+        }
+
+        auto name = getNameChild(current);
+        context.forEachChild(ref, [&](NodeRef child) {
+            if (child != name)
+                worklist.push_back(child);
+        });
+    }
+}
+
+// This is the implementation of DeclarationCollector::addFunction.
+auto DeclarationCollector::addFunction(const ASTContext &context,
+                                       NodeRef ref) -> void {
+    auto *function = context.get<FunctionDeclaration>(ref);
+    auto signature = addUnit(context, ref, CheckUnitKind::Signature);
+    declare(context, function->name, signature);
+
+    for (auto parameter : context.getList(function->parameters))
+        collectReferences(context, parameter, signature);
+    if (!function->returnType.isValid()) {
+        collectReferences(context, function->body, signature);
+        return;
+    }
+
+    collectReferences(context, function->returnType, signature);
+    if (function->body.isValid()) {
+        auto body = addUnit(context, ref, CheckUnitKind::Body);
+        graph.addDependency(body, signature);
+        collectReferences(context, function->body, body);
+    }
+}
+
+// This is the implementation of DeclarationCollector::addClass. The members
+// are part of the signature of the class, except for the bodies of methods
+// that declare their return type.
+auto DeclarationCollector::addClass(const ASTContext &context, NodeRef ref)
+    -> void {
+    auto *declaration = context.get<ClassDeclaration>(ref);
+    auto signature = addUnit(context, ref, CheckUnitKind::Signature);
+    declare(context, declaration->name, signature);
+    collectReferences(context, declaration->baseClass, signature);
+
+    for (auto member : context.getList(declaration->members)) {
+        auto *method = context.getIfPresent<MethodDeclaration>(member);
+        if (!method || !method->returnType.isValid() ||
+            !method->body.isValid()) {
+            collectReferences(context, member, signature);
+            continue;
+        }
+
+        for (auto parameter : context.getList(method->parameters))
+            collectReferences(context, parameter, signature);
+        collectReferences(context, method->returnType, signature);
+
+        auto body = addUnit(context, member, CheckUnitKind::Body);
+        graph.addDependency(body, signature);
+        collectReferences(context, method->body, body);
+    }
+}
+
+// This is the implementation of DeclarationCollector::addModule.
+auto DeclarationCollector::addModule(const ASTContext &context) -> void {
+    auto root = context.getRoot();
+    auto *file = context.get<SourceFileNode>(root);
+
+    // The top-level unit is only added once a statement needs it.
+    auto topLevel = static_cast<UnitID>(-1);
+    for (auto statement : context.getList(file->statements)) {
+        switch (context.get(statement)->kind) {
+        case NodeKind::FunctionDeclaration:
+            addFunction(context, statement);
+            break;
+        case NodeKind::ClassDeclaration:
+            addClass(context, statement);
+            break;
+        case NodeKind::TypeAliasDeclaration: {
+            auto *alias = context.get<TypeAliasDeclaration>(statement);
+            auto unit = addUnit(context, statement, CheckUnitKind::Signature);
+            declare(context, alias->name, unit);
+            collectReferences(context, alias->type, unit);
+            break;
+        }
+        case NodeKind::VariableStatement: {
+            auto *variables = context.get<VariableStatement>(statement);
+            for (auto ref : context.getList(variables->declarations)) {
+                auto *variable = context.get<VariableDeclaration>(ref);
+                auto unit = addUnit(context, ref, CheckUnitKind::Signature);
+                declare(context, variable->name, unit);
+                collectReferences(context, ref, unit);
+            }
+            break;
+        }
+        default:
+            if (topLevel == static_cast<UnitID>(-1))
+                topLevel = addUnit(context, root, CheckUnitKind::TopLevel);
+            collectReferences(context, statement, topLevel);
+            break;
+        }
+    }
+}
+
+// This is the implementation of DeclarationCollector::finish.
+auto DeclarationCollector::finish() -> void {
+    // A unit usually refers to the same names many times.
+    auto key = [](const std::pair<UnitID, Symbol> &reference) {
+        return std::make_pair(reference.first, reference.second.getValue());
+    };
+    std::sort(references.begin(), references.end(),
+              [&](const auto &left, const auto &right) {
+                  return key(left) < key(right);
+              });
+    references.erase(std::unique(references.begin(), references.end(),
+                                 [&](const auto &left, const auto &right) {
+                                     return key(left) == key(right);
+                                 }),
+                     references.end());
+
+    for (auto [unit, name] : references) {
+        auto found = declarations.find(name.getValue());
+        if (found == declarations.end())
+            continue;
+        for (auto declaration : found->second)
+            graph.addDependency(unit, declaration);
+    }
+    references.clear();
+    references.shrink_to_fit();
+    graph.computeComponents();
+}
+} // namespace ntsc
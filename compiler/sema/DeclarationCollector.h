@@ -0,0 +1,99 @@
+#ifndef NTSC_DECLARATIONCOLLECTOR_H
+#define NTSC_DECLARATIONCOLLECTOR_H
+#include "ASTContext.h"
+#include "DeclarationGraph.h"
+#include "IdentifierTable.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/*
+    This file defines the DeclarationCollector interface, which splits the
+    modules of a program into the units of work of the type checker and fills
+    in a DeclarationGraph with the dependencies between them.
+
+    The signature of a declaration, which is all that other code needs to
+    see, is a separate unit from the body of a function or method, so bodies
+    no longer wait on each other and can be checked in parallel. A function
+    without a return type has to infer it from its body, so its body is part
+    of its signature. The remaining top-level statements of a module form a
+    single unit, since they run in order.
+*/
+
+namespace ntsc {
+// This enum holds the kind of a unit of work.
+enum class CheckUnitKind : uint8_t {
+    // The type of a declaration, without the bodies that do not affect it.
+    Signature,
+    // The body of a function or method whose signature is checked apart.
+    Body,
+    // The top-level statements of a module that are not declarations.
+    TopLevel,
+};
+
+// This struct is a unit of work for the type checker. The node is the
+// declaration, or the root of the module for a TopLevel unit.
+struct CheckUnit {
+    const ASTContext *context;
+    NodeRef node;
+    CheckUnitKind kind;
+};
+
+class DeclarationCollector {
+    using UnitID = DeclarationGraph::UnitID;
+
+    DeclarationGraph &graph;
+    std::vector<CheckUnit> units;
+
+    // These are the signature units that declare each top-level name. A name
+    // may be declared more than once, such as by a class and a type alias.
+    llvm::DenseMap<uint32_t, llvm::SmallVector<UnitID, 1>> declarations;
+
+    // These are the names referenced by each unit. They are resolved once
+    // every module has been added, since a module may refer to the
+    // declarations of one added after it.
+    std::vector<std::pair<UnitID, Symbol>> references;
+
+    // This method will add a unit to the graph.
+    auto addUnit(const ASTContext &context, NodeRef node, CheckUnitKind kind)
+        -> UnitID;
+
+    // This method will record the name that a signature unit declares.
+    auto declare(const ASTContext &context, NodeRef name, UnitID unit) -> void;
+
+    // This method will record every name referenced within a node as a
+    // reference of the unit. The names that a node declares, and the names
+    // of properties, are not references.
+    auto collectReferences(const ASTContext &context, NodeRef node,
+                           UnitID unit) -> void;
+
+    // These methods will add the units of the top-level declarations.
+    auto addFunction(const ASTContext &context, NodeRef ref) -> void;
+    auto addClass(const ASTContext &context, NodeRef ref) -> void;
+
+  public:
+    explicit DeclarationCollector(DeclarationGraph &graph) : graph{graph} {}
+    DeclarationCollector(const DeclarationCollector &) = delete;
+    auto operator=(const DeclarationCollector &)
+        -> DeclarationCollector & = delete;
+
+    // This method will add the units of a module. The context must outlive
+    // the check.
+    auto addModule(const ASTContext &context) -> void;
+
+    // This method will resolve the references of every unit into
+    // dependencies, and compute the components of the graph. It must be
+    // called after the last module is added.
+    auto finish() -> void;
+
+    // This method will return the units, indexed by their UnitID.
+    [[nodiscard]] inline auto getUnits() const -> llvm::ArrayRef<CheckUnit> {
+        return units;
+    }
+};
+} // namespace ntsc
+
+#endif
@@ -0,0 +1,209 @@
+#include "DeclarationGraph.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <limits>
+#include <memory>
+
+/*
+    This file contains the implementation of the DeclarationGraph.
+*/
+
+namespace ntsc {
+// This is the implementation of DeclarationGraph::addUnit.
+auto DeclarationGraph::addUnit() -> UnitID {
+    dependencies.emplace_back();
+    return static_cast<UnitID>(dependencies.size() - 1);
+}
+
+// This is the implementation of DeclarationGraph::addDependency.
+auto DeclarationGraph::addDependency(UnitID unit, UnitID dependency) -> void {
+    assert(unit < size() && dependency < size() && "unknown unit");
+    if (unit != dependency)
+        dependencies[unit].push_back(dependency);
+}
+
+// This is the implementation of DeclarationGraph::computeComponents. It is
+// Tarjan's algorithm, with an explicit stack so that a long chain of
+// dependencies cannot overflow the native one. Tarjan's algorithm finishes a
+// component only after every component reachable from it, so the components
+// come out with dependencies first.
+auto DeclarationGraph::computeComponents() -> void {
+    constexpr auto unvisited = std::numeric_limits<uint32_t>::max();
+    auto unitCount = size();
+
+    std::vector<uint32_t> index(unitCount, unvisited), lowLink(unitCount);
+    std::vector<bool> onStack(unitCount);
+    std::vector<UnitID> stack;
+
+    // Each frame is a unit being visited, and the next dependency to visit.
+    std::vector<std::pair<UnitID, uint32_t>> frames;
+    uint32_t nextIndex = 0;
+
+    componentOf.assign(unitCount, 0);
+    componentUnits.clear();
+    componentUnits.reserve(unitCount);
+    componentStarts.assign(1, 0);
+
+    for (UnitID root = 0; root < unitCount; ++root) {
+        if (index[root] != unvisited)
+            continue;
+
+        frames.emplace_back(root, 0);
+        while (!frames.empty()) {
+            auto &[unit, next] = frames.back();
+            if (next == 0 && index[unit] == unvisited) {
+                index[unit] = lowLink[unit] = nextIndex++;
+                stack.push_back(unit);
+                onStack[unit] = true;
+            }
+
+            if (next < dependencies[unit].size()) {
+                auto dependency = dependencies[unit][next++];
+                if (index[dependency] == unvisited)
+                    frames.emplace_back(dependency, 0);
+                else if (onStack[dependency])
+                    lowLink[unit] = std::min(lowLink[unit], index[dependency]);
+                continue;
+            }
+
+            // Every dependency has been visited, so the unit is finished.
+            auto finished = unit;
+            frames.pop_back();
+            if (!frames.empty()) {
+                auto parent = frames.back().first;
+                lowLink[parent] = std::min(lowLink[parent], lowLink[finished]);
+            }
+            if (lowLink[finished] != index[finished])
+                continue;
+
+            auto component =
+                static_cast<uint32_t>(componentStarts.size() - 1);
+            UnitID member;
+            do {
+                member = stack.back();
+                stack.pop_back();
+                onStack[member] = false;
+                componentOf[member] = component;
+                componentUnits.push_back(member);
+            } while (member != finished);
+            componentStarts.push_back(
+                static_cast<uint32_t>(componentUnits.size()));
+        }
+    }
+
+    buildComponentGraph();
+}
+
+// This is the implementation of DeclarationGraph::buildComponentGraph.
+auto DeclarationGraph::buildComponentGraph() -> void {
+    auto componentCount = getComponentCount();
+
+    // Collect the distinct edges between components, as pairs of the
+    // component depended on and the dependent.
+    std::vector<std::pair<uint32_t, uint32_t>> edges;
+    for (UnitID unit = 0; unit < size(); ++unit) {
+        auto component = componentOf[unit];
+        for (auto dependency : dependencies[unit]) {
+            if (componentOf[dependency] != component)
+                edges.emplace_back(componentOf[dependency], component);
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    dependentStarts.assign(componentCount + 1, 0);
+    dependencyCounts.assign(componentCount, 0);
+    dependents.clear();
+    dependents.reserve(edges.size());
+    for (auto [dependency, dependent] : edges) {
+        ++dependentStarts[dependency + 1];
+        ++dependencyCounts[dependent];
+        dependents.push_back(dependent);
+    }
+    for (size_t component = 0; component < componentCount; ++component)
+        dependentStarts[component + 1] += dependentStarts[component];
+
+    // Dependents always come later in the order, so the heights are filled
+    // in from the back.
+    heights.assign(componentCount, 1);
+    for (auto component = componentCount; component-- > 0;) {
+        for (auto i = dependentStarts[component];
+             i < dependentStarts[component + 1]; ++i)
+            heights[component] =
+                std::max(heights[component], heights[dependents[i]] + 1);
+    }
+
+    // Start the dependents with the longest chains first.
+    for (size_t component = 0; component < componentCount; ++component) {
+        std::sort(dependents.begin() + dependentStarts[component],
+                  dependents.begin() + dependentStarts[component + 1],
+                  [this](uint32_t left, uint32_t right) {
+                      return heights[left] > heights[right];
+                  });
+    }
+}
+
+namespace {
+// This struct holds the state of a single DeclarationGraph::run on a pool.
+// Each component counts the dependencies that have not finished yet, and the
+// job that finishes the last one starts it.
+struct ScheduledRun {
+    const DeclarationGraph &graph;
+    ThreadPool &pool;
+    llvm::function_ref<void(llvm::ArrayRef<DeclarationGraph::UnitID>)> check;
+    llvm::ArrayRef<uint32_t> dependentStarts;
+    llvm::ArrayRef<uint32_t> dependents;
+    std::unique_ptr<std::atomic<uint32_t>[]> pendingCounts;
+
+    auto start(uint32_t component) -> void {
+        pool.async([this, component] { runComponent(component); });
+    }
+
+    auto runComponent(uint32_t component) -> void {
+        check(graph.getComponent(component));
+        for (auto i = dependentStarts[component];
+             i < dependentStarts[component + 1]; ++i) {
+            auto dependent = dependents[i];
+            if (pendingCounts[dependent].fetch_sub(
+                    1, std::memory_order_acq_rel) == 1)
+                start(dependent);
+        }
+    }
+};
+} // namespace
+
+// This is the implementation of DeclarationGraph::run. The components are
+// already in an order where dependencies come first, so a single thread only
+// has to walk through them.
+auto DeclarationGraph::run(
+    ThreadPool *pool,
+    llvm::function_ref<void(llvm::ArrayRef<UnitID>)> check) const -> void {
+    auto componentCount = getComponentCount();
+    if (!pool || pool->getThreadCount() <= 1) {
+        for (size_t component = 0; component < componentCount; ++component)
+            check(getComponent(component));
+        return;
+    }
+
+    ScheduledRun run{*this,           *pool,      check,
+                     dependentStarts, dependents, nullptr};
+    run.pendingCounts =
+        std::make_unique<std::atomic<uint32_t>[]>(componentCount);
+    std::vector<uint32_t> ready;
+    for (uint32_t component = 0; component < componentCount; ++component) {
+        run.pendingCounts[component].store(dependencyCounts[component],
+                                           std::memory_order_relaxed);
+        if (dependencyCounts[component] == 0)
+            ready.push_back(component);
+    }
+
+    std::stable_sort(ready.begin(), ready.end(),
+                     [this](uint32_t left, uint32_t right) {
+                         return heights[left] > heights[right];
+                     });
+    for (auto component : ready)
+        run.start(component);
+    pool->wait();
+}
+} // namespace ntsc
@@ -0,0 +1,97 @@
+#ifndef NTSC_DECLARATIONGRAPH_H
+#define NTSC_DECLARATIONGRAPH_H
+#include "ThreadPool.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/STLFunctionalExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include <cstdint>
+#include <vector>
+
+/*
+    This file defines the DeclarationGraph interface, which schedules the work
+    of the type checker. Each unit of work, such as the signature of a
+    top-level declaration or the body of a function, lists the units it
+    depends on. Units that depend on each other in a cycle are merged into a
+    single component, and the components form a DAG that is checked on the
+    ThreadPool, with each component started as soon as its dependencies are
+    done.
+*/
+
+namespace ntsc {
+class DeclarationGraph {
+  public:
+    using UnitID = uint32_t;
+
+  private:
+    // These are the dependencies of each unit.
+    std::vector<llvm::SmallVector<UnitID, 2>> dependencies;
+
+    // These are the components, in an order where every component comes
+    // after the components it depends on. The units of component i are
+    // componentUnits[componentStarts[i]] up to componentStarts[i + 1].
+    std::vector<uint32_t> componentOf;
+    std::vector<UnitID> componentUnits;
+    std::vector<uint32_t> componentStarts;
+
+    // These are the components that depend on each component, and the
+    // number of distinct components that each one depends on.
+    std::vector<uint32_t> dependentStarts;
+    std::vector<uint32_t> dependents;
+    std::vector<uint32_t> dependencyCounts;
+
+    // This is the length of the longest chain of dependents that follows
+    // each component. Components on a long chain are started first, since
+    // they bound the time of the whole check.
+    std::vector<uint32_t> heights;
+
+    // This method will build the DAG of components once they are known.
+    auto buildComponentGraph() -> void;
+
+  public:
+    DeclarationGraph() = default;
+    DeclarationGraph(const DeclarationGraph &) = delete;
+    auto operator=(const DeclarationGraph &) -> DeclarationGraph & = delete;
+
+    // This method will add a unit with no dependencies.
+    auto addUnit() -> UnitID;
+
+    // This method will record that a unit cannot be checked before another.
+    // A dependency of a unit on itself is ignored.
+    auto addDependency(UnitID unit, UnitID dependency) -> void;
+
+    // This method will return the number of units.
+    [[nodiscard]] inline auto size() const -> size_t {
+        return dependencies.size();
+    }
+
+    // This method will merge the cycles of the graph into components. It must
+    // be called after the last dependency is added.
+    auto computeComponents() -> void;
+
+    // These methods will return the components and their units.
+    [[nodiscard]] inline auto getComponentCount() const -> size_t {
+        return componentStarts.empty() ? 0 : componentStarts.size() - 1;
+    }
+    [[nodiscard]] inline auto getComponent(size_t component) const
+        -> llvm::ArrayRef<UnitID> {
+        return llvm::makeArrayRef(componentUnits)
+            .slice(componentStarts[component],
+                   componentStarts[component + 1] -
+                       componentStarts[component]);
+    }
+    [[nodiscard]] inline auto getComponentOf(UnitID unit) const -> uint32_t {
+        return componentOf[unit];
+    }
+
+    // This method will call the callback once for every component, after it
+    // has been called for every component it depends on. Components run on
+    // the pool when one is given, and in order on the calling thread
+    // otherwise. It will return once every component has been checked, so it
+    // must not be called from a job on the same pool.
+    auto run(ThreadPool *pool,
+             llvm::function_ref<void(llvm::ArrayRef<UnitID>)> check) const
+        -> void;
+};
+} // namespace ntsc
+
+#endif
@@ -0,0 +1,512 @@
+#include "DeclarationModule.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+/*
+    This file implements declaration modules. A module is a header followed
+    by these sections: the inputs, the ranges of the strings, the offsets of
+    the type records, the type records as 32 bit words, the buckets of the
+    declaration index and finally the bytes of the strings. Like the entries
+    of the TokenCache, modules use the byte order of the host.
+
+    Types refer to each other by a 32 bit reference. The references below the
+    number of primitive types are the primitive types themselves, which are
+    never written, and the others are the index of a record plus that number.
+    The first word of a record is its kind:
+
+        Array:    element
+        Union:    count, members
+        Function: count, required count, rest, parameters, return type
+        Object:   count, then the name, type and optional flag of each
+                  property
+        Named:    name, target
+
+    A record only refers to the records before it, apart from the targets of
+    named types, which are created before their targets so that a recursive
+    type ends at its name.
+*/
+
+namespace ntsc {
+// This is the version of the format. It must be bumped whenever the format or
+// the meaning of a type changes, so stale modules are rejected.
+static constexpr uint32_t moduleVersion = 1;
+static constexpr char moduleMagic[8] = {'N', 'T', 'S', 'C', 'D', 'E', 'C', 0};
+
+// This is the number of primitive types, which are the references below it.
+static constexpr uint32_t primitiveTypeCount =
+    static_cast<uint32_t>(TypeKind::String) + 1;
+
+// This is the target of a named type whose target was never set.
+static constexpr uint32_t unsetTypeRef = UINT32_MAX;
+
+struct DeclarationModule::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t inputCount;
+    uint32_t stringCount;
+    uint32_t stringBytes;
+    uint32_t typeCount;
+    uint32_t typeWords;
+    uint32_t declarationCount;
+    uint32_t bucketCount;
+};
+
+struct DeclarationModule::InputRecord {
+    uint64_t contentHash;
+    uint32_t path;
+    uint32_t reserved;
+};
+
+struct DeclarationModule::Range {
+    uint32_t start;
+    uint32_t length;
+};
+
+// This is a bucket of the declaration index, which is an open addressing hash
+// table of the names. The name is the index of its string plus one, so that
+// an empty bucket is zero.
+struct DeclarationModule::Bucket {
+    uint32_t name;
+    uint32_t type;
+};
+
+// This function will return the hash of a name in the declaration index.
+static auto getNameHash(llvm::StringRef name) -> uint64_t {
+    return llvm::xxHash64(name);
+}
+
+// This function will append a column to a module.
+template <typename T>
+static auto appendColumn(std::string &module, const T *column, size_t count)
+    -> void {
+    module.append(reinterpret_cast<const char *>(column), count * sizeof(T));
+}
+
+// This is the implementation of DeclarationModuleWriter::addString.
+auto DeclarationModuleWriter::addString(llvm::StringRef string) -> uint32_t {
+    strings.emplace_back(string);
+    return static_cast<uint32_t>(strings.size() - 1);
+}
+
+// This is the implementation of DeclarationModuleWriter::getStringIndex.
+auto DeclarationModuleWriter::getStringIndex(Symbol name) -> uint32_t {
+    auto inserted = stringIndices.try_emplace(
+        name.getValue(), static_cast<uint32_t>(strings.size()));
+    if (inserted.second)
+        strings.emplace_back(identifiers.getName(name));
+    return inserted.first->second;
+}
+
+// This is the implementation of DeclarationModuleWriter::getTypeRef. The types
+// are already interned, so each distinct type is written once however many
+// times it is used.
+auto DeclarationModuleWriter::getTypeRef(const Type *type) -> uint32_t {
+    if (llvm::isa<PrimitiveType>(type))
+        return static_cast<uint32_t>(type->getKind());
+    auto it = typeRefs.find(type);
+    if (it != typeRefs.end())
+        return it->second;
+
+    auto addRecord = [&](std::vector<uint32_t> record) {
+        auto ref = static_cast<uint32_t>(typeRecords.size()) +
+                   primitiveTypeCount;
+        typeRecords.push_back(std::move(record));
+        typeRefs[type] = ref;
+        return ref;
+    };
+
+    std::vector<uint32_t> record{static_cast<uint32_t>(type->getKind())};
+    if (auto *named = llvm::dyn_cast<NamedType>(type)) {
+        // The name is added before its target, which may refer back to it.
+        record.push_back(getStringIndex(named->getName()));
+        record.push_back(unsetTypeRef);
+        auto ref = addRecord(std::move(record));
+        if (auto *target = named->getTarget()) {
+            auto targetRef = getTypeRef(target);
+            typeRecords[ref - primitiveTypeCount][2] = targetRef;
+        }
+        return ref;
+    }
+
+    if (auto *array = llvm::dyn_cast<ArrayType>(type)) {
+        record.push_back(getTypeRef(array->getElementType()));
+    } else if (auto *unionType = llvm::dyn_cast<UnionType>(type)) {
+        auto members = unionType->getMembers();
+        record.push_back(static_cast<uint32_t>(members.size()));
+        for (auto *member : members)
+            record.push_back(getTypeRef(member));
+    } else if (auto *function = llvm::dyn_cast<FunctionType>(type)) {
+        auto parameters = function->getParameters();
+        record.push_back(static_cast<uint32_t>(parameters.size()));
+        record.push_back(function->getRequiredCount());
+        record.push_back(function->hasRest());
+        for (auto *parameter : parameters)
+            record.push_back(getTypeRef(parameter));
+        record.push_back(getTypeRef(function->getReturnType()));
+    } else {
+        auto properties = llvm::cast<ObjectType>(type)->getProperties();
+        record.push_back(static_cast<uint32_t>(properties.size()));
+        for (auto &property : properties) {
+            record.push_back(getStringIndex(property.name));
+            record.push_back(getTypeRef(property.type));
+            record.push_back(property.optional);
+        }
+    }
+    return addRecord(std::move(record));
+}
+
+// This is the implementation of DeclarationModuleWriter::addInput.
+auto DeclarationModuleWriter::addInput(llvm::StringRef path,
+                                       uint64_t contentHash) -> void {
+    inputs.emplace_back(addString(path), contentHash);
+}
+
+// This is the implementation of DeclarationModuleWriter::addDeclaration.
+auto DeclarationModuleWriter::addDeclaration(Symbol name, const Type *type)
+    -> void {
+    declarations.emplace_back(getStringIndex(name), getTypeRef(type));
+}
+
+// This is the implementation of DeclarationModuleWriter::write.
+auto DeclarationModuleWriter::write(llvm::StringRef path) -> std::error_code {
+    // The index is at most half full, so a lookup of a missing name usually
+    // ends at the first empty bucket.
+    auto bucketCount = static_cast<uint32_t>(
+        llvm::PowerOf2Ceil(std::max<size_t>(declarations.size() * 2, 1)));
+    std::vector<DeclarationModule::Bucket> buckets(bucketCount);
+    for (auto &[name, type] : declarations) {
+        auto i = getNameHash(strings[name]) & (bucketCount - 1);
+        while (buckets[i].name != 0) {
+            assert(buckets[i].name != name + 1 &&
+                   "a name may only be declared once");
+            i = (i + 1) & (bucketCount - 1);
+        }
+        buckets[i] = {name + 1, type};
+    }
+
+    std::vector<DeclarationModule::InputRecord> inputRecords;
+    for (auto &[pathIndex, contentHash] : inputs)
+        inputRecords.push_back({contentHash, pathIndex, 0});
+
+    std::vector<DeclarationModule::Range> stringRanges;
+    std::string stringBytes;
+    for (auto &string : strings) {
+        stringRanges.push_back({static_cast<uint32_t>(stringBytes.size()),
+                                static_cast<uint32_t>(string.size())});
+        stringBytes += string;
+    }
+
+    std::vector<uint32_t> typeOffsets, typeWords;
+    for (auto &record : typeRecords) {
+        typeOffsets.push_back(static_cast<uint32_t>(typeWords.size()));
+        typeWords.insert(typeWords.end(), record.begin(), record.end());
+    }
+
+    DeclarationModule::Header header{};
+    std::memcpy(header.magic, moduleMagic, 8);
+    header.version = moduleVersion;
+    header.inputCount = static_cast<uint32_t>(inputRecords.size());
+    header.stringCount = static_cast<uint32_t>(stringRanges.size());
+    header.stringBytes = static_cast<uint32_t>(stringBytes.size());
+    header.typeCount = static_cast<uint32_t>(typeOffsets.size());
+    header.typeWords = static_cast<uint32_t>(typeWords.size());
+    header.declarationCount = static_cast<uint32_t>(declarations.size());
+    header.bucketCount = bucketCount;
+
+    std::string module;
+    appendColumn(module, &header, 1);
+    appendColumn(module, inputRecords.data(), inputRecords.size());
+    appendColumn(module, stringRanges.data(), stringRanges.size());
+    appendColumn(module, typeOffsets.data(), typeOffsets.size());
+    appendColumn(module, typeWords.data(), typeWords.size());
+    appendColumn(module, buckets.data(), buckets.size());
+    module += stringBytes;
+
+    int fd;
+    llvm::SmallString<128> tempPath;
+    llvm::SmallString<128> model{path};
+    model += ".%%%%%%%%.tmp";
+    if (auto ec = llvm::sys::fs::createUniqueFile(model, fd, tempPath))
+        return ec;
+    {
+        llvm::raw_fd_ostream os{fd, /*shouldClose=*/true};
+        os << module;
+        os.close();
+        if (os.has_error()) {
+            auto ec = os.error();
+            os.clear_error();
+            llvm::sys::fs::remove(tempPath);
+            return ec;
+        }
+    }
+    if (auto ec = llvm::sys::fs::rename(tempPath, path)) {
+        llvm::sys::fs::remove(tempPath);
+        return ec;
+    }
+    return {};
+}
+
+// This is the implementation of the DeclarationModule constructor.
+DeclarationModule::DeclarationModule(
+    std::unique_ptr<llvm::MemoryBuffer> buffer, IdentifierTable &identifiers,
+    TypeContext &types)
+    : buffer{std::move(buffer)}, identifiers{identifiers}, types{types} {}
+
+// This is the implementation of DeclarationModule::load. Only the header and
+// the inputs are read here. The sizes of the sections are checked, but the
+// records in them are checked as they are read.
+auto DeclarationModule::load(llvm::StringRef path,
+                             IdentifierTable &identifiers, TypeContext &types)
+    -> llvm::ErrorOr<std::unique_ptr<DeclarationModule>> {
+    static_assert(sizeof(Header) % 8 == 0, "the inputs must stay aligned");
+
+    // Large modules are memory mapped by LLVM.
+    auto bufferResult =
+        llvm::MemoryBuffer::getFile(path, /*IsText=*/false,
+                                    /*RequiresNullTerminator=*/false);
+    if (!bufferResult)
+        return bufferResult.getError();
+
+    auto invalid = std::make_error_code(std::errc::invalid_argument);
+    auto &buffer = *bufferResult;
+    auto size = static_cast<uint64_t>(buffer->getBufferSize());
+    if (size < sizeof(Header))
+        return invalid;
+    auto *start = buffer->getBufferStart();
+    auto *header = reinterpret_cast<const Header *>(start);
+    if (std::memcmp(header->magic, moduleMagic, 8) != 0 ||
+        header->version != moduleVersion ||
+        !llvm::isPowerOf2_32(header->bucketCount))
+        return invalid;
+
+    auto offset = uint64_t{sizeof(Header)};
+    auto takeSection = [&](uint64_t bytes) {
+        auto *section = start + offset;
+        offset += bytes;
+        return section;
+    };
+    auto *inputs =
+        takeSection(uint64_t{header->inputCount} * sizeof(InputRecord));
+    auto *stringRanges =
+        takeSection(uint64_t{header->stringCount} * sizeof(Range));
+    auto *typeOffsets =
+        takeSection(uint64_t{header->typeCount} * sizeof(uint32_t));
+    auto *typeWords =
+        takeSection(uint64_t{header->typeWords} * sizeof(uint32_t));
+    auto *buckets =
+        takeSection(uint64_t{header->bucketCount} * sizeof(Bucket));
+    auto *stringBytes = takeSection(header->stringBytes);
+    if (offset != size)
+        return invalid;
+
+    std::unique_ptr<DeclarationModule> module{
+        new DeclarationModule{std::move(buffer), identifiers, types}};
+    module->header = header;
+    module->inputRecords = reinterpret_cast<const InputRecord *>(inputs);
+    module->stringRanges = reinterpret_cast<const Range *>(stringRanges);
+    module->typeOffsets = reinterpret_cast<const uint32_t *>(typeOffsets);
+    module->typeWords = reinterpret_cast<const uint32_t *>(typeWords);
+    module->buckets = reinterpret_cast<const Bucket *>(buckets);
+    module->stringBytes = stringBytes;
+    for (uint32_t i = 0; i < header->inputCount; ++i)
+        if (!module->getString(module->inputRecords[i].path))
+            return invalid;
+
+    module->materializedTypes.resize(header->typeCount);
+    module->inProgress.resize(header->typeCount);
+    return module;
+}
+
+// This is the implementation of DeclarationModule::getString.
+auto DeclarationModule::getString(uint32_t index) const
+    -> llvm::Optional<llvm::StringRef> {
+    if (index >= header->stringCount)
+        return llvm::None;
+    auto range = stringRanges[index];
+    if (uint64_t{range.start} + range.length > header->stringBytes)
+        return llvm::None;
+    return llvm::StringRef{stringBytes + range.start, range.length};
+}
+
+// This is the implementation of DeclarationModule::materialize.
+auto DeclarationModule::materialize(uint32_t ref) -> const Type * {
+    if (ref < primitiveTypeCount) {
+        switch (static_cast<TypeKind>(ref)) {
+#define PRIMITIVE_TYPE(name, spelling)                                         \
+    case TypeKind::name:                                                       \
+        return types.get##name##Type();
+#include "TypeKinds.def"
+        default:
+            return nullptr;
+        }
+    }
+
+    auto index = ref - primitiveTypeCount;
+    if (index >= header->typeCount)
+        return nullptr;
+    if (auto *type = materializedTypes[index])
+        return type;
+    if (inProgress[index])
+        return nullptr;
+
+    // Every word of the record is checked against the end of the section as
+    // it is read. Once a read fails, the record is rejected.
+    auto position = uint64_t{typeOffsets[index]};
+    auto valid = true;
+    auto read = [&]() -> uint32_t {
+        if (position >= header->typeWords) {
+            valid = false;
+            return 0;
+        }
+        return typeWords[position++];
+    };
+    auto readType = [&]() -> const Type * {
+        auto *type = valid ? materialize(read()) : nullptr;
+        valid &= type != nullptr;
+        return type;
+    };
+    auto readName = [&]() -> Symbol {
+        auto name = getString(read());
+        valid &= name.hasValue();
+        return valid ? identifiers.intern(*name) : Symbol{};
+    };
+    // A count may not claim more words than are left, so a corrupt count
+    // never allocates more than the size of the module.
+    auto readCount = [&](uint64_t wordsEach) -> uint32_t {
+        auto count = read();
+        valid &= uint64_t{count} * wordsEach <= header->typeWords - position;
+        return valid ? count : 0;
+    };
+
+    auto kind = read();
+    if (kind == static_cast<uint32_t>(TypeKind::Named)) {
+        // The named type is recorded before its target is read, so that a
+        // reference back to it from within its target ends here.
+        auto name = readName();
+        auto targetRef = read();
+        if (!valid)
+            return nullptr;
+        auto *named = types.createNamedType(name);
+        materializedTypes[index] = named;
+        ++materializedCount;
+        if (targetRef != unsetTypeRef) {
+            auto *target = materialize(targetRef);
+            if (!target)
+                return nullptr;
+            named->setTarget(target);
+        }
+        return named;
+    }
+
+    inProgress[index] = true;
+    const Type *type = nullptr;
+    switch (static_cast<TypeKind>(kind)) {
+    case TypeKind::Array:
+        if (auto *element = readType())
+            type = types.getArrayType(element);
+        break;
+    case TypeKind::Union: {
+        llvm::SmallVector<const Type *, 8> members(readCount(1));
+        for (auto &member : members)
+            member = readType();
+        if (valid)
+            type = types.getUnionType(members);
+        break;
+    }
+    case TypeKind::Function: {
+        auto count = readCount(1);
+        auto requiredCount = read();
+        auto rest = read();
+        llvm::SmallVector<const Type *, 8> parameters(count);
+        for (auto &parameter : parameters)
+            parameter = readType();
+        auto *returnType = readType();
+        if (valid && requiredCount <= count && rest <= 1 &&
+            (!rest || count != 0))
+            type = types.getFunctionType(parameters, requiredCount, rest != 0,
+                                         returnType);
+        break;
+    }
+    case TypeKind::Object: {
+        llvm::SmallVector<Property, 8> properties(readCount(3));
+        for (auto &property : properties) {
+            property.name = readName();
+            property.type = readType();
+            auto optional = read();
+            valid &= optional <= 1;
+            property.optional = optional != 0;
+        }
+
+        // The names of the properties must be distinct.
+        llvm::SmallVector<uint32_t, 8> names;
+        for (auto &property : properties)
+            names.push_back(property.name.getValue());
+        std::sort(names.begin(), names.end());
+        if (valid && std::adjacent_find(names.begin(), names.end()) ==
+                         names.end())
+            type = types.getObjectType(properties);
+        break;
+    }
+    default:
+        break;
+    }
+    inProgress[index] = false;
+    if (type) {
+        materializedTypes[index] = type;
+        ++materializedCount;
+    }
+    return type;
+}
+
+// This is the implementation of DeclarationModule::lookup. Only the buckets on
+// the probe sequence of the name, and the records of the types that the
+// declaration refers to, are touched.
+auto DeclarationModule::lookup(llvm::StringRef name) -> const Type * {
+    auto mask = header->bucketCount - 1;
+    auto i = static_cast<uint32_t>(getNameHash(name)) & mask;
+    for (uint32_t probes = 0; probes < header->bucketCount; ++probes) {
+        auto bucket = buckets[i];
+        if (bucket.name == 0)
+            return nullptr;
+        auto bucketName = getString(bucket.name - 1);
+        if (!bucketName)
+            return nullptr;
+        if (*bucketName == name) {
+            std::lock_guard<std::mutex> lock{mutex};
+            return materialize(bucket.type);
+        }
+        i = (i + 1) & mask;
+    }
+    return nullptr;
+}
+
+// This is the implementation of DeclarationModule::getInputCount.
+auto DeclarationModule::getInputCount() const -> size_t {
+    return header->inputCount;
+}
+
+// This is the implementation of DeclarationModule::getInput. The paths of the
+// inputs were checked when the module was loaded.
+auto DeclarationModule::getInput(size_t i) const -> Input {
+    return {*getString(inputRecords[i].path), inputRecords[i].contentHash};
+}
+
+// This is the implementation of DeclarationModule::getDeclarationCount.
+auto DeclarationModule::getDeclarationCount() const -> size_t {
+    return header->declarationCount;
+}
+
+// This is the implementation of DeclarationModule::getMaterializedCount.
+auto DeclarationModule::getMaterializedCount() -> size_t {
+    std::lock_guard<std::mutex> lock{mutex};
+    return materializedCount;
+}
+} // namespace ntsc
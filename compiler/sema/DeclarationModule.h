@@ -0,0 +1,162 @@
+#ifndef NTSC_DECLARATIONMODULE_H
+#define NTSC_DECLARATIONMODULE_H
+#include "IdentifierTable.h"
+#include "Type.h"
+#include "TypeContext.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/ErrorOr.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <vector>
+
+/*
+    This file defines the interface of declaration modules, which hold the
+    checked declarations of declaration files such as lib.d.ts, so that they
+    are not checked again by every compilation. A module holds the names it
+    uses, the types of its declarations, which were already interned by a
+    TypeContext and are written once each, and an index of its declarations
+    by name.
+
+    A module is mapped rather than read, and nothing in it is decoded until
+    a declaration is looked up. Only the types that the declaration refers
+    to are then created, in the TypeContext of the compilation, so the cost
+    of a module depends on how much of it is used rather than on its size.
+*/
+
+namespace ntsc {
+// This class writes the declarations of a module to a file.
+class DeclarationModuleWriter {
+    const IdentifierTable &identifiers;
+
+    // These are the strings of the module, which are the names of the
+    // declarations, types and properties and the paths of the inputs.
+    llvm::DenseMap<uint32_t, uint32_t> stringIndices;
+    std::vector<std::string> strings;
+
+    // These are the records of the types, by their index in the module.
+    llvm::DenseMap<const Type *, uint32_t> typeRefs;
+    std::vector<std::vector<uint32_t>> typeRecords;
+
+    // These are the declarations and the inputs, as indices of their names
+    // and types.
+    std::vector<std::pair<uint32_t, uint32_t>> declarations;
+    std::vector<std::pair<uint32_t, uint64_t>> inputs;
+
+    // These methods will return the index of a string in the module, adding
+    // it the first time.
+    auto getStringIndex(Symbol name) -> uint32_t;
+    auto addString(llvm::StringRef string) -> uint32_t;
+
+    // This method will return the reference to a type in the module, adding
+    // the type and every type it refers to the first time.
+    auto getTypeRef(const Type *type) -> uint32_t;
+
+  public:
+    // The Symbols of the declarations, and of the types they refer to, must
+    // belong to the given table.
+    explicit DeclarationModuleWriter(const IdentifierTable &identifiers)
+        : identifiers{identifiers} {}
+    DeclarationModuleWriter(const DeclarationModuleWriter &) = delete;
+    auto operator=(const DeclarationModuleWriter &)
+        -> DeclarationModuleWriter & = delete;
+
+    // This method will record a file that the declarations were checked
+    // from, along with the hash of its contents, so that a module can be
+    // rejected once one of its inputs has changed.
+    auto addInput(llvm::StringRef path, uint64_t contentHash) -> void;
+
+    // This method will add a declaration with its checked type. The target
+    // of every NamedType that the type refers to must already be set. A name
+    // may only be declared once.
+    auto addDeclaration(Symbol name, const Type *type) -> void;
+
+    // This method will write the module to the given path. The module is
+    // written to a temporary file and renamed into place, so a compilation
+    // that maps it at the same time never sees part of it.
+    auto write(llvm::StringRef path) -> std::error_code;
+};
+
+// This class reads a module that a DeclarationModuleWriter wrote.
+class DeclarationModule {
+    // The writer produces the records of the format.
+    friend class DeclarationModuleWriter;
+
+    std::unique_ptr<llvm::MemoryBuffer> buffer;
+    IdentifierTable &identifiers;
+    TypeContext &types;
+
+    // These are the sections of the mapped module. The records are defined
+    // with the format.
+    struct Header;
+    struct Range;
+    struct InputRecord;
+    struct Bucket;
+    const Header *header = nullptr;
+    const InputRecord *inputRecords = nullptr;
+    const Range *stringRanges = nullptr;
+    const char *stringBytes = nullptr;
+    const uint32_t *typeOffsets = nullptr;
+    const uint32_t *typeWords = nullptr;
+    const Bucket *buckets = nullptr;
+
+    // These are the types that have been created so far, by their index in
+    // the module, and whether each one is being created, which a valid
+    // module never refers to. Lookups may run on many threads, so they are
+    // serialized.
+    std::mutex mutex;
+    std::vector<const Type *> materializedTypes;
+    std::vector<bool> inProgress;
+    size_t materializedCount = 0;
+
+    DeclarationModule(std::unique_ptr<llvm::MemoryBuffer> buffer,
+                      IdentifierTable &identifiers, TypeContext &types);
+
+    // This method will return a string of the module, or null if the index
+    // is out of bounds.
+    [[nodiscard]] auto getString(uint32_t index) const
+        -> llvm::Optional<llvm::StringRef>;
+
+    // This method will create the type with the given reference, along with
+    // every type it refers to. It will return null if the module is corrupt.
+    auto materialize(uint32_t ref) -> const Type *;
+
+  public:
+    DeclarationModule(const DeclarationModule &) = delete;
+    auto operator=(const DeclarationModule &) -> DeclarationModule & = delete;
+
+    // This function will map the module at the given path. Its types are
+    // created in the given context and their names are interned in the given
+    // table, which must both outlive the module.
+    static auto load(llvm::StringRef path, IdentifierTable &identifiers,
+                     TypeContext &types)
+        -> llvm::ErrorOr<std::unique_ptr<DeclarationModule>>;
+
+    // This method will return the type of the declaration with the given
+    // name, or null if the module does not declare it.
+    auto lookup(llvm::StringRef name) -> const Type *;
+
+    // This struct is a file that the declarations were checked from.
+    struct Input {
+        llvm::StringRef path;
+        uint64_t contentHash;
+    };
+
+    // These methods will return the inputs of the module.
+    [[nodiscard]] auto getInputCount() const -> size_t;
+    [[nodiscard]] auto getInput(size_t i) const -> Input;
+
+    // These methods will return the number of declarations in the module,
+    // and the number of its types that have been created so far.
+    [[nodiscard]] auto getDeclarationCount() const -> size_t;
+    [[nodiscard]] auto getMaterializedCount() -> size_t;
+};
+} // namespace ntsc
+
+#endif
@@ -0,0 +1,34 @@
+#include "Type.h"
+#include <algorithm>
+
+/*
+    This file contains the implementation of the methods of the types.
+*/
+
+namespace ntsc {
+// This is the implementation of getTypeKindName.
+auto getTypeKindName(TypeKind kind) -> const char * {
+    switch (kind) {
+#define PRIMITIVE_TYPE(name, spelling)                                         \
+    case TypeKind::name:                                                       \
+        return spelling;
+#define TYPE(name)                                                             \
+    case TypeKind::name:                                                       \
+        return #name;
+#include "TypeKinds.def"
+    }
+    return "unknown type kind";
+}
+
+// This is the implementation of ObjectType::getProperty.
+auto ObjectType::getProperty(Symbol name) const -> const Property * {
+    auto *found = std::lower_bound(
+        properties.begin(), properties.end(), name.getValue(),
+        [](const Property &property, uint32_t value) {
+            return property.name.getValue() < value;
+        });
+    if (found == properties.end() || found->name != name)
+        return nullptr;
+    return found;
+}
+} // namespace ntsc
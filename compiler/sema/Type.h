@@ -0,0 +1,222 @@
+#ifndef NTSC_TYPE_H
+#define NTSC_TYPE_H
+#include "IdentifierTable.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/FoldingSet.h"
+#include <cstdint>
+
+/*
+    This file defines the types of the type checker. Every type is owned by a
+    TypeContext, which interns them, so two structurally equal types are the
+    same object and are compared by pointer. Types are immutable once they
+    are created, except for the target of a NamedType, which is set once when
+    its declaration has been checked. A recursive type, such as a class with
+    a field of its own type, can only be built through a NamedType.
+*/
+
+namespace ntsc {
+// This enum holds the kind of every type in TypeKinds.def.
+enum class TypeKind : uint8_t {
+#define TYPE(name) name,
+#include "TypeKinds.def"
+};
+
+// This function will return the spelling of a primitive type, or the name of
+// any other kind for debugging purposes.
+auto getTypeKindName(TypeKind kind) -> const char *;
+
+class Type : public llvm::FoldingSetNode {
+    TypeKind kind;
+
+  protected:
+    explicit Type(TypeKind kind) : kind{kind} {}
+
+  public:
+    Type(const Type &) = delete;
+    auto operator=(const Type &) -> Type & = delete;
+
+    [[nodiscard]] inline auto getKind() const -> TypeKind { return kind; }
+};
+
+// This is the class of the primitive types, such as number and string.
+class PrimitiveType : public Type {
+  public:
+    explicit PrimitiveType(TypeKind kind) : Type{kind} {}
+
+    static inline auto classof(const Type *type) -> bool {
+        return type->getKind() <= TypeKind::String;
+    }
+};
+
+// The Profile methods of the interned types add the fields that identify the
+// type to a FoldingSetNodeID. The static versions let a TypeContext look up a
+// type before creating it.
+class ArrayType : public Type {
+    const Type *elementType;
+
+  public:
+    explicit ArrayType(const Type *elementType)
+        : Type{TypeKind::Array}, elementType{elementType} {}
+
+    [[nodiscard]] inline auto getElementType() const -> const Type * {
+        return elementType;
+    }
+
+    static inline auto Profile(llvm::FoldingSetNodeID &id,
+                               const Type *elementType) -> void {
+        id.AddPointer(elementType);
+    }
+    inline auto Profile(llvm::FoldingSetNodeID &id) const -> void {
+        Profile(id, elementType);
+    }
+
+    static inline auto classof(const Type *type) -> bool {
+        return type->getKind() == TypeKind::Array;
+    }
+};
+
+// The members of a union are never unions themselves, and are sorted by
+// address, so that the same set of members always makes the same union.
+class UnionType : public Type {
+    llvm::ArrayRef<const Type *> members;
+
+  public:
+    explicit UnionType(llvm::ArrayRef<const Type *> members)
+        : Type{TypeKind::Union}, members{members} {}
+
+    [[nodiscard]] inline auto getMembers() const
+        -> llvm::ArrayRef<const Type *> {
+        return members;
+    }
+
+    static inline auto Profile(llvm::FoldingSetNodeID &id,
+                               llvm::ArrayRef<const Type *> members) -> void {
+        id.AddInteger(members.size());
+        for (auto *member : members)
+            id.AddPointer(member);
+    }
+    inline auto Profile(llvm::FoldingSetNodeID &id) const -> void {
+        Profile(id, members);
+    }
+
+    static inline auto classof(const Type *type) -> bool {
+        return type->getKind() == TypeKind::Union;
+    }
+};
+
+// The parameters after the required count are optional, and the last one is
+// an array of the remaining arguments when the function has a rest
+// parameter.
+class FunctionType : public Type {
+    llvm::ArrayRef<const Type *> parameters;
+    const Type *returnType;
+    uint32_t requiredCount;
+    bool rest;
+
+  public:
+    FunctionType(llvm::ArrayRef<const Type *> parameters,
+                 uint32_t requiredCount, bool rest, const Type *returnType)
+        : Type{TypeKind::Function}, parameters{parameters},
+          returnType{returnType}, requiredCount{requiredCount}, rest{rest} {}
+
+    [[nodiscard]] inline auto getParameters() const
+        -> llvm::ArrayRef<const Type *> {
+        return parameters;
+    }
+    [[nodiscard]] inline auto getRequiredCount() const -> uint32_t {
+        return requiredCount;
+    }
+    [[nodiscard]] inline auto hasRest() const -> bool { return rest; }
+    [[nodiscard]] inline auto getReturnType() const -> const Type * {
+        return returnType;
+    }
+
+    static inline auto Profile(llvm::FoldingSetNodeID &id,
+                               llvm::ArrayRef<const Type *> parameters,
+                               uint32_t requiredCount, bool rest,
+                               const Type *returnType) -> void {
+        id.AddInteger(parameters.size());
+        for (auto *parameter : parameters)
+            id.AddPointer(parameter);
+        id.AddInteger(requiredCount);
+        id.AddBoolean(rest);
+        id.AddPointer(returnType);
+    }
+    inline auto Profile(llvm::FoldingSetNodeID &id) const -> void {
+        Profile(id, parameters, requiredCount, rest, returnType);
+    }
+
+    static inline auto classof(const Type *type) -> bool {
+        return type->getKind() == TypeKind::Function;
+    }
+};
+
+// This struct is a property of an object type.
+struct Property {
+    Symbol name;
+    const Type *type;
+    bool optional;
+};
+
+// The properties of an object type are sorted by the value of their names,
+// so a property is found by a binary search.
+class ObjectType : public Type {
+    llvm::ArrayRef<Property> properties;
+
+  public:
+    explicit ObjectType(llvm::ArrayRef<Property> properties)
+        : Type{TypeKind::Object}, properties{properties} {}
+
+    [[nodiscard]] inline auto getProperties() const
+        -> llvm::ArrayRef<Property> {
+        return properties;
+    }
+
+    // This method will return the property with the given name, or null if
+    // there is none.
+    [[nodiscard]] auto getProperty(Symbol name) const -> const Property *;
+
+    static inline auto Profile(llvm::FoldingSetNodeID &id,
+                               llvm::ArrayRef<Property> properties) -> void {
+        id.AddInteger(properties.size());
+        for (auto &property : properties) {
+            id.AddInteger(property.name.getValue());
+            id.AddPointer(property.type);
+            id.AddBoolean(property.optional);
+        }
+    }
+    inline auto Profile(llvm::FoldingSetNodeID &id) const -> void {
+        Profile(id, properties);
+    }
+
+    static inline auto classof(const Type *type) -> bool {
+        return type->getKind() == TypeKind::Object;
+    }
+};
+
+// This is the type of a class or type alias. It is not interned, since two
+// declarations are distinct even when their bodies are equal, and it refers
+// to its structure through a target that is set once the declaration has
+// been checked. The DeclarationGraph only starts the units that depend on a
+// declaration after it is done, so the target is never read before it is
+// set.
+class NamedType : public Type {
+    Symbol name;
+    const Type *target = nullptr;
+
+  public:
+    explicit NamedType(Symbol name) : Type{TypeKind::Named}, name{name} {}
+
+    [[nodiscard]] inline auto getName() const -> Symbol { return name; }
+    [[nodiscard]] inline auto getTarget() const -> const Type * {
+        return target;
+    }
+    inline auto setTarget(const Type *type) -> void { target = type; }
+
+    static inline auto classof(const Type *type) -> bool {
+        return type->getKind() == TypeKind::Named;
+    }
+};
+} // namespace ntsc
+
+#endif
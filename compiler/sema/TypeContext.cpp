@@ -0,0 +1,162 @@
+#include "TypeContext.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Casting.h"
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <new>
+
+/*
+    This file contains the implementation of the TypeContext. A type is
+    profiled once to find its shard, and the lock of the shard is held while
+    it is looked up and created, so two threads that infer the same type at
+    once still get a single instance.
+*/
+
+namespace ntsc {
+namespace {
+// This function will copy a list of the fields of a type into the allocator
+// of its shard.
+template <typename T>
+auto copyArray(llvm::BumpPtrAllocator &allocator, llvm::ArrayRef<T> values)
+    -> llvm::ArrayRef<T> {
+    if (values.empty())
+        return {};
+    auto *copy = allocator.Allocate<T>(values.size());
+    std::uninitialized_copy(values.begin(), values.end(), copy);
+    return {copy, values.size()};
+}
+} // namespace
+
+// This is the implementation of TypeContext::getOrCreate.
+template <typename T, typename Create>
+auto TypeContext::getOrCreate(llvm::FoldingSet<T> Shard::*set,
+                              const llvm::FoldingSetNodeID &id, Create create)
+    -> const T * {
+    auto &shard = getShard(id);
+    std::lock_guard<std::mutex> lock{shard.mutex};
+
+    void *insertPosition = nullptr;
+    if (auto *existing = (shard.*set).FindNodeOrInsertPos(id, insertPosition))
+        return existing;
+
+    T *type = create(shard.allocator);
+    (shard.*set).InsertNode(type, insertPosition);
+    return type;
+}
+
+// This is the implementation of TypeContext::getArrayType.
+auto TypeContext::getArrayType(const Type *elementType) -> const Type * {
+    llvm::FoldingSetNodeID id;
+    ArrayType::Profile(id, elementType);
+    return getOrCreate(&Shard::arrayTypes, id,
+                       [&](llvm::BumpPtrAllocator &allocator) {
+                           return new (allocator.Allocate<ArrayType>())
+                               ArrayType{elementType};
+                       });
+}
+
+// This is the implementation of TypeContext::getUnionType.
+auto TypeContext::getUnionType(llvm::ArrayRef<const Type *> types)
+    -> const Type * {
+    llvm::SmallVector<const Type *, 8> members;
+    for (auto *type : types) {
+        switch (type->getKind()) {
+        case TypeKind::Any:
+        case TypeKind::Unknown:
+            // Any wins over unknown when both are present.
+            if (llvm::is_contained(types, getAnyType()))
+                return getAnyType();
+            return type;
+        case TypeKind::Never:
+            break;
+        case TypeKind::Union: {
+            auto nested = llvm::cast<UnionType>(type)->getMembers();
+            members.append(nested.begin(), nested.end());
+            break;
+        }
+        default:
+            members.push_back(type);
+            break;
+        }
+    }
+
+    std::sort(members.begin(), members.end());
+    members.erase(std::unique(members.begin(), members.end()), members.end());
+    if (members.empty())
+        return getNeverType();
+    if (members.size() == 1)
+        return members.front();
+
+    llvm::FoldingSetNodeID id;
+    UnionType::Profile(id, members);
+    return getOrCreate(&Shard::unionTypes, id,
+                       [&](llvm::BumpPtrAllocator &allocator) {
+                           auto copy = copyArray<const Type *>(allocator,
+                                                               members);
+                           return new (allocator.Allocate<UnionType>())
+                               UnionType{copy};
+                       });
+}
+
+// This is the implementation of TypeContext::getFunctionType.
+auto TypeContext::getFunctionType(llvm::ArrayRef<const Type *> parameters,
+                                  uint32_t requiredCount, bool rest,
+                                  const Type *returnType) -> const Type * {
+    llvm::FoldingSetNodeID id;
+    FunctionType::Profile(id, parameters, requiredCount, rest, returnType);
+    return getOrCreate(
+        &Shard::functionTypes, id, [&](llvm::BumpPtrAllocator &allocator) {
+            auto copy = copyArray(allocator, parameters);
+            return new (allocator.Allocate<FunctionType>())
+                FunctionType{copy, requiredCount, rest, returnType};
+        });
+}
+
+// This is the implementation of TypeContext::getObjectType.
+auto TypeContext::getObjectType(llvm::ArrayRef<Property> properties)
+    -> const Type * {
+    llvm::SmallVector<Property, 8> sorted{properties.begin(),
+                                          properties.end()};
+    std::sort(sorted.begin(), sorted.end(),
+              [](const Property &left, const Property &right) {
+                  return left.name.getValue() < right.name.getValue();
+              });
+    assert(std::adjacent_find(sorted.begin(), sorted.end(),
+                              [](const Property &left, const Property &right) {
+                                  return left.name == right.name;
+                              }) == sorted.end() &&
+           "the properties of an object type must have distinct names");
+
+    llvm::FoldingSetNodeID id;
+    ObjectType::Profile(id, sorted);
+    return getOrCreate(&Shard::objectTypes, id,
+                       [&](llvm::BumpPtrAllocator &allocator) {
+                           auto copy = copyArray<Property>(allocator, sorted);
+                           return new (allocator.Allocate<ObjectType>())
+                               ObjectType{copy};
+                       });
+}
+
+// This is the implementation of TypeContext::createNamedType. Named types are
+// spread over the shards by their name, only to share the allocators.
+auto TypeContext::createNamedType(Symbol name) -> NamedType * {
+    auto &shard = shards[name.getValue() & (shardCount - 1)];
+    std::lock_guard<std::mutex> lock{shard.mutex};
+    ++shard.namedTypeCount;
+    return new (shard.allocator.Allocate<NamedType>()) NamedType{name};
+}
+
+// This is the implementation of TypeContext::size.
+auto TypeContext::size() const -> size_t {
+    size_t total = 0;
+    for (auto &shard : shards) {
+        std::lock_guard<std::mutex> lock{shard.mutex};
+        total += shard.arrayTypes.size() + shard.unionTypes.size() +
+                 shard.functionTypes.size() + shard.objectTypes.size() +
+                 shard.namedTypeCount;
+    }
+    return total;
+}
+} // namespace ntsc
@@ -0,0 +1,97 @@
+#ifndef NTSC_TYPECONTEXT_H
+#define NTSC_TYPECONTEXT_H
+#include "Type.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/FoldingSet.h"
+#include "llvm/Support/Allocator.h"
+#include <array>
+#include <cstdint>
+#include <mutex>
+
+/*
+    This file defines the TypeContext interface, which creates and owns every
+    type of a program. A type is looked up by its structure before it is
+    created, so each distinct type exists once no matter how many times it is
+    inferred, and the units of the type checker share their types even when
+    they run on different threads.
+*/
+
+namespace ntsc {
+class TypeContext {
+    // The types are split into shards by the hash of their structure, in the
+    // same way as the IdentifierTable, and each shard allocates its own
+    // types.
+    static constexpr unsigned shardBits = 4;
+    static constexpr unsigned shardCount = 1u << shardBits;
+
+    struct Shard {
+        mutable std::mutex mutex;
+        llvm::BumpPtrAllocator allocator;
+        llvm::FoldingSet<ArrayType> arrayTypes;
+        llvm::FoldingSet<UnionType> unionTypes;
+        llvm::FoldingSet<FunctionType> functionTypes;
+        llvm::FoldingSet<ObjectType> objectTypes;
+        size_t namedTypeCount = 0;
+    };
+    std::array<Shard, shardCount> shards;
+
+    // These are the single instances of the primitive types.
+    std::array<PrimitiveType, static_cast<size_t>(TypeKind::String) + 1>
+        primitiveTypes{{
+#define PRIMITIVE_TYPE(name, spelling) PrimitiveType{TypeKind::name},
+#include "TypeKinds.def"
+        }};
+
+    [[nodiscard]] inline auto getShard(const llvm::FoldingSetNodeID &id)
+        -> Shard & {
+        return shards[id.ComputeHash() >> (32 - shardBits)];
+    }
+
+    // This method will return the type with the given structure from a set,
+    // calling create to allocate it in the shard the first time it is seen.
+    template <typename T, typename Create>
+    auto getOrCreate(llvm::FoldingSet<T> Shard::*set,
+                     const llvm::FoldingSetNodeID &id, Create create)
+        -> const T *;
+
+  public:
+    TypeContext() = default;
+    TypeContext(const TypeContext &) = delete;
+    auto operator=(const TypeContext &) -> TypeContext & = delete;
+
+    // These methods will return the primitive types.
+#define PRIMITIVE_TYPE(name, spelling)                                         \
+    [[nodiscard]] inline auto get##name##Type() const -> const Type * {        \
+        return &primitiveTypes[static_cast<size_t>(TypeKind::name)];           \
+    }
+#include "TypeKinds.def"
+
+    // This method will return the type of an array of the given elements.
+    auto getArrayType(const Type *elementType) -> const Type *;
+
+    // This method will return the union of the given types. Nested unions are
+    // flattened and duplicates are removed. The union of no types is never,
+    // the union of a single type is that type, and a union that includes any
+    // or unknown is that type.
+    auto getUnionType(llvm::ArrayRef<const Type *> types) -> const Type *;
+
+    // This method will return the type of a function.
+    auto getFunctionType(llvm::ArrayRef<const Type *> parameters,
+                         uint32_t requiredCount, bool rest,
+                         const Type *returnType) -> const Type *;
+
+    // This method will return the type of an object with the given
+    // properties, which may be in any order but must have distinct names.
+    auto getObjectType(llvm::ArrayRef<Property> properties) -> const Type *;
+
+    // This method will create the type of a class or type alias. Its target
+    // must be set before any other unit reads it.
+    auto createNamedType(Symbol name) -> NamedType *;
+
+    // This method will return the number of types that have been created,
+    // apart from the primitive types.
+    [[nodiscard]] auto size() const -> size_t;
+};
+} // namespace ntsc
+
+#endif
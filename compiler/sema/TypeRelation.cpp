@@ -0,0 +1,192 @@
+#include "TypeRelation.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/Casting.h"
+#include <algorithm>
+
+/*
+    This file contains the implementation of the TypeRelation.
+*/
+
+namespace ntsc {
+// This is the implementation of TypeRelation::isAssignable.
+auto TypeRelation::isAssignable(const Type *source, const Type *target)
+    -> bool {
+    if (auto result = compareTrivially(source, target))
+        return *result;
+    if (auto result = cache.lookup(source, target))
+        return *result;
+
+    // Only a NamedType can lead a comparison back to itself, so the stack
+    // is only searched for pairs that include one.
+    auto depth = static_cast<uint32_t>(stack.size());
+    if (llvm::isa<NamedType>(source) || llvm::isa<NamedType>(target)) {
+        for (auto i = depth; i-- > 0;) {
+            if (stack[i].source == source && stack[i].target == target) {
+                stack.back().lowestAssumption =
+                    std::min(stack.back().lowestAssumption, i);
+                return true;
+            }
+        }
+    }
+
+    stack.push_back(
+        {source, target, depth, static_cast<uint32_t>(pending.size())});
+    auto result = compareStructurally(source, target);
+    auto frame = stack.pop_back_val();
+
+    // A failure never depends on an assumption, since assuming that a pair
+    // holds can only make more comparisons hold. The results that waited on
+    // this comparison are dropped, as they may have assumed it.
+    if (!result) {
+        pending.resize(frame.pendingStart);
+        cache.insert(source, target, false);
+    } else if (frame.lowestAssumption >= depth) {
+        for (auto i = frame.pendingStart; i < pending.size(); ++i)
+            cache.insert(pending[i].first, pending[i].second, true);
+        pending.resize(frame.pendingStart);
+        cache.insert(source, target, true);
+    } else {
+        pending.emplace_back(source, target);
+    }
+
+    if (!stack.empty())
+        stack.back().lowestAssumption =
+            std::min(stack.back().lowestAssumption, frame.lowestAssumption);
+    return result;
+}
+
+// This is the implementation of TypeRelation::compareTrivially.
+auto TypeRelation::compareTrivially(const Type *source,
+                                    const Type *target) const
+    -> llvm::Optional<bool> {
+    if (source == target)
+        return true;
+
+    switch (target->getKind()) {
+    case TypeKind::Any:
+    case TypeKind::Unknown:
+        return true;
+    case TypeKind::Void:
+        if (source->getKind() == TypeKind::Undefined)
+            return true;
+        break;
+    default:
+        break;
+    }
+
+    switch (source->getKind()) {
+    case TypeKind::Any:
+        return target->getKind() != TypeKind::Never;
+    case TypeKind::Never:
+        return true;
+    case TypeKind::Undefined:
+    case TypeKind::Null:
+        // Without strict null checks, null and undefined belong to every
+        // type.
+        if (!cache.isStrict())
+            return true;
+        break;
+    default:
+        break;
+    }
+
+    // The interned types that differ only by address are never equal.
+    if (llvm::isa<PrimitiveType>(source) && llvm::isa<PrimitiveType>(target))
+        return false;
+    return llvm::None;
+}
+
+// This is the implementation of TypeRelation::compareStructurally. A named
+// type whose declaration failed to check has no target, and is treated as any
+// so that the error is only reported once.
+auto TypeRelation::compareStructurally(const Type *source, const Type *target)
+    -> bool {
+    if (auto *named = llvm::dyn_cast<NamedType>(source))
+        return !named->getTarget() || isAssignable(named->getTarget(), target);
+    if (auto *named = llvm::dyn_cast<NamedType>(target))
+        return !named->getTarget() || isAssignable(source, named->getTarget());
+
+    if (auto *sourceUnion = llvm::dyn_cast<UnionType>(source)) {
+        return llvm::all_of(sourceUnion->getMembers(), [&](const Type *member) {
+            return isAssignable(member, target);
+        });
+    }
+    if (auto *targetUnion = llvm::dyn_cast<UnionType>(target)) {
+        return llvm::any_of(targetUnion->getMembers(), [&](const Type *member) {
+            return isAssignable(source, member);
+        });
+    }
+
+    switch (target->getKind()) {
+    case TypeKind::Array:
+        if (auto *array = llvm::dyn_cast<ArrayType>(source))
+            return isAssignable(
+                array->getElementType(),
+                llvm::cast<ArrayType>(target)->getElementType());
+        return false;
+    case TypeKind::Function:
+        if (auto *function = llvm::dyn_cast<FunctionType>(source))
+            return compareFunctions(function, llvm::cast<FunctionType>(target));
+        return false;
+    case TypeKind::Object: {
+        // Every value apart from null and undefined has the type {}.
+        auto *object = llvm::cast<ObjectType>(target);
+        if (object->getProperties().empty())
+            return source->getKind() != TypeKind::Undefined &&
+                   source->getKind() != TypeKind::Null;
+        if (auto *sourceObject = llvm::dyn_cast<ObjectType>(source))
+            return compareObjects(sourceObject, object);
+        return false;
+    }
+    default:
+        return false;
+    }
+}
+
+// This is the implementation of TypeRelation::compareFunctions. A function
+// may take fewer parameters than the target, but not require more. In strict
+// mode the parameters are compared in the opposite direction to the function,
+// and otherwise either direction is enough.
+auto TypeRelation::compareFunctions(const FunctionType *source,
+                                    const FunctionType *target) -> bool {
+    auto targetParameters = target->getParameters();
+    if (!target->hasRest() &&
+        source->getRequiredCount() > targetParameters.size())
+        return false;
+
+    auto sourceParameters = source->getParameters();
+    auto count = std::min(sourceParameters.size(), targetParameters.size());
+    for (size_t i = 0; i < count; ++i) {
+        if (isAssignable(targetParameters[i], sourceParameters[i]))
+            continue;
+        if (cache.isStrict() ||
+            !isAssignable(sourceParameters[i], targetParameters[i]))
+            return false;
+    }
+
+    // A function that returns a value may be used where the result is
+    // ignored.
+    if (target->getReturnType()->getKind() == TypeKind::Void)
+        return true;
+    return isAssignable(source->getReturnType(), target->getReturnType());
+}
+
+// This is the implementation of TypeRelation::compareObjects. The source may
+// have properties that the target does not.
+auto TypeRelation::compareObjects(const ObjectType *source,
+                                  const ObjectType *target) -> bool {
+    for (auto &property : target->getProperties()) {
+        auto *found = source->getProperty(property.name);
+        if (!found) {
+            if (property.optional)
+                continue;
+            return false;
+        }
+        if (found->optional && !property.optional)
+            return false;
+        if (!isAssignable(found->type, property.type))
+            return false;
+    }
+    return true;
+}
+} // namespace ntsc
@@ -0,0 +1,94 @@
+#ifndef NTSC_TYPERELATION_H
+#define NTSC_TYPERELATION_H
+#include "ShardedMap.h"
+#include "Type.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/SmallVector.h"
+#include <cstdint>
+#include <utility>
+
+/*
+    This file defines the TypeRelation interface, which checks whether a value
+    of one type may be assigned to another. Types are structural, so a check
+    may walk the whole of two large types, but since types are interned a
+    pair of types is a pair of pointers, and every result is kept in an
+    AssignabilityCache that is shared by the units of the type checker. Once
+    any unit has compared two types, every other comparison of them is a
+    single lookup.
+*/
+
+namespace ntsc {
+class AssignabilityCache {
+    ShardedMap<std::pair<const Type *, const Type *>, bool> results;
+    bool strict;
+
+  public:
+    // The checker creates its cache with UserOpts::strictModeEnabled, since
+    // strict mode changes the results.
+    explicit AssignabilityCache(bool strict) : strict{strict} {}
+
+    [[nodiscard]] inline auto isStrict() const -> bool { return strict; }
+
+    // These methods will look up and record the result of a comparison.
+    [[nodiscard]] inline auto lookup(const Type *source,
+                                     const Type *target) const
+        -> llvm::Optional<bool> {
+        return results.lookup({source, target});
+    }
+    inline auto insert(const Type *source, const Type *target, bool result)
+        -> void {
+        results.insert({source, target}, result);
+    }
+
+    // This method will return the number of results in the cache.
+    [[nodiscard]] inline auto size() const -> size_t {
+        return results.size();
+    }
+};
+
+// A TypeRelation holds the comparisons in progress on a single thread, so
+// each job of the type checker uses its own, along with the shared cache.
+class TypeRelation {
+    AssignabilityCache &cache;
+
+    // This struct is a comparison in progress. A recursive type can lead a
+    // comparison back to itself, in which case it is assumed to hold. The
+    // result of a comparison that relied on the assumption of an outer one
+    // is only known to be right once the outer one holds, so it waits in the
+    // pending results until then.
+    struct Frame {
+        const Type *source;
+        const Type *target;
+        uint32_t lowestAssumption;
+        uint32_t pendingStart;
+    };
+    llvm::SmallVector<Frame, 16> stack;
+    llvm::SmallVector<std::pair<const Type *, const Type *>, 16> pending;
+
+    // This method will return the result of a comparison that does not need
+    // to look at the structure of the types, if there is one.
+    [[nodiscard]] auto compareTrivially(const Type *source,
+                                        const Type *target) const
+        -> llvm::Optional<bool>;
+
+    // This method will compare the structure of two types.
+    auto compareStructurally(const Type *source, const Type *target) -> bool;
+
+    // These methods will compare the types of the same kind.
+    auto compareFunctions(const FunctionType *source,
+                          const FunctionType *target) -> bool;
+    auto compareObjects(const ObjectType *source, const ObjectType *target)
+        -> bool;
+
+  public:
+    explicit TypeRelation(AssignabilityCache &cache) : cache{cache} {}
+    TypeRelation(const TypeRelation &) = delete;
+    auto operator=(const TypeRelation &) -> TypeRelation & = delete;
+
+    // This method will return whether a value of the source type may be
+    // assigned to the target type.
+    auto isAssignable(const Type *source, const Type *target) -> bool;
+};
+} // namespace ntsc
+
+#endif
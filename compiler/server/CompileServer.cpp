@@ -0,0 +1,286 @@
+#include "CompileServer.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/Endian.h"
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#if defined(LLVM_ON_UNIX)
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// A peer that closes its end early must not kill the process with SIGPIPE.
+// Systems without this flag have no other way to ask for it per call.
+#if !defined(MSG_NOSIGNAL)
+#define MSG_NOSIGNAL 0
+#endif
+#endif
+
+/*
+    This file implements the compile server. Every message is a sequence of
+    little endian 32 bit integers and strings, where each string is preceded
+    by its length. A request is the magic number, the working directory, the
+    number of arguments and the arguments, and a response is the exit code,
+    the standard output and the standard error of the compilation. Each
+    connection carries a single request.
+*/
+
+namespace ntsc {
+#if defined(LLVM_ON_UNIX)
+// This is the first word of every request. It must be changed whenever the
+// format of the messages changes, so that an old client is refused instead of
+// misread.
+static constexpr uint32_t requestMagic = 0x4e545331; // "NTS1"
+
+// Requests longer than this are refused rather than buffered, since a client
+// that sends one is not ntsc.
+static constexpr uint32_t maxRequestString = 1u << 20;
+static constexpr uint32_t maxRequestArguments = 1u << 16;
+static constexpr time_t requestTimeoutSeconds = 10;
+
+// This function will append an integer to a message.
+static auto appendInteger(std::string &message, uint32_t value) -> void {
+    char bytes[sizeof(value)];
+    llvm::support::endian::write32le(bytes, value);
+    message.append(bytes, sizeof(bytes));
+}
+
+// This function will append a string to a message.
+static auto appendString(std::string &message, llvm::StringRef value) -> void {
+    appendInteger(message, static_cast<uint32_t>(value.size()));
+    message.append(value.data(), value.size());
+}
+
+// This function will fill in the address of the socket at the given path.
+static auto getAddress(llvm::StringRef socketPath, sockaddr_un &address)
+    -> std::error_code {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path))
+        return std::make_error_code(std::errc::filename_too_long);
+    std::memcpy(address.sun_path, socketPath.data(), socketPath.size());
+    return {};
+}
+
+// This function will write the whole message to the socket.
+static auto writeAll(int fd, llvm::StringRef message) -> std::error_code {
+    while (!message.empty()) {
+        auto written = send(fd, message.data(), message.size(), MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return {errno, std::generic_category()};
+        }
+        message = message.drop_front(static_cast<size_t>(written));
+    }
+    return {};
+}
+
+// This function will read exactly the given number of bytes from the socket.
+static auto readAll(int fd, char *data, size_t size) -> std::error_code {
+    while (size != 0) {
+        auto count = read(fd, data, size);
+        if (count < 0) {
+            if (errno == EINTR)
+                continue;
+            return {errno, std::generic_category()};
+        }
+        if (count == 0)
+            return std::make_error_code(std::errc::connection_aborted);
+        data += count;
+        size -= static_cast<size_t>(count);
+    }
+    return {};
+}
+
+// This function will read an integer from the socket.
+static auto readInteger(int fd, uint32_t &value) -> std::error_code {
+    char bytes[sizeof(value)];
+    if (auto ec = readAll(fd, bytes, sizeof(bytes)))
+        return ec;
+    value = llvm::support::endian::read32le(bytes);
+    return {};
+}
+
+// This function will read a string from the socket that is at most the given
+// number of bytes long.
+static auto readString(int fd, std::string &value, uint32_t maxSize)
+    -> std::error_code {
+    uint32_t size;
+    if (auto ec = readInteger(fd, size))
+        return ec;
+    if (size > maxSize)
+        return std::make_error_code(std::errc::message_size);
+    value.resize(size);
+    return readAll(fd, value.data(), size);
+}
+
+// This function will read a request from the socket.
+static auto readRequest(int fd, CompileRequest &request) -> std::error_code {
+    uint32_t magic, argumentCount;
+    if (auto ec = readInteger(fd, magic))
+        return ec;
+    if (magic != requestMagic)
+        return std::make_error_code(std::errc::protocol_error);
+    if (auto ec = readString(fd, request.workingDirectory, maxRequestString))
+        return ec;
+    if (auto ec = readInteger(fd, argumentCount))
+        return ec;
+    if (argumentCount == 0 || argumentCount > maxRequestArguments)
+        return std::make_error_code(std::errc::protocol_error);
+    request.arguments.resize(argumentCount);
+    for (auto &argument : request.arguments)
+        if (auto ec = readString(fd, argument, maxRequestString))
+            return ec;
+    return {};
+}
+
+// This function will connect to the socket at the given path.
+static auto connectTo(const sockaddr_un &address, int &fd) -> std::error_code {
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return {errno, std::generic_category()};
+    while (connect(fd, reinterpret_cast<const sockaddr *>(&address),
+                   sizeof(address)) != 0) {
+        if (errno == EINTR)
+            continue;
+        std::error_code ec{errno, std::generic_category()};
+        close(fd);
+        return ec;
+    }
+    return {};
+}
+
+// This function will bind a listening socket to the given address. If the
+// path is taken by a socket that nothing listens on, it is removed first.
+static auto listenOn(const sockaddr_un &address, int &fd) -> std::error_code {
+    int existing;
+    if (!connectTo(address, existing)) {
+        close(existing);
+        return std::make_error_code(std::errc::address_in_use);
+    }
+    struct stat status;
+    if (lstat(address.sun_path, &status) == 0 && S_ISSOCK(status.st_mode))
+        unlink(address.sun_path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return {errno, std::generic_category()};
+
+    // The socket file is created with the permissions of the umask, so it is
+    // narrowed while binding, and no other user can ask for a compilation.
+    auto oldMask = umask(0077);
+    auto result = bind(fd, reinterpret_cast<const sockaddr *>(&address),
+                       sizeof(address));
+    umask(oldMask);
+    if (result != 0 || listen(fd, SOMAXCONN) != 0) {
+        std::error_code ec{errno, std::generic_category()};
+        close(fd);
+        return ec;
+    }
+    return {};
+}
+
+// This is the implementation of runCompileServer. The requests are run one at
+// a time, since a compilation reads the command line options, which are
+// global.
+auto runCompileServer(llvm::StringRef socketPath, CompileHandler handler)
+    -> std::error_code {
+    sockaddr_un address;
+    if (auto ec = getAddress(socketPath, address))
+        return ec;
+    int listener;
+    if (auto ec = listenOn(address, listener))
+        return ec;
+
+    while (true) {
+        auto fd = accept(listener, nullptr, nullptr);
+        if (fd < 0) {
+            // A client that gave up before it was accepted is not an error of
+            // the server.
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            std::error_code ec{errno, std::generic_category()};
+            close(listener);
+            return ec;
+        }
+
+        // A client that stops sending would keep every other client waiting,
+        // so reading the request may only take so long. A malformed request
+        // is dropped without a response.
+        timeval timeout{requestTimeoutSeconds, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        CompileRequest request;
+        if (!readRequest(fd, request)) {
+            std::string out, err;
+            llvm::raw_string_ostream outStream{out}, errStream{err};
+            auto exitCode = handler(request, outStream, errStream);
+            outStream.flush();
+            errStream.flush();
+
+            std::string response;
+            appendInteger(response, static_cast<uint32_t>(exitCode));
+            appendString(response, out);
+            appendString(response, err);
+            writeAll(fd, response);
+        }
+        close(fd);
+    }
+}
+
+// This is the implementation of sendCompileRequest.
+auto sendCompileRequest(llvm::StringRef socketPath,
+                        const CompileRequest &request, llvm::raw_ostream &out,
+                        llvm::raw_ostream &err) -> llvm::ErrorOr<int> {
+    sockaddr_un address;
+    if (auto ec = getAddress(socketPath, address))
+        return ec;
+    int fd;
+    if (auto ec = connectTo(address, fd))
+        return ec;
+
+    std::string message;
+    appendInteger(message, requestMagic);
+    appendString(message, request.workingDirectory);
+    appendInteger(message, static_cast<uint32_t>(request.arguments.size()));
+    for (auto &argument : request.arguments)
+        appendString(message, argument);
+
+    // The output of a compilation is only limited by what it prints, so the
+    // response is not bounded like a request.
+    uint32_t exitCode;
+    std::string outText, errText;
+    auto ec = writeAll(fd, message);
+    if (!ec)
+        ec = readInteger(fd, exitCode);
+    if (!ec)
+        ec = readString(fd, outText, UINT32_MAX);
+    if (!ec)
+        ec = readString(fd, errText, UINT32_MAX);
+    close(fd);
+    if (ec)
+        return ec;
+
+    out << outText;
+    err << errText;
+    return static_cast<int>(exitCode);
+}
+#else
+// This is the implementation of runCompileServer on systems without Unix
+// domain sockets.
+auto runCompileServer(llvm::StringRef, CompileHandler) -> std::error_code {
+    return std::make_error_code(std::errc::not_supported);
+}
+
+// This is the implementation of sendCompileRequest on systems without Unix
+// domain sockets.
+auto sendCompileRequest(llvm::StringRef, const CompileRequest &,
+                        llvm::raw_ostream &, llvm::raw_ostream &)
+    -> llvm::ErrorOr<int> {
+    return std::make_error_code(std::errc::not_supported);
+}
+#endif
+} // namespace ntsc
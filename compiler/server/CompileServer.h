@@ -0,0 +1,51 @@
+#ifndef NTSC_COMPILESERVER_H
+#define NTSC_COMPILESERVER_H
+#include "llvm/ADT/STLFunctionalExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/ErrorOr.h"
+#include "llvm/Support/raw_ostream.h"
+#include <string>
+#include <system_error>
+#include <vector>
+
+/*
+    This file defines the interface of the compile server, which keeps ntsc
+    resident so that the state cached by one compilation is reused by the
+    next. Clients connect to a Unix domain socket and send the working
+    directory and the arguments of a compilation, and the server replies with
+    the exit code and everything the compilation printed. The socket is only
+    accessible to the user who started the server.
+*/
+
+namespace ntsc {
+// This struct describes a single compilation that a client asks for.
+struct CompileRequest {
+    std::string workingDirectory;
+
+    // These are the arguments of the compilation, starting with the name of
+    // the program.
+    std::vector<std::string> arguments;
+};
+
+// This is the type of the function that runs a compilation on the server. It
+// will return the exit code of the compilation.
+using CompileHandler = llvm::function_ref<int(
+    const CompileRequest &request, llvm::raw_ostream &out,
+    llvm::raw_ostream &err)>;
+
+// This function will listen on the socket at the given path and run each
+// request with the handler, one at a time. A stale socket left behind by a
+// server that exited is replaced, but a socket that another server is
+// listening on is not. It will only return if the socket cannot be used.
+auto runCompileServer(llvm::StringRef socketPath, CompileHandler handler)
+    -> std::error_code;
+
+// This function will send a request to the server listening on the socket at
+// the given path, and write what the compilation printed to the given
+// streams. It will return the exit code of the compilation.
+auto sendCompileRequest(llvm::StringRef socketPath,
+                        const CompileRequest &request, llvm::raw_ostream &out,
+                        llvm::raw_ostream &err) -> llvm::ErrorOr<int>;
+} // namespace ntsc
+
+#endif
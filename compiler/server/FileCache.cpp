@@ -0,0 +1,151 @@
+#include "FileCache.h"
+#include "TokenCache.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Support/xxhash.h"
+#include <utility>
+
+/*
+    This file implements the FileCache interface. The entries are found by the
+    absolute path of the file, so requests from different working directories
+    share them. The memory of an entry is estimated from the capacity of its
+    buffers, which is exact for the text and the columns of the tokens.
+*/
+
+#define DEBUG_TYPE "server"
+
+ALWAYS_ENABLED_STATISTIC(fileCacheHits, "Number of files reused from memory");
+ALWAYS_ENABLED_STATISTIC(fileCacheMisses, "Number of files lexed again");
+ALWAYS_ENABLED_STATISTIC(fileCacheEvictions,
+                         "Number of files evicted from memory");
+
+namespace ntsc {
+// This function will add to a counter. A statistic that is first touched while
+// the statistics are disabled is never printed, even once a later request
+// enables them, so the counters are only touched when they are enabled.
+static auto count(llvm::TrackingStatistic &statistic, unsigned amount = 1)
+    -> void {
+    if (llvm::AreStatisticsEnabled())
+        statistic += amount;
+}
+
+// This is the average memory taken by an interned string, including its entry
+// in the map of its shard and its slot in the chunks. It is used to bound the
+// IdentifierTable by the capacity of the cache.
+static constexpr size_t identifierMemorySize = 64;
+
+// This function will return the key of the file at the given path.
+static auto getEntryKey(llvm::StringRef path) -> llvm::SmallString<256> {
+    llvm::SmallString<256> key{path};
+    llvm::sys::fs::make_absolute(key);
+    return key;
+}
+
+// This is the implementation of FileCache::erase.
+auto FileCache::erase(std::list<Entry>::iterator entry) -> void {
+    memorySize -= entry->memorySize;
+    entriesByPath.erase(entry->path);
+    entries.erase(entry);
+}
+
+// This is the implementation of FileCache::lookup. When only the time of the
+// file has changed, as it does when a file is saved without edits or checked
+// out again, the contents are hashed, so the entry is not lexed again.
+auto FileCache::lookup(llvm::StringRef path,
+                       llvm::sys::fs::file_status &status)
+    -> const CachedFile * {
+    auto key = getEntryKey(path);
+    if (llvm::sys::fs::status(key, status))
+        return nullptr;
+
+    auto it = entriesByPath.find(key);
+    if (it == entriesByPath.end()) {
+        count(fileCacheMisses);
+        return nullptr;
+    }
+
+    auto entry = it->second;
+    auto &file = entry->file;
+    auto fresh = file.optionsKey == TokenCache::getOptionsKey() &&
+                 file.fileSize == status.getSize();
+    if (fresh && file.modificationTime != status.getLastModificationTime()) {
+        auto text = llvm::MemoryBuffer::getFile(key, /*IsText=*/false,
+                                                /*RequiresNullTerminator=*/
+                                                false);
+        fresh = text && (*text)->getBufferSize() == file.fileSize &&
+                llvm::xxHash64((*text)->getBuffer()) == file.hash;
+        if (fresh)
+            file.modificationTime = status.getLastModificationTime();
+    }
+    if (!fresh) {
+        erase(entry);
+        count(fileCacheMisses);
+        return nullptr;
+    }
+
+    entries.splice(entries.begin(), entries, entry);
+    count(fileCacheHits);
+    return &file;
+}
+
+// This is the implementation of FileCache::insert. The text is copied, since
+// the buffer of the SourceFile belongs to the SourceManager of the request.
+auto FileCache::insert(llvm::StringRef path,
+                       const llvm::sys::fs::file_status &status,
+                       const SourceFile &file, TokenBuffer tokens)
+    -> const CachedFile * {
+    auto key = getEntryKey(path);
+    auto it = entriesByPath.find(key);
+    if (it != entriesByPath.end()) {
+        memorySize -= it->second->memorySize;
+        entries.splice(entries.begin(), entries, it->second);
+    } else {
+        entries.emplace_front();
+        entries.front().path = std::string{key};
+        entriesByPath[key] = entries.begin();
+    }
+
+    auto &entry = entries.front();
+    tokens.shrinkToFit();
+    entry.file = CachedFile{
+        llvm::MemoryBuffer::getMemBufferCopy(file.getBuffer(), key),
+        std::move(tokens),
+        status.getLastModificationTime(),
+        status.getSize(),
+        llvm::xxHash64(file.getBuffer()),
+        TokenCache::getOptionsKey()};
+    entry.memorySize = sizeof(Entry) + entry.path.size() * 2 +
+                       entry.file.text->getBufferSize() +
+                       entry.file.tokens.getMemorySize();
+    memorySize += entry.memorySize;
+    return &entry.file;
+}
+
+// This is the implementation of FileCache::evict. The Symbols of the remaining
+// entries would dangle if the IdentifierTable were replaced on its own, so the
+// whole cache starts over once the table is too large.
+auto FileCache::evict() -> void {
+    if (identifiers->size() * identifierMemorySize > capacity) {
+        count(fileCacheEvictions, static_cast<unsigned>(entries.size()));
+        entries.clear();
+        entriesByPath.clear();
+        memorySize = 0;
+        identifiers = std::make_unique<IdentifierTable>();
+        return;
+    }
+
+    // A file that is larger than the whole cache would push out every other
+    // file before being evicted itself, so it is evicted first.
+    for (auto it = entries.begin(); it != entries.end();) {
+        auto entry = it++;
+        if (entry->memorySize > capacity) {
+            erase(entry);
+            count(fileCacheEvictions);
+        }
+    }
+    while (memorySize > capacity) {
+        erase(std::prev(entries.end()));
+        count(fileCacheEvictions);
+    }
+}
+} // namespace ntsc
@@ -0,0 +1,102 @@
+#ifndef NTSC_FILECACHE_H
+#define NTSC_FILECACHE_H
+#include "IdentifierTable.h"
+#include "SourceFile.h"
+#include "TokenBuffer.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+
+/*
+    This file defines the FileCache interface, which keeps the front end state
+    of source files in memory between the requests of a compile server. Each
+    file owns a copy of its text and the token stream the Lexer produced from
+    it, so an unchanged file is never read or lexed again. The Symbols of the
+    token streams belong to the IdentifierTable of the cache, which is shared
+    by every request. The files are evicted in least recently used order once
+    they take more memory than the capacity of the cache.
+*/
+
+namespace ntsc {
+// This struct holds the state of a single cached file.
+struct CachedFile {
+    // This is the text that the tokens were lexed from. It is null terminated.
+    std::unique_ptr<llvm::MemoryBuffer> text;
+    TokenBuffer tokens;
+
+    // These describe the file on disk when it was loaded, and they are checked
+    // before the entry is reused. When only the time has changed, the hash of
+    // the contents decides.
+    llvm::sys::TimePoint<> modificationTime;
+    uint64_t fileSize = 0;
+    uint64_t hash = 0;
+
+    // These are the bits of the options that the tokens were lexed with.
+    uint32_t optionsKey = 0;
+};
+
+class FileCache {
+    // This struct is an entry of the recency list. The list is ordered from
+    // the most recently used file to the least recently used one.
+    struct Entry {
+        std::string path;
+        CachedFile file;
+        size_t memorySize = 0;
+    };
+    std::list<Entry> entries;
+    llvm::StringMap<std::list<Entry>::iterator> entriesByPath;
+
+    // This is the number of bytes that the entries may take.
+    size_t capacity;
+    size_t memorySize = 0;
+
+    // This table interns the names of every cached token stream. It only
+    // grows, so it is dropped along with every entry once it is too large.
+    std::unique_ptr<IdentifierTable> identifiers =
+        std::make_unique<IdentifierTable>();
+
+    // This method will remove an entry.
+    auto erase(std::list<Entry>::iterator entry) -> void;
+
+  public:
+    // This constructor will create an empty cache that holds up to the given
+    // number of bytes.
+    explicit FileCache(size_t capacity) : capacity{capacity} {}
+    FileCache(const FileCache &) = delete;
+    auto operator=(const FileCache &) -> FileCache & = delete;
+
+    // This method will return the table that cached token streams refer to.
+    // Every file that may be cached must be lexed with it.
+    [[nodiscard]] inline auto getIdentifiers() -> IdentifierTable & {
+        return *identifiers;
+    }
+
+    // This method will return the cached state of the file at the given path
+    // if the file has not changed since it was cached. Otherwise, it will
+    // return null and fill in the status of the file, which must be read
+    // before the file is loaded and passed to insert, so that a change during
+    // the compilation is noticed by the next request.
+    auto lookup(llvm::StringRef path, llvm::sys::fs::file_status &status)
+        -> const CachedFile *;
+
+    // This method will add a file that lexed without errors, with the status
+    // that lookup found for it. The entry stays valid until the next call to
+    // evict. A file that is given twice is updated in place, so the entry
+    // returned for it the first time stays valid too.
+    auto insert(llvm::StringRef path, const llvm::sys::fs::file_status &status,
+                const SourceFile &file, TokenBuffer tokens)
+        -> const CachedFile *;
+
+    // This method will evict the least recently used files until the cache is
+    // within its capacity. It is called between requests, so that the files
+    // of the current request are never evicted while they are in use.
+    auto evict() -> void;
+};
+} // namespace ntsc
+
+#endif
@@ -0,0 +1,125 @@
+#include "FastScan.h"
+#include "FastScanKernels.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/*
+    This file implements the baseline scanning kernels and the selection of the
+    kernels for the host CPU. The baseline vector unit (SSE2 on x86-64 and NEON
+    on AArch64) is always available, so only the wider kernels need a runtime
+    check.
+*/
+
+namespace ntsc {
+#if defined(NTSC_FASTSCAN_AVX2)
+// This is defined in FastScanAVX2.cpp, which is built with AVX2 enabled.
+auto getAVX2ScanKernels() -> const ScanKernels &;
+#endif
+
+namespace {
+#if defined(__SSE2__)
+// This is the 16 byte vector abstraction for SSE2.
+struct SSE2 {
+    using Vec = __m128i;
+    static constexpr long width = 16;
+    static constexpr int bitsPerLane = 1;
+
+    static inline auto load(const char *ptr) -> Vec {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr));
+    }
+    static inline auto eq(Vec v, char c) -> Vec {
+        return _mm_cmpeq_epi8(v, _mm_set1_epi8(c));
+    }
+    static inline auto any(Vec a, Vec b) -> Vec { return _mm_or_si128(a, b); }
+    static inline auto both(Vec a, Vec b) -> Vec { return _mm_and_si128(a, b); }
+    static inline auto bits(Vec m) -> uint64_t {
+        return static_cast<uint32_t>(_mm_movemask_epi8(m));
+    }
+    static inline auto highBits(Vec v) -> uint64_t { return bits(v); }
+};
+
+const ScanKernels sse2Kernels{"sse2",
+                              vectorSkipHorizontalWhitespace<SSE2>,
+                              vectorSkipLineComment<SSE2>,
+                              vectorSkipBlockComment<SSE2, false>,
+                              vectorSkipStringBody<SSE2, false>,
+                              vectorSkipTemplateBody<SSE2, false>,
+                              vectorFindLineBreak<SSE2>,
+                              vectorSkipBlockComment<SSE2, true>,
+                              vectorSkipStringBody<SSE2, true>,
+                              vectorSkipTemplateBody<SSE2, true>,
+                              vectorFindInvalidUTF8<SSE2>};
+#elif defined(__ARM_NEON)
+// This is the 16 byte vector abstraction for NEON. NEON has no movemask, so we
+// narrow each byte of the comparison result to 4 bits instead.
+struct NEON {
+    using Vec = uint8x16_t;
+    static constexpr long width = 16;
+    static constexpr int bitsPerLane = 4;
+
+    static inline auto load(const char *ptr) -> Vec {
+        return vld1q_u8(reinterpret_cast<const uint8_t *>(ptr));
+    }
+    static inline auto eq(Vec v, char c) -> Vec {
+        return vceqq_u8(v, vdupq_n_u8(static_cast<uint8_t>(c)));
+    }
+    static inline auto any(Vec a, Vec b) -> Vec { return vorrq_u8(a, b); }
+    static inline auto both(Vec a, Vec b) -> Vec { return vandq_u8(a, b); }
+    static inline auto bits(Vec m) -> uint64_t {
+        auto narrowed = vshrn_n_u16(vreinterpretq_u16_u8(m), 4);
+        return vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+    }
+    static inline auto highBits(Vec v) -> uint64_t {
+        return bits(vcgeq_u8(v, vdupq_n_u8(0x80)));
+    }
+};
+
+const ScanKernels neonKernels{"neon",
+                              vectorSkipHorizontalWhitespace<NEON>,
+                              vectorSkipLineComment<NEON>,
+                              vectorSkipBlockComment<NEON, false>,
+                              vectorSkipStringBody<NEON, false>,
+                              vectorSkipTemplateBody<NEON, false>,
+                              vectorFindLineBreak<NEON>,
+                              vectorSkipBlockComment<NEON, true>,
+                              vectorSkipStringBody<NEON, true>,
+                              vectorSkipTemplateBody<NEON, true>,
+                              vectorFindInvalidUTF8<NEON>};
+#endif
+
+const ScanKernels scalarKernels{"scalar",
+                                scalarSkipHorizontalWhitespace,
+                                scalarSkipLineComment,
+                                scalarSkipBlockComment<false>,
+                                scalarSkipStringBody<false>,
+                                scalarSkipTemplateBody<false>,
+                                scalarFindLineBreak,
+                                scalarSkipBlockComment<true>,
+                                scalarSkipStringBody<true>,
+                                scalarSkipTemplateBody<true>,
+                                scalarFindInvalidUTF8};
+
+// This function will pick the widest kernels that the host CPU supports.
+auto selectScanKernels() -> const ScanKernels & {
+#if defined(NTSC_FASTSCAN_AVX2)
+    if (__builtin_cpu_supports("avx2"))
+        return getAVX2ScanKernels();
+#endif
+#if defined(__SSE2__)
+    return sse2Kernels;
+#elif defined(__ARM_NEON)
+    return neonKernels;
+#else
+    return scalarKernels;
+#endif
+}
+} // namespace
+
+const ScanKernels scanKernels = selectScanKernels();
+
+auto getScalarScanKernels() -> const ScanKernels & { return scalarKernels; }
+} // namespace ntsc
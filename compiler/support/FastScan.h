@@ -0,0 +1,78 @@
+#ifndef NTSC_FASTSCAN_H
+#define NTSC_FASTSCAN_H
+
+/*
+    This file defines the interface for the vectorized scanning kernels used by
+    the Lexer to skip over long runs of uninteresting bytes. The kernels for
+    the host CPU are selected once at startup.
+*/
+
+namespace ntsc {
+// This struct holds the set of scanning kernels for a given instruction set.
+// Every kernel starts scanning at the given pointer and returns a pointer to
+// the first byte that the Lexer needs to handle itself. The buffer must be
+// terminated by a null character at the end pointer, which is always treated
+// as a stop byte.
+struct ScanKernels {
+    // This is the name of the instruction set that the kernels were built for.
+    const char *name;
+
+    // This kernel will skip ASCII horizontal whitespace (tab, vertical tab,
+    // form feed and space).
+    const char *(*skipHorizontalWhitespace)(const char *ptr,
+                                            const char *endPtr);
+
+    // This kernel will skip the body of a single line comment. It will stop at
+    // line feeds, carriage returns, null characters and non-ASCII bytes.
+    const char *(*skipLineComment)(const char *ptr, const char *endPtr);
+
+    // This kernel will skip the body of a multi line comment. It will stop at
+    // the closing '*/', null characters and non-ASCII bytes. Line terminators
+    // are consumed in bulk, so the kernel will record whether it crossed one.
+    const char *(*skipBlockComment)(const char *ptr, const char *endPtr,
+                                    bool &sawLineTerminator);
+
+    // This kernel will skip the body of a string literal. It will stop at the
+    // given quote character, backslashes, line terminators, null characters and
+    // non-ASCII bytes.
+    const char *(*skipStringBody)(const char *ptr, const char *endPtr,
+                                  char quote);
+
+    // This kernel will skip the body of a template literal. It will stop at
+    // backticks, dollar signs, backslashes, carriage returns, null characters
+    // and non-ASCII bytes. Line feeds are part of the template.
+    const char *(*skipTemplateBody)(const char *ptr, const char *endPtr);
+
+    // This kernel will find the next byte that may begin a line terminator. It
+    // will stop at line feeds, carriage returns, null characters and the lead
+    // byte 0xE2 of U+2028 and U+2029.
+    const char *(*findLineBreak)(const char *ptr, const char *endPtr);
+
+    // These kernels are the variants of the ones above for text that is known
+    // to be valid UTF-8, so non-ASCII bytes do not need to be decoded. The
+    // literal kernels do not stop at them, and the comment kernel only stops
+    // at the lead byte 0xE2 of U+2028 and U+2029. The body of a single line
+    // comment is skipped with findLineBreak.
+    const char *(*skipValidBlockComment)(const char *ptr, const char *endPtr,
+                                         bool &sawLineTerminator);
+    const char *(*skipValidStringBody)(const char *ptr, const char *endPtr,
+                                       char quote);
+    const char *(*skipValidTemplateBody)(const char *ptr, const char *endPtr);
+
+    // This kernel will validate the UTF-8 text between the pointers, which
+    // must begin at the start of a character. It will return a pointer to the
+    // first sequence that is invalid or cut off by the end pointer, or the end
+    // pointer if the whole text is valid. Unlike the other kernels, it never
+    // reads past the end pointer, so the text does not need a terminator.
+    const char *(*findInvalidUTF8)(const char *ptr, const char *endPtr);
+};
+
+// These are the kernels chosen for the host CPU at startup.
+extern const ScanKernels scanKernels;
+
+// This function will return the portable scalar kernels. They are always
+// available and are used as the fallback when no vector unit is found.
+auto getScalarScanKernels() -> const ScanKernels &;
+} // namespace ntsc
+
+#endif
@@ -0,0 +1,193 @@
+#include "FastScan.h"
+#include "FastScanKernels.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/*
+    This file implements the 32 byte AVX2 scanning kernels. It is the only
+    translation unit built with AVX2 enabled, and the kernels are only selected
+    when the host CPU reports AVX2 support at startup. The UTF-8 validation
+    kernel relies on the byte shuffle of AVX2, so it is not built from the
+    templates the other kernels share.
+*/
+
+#if defined(__AVX2__)
+namespace ntsc {
+namespace {
+// This is the 32 byte vector abstraction for AVX2.
+struct AVX2 {
+    using Vec = __m256i;
+    static constexpr long width = 32;
+    static constexpr int bitsPerLane = 1;
+
+    static inline auto load(const char *ptr) -> Vec {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ptr));
+    }
+    static inline auto eq(Vec v, char c) -> Vec {
+        return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c));
+    }
+    static inline auto any(Vec a, Vec b) -> Vec {
+        return _mm256_or_si256(a, b);
+    }
+    static inline auto both(Vec a, Vec b) -> Vec {
+        return _mm256_and_si256(a, b);
+    }
+    static inline auto bits(Vec m) -> uint64_t {
+        return static_cast<uint32_t>(_mm256_movemask_epi8(m));
+    }
+    static inline auto highBits(Vec v) -> uint64_t { return bits(v); }
+};
+
+// This function will return the bytes of the input shifted up by N lanes, with
+// the last N bytes of the previous vector shifted in.
+template <int N>
+inline auto previousBytes(__m256i input, __m256i previous) -> __m256i {
+    return _mm256_alignr_epi8(
+        input, _mm256_permute2x128_si256(previous, input, 0x21), 16 - N);
+}
+
+// This function will look up each byte of the index, which must be below 16,
+// in a table of 16 bytes.
+inline auto lookup(__m256i index, __m128i table) -> __m256i {
+    return _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(table), index);
+}
+
+// This function will return the high nibble of each byte.
+inline auto highNibbles(__m256i v) -> __m256i {
+    return _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0f));
+}
+
+// These are the errors that a pair of bytes can reveal. Each of the three
+// tables below maps a nibble of the pair to the errors that it is consistent
+// with, so a pair is invalid when all three agree on an error. The bits of the
+// pairs are written from the high bit, and a byte past 0xF4 is too large.
+constexpr uint8_t tooShort = 1 << 0;         // 11______ 0_______ or 11______
+constexpr uint8_t tooLong = 1 << 1;          // 0_______ 10______
+constexpr uint8_t overlong3 = 1 << 2;        // 11100000 100_____
+constexpr uint8_t tooLarge = 1 << 3;         // 11110100 1001____ or 101_____
+constexpr uint8_t surrogate = 1 << 4;        // 11101101 101_____
+constexpr uint8_t overlong2 = 1 << 5;        // 1100000_ 10______
+constexpr uint8_t tooLarge1000 = 1 << 6;     // 11110101 1000____ and past it
+constexpr uint8_t overlong4 = 1 << 6;        // 11110000 1000____
+constexpr uint8_t twoContinuations = 1 << 7; // 10______ 10______
+constexpr uint8_t carry = tooShort | tooLong | twoContinuations;
+
+// This function will return the errors in the pairs of adjacent bytes of the
+// input. It is the lookup algorithm of Keiser and Lemire, "Validating UTF-8 In
+// Less Than One Instruction Per Byte". The error of a missing continuation is
+// found from the pairs, but a continuation that should be the third or fourth
+// byte of a character is checked separately.
+inline auto findPairErrors(__m256i input, __m256i previous1) -> __m256i {
+    auto firstHigh = lookup(
+        highNibbles(previous1),
+        _mm_setr_epi8(tooLong, tooLong, tooLong, tooLong, tooLong, tooLong,
+                      tooLong, tooLong, twoContinuations, twoContinuations,
+                      twoContinuations, twoContinuations, tooShort | overlong2,
+                      tooShort, tooShort | overlong3 | surrogate,
+                      tooShort | tooLarge | tooLarge1000 | overlong4));
+    auto firstLow = lookup(
+        _mm256_and_si256(previous1, _mm256_set1_epi8(0x0f)),
+        _mm_setr_epi8(carry | overlong3 | overlong2 | overlong4,
+                      carry | overlong2, carry, carry, carry | tooLarge,
+                      carry | tooLarge | tooLarge1000,
+                      carry | tooLarge | tooLarge1000,
+                      carry | tooLarge | tooLarge1000,
+                      carry | tooLarge | tooLarge1000,
+                      carry | tooLarge | tooLarge1000,
+                      carry | tooLarge | tooLarge1000,
+                      carry | tooLarge | tooLarge1000,
+                      carry | tooLarge | tooLarge1000,
+                      carry | tooLarge | tooLarge1000 | surrogate,
+                      carry | tooLarge | tooLarge1000,
+                      carry | tooLarge | tooLarge1000));
+    auto secondHigh = lookup(
+        highNibbles(input),
+        _mm_setr_epi8(tooShort, tooShort, tooShort, tooShort, tooShort,
+                      tooShort, tooShort, tooShort,
+                      static_cast<char>(tooLong | overlong2 |
+                                        twoContinuations | overlong3 |
+                                        tooLarge1000 | overlong4),
+                      static_cast<char>(tooLong | overlong2 |
+                                        twoContinuations | overlong3 |
+                                        tooLarge),
+                      static_cast<char>(tooLong | overlong2 |
+                                        twoContinuations | surrogate |
+                                        tooLarge),
+                      static_cast<char>(tooLong | overlong2 |
+                                        twoContinuations | surrogate |
+                                        tooLarge),
+                      tooShort, tooShort, tooShort, tooShort));
+    return _mm256_and_si256(_mm256_and_si256(firstHigh, firstLow),
+                            secondHigh);
+}
+
+// This function will return the errors of a vector that holds non-ASCII
+// bytes. A byte two after a lead byte of three or four bytes, or three after
+// one of four, must be a continuation. Those are exactly the bytes where the
+// pair errors report two continuations, so the high bits must match them.
+inline auto findErrors(__m256i input, __m256i previous) -> __m256i {
+    auto previous1 = previousBytes<1>(input, previous);
+    auto pairErrors = findPairErrors(input, previous1);
+
+    auto isThirdByte = _mm256_subs_epu8(previousBytes<2>(input, previous),
+                                        _mm256_set1_epi8(0xe0 - 0x80));
+    auto isFourthByte = _mm256_subs_epu8(previousBytes<3>(input, previous),
+                                         _mm256_set1_epi8(0xf0 - 0x80));
+    auto mustBeContinuation =
+        _mm256_and_si256(_mm256_or_si256(isThirdByte, isFourthByte),
+                         _mm256_set1_epi8(static_cast<char>(0x80)));
+    return _mm256_xor_si256(mustBeContinuation, pairErrors);
+}
+
+// This function will return a nonzero vector if the last character of the
+// input continues past it, which is an error if the next vector is ASCII.
+inline auto findIncomplete(__m256i input) -> __m256i {
+    auto maxValues = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, static_cast<char>(0xf0 - 1),
+        static_cast<char>(0xe0 - 1), static_cast<char>(0xc0 - 1));
+    return _mm256_subs_epu8(input, maxValues);
+}
+
+// This kernel validates 32 bytes at a time without branching on the bytes. It
+// only reports whether a vector holds an error, so the scalar kernel finds
+// where the error is, starting from the last character before that vector.
+auto avx2FindInvalidUTF8(const char *ptr, const char *endPtr) -> const char * {
+    auto *start = ptr;
+    auto previous = _mm256_setzero_si256(), incomplete = previous;
+    while (endPtr - ptr >= AVX2::width) {
+        auto input = AVX2::load(ptr);
+        __m256i errors;
+        if (AVX2::highBits(input) == 0) {
+            errors = incomplete;
+            incomplete = _mm256_setzero_si256();
+        } else {
+            errors = findErrors(input, previous);
+            incomplete = findIncomplete(input);
+        }
+        if (!_mm256_testz_si256(errors, errors))
+            break;
+        previous = input;
+        ptr += AVX2::width;
+    }
+    return scalarFindInvalidUTF8(findSequenceStart(start, ptr), endPtr);
+}
+
+const ScanKernels avx2Kernels{"avx2",
+                              vectorSkipHorizontalWhitespace<AVX2>,
+                              vectorSkipLineComment<AVX2>,
+                              vectorSkipBlockComment<AVX2, false>,
+                              vectorSkipStringBody<AVX2, false>,
+                              vectorSkipTemplateBody<AVX2, false>,
+                              vectorFindLineBreak<AVX2>,
+                              vectorSkipBlockComment<AVX2, true>,
+                              vectorSkipStringBody<AVX2, true>,
+                              vectorSkipTemplateBody<AVX2, true>,
+                              avx2FindInvalidUTF8};
+} // namespace
+
+auto getAVX2ScanKernels() -> const ScanKernels & { return avx2Kernels; }
+} // namespace ntsc
+#endif
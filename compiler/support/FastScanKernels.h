@@ -0,0 +1,335 @@
+#ifndef NTSC_FASTSCANKERNELS_H
+#define NTSC_FASTSCANKERNELS_H
+#include <cstdint>
+
+/*
+    This file implements the scanning kernels as templates over a small vector
+    abstraction. It is only included by the FastScan translation units, each of
+    which is built for a single instruction set. Everything here has internal
+    linkage so that code built for one instruction set can never be merged
+    into another translation unit by the linker.
+*/
+
+namespace ntsc {
+namespace {
+// This method will determine whether the given byte is ASCII horizontal
+// whitespace. It must match Lexer::isHorizontalWhitespace.
+[[nodiscard]] inline auto isScanWhitespace(char c) -> bool {
+    return c == 0x9 || c == 0xb || c == 0xc || c == ' ';
+}
+
+// This method will determine whether the given byte is outside of the ASCII
+// range.
+[[nodiscard]] inline auto isScanNonAscii(char c) -> bool {
+    return static_cast<uint8_t>(c) >= 0x80;
+}
+
+// These are the scalar kernels. They are the fallback for CPUs without a
+// vector unit, and they also scan the tail of the buffer for the vector
+// kernels, which cannot read a full vector past the null terminator.
+auto scalarSkipHorizontalWhitespace(const char *ptr, const char *) -> const
+    char * {
+    while (isScanWhitespace(ptr[0]))
+        ++ptr;
+    return ptr;
+}
+
+auto scalarSkipLineComment(const char *ptr, const char *) -> const char * {
+    while (ptr[0] != '\n' && ptr[0] != '\r' && ptr[0] != 0 &&
+           !isScanNonAscii(ptr[0]))
+        ++ptr;
+    return ptr;
+}
+
+// The kernels for comments and literals are also instantiated for text that
+// is known to be valid UTF-8. Those do not stop at non-ASCII bytes, except
+// that the comment kernels stop at the lead byte 0xE2 of U+2028 and U+2029.
+template <bool validUTF8>
+[[nodiscard]] inline auto isCommentStop(char c) -> bool {
+    return validUTF8 ? c == '\xe2' : isScanNonAscii(c);
+}
+
+template <bool validUTF8>
+[[nodiscard]] inline auto isLiteralStop(char c) -> bool {
+    return !validUTF8 && isScanNonAscii(c);
+}
+
+template <bool validUTF8>
+auto scalarSkipBlockComment(const char *ptr, const char *,
+                            bool &sawLineTerminator) -> const char * {
+    while (true) {
+        switch (ptr[0]) {
+        case 0:
+            return ptr;
+        case '*':
+            if (ptr[1] == '/')
+                return ptr;
+            break;
+        case '\n':
+        case '\r':
+            sawLineTerminator = true;
+            break;
+        default:
+            if (isCommentStop<validUTF8>(ptr[0]))
+                return ptr;
+        }
+        ++ptr;
+    }
+}
+
+template <bool validUTF8>
+auto scalarSkipStringBody(const char *ptr, const char *, char quote) -> const
+    char * {
+    while (ptr[0] != quote && ptr[0] != '\\' && ptr[0] != '\n' &&
+           ptr[0] != '\r' && ptr[0] != 0 &&
+           !isLiteralStop<validUTF8>(ptr[0]))
+        ++ptr;
+    return ptr;
+}
+
+template <bool validUTF8>
+auto scalarSkipTemplateBody(const char *ptr, const char *) -> const char * {
+    while (ptr[0] != '`' && ptr[0] != '$' && ptr[0] != '\\' &&
+           ptr[0] != '\r' && ptr[0] != 0 &&
+           !isLiteralStop<validUTF8>(ptr[0]))
+        ++ptr;
+    return ptr;
+}
+
+auto scalarFindLineBreak(const char *ptr, const char *) -> const char * {
+    while (ptr[0] != '\n' && ptr[0] != '\r' && ptr[0] != 0 &&
+           ptr[0] != '\xe2')
+        ++ptr;
+    return ptr;
+}
+
+// This function will return the length of the UTF-8 sequence at the pointer,
+// or 0 if it is not a valid sequence that ends by the end pointer. These are
+// the rules of llvm::convertUTF8Sequence with strict conversion, so overlong
+// forms, surrogates and code points past U+10FFFF are invalid.
+[[nodiscard]] inline auto getValidSequenceLength(const char *ptr,
+                                                 const char *endPtr) -> long {
+    auto *bytes = reinterpret_cast<const uint8_t *>(ptr);
+    auto isContinuation = [](uint8_t byte) { return (byte & 0xc0) == 0x80; };
+    auto available = endPtr - ptr;
+
+    auto lead = bytes[0];
+    if (lead < 0x80)
+        return 1;
+    if (lead < 0xc2)
+        return 0;
+    if (lead < 0xe0)
+        return available >= 2 && isContinuation(bytes[1]) ? 2 : 0;
+    if (lead < 0xf0) {
+        // The second byte is limited to reject overlong forms after 0xE0 and
+        // surrogates after 0xED.
+        auto low = lead == 0xe0 ? 0xa0 : 0x80;
+        auto high = lead == 0xed ? 0x9f : 0xbf;
+        return available >= 3 && bytes[1] >= low && bytes[1] <= high &&
+                       isContinuation(bytes[2])
+                   ? 3
+                   : 0;
+    }
+    if (lead < 0xf5) {
+        // The second byte is limited to reject overlong forms after 0xF0 and
+        // code points past U+10FFFF after 0xF4.
+        auto low = lead == 0xf0 ? 0x90 : 0x80;
+        auto high = lead == 0xf4 ? 0x8f : 0xbf;
+        return available >= 4 && bytes[1] >= low && bytes[1] <= high &&
+                       isContinuation(bytes[2]) && isContinuation(bytes[3])
+                   ? 4
+                   : 0;
+    }
+    return 0;
+}
+
+auto scalarFindInvalidUTF8(const char *ptr, const char *endPtr) -> const
+    char * {
+    while (ptr < endPtr) {
+        if (!isScanNonAscii(ptr[0])) {
+            ++ptr;
+            continue;
+        }
+        auto length = getValidSequenceLength(ptr, endPtr);
+        if (length == 0)
+            return ptr;
+        ptr += length;
+    }
+    return endPtr;
+}
+
+// This function will find where the scalar kernel must resume the validation
+// of a vector kernel. The text before the pointer is valid, except that its
+// last character may be cut off at the pointer, so the scalar kernel starts at
+// that character if it begins with one of the last three bytes.
+[[nodiscard]] inline auto findSequenceStart(const char *start, const char *ptr)
+    -> const char * {
+    for (auto *lead = ptr; lead > start && ptr - lead < 3;) {
+        auto byte = static_cast<uint8_t>(*--lead);
+        if (byte < 0x80)
+            return ptr;
+        if (byte >= 0xc0)
+            return lead;
+    }
+    return ptr;
+}
+
+// This is the portable bit scanning used on masks.
+[[nodiscard]] inline auto countTrailingZeros(uint64_t mask) -> int {
+    return __builtin_ctzll(mask);
+}
+
+// The vector kernels below are written against an abstraction V which must
+// provide:
+//  - width: the number of bytes in a vector.
+//  - bitsPerLane: the number of mask bits produced for each byte.
+//  - load(ptr): an unaligned load.
+//  - eq(v, c): a lane mask of the bytes equal to c.
+//  - any(a, b): the union of two lane masks.
+//  - both(a, b): the intersection of two lane masks.
+//  - bits(m): the lane mask compressed into an integer.
+//  - highBits(v): the compressed mask of the non-ASCII bytes of v.
+template <typename V>
+[[nodiscard]] inline auto lanesMask(int lanes) -> uint64_t {
+    auto bitCount = lanes * V::bitsPerLane;
+    return bitCount >= 64 ? ~uint64_t{0} : (uint64_t{1} << bitCount) - 1;
+}
+
+template <typename V>
+auto vectorSkipHorizontalWhitespace(const char *ptr, const char *endPtr) -> const
+    char * {
+    while (endPtr - ptr >= V::width) {
+        auto chunk = V::load(ptr);
+        auto whitespace =
+            V::any(V::any(V::eq(chunk, ' '), V::eq(chunk, '\t')),
+                   V::any(V::eq(chunk, 0xb), V::eq(chunk, 0xc)));
+        auto stop = ~V::bits(whitespace) & lanesMask<V>(V::width);
+        if (stop)
+            return ptr + countTrailingZeros(stop) / V::bitsPerLane;
+        ptr += V::width;
+    }
+    return scalarSkipHorizontalWhitespace(ptr, endPtr);
+}
+
+template <typename V>
+auto vectorSkipLineComment(const char *ptr, const char *endPtr) -> const
+    char * {
+    while (endPtr - ptr >= V::width) {
+        auto chunk = V::load(ptr);
+        auto stop = V::bits(V::any(V::any(V::eq(chunk, '\n'),
+                                          V::eq(chunk, '\r')),
+                                   V::eq(chunk, 0))) |
+                    V::highBits(chunk);
+        if (stop)
+            return ptr + countTrailingZeros(stop) / V::bitsPerLane;
+        ptr += V::width;
+    }
+    return scalarSkipLineComment(ptr, endPtr);
+}
+
+template <typename V, bool validUTF8>
+auto vectorSkipBlockComment(const char *ptr, const char *endPtr,
+                            bool &sawLineTerminator) -> const char * {
+    // The second load is one byte ahead so that we can find '*/' pairs without
+    // a loop-carried dependency. It reads at most up to the null terminator at
+    // the end pointer.
+    while (endPtr - ptr >= V::width) {
+        auto chunk = V::load(ptr), next = V::load(ptr + 1);
+        auto stop =
+            V::bits(V::any(V::both(V::eq(chunk, '*'), V::eq(next, '/')),
+                           V::eq(chunk, 0))) |
+            (validUTF8 ? V::bits(V::eq(chunk, '\xe2')) : V::highBits(chunk));
+
+        // Only the bytes before the first stop byte are consumed.
+        auto lanes = stop ? countTrailingZeros(stop) / V::bitsPerLane
+                          : static_cast<int>(V::width);
+        auto terminators =
+            V::bits(V::any(V::eq(chunk, '\n'), V::eq(chunk, '\r')));
+        if (terminators & lanesMask<V>(lanes))
+            sawLineTerminator = true;
+
+        ptr += lanes;
+        if (stop)
+            return ptr;
+    }
+    return scalarSkipBlockComment<validUTF8>(ptr, endPtr, sawLineTerminator);
+}
+
+template <typename V, bool validUTF8>
+auto vectorSkipStringBody(const char *ptr, const char *endPtr, char quote)
+    -> const char * {
+    while (endPtr - ptr >= V::width) {
+        auto chunk = V::load(ptr);
+        auto stop =
+            V::bits(V::any(V::any(V::eq(chunk, quote), V::eq(chunk, '\\')),
+                           V::any(V::any(V::eq(chunk, '\n'),
+                                         V::eq(chunk, '\r')),
+                                  V::eq(chunk, 0)))) |
+            (validUTF8 ? 0 : V::highBits(chunk));
+        if (stop)
+            return ptr + countTrailingZeros(stop) / V::bitsPerLane;
+        ptr += V::width;
+    }
+    return scalarSkipStringBody<validUTF8>(ptr, endPtr, quote);
+}
+
+template <typename V, bool validUTF8>
+auto vectorSkipTemplateBody(const char *ptr, const char *endPtr) -> const
+    char * {
+    while (endPtr - ptr >= V::width) {
+        auto chunk = V::load(ptr);
+        auto stop =
+            V::bits(V::any(V::any(V::eq(chunk, '`'), V::eq(chunk, '$')),
+                           V::any(V::any(V::eq(chunk, '\\'),
+                                         V::eq(chunk, '\r')),
+                                  V::eq(chunk, 0)))) |
+            (validUTF8 ? 0 : V::highBits(chunk));
+        if (stop)
+            return ptr + countTrailingZeros(stop) / V::bitsPerLane;
+        ptr += V::width;
+    }
+    return scalarSkipTemplateBody<validUTF8>(ptr, endPtr);
+}
+
+template <typename V>
+auto vectorFindLineBreak(const char *ptr, const char *endPtr) -> const char * {
+    while (endPtr - ptr >= V::width) {
+        auto chunk = V::load(ptr);
+        auto stop = V::bits(V::any(V::any(V::eq(chunk, '\n'),
+                                          V::eq(chunk, '\r')),
+                                   V::any(V::eq(chunk, 0),
+                                          V::eq(chunk, '\xe2'))));
+        if (stop)
+            return ptr + countTrailingZeros(stop) / V::bitsPerLane;
+        ptr += V::width;
+    }
+    return scalarFindLineBreak(ptr, endPtr);
+}
+
+// This kernel only checks the characters after a non-ASCII byte one by one,
+// so it helps most with code that is mostly ASCII. Vector units with a byte
+// shuffle validate whole vectors instead, as FastScanAVX2.cpp does.
+template <typename V>
+auto vectorFindInvalidUTF8(const char *ptr, const char *endPtr) -> const
+    char * {
+    while (endPtr - ptr >= V::width) {
+        auto nonAscii = V::highBits(V::load(ptr));
+        if (!nonAscii) {
+            ptr += V::width;
+            continue;
+        }
+
+        ptr += countTrailingZeros(nonAscii) / V::bitsPerLane;
+        do {
+            auto length = getValidSequenceLength(ptr, endPtr);
+            if (length == 0)
+                return ptr;
+            ptr += length;
+        } while (ptr < endPtr && isScanNonAscii(ptr[0]));
+    }
+    return scalarFindInvalidUTF8(ptr, endPtr);
+}
+} // namespace
+} // namespace ntsc
+
+#endif
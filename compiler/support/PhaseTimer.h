@@ -0,0 +1,35 @@
+#ifndef NTSC_PHASETIMER_H
+#define NTSC_PHASETIMER_H
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Timer.h"
+
+/*
+    This file defines the PhaseTimer interface for -ftime-report. Each phase of
+    the compiler times itself with a PhaseTimer, and every timer is added to a
+    single group, so a new phase only has to create one to appear in the
+    report.
+*/
+
+namespace ntsc {
+class PhaseTimer {
+    llvm::NamedRegionTimer timer;
+
+  public:
+    // This flag is set by -ftime-report. When it is clear, a PhaseTimer does
+    // not read the clock at all.
+    static inline auto enabled = false;
+
+    // This constructor will start timing the phase with the given name. The
+    // time is added to the phase until the PhaseTimer goes out of scope, so a
+    // phase may be timed in several parts. Timers are not thread safe, so a
+    // phase is timed on the thread that drives it.
+    PhaseTimer(llvm::StringRef name, llvm::StringRef description)
+        : timer{name, description, "ntsc", "Native-TS Compiler Phases",
+                enabled} {}
+
+    PhaseTimer(const PhaseTimer &) = delete;
+    auto operator=(const PhaseTimer &) -> PhaseTimer & = delete;
+};
+} // namespace ntsc
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef NTSC_SHARDEDMAP_H
+#define NTSC_SHARDEDMAP_H
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Optional.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+/*
+    This file defines the ShardedMap interface, which is a map that many
+    threads may read and write at once, such as a cache shared by the jobs of
+    the type checker. The entries are split into shards by the hash of the
+    key, each behind its own lock, so threads working on different keys
+    rarely wait on each other.
+*/
+
+namespace ntsc {
+template <typename Key, typename Value, unsigned ShardBits = 4>
+class ShardedMap {
+    static constexpr unsigned shardCount = 1u << ShardBits;
+
+    struct Shard {
+        mutable std::mutex mutex;
+        llvm::DenseMap<Key, Value> map;
+    };
+    std::array<Shard, shardCount> shards;
+
+    // This method will return the shard of a key. The hashes of DenseMapInfo
+    // are often weak in their high bits, which the map does not use, so the
+    // hash is mixed before the high bits pick the shard.
+    [[nodiscard]] inline auto getShard(const Key &key) const -> const Shard & {
+        uint64_t hash = llvm::DenseMapInfo<Key>::getHashValue(key);
+        return shards[(hash * 0x9e3779b97f4a7c15ull) >> (64 - ShardBits)];
+    }
+    [[nodiscard]] inline auto getShard(const Key &key) -> Shard & {
+        return const_cast<Shard &>(
+            static_cast<const ShardedMap *>(this)->getShard(key));
+    }
+
+  public:
+    ShardedMap() = default;
+    ShardedMap(const ShardedMap &) = delete;
+    auto operator=(const ShardedMap &) -> ShardedMap & = delete;
+
+    // This method will return the value of a key, if it has one.
+    [[nodiscard]] auto lookup(const Key &key) const -> llvm::Optional<Value> {
+        auto &shard = getShard(key);
+        std::lock_guard<std::mutex> lock{shard.mutex};
+        auto found = shard.map.find(key);
+        if (found == shard.map.end())
+            return llvm::None;
+        return found->second;
+    }
+
+    // This method will set the value of a key unless it already has one, and
+    // return the value the key ends up with. When two threads compute the
+    // value of a key at once, both of them see the first one.
+    auto insert(const Key &key, Value value) -> Value {
+        auto &shard = getShard(key);
+        std::lock_guard<std::mutex> lock{shard.mutex};
+        return shard.map.try_emplace(key, std::move(value)).first->second;
+    }
+
+    // This method will return the number of keys in the map.
+    [[nodiscard]] auto size() const -> size_t {
+        size_t total = 0;
+        for (auto &shard : shards) {
+            std::lock_guard<std::mutex> lock{shard.mutex};
+            total += shard.map.size();
+        }
+        return total;
+    }
+};
+} // namespace ntsc
+
+#endif
@@ -0,0 +1,117 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+/*
+    This file implements the work stealing ThreadPool.
+*/
+
+namespace ntsc {
+// This is the implementation of the constructor.
+ThreadPool::ThreadPool(unsigned threadCount) {
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    queues.reserve(threadCount);
+    for (unsigned i = 0; i < threadCount; ++i)
+        queues.push_back(std::make_unique<WorkQueue>());
+
+    workers.reserve(threadCount);
+    for (unsigned i = 0; i < threadCount; ++i)
+        workers.emplace_back([this, i] { runWorker(i); });
+}
+
+// This is the implementation of the destructor.
+ThreadPool::~ThreadPool() {
+    wait();
+    {
+        std::lock_guard<std::mutex> lock{stateMutex};
+        shuttingDown = true;
+    }
+    workAvailable.notify_all();
+    for (auto &worker : workers)
+        worker.join();
+}
+
+// This is the implementation of the method to submit a job. The job is placed
+// in a queue before it is counted, so a worker that reserves a job will always
+// find one.
+auto ThreadPool::async(std::function<void()> job) -> void {
+    size_t index;
+    {
+        std::lock_guard<std::mutex> lock{stateMutex};
+        index = nextQueue;
+        nextQueue = (nextQueue + 1) % queues.size();
+    }
+
+    {
+        auto &queue = *queues[index];
+        std::lock_guard<std::mutex> lock{queue.mutex};
+        queue.jobs.push_back(std::move(job));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{stateMutex};
+        ++queuedJobs;
+        ++pendingJobs;
+    }
+    workAvailable.notify_one();
+}
+
+// This is the implementation of the method to wait for all jobs.
+auto ThreadPool::wait() -> void {
+    std::unique_lock<std::mutex> lock{stateMutex};
+    allJobsDone.wait(lock, [this] { return pendingJobs == 0; });
+}
+
+// This is the implementation of the method to take a job. The owner takes from
+// the front of its queue, which holds the largest of its jobs when they were
+// submitted in decreasing size. Thieves take from the back, so they rarely
+// contend with the owner.
+auto ThreadPool::takeJob(size_t index) -> std::function<void()> {
+    while (true) {
+        {
+            auto &queue = *queues[index];
+            std::lock_guard<std::mutex> lock{queue.mutex};
+            if (!queue.jobs.empty()) {
+                auto job = std::move(queue.jobs.front());
+                queue.jobs.pop_front();
+                return job;
+            }
+        }
+
+        for (size_t i = 1; i < queues.size(); ++i) {
+            auto &victim = *queues[(index + i) % queues.size()];
+            std::lock_guard<std::mutex> lock{victim.mutex};
+            if (!victim.jobs.empty()) {
+                auto job = std::move(victim.jobs.back());
+                victim.jobs.pop_back();
+                return job;
+            }
+        }
+
+        // Another worker took the job we saw, but our reservation guarantees
+        // that there is another one in some queue.
+        std::this_thread::yield();
+    }
+}
+
+// This is the implementation of the worker loop.
+auto ThreadPool::runWorker(size_t index) -> void {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock{stateMutex};
+            workAvailable.wait(
+                lock, [this] { return queuedJobs > 0 || shuttingDown; });
+            if (queuedJobs == 0)
+                return;
+            --queuedJobs;
+        }
+
+        takeJob(index)();
+
+        std::lock_guard<std::mutex> lock{stateMutex};
+        if (--pendingJobs == 0)
+            allJobsDone.notify_all();
+    }
+}
+} // namespace ntsc
@@ -0,0 +1,76 @@
+#ifndef NTSC_THREADPOOL_H
+#define NTSC_THREADPOOL_H
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+    This file defines the ThreadPool interface for running independent jobs,
+    such as lexing a single file, on a fixed set of worker threads. Every
+    worker has its own queue, and idle workers steal from the queues of busy
+    ones.
+*/
+
+namespace ntsc {
+class ThreadPool {
+    // This struct is the queue of a single worker. The owner takes jobs from
+    // the front, while other workers steal from the back.
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> jobs;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::thread> workers;
+
+    // This is the queue that will receive the next submitted job. Jobs are
+    // spread over the queues in a round robin.
+    size_t nextQueue = 0;
+
+    // These track the jobs that are waiting in a queue, and the jobs that
+    // have been submitted but not yet finished. They are guarded by the state
+    // mutex.
+    std::mutex stateMutex;
+    std::condition_variable workAvailable, allJobsDone;
+    size_t queuedJobs = 0, pendingJobs = 0;
+    bool shuttingDown = false;
+
+    // This method is the main loop of each worker thread.
+    auto runWorker(size_t index) -> void;
+
+    // This method will take a job for the given worker, first from its own
+    // queue and then from the others. The caller must have reserved a job by
+    // decrementing queuedJobs, so one is guaranteed to be found.
+    auto takeJob(size_t index) -> std::function<void()>;
+
+  public:
+    // This constructor will start the given number of worker threads. A count
+    // of zero will use one thread per hardware thread.
+    explicit ThreadPool(unsigned threadCount);
+    ThreadPool(const ThreadPool &) = delete;
+    auto operator=(const ThreadPool &) -> ThreadPool & = delete;
+
+    // This destructor will wait for the remaining jobs and join the workers.
+    ~ThreadPool();
+
+    // This method will submit a job to the pool. Jobs submitted from a single
+    // thread start in roughly the order they were submitted, so callers that
+    // care about tail latency should submit the largest jobs first.
+    auto async(std::function<void()> job) -> void;
+
+    // This method will block until every submitted job has finished.
+    auto wait() -> void;
+
+    // This method will return the number of worker threads.
+    [[nodiscard]] auto getThreadCount() const -> unsigned {
+        return static_cast<unsigned>(workers.size());
+    }
+};
+} // namespace ntsc
+
+#endif
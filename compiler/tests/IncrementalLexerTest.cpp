@@ -0,0 +1,178 @@
+#include "Diagnostics.h"
+#include "IdentifierTable.h"
+#include "IncrementalLexer.h"
+#include "Lexer.h"
+#include "SourceManager.h"
+#include "TokenBuffer.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+    This file implements the differential test of the IncrementalLexer. Random
+    documents are built from fragments that stress its resynchronization, such
+    as comments, templates, regular expressions, line terminators and invalid
+    UTF-8, and edited at random. After every edit, the token stream, the
+    diagnostics and the locations of the IncrementalLexer must match a full
+    lex of the same text.
+*/
+
+using namespace ntsc;
+
+// These are the fragments that the documents and edits are built from.
+static const char *const fragments[] = {
+    "a",    " ",  "\n",   "\r\n", "\r",   "\xe2\x80\xa8", "/*", "*/",
+    "`",    "${", "}",    "{",    "(",    ")",            "if", "while",
+    "/",    "x",  "'",    "\"",   "\\",   "//",           "?.", ".",
+    "1.5",  "0x", "0x1f", "7",    "123n", "99999999999999999999999n",
+    "\xff", "\xc3", "\xa9", "\xe2", "\x80"};
+
+// This function will append the given number of random fragments to a string.
+static auto appendFragments(std::mt19937 &random, std::string &text,
+                            unsigned count) -> void {
+    for (unsigned i = 0; i < count; ++i)
+        text += fragments[random() % std::size(fragments)];
+}
+
+// This function will compare two token streams, including the values of
+// their numeric literals, and report the first difference.
+static auto compareTokens(const TokenBuffer &actual,
+                          const TokenBuffer &expected) -> bool {
+    if (actual.size() != expected.size()) {
+        llvm::errs() << "token count " << actual.size() << " != "
+                     << expected.size() << "\n";
+        return false;
+    }
+    for (size_t i = 0; i < expected.size(); ++i) {
+        auto same = actual.kind(i) == expected.kind(i) &&
+                    actual.offset(i) == expected.offset(i) &&
+                    actual.length(i) == expected.length(i) &&
+                    actual.afterLineTerminator(i) ==
+                        expected.afterLineTerminator(i);
+        if (same && isNumberLiteral(expected.kind(i)))
+            same = actual.isFloatValue(i) == expected.isFloatValue(i) &&
+                   actual.intValue(i) == expected.intValue(i);
+        else if (same && isBigIntLiteral(expected.kind(i)))
+            same = actual.bigIntLimbs(i) == expected.bigIntLimbs(i);
+        if (!same) {
+            llvm::errs() << "token " << i << " differs\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// This function will compare two lists of diagnostics. The IncrementalLexer
+// keeps them in the order of their tokens, so both are sorted by offset the
+// way the engine sorts them.
+static auto compareDiagnostics(llvm::ArrayRef<Diagnostic> actual,
+                               std::vector<Diagnostic> expected) -> bool {
+    std::vector<Diagnostic> sorted{actual.begin(), actual.end()};
+    auto byOffset = [](const Diagnostic &a, const Diagnostic &b) {
+        return a.offset < b.offset;
+    };
+    std::stable_sort(sorted.begin(), sorted.end(), byOffset);
+    std::stable_sort(expected.begin(), expected.end(), byOffset);
+    if (sorted.size() != expected.size()) {
+        llvm::errs() << "diagnostic count " << sorted.size()
+                     << " != " << expected.size() << "\n";
+        return false;
+    }
+    for (size_t i = 0; i < expected.size(); ++i) {
+        auto same = sorted[i].id == expected[i].id &&
+                    sorted[i].offset == expected[i].offset &&
+                    sorted[i].argCount == expected[i].argCount;
+        for (unsigned j = 0; same && j < expected[i].argCount; ++j)
+            same = sorted[i].args[j] == expected[i].args[j];
+        if (!same) {
+            llvm::errs() << "diagnostic " << i << " differs\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// This function will compare the locations and the valid UTF-8 of the edited
+// file with those of a fresh view of the same text. Every offset near the
+// edit is compared, and a sample of the others, which is enough to catch a
+// line start that was not moved.
+static auto compareFiles(const SourceFile &actual, const SourceFile &expected,
+                         uint32_t editOffset) -> bool {
+    if (actual.getValidUTF8End() - actual.getBufferStart() !=
+        expected.getValidUTF8End() - expected.getBufferStart()) {
+        llvm::errs() << "end of valid UTF-8 differs\n";
+        return false;
+    }
+    auto size = static_cast<uint32_t>(expected.getBuffer().size());
+    if (actual.getLineCount() != expected.getLineCount()) {
+        llvm::errs() << "line count differs\n";
+        return false;
+    }
+    for (uint32_t offset = 0; offset <= size; ++offset) {
+        if (offset % 17 != 0 &&
+            (offset + 32 < editOffset || offset > editOffset + 64))
+            continue;
+        auto a = actual.getLineAndColumn(offset);
+        auto b = expected.getLineAndColumn(offset);
+        if (a.line != b.line || a.col != b.col) {
+            llvm::errs() << "location of offset " << offset << " differs\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+auto main() -> int {
+    std::mt19937 random{20261015};
+    SourceManager sourceManager;
+    IdentifierTable identifiers;
+    unsigned editCount = 0;
+
+    for (unsigned document = 0; document < 40; ++document) {
+        std::string initial;
+        appendFragments(random, initial, 400 + random() % 2000);
+        auto id = sourceManager.addBuffer(
+            llvm::MemoryBuffer::getMemBufferCopy(initial, "test.ts"));
+        IncrementalLexer incremental{sourceManager.getFile(id), sourceManager,
+                                     identifiers};
+
+        for (unsigned edit = 0; edit < 100; ++edit, ++editCount) {
+            // Some of the edits come before the line table is built, so both
+            // the patching and the first build are covered.
+            if (edit % 7 == 3)
+                (void)incremental.getFile().getLineAndColumn(0);
+
+            auto size =
+                static_cast<uint32_t>(incremental.getFile().getBuffer().size());
+            auto offset = static_cast<uint32_t>(random() % (size + 1));
+            auto removed = std::min<uint32_t>(random() % 24, size - offset);
+            std::string inserted;
+            appendFragments(random, inserted, random() % 4);
+            incremental.applyEdit(offset, removed, inserted);
+
+            auto text = incremental.getFile().getBuffer().str();
+            SourceFile fresh{"test.ts", text.data(), text.data() + text.size(),
+                             id};
+            DiagnosticsEngine diags{sourceManager};
+            TokenBuffer tokens;
+            Lexer lexer{fresh, diags, identifiers};
+            lexer.lexAll(tokens);
+
+            if (!compareTokens(incremental.getTokens(), tokens) ||
+                !compareDiagnostics(incremental.getDiagnostics(),
+                                    diags.takeDiagnostics()) ||
+                !compareFiles(incremental.getFile(), fresh, offset)) {
+                llvm::errs() << "after edit " << edit << " of document "
+                             << document << ": replaced " << removed
+                             << " bytes at " << offset << "\n";
+                return 1;
+            }
+        }
+    }
+    llvm::outs() << editCount << " edits matched a full lex\n";
+    return 0;
+}
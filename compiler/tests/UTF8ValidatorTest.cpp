@@ -0,0 +1,101 @@
+#include "FastScan.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+
+/*
+    This file implements the differential test of the vectorized UTF-8
+    validator. Random text is built from runs of ASCII, which take the vector
+    paths, and from valid and invalid sequences, which leave them at every
+    position within a vector. The kernel chosen for the host must find the same
+    first invalid sequence as the scalar kernel, for every start and end of the
+    text.
+*/
+
+using namespace ntsc;
+
+// These are the valid sequences that the text is built from, besides ASCII.
+static const char *const validSequences[] = {
+    "\xc3\xa9", "\xe2\x80\xa8", "\xef\xbb\xbf", "\xf0\x9f\x98\x80",
+    "\xf4\x8f\xbf\xbf"};
+
+// These are the invalid sequences. They cover every rule of UTF-8: stray
+// continuation bytes, bytes that never occur, overlong forms, surrogates,
+// code points past U+10FFFF and sequences that are cut off.
+static const char *const invalidSequences[] = {
+    "\x80",
+    "\xbf",
+    "\xff",
+    "\xc0\x80",
+    "\xc1\xbf",
+    "\xe0\x80\x80",
+    "\xed\xa0\x80",
+    "\xf0\x80\x80\x80",
+    "\xf4\x90\x80\x80",
+    "\xf5\x80\x80\x80",
+    "\xc3",
+    "\xe2\x80",
+    "\xf0\x9f\x98",
+};
+
+// This function will append a run of ASCII of random length. The lengths
+// place the next sequence at every position within a vector, and the longer
+// runs fill whole vectors, which take the fast path of the kernels.
+static auto appendASCII(std::mt19937 &random, std::string &text) -> void {
+    text.append(random() % 80, static_cast<char>('a' + random() % 26));
+}
+
+auto main() -> int {
+    auto &vector = scanKernels;
+    auto &scalar = getScalarScanKernels();
+    std::mt19937 random{20261015};
+    unsigned checkCount = 0;
+
+    for (unsigned round = 0; round < 20000; ++round) {
+        // Every text is valid apart from at most one invalid sequence, so the
+        // invalid one is found after a long valid run, as it is in real files.
+        std::string text;
+        auto sequenceCount = 1 + random() % 8;
+        auto invalidIndex = random() % (sequenceCount + 1);
+        for (unsigned i = 0; i < sequenceCount; ++i) {
+            appendASCII(random, text);
+            text += i == invalidIndex
+                        ? invalidSequences[random() %
+                                           std::size(invalidSequences)]
+                        : validSequences[random() % std::size(validSequences)];
+        }
+        appendASCII(random, text);
+
+        // The text is copied to a buffer of its exact size, so a kernel that
+        // reads past the end pointer is caught by a sanitizer.
+        auto size = text.size();
+        auto buffer = std::make_unique<char[]>(size);
+        text.copy(buffer.get(), size);
+        auto *start = buffer.get();
+
+        for (unsigned check = 0; check < 8; ++check, ++checkCount) {
+            // The kernels must begin at the start of a character.
+            auto *begin = start + random() % (size / 2 + 1);
+            while (begin > start &&
+                   (static_cast<uint8_t>(begin[0]) & 0xc0) == 0x80)
+                --begin;
+            auto *end = begin + random() % (start + size - begin + 1);
+
+            auto *expected = scalar.findInvalidUTF8(begin, end);
+            auto *actual = vector.findInvalidUTF8(begin, end);
+            if (actual != expected) {
+                llvm::errs() << vector.name << " kernel found offset "
+                             << actual - begin << " but scalar kernel found "
+                             << expected - begin << " in " << end - begin
+                             << " bytes\n";
+                return 1;
+            }
+        }
+    }
+    llvm::outs() << checkCount << " ranges matched the scalar kernel with the "
+                 << vector.name << " kernels\n";
+    return 0;
+}